@@ -451,6 +451,10 @@ se::Configuration parseArgs(unsigned int argc, char** argv) {
       if (has_yaml_general_config && yaml_general_config["enable_render"]) {
         config.enable_render = yaml_general_config["enable_render"].as<bool>();
       }
+      // Asynchronous render
+      if (has_yaml_general_config && yaml_general_config["async_render"]) {
+        config.async_render = yaml_general_config["async_render"].as<bool>();
+      }
       // Render path
       if (has_yaml_general_config && yaml_general_config["output_render_path"]) {
         config.output_render_file = yaml_general_config["output_render_path"].as<std::string>();
@@ -463,6 +467,10 @@ se::Configuration parseArgs(unsigned int argc, char** argv) {
       if (has_yaml_general_config && yaml_general_config["output_mesh_path"]) {
         config.output_mesh_file = yaml_general_config["output_mesh_path"].as<std::string>();
       }
+      // Binary or ASCII mesh files
+      if (has_yaml_general_config && yaml_general_config["binary_mesh"]) {
+        config.binary_mesh = yaml_general_config["binary_mesh"].as<bool>();
+      }
       // En/disable octree structure
       if (has_yaml_general_config && yaml_general_config["enable_structure"]) {
         config.enable_structure = yaml_general_config["enable_structure"].as<bool>();
@@ -476,6 +484,10 @@ se::Configuration parseArgs(unsigned int argc, char** argv) {
       if (has_yaml_general_config && yaml_general_config["integration_rate"]) {
         config.integration_rate = yaml_general_config["integration_rate"].as<int>();
       }
+      // Integration batch size
+      if (has_yaml_general_config && yaml_general_config["integration_batch_size"]) {
+        config.integration_batch_size = yaml_general_config["integration_batch_size"].as<int>();
+      }
       // Tracking rate
       if (has_yaml_general_config && yaml_general_config["tracking_rate"]) {
         config.tracking_rate = yaml_general_config["tracking_rate"].as<int>();
@@ -510,6 +522,18 @@ se::Configuration parseArgs(unsigned int argc, char** argv) {
       if (has_yaml_general_config && yaml_general_config["render_volume_fullsize"]) {
         config.render_volume_fullsize = yaml_general_config["render_volume_fullsize"].as<bool>();
       }
+      // Raycast temporal coherence
+      if (has_yaml_general_config && yaml_general_config["raycast_temporal_coherence"]) {
+        config.raycast_temporal_coherence = yaml_general_config["raycast_temporal_coherence"].as<bool>();
+      }
+      // Raycast seed margin
+      if (has_yaml_general_config && yaml_general_config["raycast_seed_margin"]) {
+        config.raycast_seed_margin = yaml_general_config["raycast_seed_margin"].as<float>();
+      }
+      // SDF tracking
+      if (has_yaml_general_config && yaml_general_config["sdf_tracking"]) {
+        config.sdf_tracking = yaml_general_config["sdf_tracking"].as<bool>();
+      }
       // Bilateral filter
       if (has_yaml_general_config && yaml_general_config["bilateral_filter"]) {
         config.bilateral_filter = yaml_general_config["bilateral_filter"].as<bool>();
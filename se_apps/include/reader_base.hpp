@@ -115,6 +115,19 @@ namespace se {
                             Image<uint32_t>& rgba_image,
                             Eigen::Matrix4f& T_WB);
 
+      /** Same as the nextData() overloads above but reading the depth image
+       * in the integer units of the sensor. Only supported if
+       * Reader::rawDepthScale() is positive.
+       */
+      ReaderStatus nextData(Image<uint16_t>& depth_image);
+
+      ReaderStatus nextData(Image<uint16_t>& depth_image,
+                            Image<uint32_t>& rgba_image);
+
+      ReaderStatus nextData(Image<uint16_t>& depth_image,
+                            Image<uint32_t>& rgba_image,
+                            Eigen::Matrix4f& T_WB);
+
      /** Read the ground truth pose at the provided frame number.
        * Each line in the ground truth file should correspond to a single
        * depth/RGBA image pair and have a format<br>
@@ -172,6 +185,14 @@ namespace se {
        */
       Eigen::Vector2i depthImageRes() const;
 
+      /** The factor converting the depth images read in the integer units of
+       * the sensor to meters.
+       *
+       * \return The factor, e.g. 0.001 for millimeters. Returns 0 if the
+       *         reader can only read depth images in meters.
+       */
+      float rawDepthScale() const;
+
       /** The dimensions of the RGBA images.
        *
        * \return A 2D vector containing the width and height of the images.
@@ -211,6 +232,7 @@ namespace se {
       std::ifstream ground_truth_fs_;
       Eigen::Vector2i depth_image_res_;
       Eigen::Vector2i rgba_image_res_;
+      float raw_depth_scale_;
       float fps_;
       double spf_;
       bool drop_frames_;
@@ -266,6 +288,16 @@ namespace se {
        */
       void nextFrame();
 
+      /** Read the next frame, implementing all nextData() overloads. The
+       * depth image is read with next_depth. The RGBA image and pose are not
+       * read if rgba_image or T_WB respectively are nullptr.
+       */
+      template <typename DepthT>
+      ReaderStatus nextFrameData(ReaderStatus (Reader::*next_depth)(Image<DepthT>&),
+                                 Image<DepthT>&   depth_image,
+                                 Image<uint32_t>* rgba_image,
+                                 Eigen::Matrix4f* T_WB);
+
       /** Read the next depth image.
        *
        * \param[out] depth_image The next depth image.
@@ -273,6 +305,15 @@ namespace se {
        */
       virtual ReaderStatus nextDepth(Image<float>& depth_image) = 0;
 
+      /** Read the next depth image in the integer units of the sensor.
+       * Readers setting Reader::raw_depth_scale_ must override this.
+       *
+       * \param[out] depth_image The next depth image.
+       * \return An appropriate status code. The default implementation
+       *         returns se::ReaderStatus::error.
+       */
+      virtual ReaderStatus nextRawDepth(Image<uint16_t>& depth_image);
+
       /** Read the next RGBA image.
        *
        * \param[out] rgba_image The next RGBA image.
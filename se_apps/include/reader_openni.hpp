@@ -72,10 +72,16 @@ namespace se {
       openni::VideoFrameRef rgb_frame_;
       std::unique_ptr<uint16_t> depth_image_;
       std::unique_ptr<uint8_t> rgb_image_;
+
+      /** Read the next depth and RGB frames into depth_image_ and
+       * rgb_image_. */
+      ReaderStatus readFrames();
 #endif
 
       ReaderStatus nextDepth(Image<float>& depth_image);
 
+      ReaderStatus nextRawDepth(Image<uint16_t>& depth_image);
+
       ReaderStatus nextRGBA(Image<uint32_t>& rgba_image);
   };
 
@@ -61,6 +61,8 @@ namespace se {
 
       ReaderStatus nextDepth(Image<float>& depth_image);
 
+      ReaderStatus nextRawDepth(Image<uint16_t>& depth_image);
+
       ReaderStatus nextRGBA(Image<uint32_t>& rgba_image);
   };
 
@@ -260,7 +260,8 @@ int processAll(se::Reader*        reader,
   bool tracked = false;
   bool integrated = false;
   const bool track = !config->enable_ground_truth;
-  const bool raycast = (track || render_images);
+  // SDF tracking doesn't need a raycast of the map, only rendering does.
+  const bool raycast = ((track && !pipeline->usesSDFTracking()) || render_images);
   int frame = 0;
   const Eigen::Vector2i input_image_res = (reader != nullptr)
       ? reader->depthImageRes()
@@ -279,6 +280,10 @@ int processAll(se::Reader*        reader,
                            azimuth_angles, elevation_angles});
 
   static se::Image<float> input_depth_image (input_image_res.x(), input_image_res.y());
+  // Read the depth in the units of the sensor if possible, it's converted to
+  // meters while downsampling.
+  static se::Image<uint16_t> input_raw_depth_image (input_image_res.x(), input_image_res.y());
+  const bool raw_depth = (reader != nullptr) && (reader->rawDepthScale() > 0.f);
   static se::Image<uint32_t> input_rgba_image (input_image_res.x(), input_image_res.y());
 
   Eigen::Matrix4f T_WB;
@@ -308,9 +313,13 @@ int processAll(se::Reader*        reader,
     se::ReaderStatus read_ok;
     TICK("ACQUISITION")
     if (config->enable_ground_truth) {
-      read_ok = reader->nextData(input_depth_image, input_rgba_image, T_WB);
+      read_ok = raw_depth
+          ? reader->nextData(input_raw_depth_image, input_rgba_image, T_WB)
+          : reader->nextData(input_depth_image, input_rgba_image, T_WB);
     } else {
-      read_ok = reader->nextData(input_depth_image, input_rgba_image);
+      read_ok = raw_depth
+          ? reader->nextData(input_raw_depth_image, input_rgba_image)
+          : reader->nextData(input_depth_image, input_rgba_image);
     }
     size_t reader_frame = reader->frame();
     se::perfstats.setIter(reader_frame);
@@ -326,6 +335,7 @@ int processAll(se::Reader*        reader,
       return false;
     } else {
       // Finish processing if the next frame could not be read
+      pipeline->flushIntegration();
       timings[0] = std::chrono::steady_clock::now();
       TOCK("COMPUTATION")
       TOCK("TOTAL")
@@ -333,6 +343,7 @@ int processAll(se::Reader*        reader,
     }
 
     if (config->max_frame != -1 && frame > config->max_frame) {
+      pipeline->flushIntegration();
       timings[0] = std::chrono::steady_clock::now();
       TOCK("COMPUTATION")
       TOCK("TOTAL")
@@ -342,15 +353,20 @@ int processAll(se::Reader*        reader,
       power_monitor->start();
 
     TICK("PREPROCESSING")
-    pipeline->preprocessDepth(input_depth_image.data(), input_image_res,
-        config->bilateral_filter);
+    if (raw_depth) {
+      pipeline->preprocessDepth(input_raw_depth_image.data(), input_image_res,
+          reader->rawDepthScale(), config->bilateral_filter);
+    } else {
+      pipeline->preprocessDepth(input_depth_image.data(), input_image_res,
+          config->bilateral_filter);
+    }
     pipeline->preprocessColor(input_rgba_image.data(), input_image_res);
     TOCK("PREPROCESSING")
 
     if (track) {
       // No ground truth used, call track every tracking_rate frames.
       if (frame % config->tracking_rate == 0) {
-        tracked = pipeline->track(sensor, config->icp_threshold);
+        tracked = pipeline->track(sensor, config->icp_threshold, render_images);
       } else {
         tracked = false;
       }
@@ -370,6 +386,11 @@ int processAll(se::Reader*        reader,
       integrated = false;
     }
 
+    // Integrate the frames still queued in the last batch.
+    if (frame == config->max_frame) {
+      pipeline->flushIntegration();
+    }
+
     if (raycast && frame > 2) {
       pipeline->raycast(sensor);
     }
@@ -385,11 +406,24 @@ int processAll(se::Reader*        reader,
       render_volume = (config->rendering_rate < 0) ?
           frame == std::abs(config->rendering_rate) : frame % config->rendering_rate == 0;
     }
-    pipeline->renderRGBA(rgba_render, pipeline->getImageResolution());
-    pipeline->renderDepth(depth_render, pipeline->getImageResolution(), sensor);
-    pipeline->renderTrack(track_render, pipeline->getImageResolution());
-    if (render_volume) {
-      pipeline->renderVolume(volume_render, pipeline->getImageResolution(), sensor);
+    if (config->async_render) {
+      // Show the latest images rendered in the background. Volume renders
+      // that are saved must be of the current frame.
+      const bool save_volume = render_volume && config->output_render_file != "";
+      const bool requested = pipeline->requestRender(sensor, render_volume && !save_volume);
+      se::perfstats.sample("render_dropped", !requested, PerfStats::BOOL);
+      pipeline->renderedImages(rgba_render, depth_render, track_render,
+          save_volume ? nullptr : volume_render);
+      if (save_volume) {
+        pipeline->renderVolume(volume_render, pipeline->getImageResolution(), sensor);
+      }
+    } else {
+      pipeline->renderRGBA(rgba_render, pipeline->getImageResolution());
+      pipeline->renderDepth(depth_render, pipeline->getImageResolution(), sensor);
+      pipeline->renderTrack(track_render, pipeline->getImageResolution());
+      if (render_volume) {
+        pipeline->renderVolume(volume_render, pipeline->getImageResolution(), sensor);
+      }
     }
     TOCK("RENDERING")
   }
@@ -428,7 +462,8 @@ int processAll(se::Reader*        reader,
     std::stringstream output_mesh_file_ss;
     output_mesh_file_ss << config->output_mesh_file << "_frame_"
                           << std::setw(4) << std::setfill('0') << frame << ".vtk";
-    pipeline->dumpMesh(output_mesh_file_ss.str().c_str(), !config->enable_benchmark);
+    pipeline->dumpMesh(output_mesh_file_ss.str().c_str(), !config->enable_benchmark, 0,
+        config->binary_mesh);
   }
 
   //  ===  SAVE OCTREE STRUCTURE AND SLICE ===
@@ -26,6 +26,7 @@ se::Reader::Reader(const se::ReaderConfig& c)
       ground_truth_file_(c.ground_truth_file),
       depth_image_res_(1, 1),
       rgba_image_res_(1, 1),
+      raw_depth_scale_(0.f),
       fps_(c.fps),
       spf_(1.0 / c.fps),
       drop_frames_(c.drop_frames),
@@ -59,12 +60,22 @@ se::Reader::Reader(const se::ReaderConfig& c)
 
 
 
-se::ReaderStatus se::Reader::nextData(se::Image<float>& depth_image) {
+template <typename DepthT>
+se::ReaderStatus se::Reader::nextFrameData(se::ReaderStatus (se::Reader::*next_depth)(se::Image<DepthT>&),
+                                           se::Image<DepthT>&   depth_image,
+                                           se::Image<uint32_t>* rgba_image,
+                                           Eigen::Matrix4f*     T_WB) {
   if (!good()) {
     return status_;
   }
   nextFrame();
-  status_ = nextDepth(depth_image);
+  status_ = (this->*next_depth)(depth_image);
+  if (good() && rgba_image) {
+    status_ = mergeStatus(nextRGBA(*rgba_image), status_);
+  }
+  if (good() && T_WB) {
+    status_ = mergeStatus(nextPose(*T_WB), status_);
+  }
   if (!good()) {
     camera_active_ = false;
     camera_open_ = false;
@@ -74,24 +85,15 @@ se::ReaderStatus se::Reader::nextData(se::Image<float>& depth_image) {
 
 
 
+se::ReaderStatus se::Reader::nextData(se::Image<float>& depth_image) {
+  return nextFrameData(&se::Reader::nextDepth, depth_image, nullptr, nullptr);
+}
+
+
+
 se::ReaderStatus se::Reader::nextData(se::Image<float>&    depth_image,
                                       se::Image<uint32_t>& rgba_image) {
-  if (!good()) {
-    return status_;
-  }
-  nextFrame();
-  status_ = nextDepth(depth_image);
-  if (!good()) {
-    camera_active_ = false;
-    camera_open_ = false;
-    return status_;
-  }
-  status_ = mergeStatus(nextRGBA(rgba_image), status_);
-  if (!good()) {
-    camera_active_ = false;
-    camera_open_ = false;
-  }
-  return status_;
+  return nextFrameData(&se::Reader::nextDepth, depth_image, &rgba_image, nullptr);
 }
 
 
@@ -99,28 +101,28 @@ se::ReaderStatus se::Reader::nextData(se::Image<float>&    depth_image,
 se::ReaderStatus se::Reader::nextData(se::Image<float>&    depth_image,
                                       se::Image<uint32_t>& rgba_image,
                                       Eigen::Matrix4f&     T_WB) {
-  if (!good()) {
-    return status_;
-  }
-  nextFrame();
-  status_ = nextDepth(depth_image);
-  if (!good()) {
-    camera_active_ = false;
-    camera_open_ = false;
-    return status_;
-  }
-  status_ = mergeStatus(nextRGBA(rgba_image), status_);
-  if (!good()) {
-    camera_active_ = false;
-    camera_open_ = false;
-    return status_;
-  }
-  status_ = mergeStatus(nextPose(T_WB), status_);
-  if (!good()) {
-    camera_active_ = false;
-    camera_open_ = false;
-  }
-  return status_;
+  return nextFrameData(&se::Reader::nextDepth, depth_image, &rgba_image, &T_WB);
+}
+
+
+
+se::ReaderStatus se::Reader::nextData(se::Image<uint16_t>& depth_image) {
+  return nextFrameData(&se::Reader::nextRawDepth, depth_image, nullptr, nullptr);
+}
+
+
+
+se::ReaderStatus se::Reader::nextData(se::Image<uint16_t>& depth_image,
+                                      se::Image<uint32_t>& rgba_image) {
+  return nextFrameData(&se::Reader::nextRawDepth, depth_image, &rgba_image, nullptr);
+}
+
+
+
+se::ReaderStatus se::Reader::nextData(se::Image<uint16_t>& depth_image,
+                                      se::Image<uint32_t>& rgba_image,
+                                      Eigen::Matrix4f&     T_WB) {
+  return nextFrameData(&se::Reader::nextRawDepth, depth_image, &rgba_image, &T_WB);
 }
 
 
@@ -162,6 +164,12 @@ Eigen::Vector2i se::Reader::depthImageRes() const {
 
 
 
+float se::Reader::rawDepthScale() const {
+  return raw_depth_scale_;
+}
+
+
+
 Eigen::Vector2i se::Reader::RGBAImageRes() const {
   return rgba_image_res_;
 }
@@ -279,6 +287,12 @@ se::ReaderStatus se::Reader::readPose(Eigen::Matrix4f& T_WB, const size_t frame)
 }
 
 
+se::ReaderStatus se::Reader::nextRawDepth(se::Image<uint16_t>&) {
+  return se::ReaderStatus::error;
+}
+
+
+
 void se::Reader::nextFrame() {
   // Just increment the frame number when no FPS was specified or a live camera
   // is being used.
@@ -8,6 +8,7 @@
 
 #include "reader_openni.hpp"
 
+#include <cstring>
 #include <iostream>
 
 #include "se/image_utils.hpp"
@@ -22,6 +23,8 @@ se::OpenNIReader::OpenNIReader(const se::ReaderConfig& c)
       rgb_image_(nullptr) {
   // Ensure this is handled as a live camera reader.
   is_live_reader_ = true;
+  // The depth is read in millimeters, see OpenNIReader::readFrames().
+  raw_depth_scale_ = 0.001f;
   // Initialize OpenNI
   rc_ = openni::OpenNI::initialize();
   if (rc_ != openni::STATUS_OK) {
@@ -187,7 +190,7 @@ std::string se::OpenNIReader::name() const {
 
 
 
-se::ReaderStatus se::OpenNIReader::nextDepth(se::Image<float>& depth_image) {
+se::ReaderStatus se::OpenNIReader::readFrames() {
   rc_ = depth_stream_.readFrame(&depth_frame_);
   if (rc_ != openni::STATUS_OK) {
     std::cerr << "Error: Wait for depth image failed\n";
@@ -208,6 +211,16 @@ se::ReaderStatus se::OpenNIReader::nextDepth(se::Image<float>& depth_image) {
     std::cerr << "Error: Unexpected RGB image format\n";
     return se::ReaderStatus::error;
   }
+  return se::ReaderStatus::ok;
+}
+
+
+
+se::ReaderStatus se::OpenNIReader::nextDepth(se::Image<float>& depth_image) {
+  const se::ReaderStatus status = readFrames();
+  if (status != se::ReaderStatus::ok) {
+    return status;
+  }
 
   // Resize the output image if needed.
   if ((depth_image.width() != depth_image_res_.x())
@@ -225,6 +238,25 @@ se::ReaderStatus se::OpenNIReader::nextDepth(se::Image<float>& depth_image) {
 
 
 
+se::ReaderStatus se::OpenNIReader::nextRawDepth(se::Image<uint16_t>& depth_image) {
+  const se::ReaderStatus status = readFrames();
+  if (status != se::ReaderStatus::ok) {
+    return status;
+  }
+
+  // Resize the output image if needed.
+  if ((depth_image.width() != depth_image_res_.x())
+      || (depth_image.height() != depth_image_res_.y())) {
+    depth_image = se::Image<uint16_t>(depth_image_res_.x(), depth_image_res_.y());
+  }
+
+  std::memcpy(depth_image.data(), depth_image_.get(), sizeof(uint16_t) * depth_image_res_.prod());
+
+  return se::ReaderStatus::ok;
+}
+
+
+
 se::ReaderStatus se::OpenNIReader::nextRGBA(se::Image<uint32_t>& rgba_image) {
   // Resize the output image if needed.
   if ((rgba_image.width() != rgba_image_res_.x())
@@ -274,6 +306,12 @@ se::ReaderStatus se::OpenNIReader::nextDepth(se::Image<float>&) {
 
 
 
+se::ReaderStatus se::OpenNIReader::nextRawDepth(se::Image<uint16_t>&) {
+  return se::ReaderStatus::error;
+}
+
+
+
 se::ReaderStatus se::OpenNIReader::nextRGBA(se::Image<uint32_t>&) {
   return se::ReaderStatus::error;
 }
@@ -21,6 +21,8 @@ constexpr size_t se::RAWReader::res_size_;
 
 se::RAWReader::RAWReader(const se::ReaderConfig& c)
     : se::Reader(c) {
+  // The depth is stored in millimeters.
+  raw_depth_scale_ = 0.001f;
   // Open the .raw file for reading.
   raw_fs_.open(sequence_path_, std::ios::in | std::ios::binary);
   if (!raw_fs_.good()) {
@@ -106,6 +108,26 @@ bool se::RAWReader::readResolution(std::ifstream& fs, Eigen::Vector2i& res) {
 
 
 se::ReaderStatus se::RAWReader::nextDepth(se::Image<float>& depth_image) {
+  se::Image<uint16_t> raw_depth_image (depth_image.width(), depth_image.height());
+  const se::ReaderStatus status = nextRawDepth(raw_depth_image);
+  if (status != se::ReaderStatus::ok) {
+    return status;
+  }
+  // Resize the output image if needed.
+  if ((depth_image.width() != raw_depth_image.width())
+      || (depth_image.height() != raw_depth_image.height())) {
+    depth_image = se::Image<float>(raw_depth_image.width(), raw_depth_image.height());
+  }
+  // Scale the data from millimeters to meters.
+  for (size_t p = 0; p < depth_image.size(); ++p) {
+    depth_image[p] = raw_depth_scale_ * raw_depth_image[p];
+  }
+  return se::ReaderStatus::ok;
+}
+
+
+
+se::ReaderStatus se::RAWReader::nextRawDepth(se::Image<uint16_t>& depth_image) {
   // Seek to the appropriate place in the file.
   raw_fs_.seekg(frame_ * (depth_total_size_ + rgba_total_size_));
   // Read the image dimensions.
@@ -115,16 +137,12 @@ se::ReaderStatus se::RAWReader::nextDepth(se::Image<float>& depth_image) {
   }
   // Resize the output image if needed.
   if ((depth_image.width() != size.x()) || (depth_image.height() != size.y())) {
-    depth_image = se::Image<float>(size.x(), size.y());
+    depth_image = se::Image<uint16_t>(size.x(), size.y());
   }
-  // Read the image data pixel-by-pixel.
-  for (size_t p = 0; p < depth_image.size(); ++p) {
-    uint16_t pixel;
-    if (!raw_fs_.read(reinterpret_cast<char*>(&pixel), depth_pixel_size_)) {
-      return se::ReaderStatus::error;
-    }
-    // Scale the data from millimeters to meters.
-    depth_image[p] = pixel / 1000.f;
+  // Read the image data, it's stored in the same format as the image.
+  if (!raw_fs_.read(reinterpret_cast<char*>(depth_image.data()),
+        depth_pixel_size_ * depth_image.size())) {
+    return se::ReaderStatus::error;
   }
   return se::ReaderStatus::ok;
 }
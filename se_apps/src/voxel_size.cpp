@@ -5,6 +5,7 @@
 #include <cstdio>
 
 #include <se/octree_iterator.hpp>
+#include <se/voxel_implementations/MultiresOFusion/MultiresOFusion.hpp>
 #include <se/voxel_implementations/MultiresTSDF/MultiresTSDF.hpp>
 #include <se/voxel_implementations/OFusion/OFusion.hpp>
 #include <se/voxel_implementations/TSDF/TSDF.hpp>
@@ -16,6 +17,7 @@
 #define VOXEL_IMPLS \
   X(TSDF) \
   X(OFusion) \
+  X(MultiresOFusion) \
   X(MultiresTSDF)
 
 // The length of the longest voxel implementation name, used for alignment when
@@ -126,3 +126,26 @@ TEST_F(TestRAWDataset, ReadDepthRGBAPose) {
   }
 }
 
+
+
+TEST_F(TestRAWDataset, ReadRawDepth) {
+  se::RAWReader reader (config_);
+  ASSERT_TRUE(reader.good());
+  ASSERT_FLOAT_EQ(reader.rawDepthScale(), 0.001f);
+
+  se::Image<uint16_t> depth_image (1, 1);
+  se::Image<uint32_t> rgba_image (1, 1);
+  size_t frame = 0;
+  while (reader.nextData(depth_image, rgba_image) == se::ReaderStatus::ok) {
+    ASSERT_EQ(reader.frame(), frame);
+    ASSERT_EQ(static_cast<size_t>(depth_image.width()), width_);
+    ASSERT_EQ(static_cast<size_t>(depth_image.height()), height_);
+    for (size_t pixel = 0; pixel < depth_image.size(); ++pixel) {
+      ASSERT_EQ(depth_image[pixel], 1000 * (frame + pixel));
+      ASSERT_EQ(rgba_image[pixel], 0xFF000000 + frame + 10 * pixel);
+    }
+    frame++;
+  }
+  ASSERT_EQ(frame, num_frames_);
+  ASSERT_FALSE(reader.good());
+}
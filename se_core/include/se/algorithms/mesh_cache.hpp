@@ -0,0 +1,283 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../octree.hpp"
+#include "meshing.hpp"
+
+namespace se {
+
+/*! \brief Cache the indexed mesh of each VoxelBlock of an Octree so that only
+ * the VoxelBlocks updated since the last extraction need to be meshed again.
+ *
+ * The mesh of each VoxelBlock is stored under its Morton code together with
+ * the VoxelBlock timestamp it was created from. A VoxelBlock is considered
+ * updated when its timestamp differs from the cached one, i.e. the voxel
+ * implementations must set the timestamp of each VoxelBlock they integrate
+ * into to the frame number. Since the triangles of a VoxelBlock depend on the
+ * voxels of its 26 neighbours, the neighbours of updated, allocated and
+ * deallocated VoxelBlocks are meshed again too. Where a neighbour isn't
+ * allocated the triangles depend on the data of the Node covering it instead,
+ * which the voxel implementations update without touching any VoxelBlock
+ * timestamp. That data is cached with the mesh and the VoxelBlock is meshed
+ * again when it changes.
+ */
+template <typename FieldType>
+class MeshCache {
+
+  public:
+    using VoxelBlockType = typename FieldType::VoxelBlockType;
+    using VoxelData = typename FieldType::VoxelData;
+
+    /*! \brief Mesh the VoxelBlocks of map that were updated since the last
+     * call.
+     *
+     * \param[in] map        The octree to mesh.
+     * \param[in] mesh_block The function creating the mesh of a single
+     *                       VoxelBlock with signature
+     *                       `void(Octree<FieldType>&, const VoxelBlockType*,
+     *                       IndexedMesh&)`.
+     * \return The number of VoxelBlocks that were meshed.
+     */
+    template <typename BlockMesherT>
+    size_t update(Octree<FieldType>& map, BlockMesherT mesh_block);
+
+    /*! \brief Add the mesh of all the VoxelBlocks to mesh. The vertices
+     * shared by neighbouring VoxelBlocks are only added once.
+     */
+    void mesh(IndexedMesh& mesh) const;
+
+    /*! \brief Add the mesh of the VoxelBlocks meshed by the last call to
+     * update() to mesh. Together with updatedBlocks() and removedBlocks() it
+     * allows keeping a copy of the mesh in sync without copying all of it.
+     */
+    void deltaMesh(IndexedMesh& mesh) const;
+
+    /*! \brief The Morton codes of the VoxelBlocks meshed by the last call to
+     * update(). Their previous triangles should be replaced by those returned
+     * by blockMesh().
+     */
+    const std::vector<key_t>& updatedBlocks() const { return updated_blocks_; }
+
+    /*! \brief The Morton codes of the VoxelBlocks that were deallocated since
+     * the previous call to update(). Their triangles should be discarded.
+     */
+    const std::vector<key_t>& removedBlocks() const { return removed_blocks_; }
+
+    /*! \brief The mesh of the VoxelBlock with Morton code block_key. Empty if
+     * the VoxelBlock isn't cached.
+     */
+    const IndexedMesh& blockMesh(const key_t block_key) const;
+
+    /*! \brief The number of cached VoxelBlocks.
+     */
+    size_t size() const { return cache_.size(); }
+
+    /*! \brief Remove all the cached meshes.
+     */
+    void clear();
+
+  private:
+    struct BlockMesh {
+      unsigned int timestamp;
+      std::vector<VoxelData> neighbour_node_data;
+      IndexedMesh mesh;
+    };
+
+    /*! \brief The Node data of the unallocated neighbours of the VoxelBlock at
+     * block_coord, in a fixed neighbour order.
+     */
+    static std::vector<VoxelData> neighbourNodeData(Octree<FieldType>&               map,
+                                                    const Eigen::Vector3i&           block_coord,
+                                                    const std::unordered_set<key_t>& allocated_keys);
+
+    static bool equalData(const std::vector<VoxelData>& data_0,
+                          const std::vector<VoxelData>& data_1) {
+      // Bytewise, VoxelData has no comparison operator. Differing padding
+      // only causes a VoxelBlock to be meshed again needlessly.
+      return data_0.size() == data_1.size()
+          && std::memcmp(data_0.data(), data_1.data(), data_0.size() * sizeof(VoxelData)) == 0;
+    }
+
+    std::unordered_map<key_t, BlockMesh> cache_;
+    std::vector<key_t> updated_blocks_;
+    std::vector<key_t> removed_blocks_;
+    IndexedMesh empty_mesh_;
+};
+
+
+
+template <typename FieldType>
+template <typename BlockMesherT>
+size_t MeshCache<FieldType>::update(Octree<FieldType>& map,
+                                    BlockMesherT       mesh_block) {
+
+  const int block_size = VoxelBlockType::size_li;
+  const int map_size = map.size();
+  std::vector<VoxelBlockType*> block_list;
+  map.getBlockList(block_list, false);
+  std::vector<key_t> block_keys (block_list.size());
+  for (size_t i = 0; i < block_list.size(); ++i) {
+    const Eigen::Vector3i block_coord = block_list[i]->coordinates();
+    block_keys[i] = map.hash(block_coord.x(), block_coord.y(), block_coord.z());
+  }
+
+  // Find the VoxelBlocks whose voxels changed since they were last meshed and
+  // the ones whose unallocated neighbours' Node data changed. The latter
+  // don't affect the mesh of their neighbours.
+  std::unordered_set<key_t> changed_keys;
+  std::unordered_set<key_t> allocated_keys (block_keys.begin(), block_keys.end());
+  std::vector<std::vector<VoxelData>> neighbour_node_data (block_list.size());
+  std::vector<char> node_data_changed (block_list.size(), false);
+#pragma omp parallel for
+  for (size_t i = 0; i < block_list.size(); ++i) {
+    neighbour_node_data[i] = neighbourNodeData(map, block_list[i]->coordinates(), allocated_keys);
+    const auto cached = cache_.find(block_keys[i]);
+    node_data_changed[i] = cached != cache_.end()
+        && !equalData(cached->second.neighbour_node_data, neighbour_node_data[i]);
+  }
+  for (size_t i = 0; i < block_list.size(); ++i) {
+    const auto cached = cache_.find(block_keys[i]);
+    if (cached == cache_.end() || cached->second.timestamp != block_list[i]->timestamp()) {
+      changed_keys.insert(block_keys[i]);
+    }
+  }
+  removed_blocks_.clear();
+  for (auto it = cache_.begin(); it != cache_.end(); ) {
+    if (allocated_keys.count(it->first) == 0) {
+      changed_keys.insert(it->first);
+      removed_blocks_.push_back(it->first);
+      it = cache_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  // Mesh the changed VoxelBlocks and their neighbours.
+  std::vector<size_t> dirty_idxs;
+  for (size_t i = 0; i < block_list.size(); ++i) {
+    const Eigen::Vector3i block_coord = block_list[i]->coordinates();
+    bool dirty = node_data_changed[i];
+    if (!changed_keys.empty()) {
+      for (int dz = -1; dz <= 1 && !dirty; ++dz) {
+        for (int dy = -1; dy <= 1 && !dirty; ++dy) {
+          for (int dx = -1; dx <= 1 && !dirty; ++dx) {
+            const Eigen::Vector3i neighbour_coord = block_coord + block_size * Eigen::Vector3i(dx, dy, dz);
+            if ((neighbour_coord.array() < 0).any() || (neighbour_coord.array() >= map_size).any()) {
+              continue;
+            }
+            dirty = changed_keys.count(
+                map.hash(neighbour_coord.x(), neighbour_coord.y(), neighbour_coord.z())) > 0;
+          }
+        }
+      }
+    }
+    if (dirty) {
+      dirty_idxs.push_back(i);
+    }
+  }
+
+  std::vector<BlockMesh> block_meshes (dirty_idxs.size());
+#pragma omp parallel for schedule(dynamic)
+  for (size_t i = 0; i < dirty_idxs.size(); ++i) {
+    const VoxelBlockType* block = block_list[dirty_idxs[i]];
+    block_meshes[i].timestamp = block->timestamp();
+    block_meshes[i].neighbour_node_data = std::move(neighbour_node_data[dirty_idxs[i]]);
+    mesh_block(map, block, block_meshes[i].mesh);
+  }
+
+  updated_blocks_.resize(dirty_idxs.size());
+  for (size_t i = 0; i < dirty_idxs.size(); ++i) {
+    updated_blocks_[i] = block_keys[dirty_idxs[i]];
+    cache_[updated_blocks_[i]] = std::move(block_meshes[i]);
+  }
+  return dirty_idxs.size();
+}
+
+
+
+template <typename FieldType>
+std::vector<typename FieldType::VoxelData> MeshCache<FieldType>::neighbourNodeData(
+    Octree<FieldType>&               map,
+    const Eigen::Vector3i&           block_coord,
+    const std::unordered_set<key_t>& allocated_keys) {
+
+  const int block_size = VoxelBlockType::size_li;
+  const int map_size = map.size();
+  std::vector<VoxelData> neighbour_node_data;
+  for (int dz = -1; dz <= 1; ++dz) {
+    for (int dy = -1; dy <= 1; ++dy) {
+      for (int dx = -1; dx <= 1; ++dx) {
+        const Eigen::Vector3i neighbour_coord = block_coord + block_size * Eigen::Vector3i(dx, dy, dz);
+        if ((neighbour_coord.array() < 0).any() || (neighbour_coord.array() >= map_size).any()
+            || allocated_keys.count(map.hash(neighbour_coord.x(), neighbour_coord.y(), neighbour_coord.z())) > 0) {
+          continue;
+        }
+        // Nodes are at least as large as a VoxelBlock, so the whole neighbour
+        // is covered by a single Node child.
+        VoxelData data;
+        std::memset(&data, 0, sizeof(VoxelData));
+        map.get(neighbour_coord, data);
+        neighbour_node_data.push_back(data);
+      }
+    }
+  }
+  return neighbour_node_data;
+}
+
+
+
+template <typename FieldType>
+void MeshCache<FieldType>::mesh(IndexedMesh& mesh) const {
+
+  size_t num_indices = mesh.indices.size();
+  for (const auto& block_mesh : cache_) {
+    num_indices += block_mesh.second.mesh.indices.size();
+  }
+  mesh.indices.reserve(num_indices);
+  meshing::IndexedMeshBuilder mesh_builder (mesh);
+  for (const auto& block_mesh : cache_) {
+    mesh_builder.append(block_mesh.second.mesh);
+  }
+}
+
+
+
+template <typename FieldType>
+void MeshCache<FieldType>::deltaMesh(IndexedMesh& mesh) const {
+
+  meshing::IndexedMeshBuilder mesh_builder (mesh);
+  for (const key_t block_key : updated_blocks_) {
+    mesh_builder.append(blockMesh(block_key));
+  }
+}
+
+
+
+template <typename FieldType>
+const IndexedMesh& MeshCache<FieldType>::blockMesh(const key_t block_key) const {
+
+  const auto cached = cache_.find(block_key);
+  return (cached == cache_.end()) ? empty_mesh_ : cached->second.mesh;
+}
+
+
+
+template <typename FieldType>
+void MeshCache<FieldType>::clear() {
+
+  cache_.clear();
+  updated_blocks_.clear();
+  removed_blocks_.clear();
+}
+
+} // namespace se
+
+#endif // MESH_CACHE_HPP
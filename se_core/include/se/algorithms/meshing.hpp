@@ -31,6 +31,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #ifndef MESHING_HPP
 #define MESHING_HPP
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include "../octree.hpp"
 #include "edge_tables.hpp"
 
@@ -122,6 +126,138 @@ typedef struct Triangle {
 
 } Triangle;
 
+namespace meshing {
+  /*! \brief The key of a mesh vertex interpolated on an edge of the volume.
+   * The vertices interpolated on the same edge get the same key, regardless of
+   * the (dual) cube they were computed from. Edges of dual cubes crossing
+   * scale changes aren't axis-aligned, so both endpoints are stored.
+   */
+  struct EdgeKey {
+    // The coordinates of the endpoints of the edge in half voxels, the
+    // lexicographically smaller one first.
+    Eigen::Vector3i coord_0;
+    Eigen::Vector3i coord_1;
+
+    bool operator==(const EdgeKey& other) const {
+      return coord_0 == other.coord_0 && coord_1 == other.coord_1;
+    }
+  };
+
+  struct EdgeKeyHash {
+    size_t operator()(const EdgeKey& key) const {
+      size_t hash = 0;
+      for (int i = 0; i < 3; ++i) {
+        hash ^= static_cast<uint32_t>(key.coord_0[i]) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        hash ^= static_cast<uint32_t>(key.coord_1[i]) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+      }
+      return hash;
+    }
+  };
+
+  /*! \brief The key of the edge between two points whose coordinates are in
+   * half voxels.
+   */
+  inline EdgeKey edge_key(const Eigen::Vector3i& coord_0,
+                          const Eigen::Vector3i& coord_1) {
+    const bool ordered = std::lexicographical_compare(coord_0.data(), coord_0.data() + 3,
+                                                      coord_1.data(), coord_1.data() + 3);
+    return ordered ? EdgeKey{coord_0, coord_1} : EdgeKey{coord_1, coord_0};
+  }
+}
+
+/*! \brief A triangle mesh whose triangles share their vertices. The vertices
+ * interpolated on the same edge of the volume are only stored once.
+ */
+struct IndexedMesh {
+  std::vector<Eigen::Vector3f> vertexes;
+  // The indices of the 3 vertexes of each triangle.
+  std::vector<uint32_t> indices;
+  // The edge each vertex was interpolated on, used to merge meshes.
+  std::vector<meshing::EdgeKey> vertex_keys;
+  // The sum of the area-weighted normals of the triangles sharing each vertex,
+  // accumulated while the mesh is built. Normalise before use.
+  std::vector<Eigen::Vector3f> normals;
+
+  size_t numTriangles() const { return indices.size() / 3; }
+
+  void clear() {
+    vertexes.clear();
+    indices.clear();
+    vertex_keys.clear();
+    normals.clear();
+  }
+
+  /*! \brief Append the triangles of the mesh to triangles, duplicating the
+   * shared vertices.
+   */
+  void toTriangles(std::vector<Triangle>& triangles) const {
+    triangles.reserve(triangles.size() + numTriangles());
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      Triangle triangle;
+      for (int v = 0; v < 3; ++v) {
+        triangle.vertexes[v] = vertexes[indices[i + v]];
+      }
+      triangles.push_back(triangle);
+    }
+  }
+};
+
+namespace meshing {
+  /*! \brief Add triangles and whole meshes to an IndexedMesh, reusing its
+   * vertices with the same EdgeKey and accumulating their normals.
+   */
+  class IndexedMeshBuilder {
+    public:
+      IndexedMeshBuilder(IndexedMesh& mesh) : mesh_(mesh) {
+        mesh_.normals.resize(mesh_.vertexes.size(), Eigen::Vector3f::Zero());
+        vertex_idxs_.reserve(mesh_.vertexes.size());
+        for (size_t i = 0; i < mesh_.vertex_keys.size(); ++i) {
+          vertex_idxs_.emplace(mesh_.vertex_keys[i], i);
+        }
+      }
+
+      void addTriangle(const Eigen::Vector3f vertexes[3],
+                       const EdgeKey         vertex_keys[3]) {
+        const Eigen::Vector3f normal = (vertexes[1] - vertexes[0]).cross(vertexes[2] - vertexes[1]);
+        for (int v = 0; v < 3; ++v) {
+          const uint32_t vertex_idx = vertexIdx(vertexes[v], vertex_keys[v]);
+          mesh_.indices.push_back(vertex_idx);
+          mesh_.normals[vertex_idx] += normal;
+        }
+      }
+
+      void append(const IndexedMesh& mesh) {
+        const bool has_normals = mesh.normals.size() == mesh.vertexes.size();
+        std::vector<uint32_t> vertex_idxs (mesh.vertexes.size());
+        for (size_t i = 0; i < mesh.vertexes.size(); ++i) {
+          vertex_idxs[i] = vertexIdx(mesh.vertexes[i], mesh.vertex_keys[i]);
+          if (has_normals) {
+            mesh_.normals[vertex_idxs[i]] += mesh.normals[i];
+          }
+        }
+        mesh_.indices.reserve(mesh_.indices.size() + mesh.indices.size());
+        for (const uint32_t idx : mesh.indices) {
+          mesh_.indices.push_back(vertex_idxs[idx]);
+        }
+      }
+
+    private:
+      uint32_t vertexIdx(const Eigen::Vector3f& vertex,
+                         const EdgeKey&         vertex_key) {
+        const auto inserted = vertex_idxs_.emplace(vertex_key, mesh_.vertexes.size());
+        if (inserted.second) {
+          mesh_.vertexes.push_back(vertex);
+          mesh_.vertex_keys.push_back(vertex_key);
+          mesh_.normals.push_back(Eigen::Vector3f::Zero());
+        }
+        return inserted.first->second;
+      }
+
+      IndexedMesh& mesh_;
+      std::unordered_map<EdgeKey, uint32_t, EdgeKeyHash> vertex_idxs_;
+  };
+}
+
 namespace meshing {
   enum status : uint8_t {
     OUTSIDE = 0x0,
@@ -284,12 +420,11 @@ namespace meshing {
 
   template <typename DataT,
             typename ValueSelector>
-  inline Eigen::Vector3f interp_dual_vertexes(const int                                   edge,
-                                              const DataT                                 data[8],
-                                              const std::vector<Eigen::Vector3f,
-                                              Eigen::aligned_allocator<Eigen::Vector3f>>& dual_corner_coords_f,
-                                              const float                                 voxel_dim,
-                                              ValueSelector                               select_value) {
+  inline Eigen::Vector3f interp_dual_vertexes(const int             edge,
+                                              const DataT           data[8],
+                                              const Eigen::Vector3f dual_corner_coords_f[8],
+                                              const float           voxel_dim,
+                                              ValueSelector         select_value) {
     switch(edge){
       case 0:  return compute_dual_intersection(select_value(data[0]), select_value(data[1]),
           dual_corner_coords_f[0], dual_corner_coords_f[1], voxel_dim, 0);
@@ -326,15 +461,22 @@ namespace meshing {
       {{-1, -1, -1}, {+1, -1, -1}, {+1, -1, +1}, {-1, -1, +1},
        {-1, +1, -1}, {+1, +1, -1}, {+1, +1, +1}, {-1, +1, +1}};
 
+  /*
+   * The indices of the (dual) corners at the endpoints of each edge, in the
+   * order used by interp_vertexes and interp_dual_vertexes
+   */
+  static const int edge_corner_idxs[12][2] =
+      {{0, 1}, {1, 2}, {2, 3}, {0, 3}, {4, 5}, {5, 6}, {6, 7}, {4, 7},
+       {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
   template <typename FieldType,
             template <typename FieldT> class VoxelBlockT,
             typename DataT>
-  inline void gather_dual_data(const VoxelBlockT<FieldType>*               block,
-                               const int                                   scale,
-                               const Eigen::Vector3f&                      primal_corner_coord_f,
-                               DataT                                       data[8],
-                               std::vector<Eigen::Vector3f,
-                               Eigen::aligned_allocator<Eigen::Vector3f>>& dual_corner_coords_f) {
+  inline void gather_dual_data(const VoxelBlockT<FieldType>* block,
+                               const int                     scale,
+                               const Eigen::Vector3f&        primal_corner_coord_f,
+                               DataT                         data[8],
+                               Eigen::Vector3f               dual_corner_coords_f[8]) {
     // In the local case:        actual_dual_offset = actual_dual_scaling * norm_dual_offset_f and
     // dual_corner_coords_f = primal_corner_coord_f + actual_dual_scaling * norm_dual_offset_f
     const float actual_dual_scaling = (float) (1 << scale) / 2;
@@ -345,6 +487,59 @@ namespace meshing {
     }
   }
 
+  /*
+   * Normalised offsets of the primal corners from the primal corner
+   * The correct coordinates would be {-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5}, ...
+   * However this would cause a lot of extra computations to cast the voxels back and forth and
+   * to make sure that the absolute coordinates {-0.5, y, z} won't be casted to {0, y, z} (and for y, z accordingly).
+   */
+  static const Eigen::Vector3i logical_dual_offset[8] =
+      {{-1, -1, -1}, {+0, -1, -1}, {+0, -1, +0}, {-1, -1, +0},
+       {-1, +0, -1}, {+0, +0, -1}, {+0, +0, +0}, {-1, +0, +0}};
+
+  /*
+   * The index of a VoxelBlock neighbour in the array filled by
+   * fetch_neighbour_blocks(), given its offset in VoxelBlocks. The VoxelBlock
+   * itself has index 13.
+   */
+  constexpr int neighbour_block_idx(const int dx, const int dy, const int dz) {
+    return 9 * (dx + 1) + 3 * (dy + 1) + (dz + 1);
+  }
+
+  static constexpr int self_block_idx = neighbour_block_idx(0, 0, 0);
+
+  /*! \brief The scale block is meshed at when meshing at min_scale or
+   * coarser.
+   */
+  template <typename FieldType>
+  inline int mesh_scale(const VoxelBlockType<FieldType>* block,
+                        const int                        min_scale) {
+    return std::min(std::max(block->current_scale(), min_scale),
+                    static_cast<int>(VoxelBlockType<FieldType>::max_scale));
+  }
+
+  /*! \brief Fetch the 26 neighbours of block once so that the dual corners
+   * crossing the block faces don't need to descend the octree. Neighbours
+   * outside the map or not allocated are nullptr.
+   */
+  template <typename FieldType,
+            template <typename FieldT> class OctreeT>
+  inline void fetch_neighbour_blocks(const OctreeT<FieldType>&        map,
+                                     const VoxelBlockType<FieldType>* block,
+                                     const VoxelBlockType<FieldType>* neighbour_blocks[27]) {
+    const int block_size = VoxelBlockType<FieldType>::size_li;
+    for (int dx = -1; dx <= 1; ++dx) {
+      for (int dy = -1; dy <= 1; ++dy) {
+        for (int dz = -1; dz <= 1; ++dz) {
+          const Eigen::Vector3i neighbour_coord = block->coordinates() + block_size * Eigen::Vector3i(dx, dy, dz);
+          neighbour_blocks[neighbour_block_idx(dx, dy, dz)] =
+              map.contains(neighbour_coord) ? map.fetch(neighbour_coord) : nullptr;
+        }
+      }
+    }
+    neighbour_blocks[self_block_idx] = block;
+  }
+
   /*! \brief The following strategy is derived from I. Wald, A Simple, General,
    *  and GPU Friendly Method for Computing Dual Mesh and Iso-Surfaces of Adaptive Mesh Refinement (AMR) Data, 2020
    *
@@ -356,456 +551,88 @@ namespace meshing {
    * v = 4 << (x is +1) + 2 << (y is +1) + 1 << (z is +1).
    * The minium value is computed for all neighbours for dual corners (c0-8). This means if multiple dual corners fall
    * inside the same neighbouring block we take the minimum value of all the dual corners inside the block.
-   * The threshold for populate the lower or higher priority list is the lowest dual corner cost of the corners falling
-   * inside the block the relative primal coordinate belongs to.
+   * Neighbours with a lower value than the block the relative primal coordinate belongs to have lower priority, i.e.
+   * the dual cube is neglected if scale >= scale neighbour. Neighbours with a higher value have higher priority, i.e.
+   * the dual cube is only neglected if scale > scale neighbour.
    *
-   * \param[in] primal_corner_coord_rel     relative voxel offset of the primal corner from the block coordinates
-   * \param[in] block_size                  size of a voxel block in voxel units
-   * \param[in] lower_priority_neighbours   blocks with lower priority, i.e. will be neglected if scale >= scale neighbour
-   * \param[in] higher_priority_neighbours  blocks with higher priority, i.e. will only be neglected if scale > scale neighbour
-   * \param[in] neighbours                  vector containing a vector with all corner offsets for a neighbouring block.
-   *                                        First index is the main block.
+   * The classification only depends on whether the primal corner lies on the lower face (0), upper face
+   * (block_size) or inside the block along each axis, so it is precomputed for the resulting 27 cases, indexed
+   * by dual_neighbour_case().
    */
-  inline void norm_dual_corner_idxs(const Eigen::Vector3i&         primal_corner_coord_rel,
-                                    const int                      block_size,
-                                    std::vector<int>&              lower_priority_neighbours,
-                                    std::vector<int>&              higher_priority_neighbours,
-                                    std::vector<std::vector<int>>& neighbours) {
-
-    // 26 binary cases (6 faces, 8 corners, 12 edges)
-    // 100 000 upper x crossing
-    // 010 000 upper y crossing
-    // 001 000 upper z crossing
-
-    // 000 100 lower x crossing
-    // 000 010 lower y crossing
-    // 000 001 lower z crossing
-
-    unsigned int crossmask = ((primal_corner_coord_rel.x() == block_size) << 5) |
-                             ((primal_corner_coord_rel.y() == block_size) << 4) |
-                             ((primal_corner_coord_rel.z() == block_size) << 3) |
-                             ((primal_corner_coord_rel.x() == 0) << 2) |
-                             ((primal_corner_coord_rel.y() == 0) << 1) |
-                             ( primal_corner_coord_rel.z() == 0);
-
-    switch(crossmask) {
-      // 6 Faces
-      case 1: /* CASE 1 = crosses lower z */ {
-        // Inside
-        // (c3;v1)-{-1, -1, +1} and (c7;v3)-{-1, +1, +1} and (c2;v5)-{+1, -1, +1} and (c6;v7)-{+1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c4;v2)-{-1, +1, -1} and (c1;v4)-{+1, -1, -1} and (c5;v6)-{+1, +1, -1}
-        // Higher priority
-        // -
-        lower_priority_neighbours = {0};
-        higher_priority_neighbours = {};
-        neighbours = {{2,3,6,7}, {0,1,4,5}};
-      }
-        break;
-      case 2: /* CASE 2 = crosses lower y */ {
-        // Inside
-        // (c4;v2)-{-1, +1, -1} and (c7;v3)-{-1, +1, +1} and (c5;v6)-{+1, +1, -1} and (c6;v7)-{+1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c3;v1)-{-1, -1, +1} and (c1;v4)-{+1, -1, -1} and (c2;v5)-{+1, -1, +1}
-        // Higher priority
-        // -
-        lower_priority_neighbours = {0};
-        higher_priority_neighbours = {};
-        neighbours = {{4,5,6,7}, {0,1,2,3}};
-      }
-        break;
-      case 4: /* CASE 3 = crosses lower x */ {
-        // Inside
-        // (c1;v4)-{+1, -1, -1} and (c2;v5)-{+1, -1, +1} and (c5;v6)-{+1, +1, -1} and (c6;v7)-{+1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c3;v1)-{-1, -1, +1} and (c4;v2)-{-1, +1, -1} and (c7;v3)-{-1, +1, +1}
-        // Higher priority
-        // -
-        lower_priority_neighbours = {0};
-        higher_priority_neighbours = {};
-        neighbours = {{1,2,5,6}, {0,3,4,7}};
-      }
-        break;
-      case 8: /* CASE 4 = crosses upper z */ {
-        // Inside
-        // (c0;v0)-{-1, -1, -1} and (c4;v2)-{-1, +1, -1} and (c1;v4)-{+1, -1, -1} and (c5;v6)-{+1, +1, -1}
-        // Lower priority
-        // -
-        // Higher priority
-        // (c3;v1)-{-1, -1, +1} and (c7;v3)-{-1, +1, +1} and (c2;v5)-{+1, -1, +1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {};
-        higher_priority_neighbours = {3};
-        neighbours = {{0,1,4,5}, {2,3,6,7}};
-      }
-        break;
-      case 16: /* CASE 5 = crosses upper y */ {
-        // Inside
-        // (c0;v0)-{-1, -1, -1} and (c3;v1)-{-1, -1, +1} and (c1;v4)-{+1, -1, -1} and (c2;v5)-{+1, -1, +1}
-        // Lower priority
-        // -
-        // Higher priority
-        // (c4;v2)-{-1, +1, -1} and (c7;v3)-{-1, +1, +1} and (c5;v6)-{+1, +1, -1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {};
-        higher_priority_neighbours = {4};
-        neighbours = {{0,1,2,3}, {4,5,6,7}};
-      }
-        break;
-      case 32: /* CASE 6 = crosses upper x */ {
-        // Inside
-        // (c0;v0)-{-1, -1, -1} and (c3;v1)-{-1, -1, +1} and (c4;v2)-{-1, +1, -1} and (c7;v3)-{-1, +1, +1}
-        // Lower priority
-        // -
-        // Higher priority
-        // (c1;v4)-{+1, -1, -1} and (c2;v5)-{+1, -1, +1} and (c5;v6)-{+1, +1, -1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {};
-        higher_priority_neighbours = {1};
-        neighbours = {{0,3,4,7}, {1,2,5,6}};
-      }
-        break;
-
-
-      // 8 Corners
-      case 7: /* CASE 7 = crosses lower x(4), y(2), z(1) */ {
-        // Inside
-        // (c6;v7)-{+1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1}, (c3;v1)-{-1, -1, +1}, (c4;v2)-{-1, +1, -1}, (c7;v3)-{-1, +1, +1}
-        // (c1;v4)-{+1, -1, -1}, (c2;v5)-{+1, -1, +1}, (c5;v6)-{+1, +1, -1},
-        // Higher priority
-        // -
-        lower_priority_neighbours = {0, 1, 2, 3, 4, 5, 7};
-        higher_priority_neighbours = {};
-        neighbours = {{6}, {0}, {1}, {2}, {3}, {4}, {5}, {7}};
-      }
-        break;
-      case 14: /* CASE 8 = crosses lower x(4), y(2) and upper z(8) */ {
-        // Inside
-        // (c5;v6)-{+1, +1, -1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1}, (c3;v1)-{-1, -1, +1}, (c4;v2)-{-1, +1, -1},
-        // (c7;v3)-{-1, +1, +1}, (c1;v4)-{+1, -1, -1}, (c2;v5)-{+1, -1, +1},
-        // Higher priority
-        // (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0,1,2,3,4,7};
-        higher_priority_neighbours = {6};
-        neighbours = {{5}, {0}, {1}, {2}, {3}, {4}, {6}, {7}};
-      }
-        break;
-      case 21: /* CASE 9 = crosses lower x(4), upper y(16) and lower z(1) */ {
-        // Inside
-        // (c2;v5)-{+1, -1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1}, (c3;v1)-{-1, -1, +1}, (c4;v2)-{-1, +1, -1},
-        // (c7;v3)-{-1, +1, +1}, (c1;v4)-{+1, -1, -1},
-        // Higher priority
-        // (c5;v6)-{+1, +1, -1}, (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0,1,3,4,7};
-        higher_priority_neighbours = {5,6};
-        neighbours = {{2}, {0}, {1}, {3}, {4}, {5}, {6}, {7}};
-      }
-        break;
-      case 28: /* CASE 10 = crosses lower x(4) and upper y(16), z(8) */ {
-        // Inside
-        // (c1;v4)-{+1, -1, -1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1}, (c3;v1)-{-1, -1, +1},
-        // (c4;v2)-{-1, +1, -1}, (c7;v3)-{-1, +1, +1}
-        // Higher priority
-        // (c2;v5)-{+1, -1, +1}, (c5;v6)-{+1, +1, -1}, (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0,3,4,7};
-        higher_priority_neighbours = {2,5,6};
-        neighbours = {{1}, {0}, {2}, {3}, {4}, {5}, {6}, {7}};
-      }
-        break;
-      case 35: /* CASE 11 = crosses upper x(32) and lower y(2), z(1) */ {
-        // Inside
-        // (c7;v3)-{-1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1}, (c3;v1)-{-1, -1, +1}, (c4;v2)-{-1, +1, -1}
-        // Higher priority
-        // (c1;v4)-{+1, -1, -1}, (c2;v5)-{+1, -1, +1}, (c5;v6)-{+1, +1, -1}, (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0,3,4};
-        higher_priority_neighbours = {1,2,5,6};
-        neighbours = {{7}, {0}, {1}, {2}, {3}, {4}, {5}, {6}};
-      }
-        break;
-      case 42: /* CASE 12 = crosses upper x(32), lower y(2) and upper z(8) */ {
-        // Inside
-        // (c4;v2)-{-1, +1, -1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1}, (c3;v1)-{-1, -1, +1}
-        // Higher priority
-        // (c7;v3)-{-1, +1, +1}, (c1;v4)-{+1, -1, -1}, (c2;v5)-{+1, -1, +1},
-        // (c5;v6)-{+1, +1, -1}, (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0,3};
-        higher_priority_neighbours = {1,2,5,6,7};
-        neighbours = {{4}, {0}, {1}, {2}, {3}, {5}, {6}, {7}};
-      }
-        break;
-      case 49: /* CASE 13 = crosses upper x(32), y(16) and lower z(1) */ {
-        // Inside
-        // (c3;v1)-{-1, -1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1}
-        // Higher priority
-        // (c4;v2)-{-1, +1, -1}, (c7;v3)-{-1, +1, +1}, (c1;v4)-{+1, -1, -1},
-        // (c2;v5)-{+1, -1, +1}, (c5;v6)-{+1, +1, -1}, (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0};
-        higher_priority_neighbours = {1,2,4,5,6,7};
-        neighbours = {{3}, {0}, {1}, {2}, {4}, {5}, {6}, {7}};
-      }
-        break;
-      case 56: /* CASE 14 = crosses upper x(32), y(16), z(8) */ {
-        // Inside
-        // (c0;v0)-{-1, -1, -1}
-        // Lower priority
-        // -
-        // Higher priority
-        // (c3;v1)-{-1, -1, +1}, (c4;v2)-{-1, +1, -1}, (c7;v3)-{-1, +1, +1}
-        // (c1;v4)-{+1, -1, -1}, (c2;v5)-{+1, -1, +1}, (c5;v6)-{+1, +1, -1}, (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {};
-        higher_priority_neighbours = {1, 2, 3, 4, 5, 6, 7};
-        neighbours = {{0}, {1}, {2}, {3}, {4}, {5}, {6}, {7}};
-      }
-        break;
-
-
-        // 12 Edges
-      case 3: /* CASE 15 = crosses lower y(2), z(1) */ {
-        // Inside
-        // (c7;v3)-{-1, +1, +1} and (c6;v7)-{+1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c1;v4)-{+1, -1, -1}
-        // (c3;v1)-{-1, -1, +1} and (c2;v5)-{+1, -1, +1}
-        // (c4;v2)-{-1, +1, -1} and (c5;v6)-{+1, +1, -1}
-        // Higher priority
-        // -
-        lower_priority_neighbours = {0,3,4};
-        higher_priority_neighbours = {};
-        neighbours = {{6,7}, {0,1}, {2,3}, {4,5}};
-      }
-        break;
-      case 5: /* CASE 16 = crosses lower x(4), z(1) */ {
-        // Inside
-        // (c2;v5)-{+1, -1, +1} and (c6;v7)-{+1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c4;v2)-{-1, +1, -1}
-        // (c3;v1)-{-1, -1, +1} and (c7;v3)-{-1, +1, +1}
-        // (c1;v4)-{+1, -1, -1} and (c5;v6)-{+1, +1, -1}
-        // Higher priority
-        // -
-        lower_priority_neighbours = {0,1,3};
-        higher_priority_neighbours = {};
-        neighbours = {{2,6}, {0,4}, {3,7}, {1,5}};
-      }
-        break;
-      case 6: /* CASE 17 = crosses lower x(4), y(2) */ {
-        // Inside
-        // (c5;v6)-{+1, +1, -1} and (c6;v7)-{+1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c3;v1)-{-1, -1, +1}
-        // (c4;v2)-{-1, +1, -1} and (c7;v3)-{-1, +1, +1}
-        // (c1;v4)-{+1, -1, -1} and (c2;v5)-{+1, -1, +1}
-        // Higher priority
-        // -
-        lower_priority_neighbours = {0,1,4};
-        higher_priority_neighbours = {};
-        neighbours = {{5,6}, {0,3}, {4,7}, {1,2}};
-      }
-        break;
-      case 10: /* CASE 18 = crosses lower y(2) and upper z(8) */ {
-        // Inside
-        // (c4;v2)-{-1, +1, -1} and (c5;v6)-{+1, +1, -1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c1;v4)-{+1, -1, -1}
-        // (c3;v1)-{-1, -1, +1} and (c2;v5)-{+1, -1, +1}
-        // (c7;v3)-{-1, +1, +1} and (c6;v7)-{+1, +1, +1}
-        // Higher priority
-        //
-        lower_priority_neighbours = {0,3};
-        higher_priority_neighbours = {7};
-        neighbours = {{4,5}, {0,1}, {2,3}, {6,7}};
-      }
-        break;
-      case 12: /* CASE 19 = crosses lower x(4) and upper z(8) */ {
-        // Inside
-        // (c1;v4)-{+1, -1, -1} and (c5;v6)-{+1, +1, -1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c4;v2)-{-1, +1, -1}
-        // (c3;v1)-{-1, -1, +1} and (c7;v3)-{-1, +1, +1}
-        // Higher priority
-        // (c2;v5)-{+1, -1, +1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0,3};
-        higher_priority_neighbours = {2};
-        neighbours = {{1,5}, {0,4}, {3,7}, {2,6}};
-      }
-        break;
-      case 17: /* CASE 20 = crosses upper y(16) and lower z(1) */ {
-        // Inside
-        // (c3;v1)-{-1, -1, +1} and (c2;v5)-{+1, -1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c1;v4)-{+1, -1, -1}
-        // Higher priority
-        // (c4;v2)-{-1, +1, -1} and (c5;v6)-{+1, +1, -1}
-        // (c7;v3)-{-1, +1, +1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0};
-        higher_priority_neighbours = {4,7};
-        neighbours = {{2,3}, {0,1}, {4,5}, {6,7}};
-      }
-        break;
-      case 20: /* CASE 21 = crosses lower x(4) and upper y(16)*/ {
-        // Inside
-        // (c1;v4)-{+1, -1, -1} and (c2;v5)-{+1, -1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c3;v1)-{-1, -1, +1}
-        // (c4;v2)-{-1, +1, -1} and (c7;v3)-{-1, +1, +1}
-        // Higher priority
-        // (c5;v6)-{+1, +1, -1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0,4};
-        higher_priority_neighbours = {5};
-        neighbours = {{1,2}, {0,3}, {4,7}, {5,6}};
-      }
-        break;
-      case 24: /* CASE 22 = crosses upper y(16), z(8)*/ {
-        // Inside
-        // (c0;v0)-{-1, -1, -1} and (c1;v4)-{+1, -1, -1}
-        // Lower priority
-        // -
-        // Higher priority
-        // (c3;v1)-{-1, -1, +1} and (c2;v5)-{+1, -1, +1}
-        // (c4;v2)-{-1, +1, -1} and (c5;v6)-{+1, +1, -1}
-        // (c7;v3)-{-1, +1, +1} and (c6;v7)-{+1, +1, +1}
-        //
-        lower_priority_neighbours = {};
-        higher_priority_neighbours = {3,4,7};
-        neighbours = {{0,1}, {2,3}, {4,5}, {6,7}};
-      }
-        break;
-      case 33: /* CASE 23 = crosses upper x(32) and lower z(1) */ {
-        // Inside
-        // (c3;v1)-{-1, -1, +1} and (c7;v3)-{-1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c4;v2)-{-1, +1, -1}
-        // Higher priority
-        // (c1;v4)-{+1, -1, -1} and (c5;v6)-{+1, +1, -1}
-        // (c2;v5)-{+1, -1, +1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0};
-        higher_priority_neighbours = {1,2};
-        neighbours = {{3,7}, {0,4}, {1,5}, {2,6}};
-      }
-        break;
-      case 34: /* CASE 24 = crosses upper x(32) and lower y(2) */ {
-        // Inside
-        // (c4;v2)-{-1, +1, -1} and (c7;v3)-{-1, +1, +1}
-        // Lower priority
-        // (c0;v0)-{-1, -1, -1} and (c3;v1)-{-1, -1, +1}
-        // Higher priority
-        // (c1;v4)-{+1, -1, -1} and (c2;v5)-{+1, -1, +1}
-        // (c5;v6)-{+1, +1, -1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {0};
-        higher_priority_neighbours = {1,5};
-        neighbours = {{4,7}, {0,3}, {1,2}, {5,6}};
-      }
-        break;
-      case 40: /* CASE 25 = crosses upper x(32), z(8) */ {
-        // Inside
-        // (c0;v0)-{-1, -1, -1} and (c4;v2)-{-1, +1, -1}
-        // Lower priority
-        // -
-        // Higher priority
-        // (c3;v1)-{-1, -1, +1} and (c7;v3)-{-1, +1, +1}
-        // (c1;v4)-{+1, -1, -1} and (c5;v6)-{+1, +1, -1}
-        // (c2;v5)-{+1, -1, +1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {};
-        higher_priority_neighbours = {1,2,3};
-        neighbours = {{0,4}, {3,7}, {1,5}, {2,6}};
-      }
-        break;
-      case 48: /* CASE 26 = crosses upper x(32), y(16) */ {
-        // Inside
-        // (c0;v0)-{-1, -1, -1} and (c3;v1)-{-1, -1, +1}
-        // Lower priority
-        // -
-        // Higher priority
-        // (c4;v2)-{-1, +1, -1} and (c7;v3)-{-1, +1, +1}
-        // (c1;v4)-{+1, -1, -1} and (c2;v5)-{+1, -1, +1}
-        // (c5;v6)-{+1, +1, -1} and (c6;v7)-{+1, +1, +1}
-        lower_priority_neighbours = {};
-        higher_priority_neighbours = {1,4,5};
-        neighbours = {{0,3}, {4,7}, {1,2}, {5,6}};
-      }
-    }
-  }
 
   /*
-   * Normalised offsets of the primal corners from the primal corner
-   * The correct coordinates would be {-0.5, -0.5, -0.5}, {0.5, -0.5, -0.5}, ...
-   * However this would cause a lot of extra computations to cast the voxels back and forth and
-   * to make sure that the absolute coordinates {-0.5, y, z} won't be casted to {0, y, z} (and for y, z accordingly).
+   * The neighbour_block_idx() of the VoxelBlock containing each dual corner
    */
-  static const Eigen::Vector3i logical_dual_offset[8] =
-      {{-1, -1, -1}, {+0, -1, -1}, {+0, -1, +0}, {-1, -1, +0},
-       {-1, +0, -1}, {+0, +0, -1}, {+0, +0, +0}, {-1, +0, +0}};
+  static constexpr int dual_corner_neighbours[27][8] =
+      {{13, 13, 13, 13, 13, 13, 13, 13}, {12, 12, 13, 13, 12, 12, 13, 13}, {13, 13, 14, 14, 13, 13, 14, 14},
+       {10, 10, 10, 10, 13, 13, 13, 13}, { 9,  9, 10, 10, 12, 12, 13, 13}, {10, 10, 11, 11, 13, 13, 14, 14},
+       {13, 13, 13, 13, 16, 16, 16, 16}, {12, 12, 13, 13, 15, 15, 16, 16}, {13, 13, 14, 14, 16, 16, 17, 17},
+       { 4, 13, 13,  4,  4, 13, 13,  4}, { 3, 12, 13,  4,  3, 12, 13,  4}, { 4, 13, 14,  5,  4, 13, 14,  5},
+       { 1, 10, 10,  1,  4, 13, 13,  4}, { 0,  9, 10,  1,  3, 12, 13,  4}, { 1, 10, 11,  2,  4, 13, 14,  5},
+       { 4, 13, 13,  4,  7, 16, 16,  7}, { 3, 12, 13,  4,  6, 15, 16,  7}, { 4, 13, 14,  5,  7, 16, 17,  8},
+       {13, 22, 22, 13, 13, 22, 22, 13}, {12, 21, 22, 13, 12, 21, 22, 13}, {13, 22, 23, 14, 13, 22, 23, 14},
+       {10, 19, 19, 10, 13, 22, 22, 13}, { 9, 18, 19, 10, 12, 21, 22, 13}, {10, 19, 20, 11, 13, 22, 23, 14},
+       {13, 22, 22, 13, 16, 25, 25, 16}, {12, 21, 22, 13, 15, 24, 25, 16}, {13, 22, 23, 14, 16, 25, 26, 17}};
+
+  /*
+   * Bit mask of the dual corners contained in lower priority neighbours
+   */
+  static constexpr uint8_t dual_corner_lower_priority[27] =
+      {0x00, 0x33, 0x00, 0x0f, 0x3f, 0x0f, 0x00, 0x03, 0x00,
+       0x99, 0xbb, 0x99, 0x9f, 0xbf, 0x9f, 0x99, 0x9b, 0x99,
+       0x00, 0x11, 0x00, 0x09, 0x19, 0x09, 0x00, 0x01, 0x00};
+
+  /*! \brief The index of the dual_corner_neighbours row of a primal corner.
+   *
+   * \param[in] primal_corner_coord_rel relative voxel offset of the primal corner from the block coordinates
+   * \param[in] block_size              size of a voxel block in voxel units
+   */
+  inline int dual_neighbour_case(const Eigen::Vector3i& primal_corner_coord_rel,
+                                 const int              block_size) {
+    int case_idx = 0;
+    for (int i = 0; i < 3; ++i) {
+      const int crossing = (primal_corner_coord_rel[i] == 0) ? 1 : ((primal_corner_coord_rel[i] == block_size) ? 2 : 0);
+      case_idx = 3 * case_idx + crossing;
+    }
+    return case_idx;
+  }
 
   template <typename FieldType,
       template <typename FieldT> class OctreeT,
       typename DataT>
-  inline void gather_dual_data(const OctreeT<FieldType>&                   map,
-                               const VoxelBlockType<FieldType>*            block,
-                               const int                                   scale,
-                               const Eigen::Vector3i&                      primal_corner_coord,
-                               DataT                                       data[8],
-                               std::vector<Eigen::Vector3f,
-                               Eigen::aligned_allocator<Eigen::Vector3f>>& dual_corner_coords_f) {
+  inline void gather_dual_data(const OctreeT<FieldType>&              /* map */,
+                               const VoxelBlockType<FieldType>*       block,
+                               const VoxelBlockType<FieldType>* const neighbour_blocks[27],
+                               const int                              scale,
+                               const int                              min_scale,
+                               const Eigen::Vector3i&                 primal_corner_coord,
+                               DataT                                  data[8],
+                               Eigen::Vector3f                        dual_corner_coords_f[8]) {
     const Eigen::Vector3i primal_corner_coord_rel = primal_corner_coord - block->coordinates();
+    const int case_idx = dual_neighbour_case(primal_corner_coord_rel, VoxelBlockType<FieldType>::size_li);
+    const int* corner_neighbours = dual_corner_neighbours[case_idx];
+    const uint8_t lower_priority = dual_corner_lower_priority[case_idx];
 
-    std::vector<int> lower_priority_neighbours, higher_priority_neighbours;
-    std::vector<std::vector<int>> neighbours;
-    norm_dual_corner_idxs(primal_corner_coord_rel, VoxelBlockType<FieldType>::size_li,
-        lower_priority_neighbours, higher_priority_neighbours, neighbours);
-
-    for(const auto& offset_idx: lower_priority_neighbours) {
-      Eigen::Vector3i logical_dual_corner_coord = primal_corner_coord + logical_dual_offset[offset_idx];
-      if (!map.contains(logical_dual_corner_coord)) {
-        data[0].y = 0.f;
-        return;
-      }
-      VoxelBlockType<FieldType>* block = map.fetch(logical_dual_corner_coord);
-      if (block == nullptr || block->current_scale() <= scale) {
-        data[0].y = 0.f;
-        return;
-      }
-    }
-    for(const auto& offset_idx: higher_priority_neighbours) {
-      Eigen::Vector3i logical_dual_corner_coord = primal_corner_coord + logical_dual_offset[offset_idx];
-      if (!map.contains(logical_dual_corner_coord)) {
+    for (int corner_idx = 0; corner_idx < 8; corner_idx++) {
+      const VoxelBlockType<FieldType>* neighbour = neighbour_blocks[corner_neighbours[corner_idx]];
+      if (neighbour == nullptr) {
         data[0].y = 0.f;
         return;
       }
-      VoxelBlockType<FieldType>* block = map.fetch(logical_dual_corner_coord);
-      if (block == nullptr || block->current_scale() < scale) {
-        data[0].y = 0.f;
-        return;
+      const int neighbour_scale = mesh_scale<FieldType>(neighbour, min_scale);
+      if (corner_neighbours[corner_idx] != self_block_idx) {
+        const bool coarser_neighbour = (lower_priority & (1 << corner_idx))
+            ? neighbour_scale > scale : neighbour_scale >= scale;
+        if (!coarser_neighbour) {
+          data[0].y = 0.f;
+          return;
+        }
       }
-    }
-
-    int stride = 1 << block->current_scale();
-    for(const auto& offset_idx: neighbours[0]) {
-      Eigen::Vector3i logical_dual_corner_coord = primal_corner_coord + logical_dual_offset[offset_idx];
-      dual_corner_coords_f[offset_idx] = ((logical_dual_corner_coord / stride) * stride).cast<float>() +
+      const int stride = 1 << neighbour_scale;
+      const Eigen::Vector3i logical_dual_corner_coord = primal_corner_coord + logical_dual_offset[corner_idx];
+      dual_corner_coords_f[corner_idx] = ((logical_dual_corner_coord / stride) * stride).cast<float>() +
           stride * OctreeT<FieldType>::sample_offset_frac_;
-      data[offset_idx] = block->data(dual_corner_coords_f[offset_idx].cast<int>(), block->current_scale());
-    }
-    for (size_t neighbour_idx = 1; neighbour_idx < neighbours.size(); ++neighbour_idx) {
-      Eigen::Vector3i logical_dual_corner_coord = primal_corner_coord + logical_dual_offset[neighbours[neighbour_idx][0]];
-      VoxelBlockType<FieldType>* neighbour = map.fetch(logical_dual_corner_coord);
-      int stride = 1 << neighbour->current_scale();
-      for(const auto& offset_idx: neighbours[neighbour_idx]) {
-        logical_dual_corner_coord = primal_corner_coord + logical_dual_offset[offset_idx];
-        dual_corner_coords_f[offset_idx] = ((logical_dual_corner_coord / stride) * stride).cast<float>() +
-            stride * OctreeT<FieldType>::sample_offset_frac_;
-        data[offset_idx] = neighbour->data(dual_corner_coords_f[offset_idx].cast<int>(), neighbour->current_scale());
-      }
+      data[corner_idx] = neighbour->data(dual_corner_coords_f[corner_idx].cast<int>(), neighbour_scale);
     }
   }
 
@@ -813,15 +640,16 @@ namespace meshing {
             template <typename FieldT> class OctreeT,
             typename InsidePredicate,
             typename DataT>
-  void compute_dual_index(const OctreeT<FieldType>&                   map,
-                          const VoxelBlockType<FieldType>*            block,
-                          const int                                   scale,
-                          InsidePredicate                             inside,
-                          const Eigen::Vector3i&                      primal_corner_coord,
-                          uint8_t&                                    edge_pattern_idx,
-                          DataT                                       data[8],
-                          std::vector<Eigen::Vector3f,
-                          Eigen::aligned_allocator<Eigen::Vector3f>>& dual_corner_coords_f) {
+  void compute_dual_index(const OctreeT<FieldType>&              map,
+                          const VoxelBlockType<FieldType>*       block,
+                          const VoxelBlockType<FieldType>* const neighbour_blocks[27],
+                          const int                              scale,
+                          const int                              min_scale,
+                          InsidePredicate                        inside,
+                          const Eigen::Vector3i&                 primal_corner_coord,
+                          uint8_t&                               edge_pattern_idx,
+                          DataT                                  data[8],
+                          Eigen::Vector3f                        dual_corner_coords_f[8]) {
     const unsigned int block_size =  VoxelBlockType<FieldType>::size_li;
     // The local case is independent of the scale.
     // lower or upper x boundary (block_coord.x() +0 or +block size) -> (binary) 100 -> local += 4
@@ -841,26 +669,16 @@ namespace meshing {
 
     edge_pattern_idx = 0;
     if(!local) gather_dual_data(block, scale, primal_corner_coord.cast<float>(), data, dual_corner_coords_f);
-    else gather_dual_data(map, block, scale, primal_corner_coord, data, dual_corner_coords_f);
+    else gather_dual_data(map, block, neighbour_blocks, scale, min_scale, primal_corner_coord, data, dual_corner_coords_f);
 
     // Only compute dual index if all data is valid/observed
     for (int corner_idx = 0; corner_idx < 8; corner_idx++) {
       if(data[corner_idx].y == 0.f) return;
     }
 
-    // if(inside(data[0])) edge_pattern_idx |= 1;
-    // if(inside(data[1])) edge_pattern_idx |= 2;
-    // if(inside(data[2])) edge_pattern_idx |= 4;
-    // if(inside(data[3])) edge_pattern_idx |= 8;
-    // if(inside(data[4])) edge_pattern_idx |= 16;
-    // if(inside(data[5])) edge_pattern_idx |= 32;
-    // if(inside(data[6])) edge_pattern_idx |= 64;
-    // if(inside(data[7])) edge_pattern_idx |= 128;
     for (int corner_idx = 0; corner_idx < 8; corner_idx++) {
       if(inside(data[corner_idx])) edge_pattern_idx |= (1 << corner_idx);
     }
-    // std::cerr << std::endl << std::endl;
-
   }
 
   inline bool checkVertex(const Eigen::Vector3f& vertex_M, const float dim){
@@ -869,7 +687,211 @@ namespace meshing {
   }
 
 }
+namespace meshing {
+  /*
+   * The number of chunks the VoxelBlocks are split into when meshing the whole
+   * map. Each chunk is meshed into its own buffer and the buffers are merged
+   * in order, so the result doesn't depend on the number of threads.
+   */
+  static constexpr size_t num_block_chunks = 64;
+
+  template <typename MeshChunkF>
+  void for_each_block_chunk(const size_t num_blocks,
+                            const size_t num_chunks,
+                            MeshChunkF   mesh_chunk) {
+#pragma omp parallel for schedule(dynamic)
+    for (size_t chunk_idx = 0; chunk_idx < num_chunks; ++chunk_idx) {
+      mesh_chunk(chunk_idx, chunk_idx * num_blocks / num_chunks,
+          (chunk_idx + 1) * num_blocks / num_chunks);
+    }
+  }
+
+  /*! \brief Call add_triangle(vertexes, vertex_keys) for each marching cubes
+   * triangle of the cubes whose lower corner lies inside block. The cubes on
+   * the upper faces of the block also read the voxels of the neighbouring
+   * VoxelBlocks.
+   */
+  template <typename FieldType,
+            typename ValueSelector,
+            typename InsidePredicate,
+            typename AddTriangleF>
+  void marching_cube_block(Octree<FieldType>&               map,
+                           const VoxelBlockType<FieldType>* block,
+                           ValueSelector                    select_value,
+                           InsidePredicate                  inside,
+                           AddTriangleF                     add_triangle) {
+
+    const int map_size = map.size();
+    const float map_dim = map.dim();
+    const int block_size = VoxelBlockType<FieldType>::size_li;
+    const Eigen::Vector3i& start_coord = block->coordinates();
+    const Eigen::Vector3i last_coord =
+      (block->coordinates() + Eigen::Vector3i::Constant(block_size)).cwiseMin(
+          Eigen::Vector3i::Constant(map_size-1));
+    Eigen::Vector3f vertexes[3];
+    EdgeKey vertex_keys[3];
+    for (int x = start_coord.x(); x < last_coord.x(); x++) {
+      for (int y = start_coord.y(); y < last_coord.y(); y++) {
+        for (int z = start_coord.z(); z < last_coord.z(); z++) {
+          const uint8_t edge_pattern_idx = compute_index(map, block, inside, x, y, z);
+          const int* edges = triTable[edge_pattern_idx];
+          for (unsigned int e = 0; edges[e] != -1 && e < 16; e += 3) {
+            for (int v = 0; v < 3; ++v) {
+              vertexes[v] = interp_vertexes(map, select_value, x, y, z, edges[e + v]);
+            }
+            if (checkVertex(vertexes[0], map_dim) || checkVertex(vertexes[1], map_dim) || checkVertex(vertexes[2], map_dim))
+              continue;
+            const Eigen::Vector3i corner_coord = 2 * Eigen::Vector3i(x, y, z) + Eigen::Vector3i::Ones();
+            for (int v = 0; v < 3; ++v) {
+              const int* corner_idxs = edge_corner_idxs[edges[e + v]];
+              vertex_keys[v] = edge_key(corner_coord + norm_dual_offset_f[corner_idxs[0]].cast<int>(),
+                                        corner_coord + norm_dual_offset_f[corner_idxs[1]].cast<int>());
+            }
+            add_triangle(vertexes, vertex_keys);
+          }
+        }
+      }
+    }
+  }
+
+  /*! \brief Call add_triangle(vertexes, vertex_keys) for each triangle of a
+   * single dual cube.
+   */
+  template <typename DataT,
+            typename ValueSelector,
+            typename AddTriangleF>
+  inline void add_dual_triangles(const uint8_t         edge_pattern_idx,
+                                 const DataT           data[8],
+                                 const Eigen::Vector3f dual_corner_coords_f[8],
+                                 const float           voxel_dim,
+                                 const float           map_dim,
+                                 ValueSelector         select_value,
+                                 AddTriangleF          add_triangle) {
+    Eigen::Vector3f vertexes[3];
+    EdgeKey vertex_keys[3];
+    const int* edges = triTable[edge_pattern_idx];
+    for (unsigned int e = 0; edges[e] != -1 && e < 16; e += 3) {
+      for (int v = 0; v < 3; ++v) {
+        vertexes[v] = interp_dual_vertexes(edges[e + v], data, dual_corner_coords_f, voxel_dim, select_value);
+      }
+      if (checkVertex(vertexes[0], map_dim) || checkVertex(vertexes[1], map_dim) || checkVertex(vertexes[2], map_dim))
+        continue;
+      for (int v = 0; v < 3; ++v) {
+        const int* corner_idxs = edge_corner_idxs[edges[e + v]];
+        vertex_keys[v] = edge_key((2.f * dual_corner_coords_f[corner_idxs[0]]).cast<int>(),
+                                  (2.f * dual_corner_coords_f[corner_idxs[1]]).cast<int>());
+      }
+      add_triangle(vertexes, vertex_keys);
+    }
+  }
+
+  /*! \brief Call add_triangle(vertexes, vertex_keys) for each dual marching
+   * cubes triangle of the primal corners of block. The primal corners on the
+   * block faces read the dual corners of all the neighbouring VoxelBlocks.
+   * VoxelBlocks are meshed at their current scale or min_scale, whichever is
+   * coarser.
+   */
+  template <typename FieldType,
+            typename ValueSelector,
+            typename InsidePredicate,
+            typename AddTriangleF>
+  void dual_marching_cube_block(Octree<FieldType>&               map,
+                                const VoxelBlockType<FieldType>* block,
+                                ValueSelector                    select_value,
+                                InsidePredicate                  inside,
+                                AddTriangleF                     add_triangle,
+                                const int                        min_scale) {
+
+    const int map_size = map.size();
+    const float map_dim = map.dim();
+    const float voxel_dim = map_dim / map_size;
+    const int block_size = VoxelBlockType<FieldType>::size_li;
+    const int voxel_scale = mesh_scale<FieldType>(block, min_scale);
+    const int voxel_stride = 1 << voxel_scale;
+    const Eigen::Vector3i& start_coord = block->coordinates();
+    const Eigen::Vector3i last_coord =
+        (block->coordinates() + Eigen::Vector3i::Constant(block_size)).cwiseMin(
+            Eigen::Vector3i::Constant(map_size - 1));
+    const VoxelBlockType<FieldType>* neighbour_blocks[27];
+    fetch_neighbour_blocks(map, block, neighbour_blocks);
+    typename FieldType::VoxelData data[8];
+    Eigen::Vector3f dual_corner_coords_f[8];
+    for (int x = start_coord.x(); x <= last_coord.x(); x += voxel_stride) {
+      for (int y = start_coord.y(); y <= last_coord.y(); y += voxel_stride) {
+        for (int z = start_coord.z(); z <= last_coord.z(); z += voxel_stride) {
+          const Eigen::Vector3i primal_corner_coord = Eigen::Vector3i(x, y, z);
+          if (x == last_coord.x() || y == last_coord.y() || z == last_coord.z()) {
+            // The primal corner is only meshed if the VoxelBlock containing it
+            // is allocated.
+            const Eigen::Vector3i primal_corner_rel = primal_corner_coord - start_coord;
+            if (neighbour_blocks[neighbour_block_idx(primal_corner_rel.x() >= block_size,
+                                                     primal_corner_rel.y() >= block_size,
+                                                     primal_corner_rel.z() >= block_size)] == nullptr) {
+              continue;
+            }
+          }
+          uint8_t edge_pattern_idx;
+          compute_dual_index(map, block, neighbour_blocks, voxel_scale, min_scale, inside,
+              primal_corner_coord, edge_pattern_idx, data, dual_corner_coords_f);
+          add_dual_triangles(edge_pattern_idx, data, dual_corner_coords_f, voxel_dim, map_dim,
+              select_value, add_triangle);
+        }
+      }
+    }
+  }
+
+  template <typename TriangleType>
+  void add_triangle(std::vector<TriangleType>& triangles,
+                    const Eigen::Vector3f      vertexes[3]) {
+    TriangleType triangle = TriangleType();
+    for (int v = 0; v < 3; ++v) {
+      triangle.vertexes[v] = vertexes[v];
+    }
+    triangles.push_back(triangle);
+  }
+}
+
+
+
 namespace algorithms {
+  /*! \brief Append the marching cubes triangles of the cubes whose lower
+   * corner lies inside block to triangles.
+   */
+  template <typename FieldType,
+            typename ValueSelector,
+            typename InsidePredicate,
+            typename TriangleType>
+  void marching_cube_block(Octree<FieldType>&               map,
+                           const VoxelBlockType<FieldType>* block,
+                           ValueSelector                    select_value,
+                           InsidePredicate                  inside,
+                           std::vector<TriangleType>&       triangles) {
+
+    meshing::marching_cube_block(map, block, select_value, inside,
+        [&](const Eigen::Vector3f vertexes[3], const meshing::EdgeKey*) {
+          meshing::add_triangle(triangles, vertexes);
+        });
+  }
+
+  /*! \brief Add the marching cubes triangles of the cubes whose lower corner
+   * lies inside block to mesh.
+   */
+  template <typename FieldType,
+            typename ValueSelector,
+            typename InsidePredicate>
+  void marching_cube_block(Octree<FieldType>&               map,
+                           const VoxelBlockType<FieldType>* block,
+                           ValueSelector                    select_value,
+                           InsidePredicate                  inside,
+                           IndexedMesh&                     mesh) {
+
+    meshing::IndexedMeshBuilder mesh_builder (mesh);
+    meshing::marching_cube_block(map, block, select_value, inside,
+        [&](const Eigen::Vector3f vertexes[3], const meshing::EdgeKey vertex_keys[3]) {
+          mesh_builder.addTriangle(vertexes, vertex_keys);
+        });
+  }
+
   template <typename FieldType,
             typename ValueSelector,
             typename InsidePredicate,
@@ -879,46 +901,103 @@ namespace algorithms {
                      InsidePredicate            inside,
                      std::vector<TriangleType>& triangles) {
 
-    using namespace meshing;
     std::vector<VoxelBlockType<FieldType>*> block_list;
-    std::mutex lck;
-    const int map_size = map.size();
-    const float map_dim = map.dim();
     map.getBlockList(block_list, false);
+    const size_t num_chunks = std::min(block_list.size(), meshing::num_block_chunks);
+    std::vector<std::vector<TriangleType>> chunk_triangles (num_chunks);
+    meshing::for_each_block_chunk(block_list.size(), num_chunks,
+        [&](const size_t chunk_idx, const size_t begin, const size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            marching_cube_block(map, block_list[i], select_value, inside, chunk_triangles[chunk_idx]);
+          }
+        });
+    for (const auto& block_triangles : chunk_triangles) {
+      triangles.insert(triangles.end(), block_triangles.begin(), block_triangles.end());
+    }
+  }
 
-#pragma omp parallel for
-    for (size_t i = 0; i < block_list.size(); i++) {
-      VoxelBlockType<FieldType>* block = static_cast<VoxelBlockType<FieldType> *>(block_list[i]);
-      const int block_size = VoxelBlockType<FieldType>::size_li;
-      const Eigen::Vector3i& start_coord = block->coordinates();
-      const Eigen::Vector3i last_coord =
-        (block->coordinates() + Eigen::Vector3i::Constant(block_size)).cwiseMin(
-            Eigen::Vector3i::Constant(map_size-1));
-      for (int x = start_coord.x(); x < last_coord.x(); x++) {
-        for (int y = start_coord.y(); y < last_coord.y(); y++) {
-          for (int z = start_coord.z(); z < last_coord.z(); z++) {
-            const uint8_t edge_pattern_idx = meshing::compute_index(map, block, inside, x, y, z);
-            const int* edges = triTable[edge_pattern_idx];
-            for (unsigned int e = 0; edges[e] != -1 && e < 16; e += 3) {
-              Eigen::Vector3f vertex_0 = interp_vertexes(map, select_value, x, y, z, edges[e]);
-              Eigen::Vector3f vertex_1 = interp_vertexes(map, select_value, x, y, z, edges[e + 1]);
-              Eigen::Vector3f vertex_2 = interp_vertexes(map, select_value, x, y, z, edges[e + 2]);
-              if (checkVertex(vertex_0, map_dim) || checkVertex(vertex_1, map_dim) || checkVertex(vertex_2, map_dim))
-                continue;
-              Triangle temp = Triangle();
-              temp.vertexes[0] = vertex_0;
-              temp.vertexes[1] = vertex_1;
-              temp.vertexes[2] = vertex_2;
-              lck.lock();
-              triangles.push_back(temp);
-              lck.unlock();
-            }
+  /*! \brief Create an indexed marching cubes mesh of the whole map. Vertices
+   * interpolated on the same voxel edge are only added once.
+   */
+  template <typename FieldType,
+            typename ValueSelector,
+            typename InsidePredicate>
+  void marching_cube(Octree<FieldType>& map,
+                     ValueSelector      select_value,
+                     InsidePredicate    inside,
+                     IndexedMesh&       mesh) {
+
+    std::vector<VoxelBlockType<FieldType>*> block_list;
+    map.getBlockList(block_list, false);
+    const size_t num_chunks = std::min(block_list.size(), meshing::num_block_chunks);
+    std::vector<IndexedMesh> chunk_meshes (num_chunks);
+    meshing::for_each_block_chunk(block_list.size(), num_chunks,
+        [&](const size_t chunk_idx, const size_t begin, const size_t end) {
+          meshing::IndexedMeshBuilder mesh_builder (chunk_meshes[chunk_idx]);
+          for (size_t i = begin; i < end; ++i) {
+            meshing::marching_cube_block(map, block_list[i], select_value, inside,
+                [&](const Eigen::Vector3f vertexes[3], const meshing::EdgeKey vertex_keys[3]) {
+                  mesh_builder.addTriangle(vertexes, vertex_keys);
+                });
           }
-        }
-      }
+        });
+    meshing::IndexedMeshBuilder mesh_builder (mesh);
+    for (const auto& chunk_mesh : chunk_meshes) {
+      mesh_builder.append(chunk_mesh);
     }
   }
 
+  /*! \brief Append the dual marching cubes triangles of the primal corners of
+   * block to triangles. The block is meshed at min_scale if its current scale
+   * is finer.
+   */
+  template <typename FieldType,
+            typename ValueSelector,
+            typename InsidePredicate,
+            typename TriangleType>
+  void dual_marching_cube_block(Octree<FieldType>&               map,
+                                const VoxelBlockType<FieldType>* block,
+                                ValueSelector                    select_value,
+                                InsidePredicate                  inside,
+                                std::vector<TriangleType>&       triangles,
+                                const int                        min_scale = 0) {
+
+    meshing::dual_marching_cube_block(map, block, select_value, inside,
+        [&](const Eigen::Vector3f vertexes[3], const meshing::EdgeKey*) {
+          meshing::add_triangle(triangles, vertexes);
+        }, min_scale);
+  }
+
+  /*! \brief Add the dual marching cubes triangles of the primal corners of
+   * block to mesh. The block is meshed at min_scale if its current scale is
+   * finer.
+   */
+  template <typename FieldType,
+            typename ValueSelector,
+            typename InsidePredicate>
+  void dual_marching_cube_block(Octree<FieldType>&               map,
+                                const VoxelBlockType<FieldType>* block,
+                                ValueSelector                    select_value,
+                                InsidePredicate                  inside,
+                                IndexedMesh&                     mesh,
+                                const int                        min_scale = 0) {
+
+    meshing::IndexedMeshBuilder mesh_builder (mesh);
+    meshing::dual_marching_cube_block(map, block, select_value, inside,
+        [&](const Eigen::Vector3f vertexes[3], const meshing::EdgeKey vertex_keys[3]) {
+          mesh_builder.addTriangle(vertexes, vertex_keys);
+        }, min_scale);
+  }
+
+  /*! \brief Append the dual marching cubes triangles of the whole map to
+   * triangles.
+   *
+   * \param[in] min_scale The finest scale to mesh at. VoxelBlocks with a
+   *                      finer current scale are meshed at min_scale, which
+   *                      gives a coarser but still crack-free mesh. Values
+   *                      above the coarsest VoxelBlock scale mesh at that
+   *                      scale.
+   */
   template <typename FieldType,
             typename ValueSelector,
             typename InsidePredicate,
@@ -926,58 +1005,56 @@ namespace algorithms {
   void dual_marching_cube(Octree<FieldType>&         map,
                           ValueSelector              select_value,
                           InsidePredicate            inside,
-                          std::vector<TriangleType>& triangles) {
+                          std::vector<TriangleType>& triangles,
+                          const int                  min_scale = 0) {
 
-    using namespace meshing;
     std::vector<VoxelBlockType<FieldType>*> block_list;
-    std::mutex lck;
-    const int map_size = map.size();
-    const float map_dim = map.dim();
-    const float voxel_dim = map_dim / map_size;
     map.getBlockList(block_list, false);
+    const size_t num_chunks = std::min(block_list.size(), meshing::num_block_chunks);
+    std::vector<std::vector<TriangleType>> chunk_triangles (num_chunks);
+    meshing::for_each_block_chunk(block_list.size(), num_chunks,
+        [&](const size_t chunk_idx, const size_t begin, const size_t end) {
+          for (size_t i = begin; i < end; ++i) {
+            dual_marching_cube_block(map, block_list[i], select_value, inside, chunk_triangles[chunk_idx], min_scale);
+          }
+        });
+    for (const auto& block_triangles : chunk_triangles) {
+      triangles.insert(triangles.end(), block_triangles.begin(), block_triangles.end());
+    }
+  }
 
-#pragma omp parallel for
-    for (size_t i = 0; i < block_list.size(); i++) {
-      VoxelBlockType<FieldType>* block = static_cast<VoxelBlockType<FieldType> *>(block_list[i]);
-      const int block_size = VoxelBlockType<FieldType>::size_li;
-      const int voxel_scale = block->current_scale();
-      const int voxel_stride = 1 << voxel_scale;
-      const Eigen::Vector3i& start_coord = block->coordinates();
-      const Eigen::Vector3i last_coord =
-          (block->coordinates() + Eigen::Vector3i::Constant(block_size)).cwiseMin(
-              Eigen::Vector3i::Constant(map_size - 1));
-      for (int x = start_coord.x(); x <= last_coord.x(); x += voxel_stride) {
-        for (int y = start_coord.y(); y <= last_coord.y(); y += voxel_stride) {
-          for (int z = start_coord.z(); z <= last_coord.z(); z += voxel_stride) {
-            const Eigen::Vector3i primal_corner_coord = Eigen::Vector3i(x, y, z);
-            if (x == last_coord.x() || y == last_coord.y() || z == last_coord.z()) {
-              if (map.fetch(x,y,z) == nullptr) {
-                continue;
-              }
-            }
-            uint8_t edge_pattern_idx;
-            typename FieldType::VoxelData data[8];
-            std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f>> dual_corner_coords_f(8, Eigen::Vector3f::Constant(0));
-            meshing::compute_dual_index(map, block, voxel_scale, inside, primal_corner_coord, edge_pattern_idx, data, dual_corner_coords_f);
-            const int* edges = triTable[edge_pattern_idx];
-            for (unsigned int e = 0; edges[e] != -1 && e < 16; e += 3) {
-              Eigen::Vector3f vertex_0 = interp_dual_vertexes(edges[e], data, dual_corner_coords_f, voxel_dim, select_value);
-              Eigen::Vector3f vertex_1 = interp_dual_vertexes(edges[e + 1], data, dual_corner_coords_f, voxel_dim, select_value);
-              Eigen::Vector3f vertex_2 = interp_dual_vertexes(edges[e + 2], data, dual_corner_coords_f, voxel_dim, select_value);
-
-              if (checkVertex(vertex_0, map_dim) || checkVertex(vertex_1, map_dim) || checkVertex(vertex_2, map_dim))
-                continue;
-              Triangle temp = Triangle();
-              temp.vertexes[0] = vertex_0;
-              temp.vertexes[1] = vertex_1;
-              temp.vertexes[2] = vertex_2;
-              lck.lock();
-              triangles.push_back(temp);
-              lck.unlock();
-            }
+  /*! \brief Create an indexed dual marching cubes mesh of the whole map.
+   * Vertices interpolated on the same dual edge are only added once.
+   *
+   * \param[in] min_scale The finest scale to mesh at, see the
+   *                      std::vector<TriangleType> overload.
+   */
+  template <typename FieldType,
+            typename ValueSelector,
+            typename InsidePredicate>
+  void dual_marching_cube(Octree<FieldType>& map,
+                          ValueSelector      select_value,
+                          InsidePredicate    inside,
+                          IndexedMesh&       mesh,
+                          const int          min_scale = 0) {
+
+    std::vector<VoxelBlockType<FieldType>*> block_list;
+    map.getBlockList(block_list, false);
+    const size_t num_chunks = std::min(block_list.size(), meshing::num_block_chunks);
+    std::vector<IndexedMesh> chunk_meshes (num_chunks);
+    meshing::for_each_block_chunk(block_list.size(), num_chunks,
+        [&](const size_t chunk_idx, const size_t begin, const size_t end) {
+          meshing::IndexedMeshBuilder mesh_builder (chunk_meshes[chunk_idx]);
+          for (size_t i = begin; i < end; ++i) {
+            meshing::dual_marching_cube_block(map, block_list[i], select_value, inside,
+                [&](const Eigen::Vector3f vertexes[3], const meshing::EdgeKey vertex_keys[3]) {
+                  mesh_builder.addTriangle(vertexes, vertex_keys);
+                }, min_scale);
           }
-        }
-      }
+        });
+    meshing::IndexedMeshBuilder mesh_builder (mesh);
+    for (const auto& chunk_mesh : chunk_meshes) {
+      mesh_builder.append(chunk_mesh);
     }
   }
 }
@@ -0,0 +1,123 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef EMPTY_SPACE_SKIPPING_HPP
+#define EMPTY_SPACE_SKIPPING_HPP
+
+#include <algorithm>
+#include <limits>
+
+#include <Eigen/Dense>
+
+#include "octree.hpp"
+
+
+
+namespace se {
+
+  /*! \brief Skip the coarsest empty octant containing the point at distance t
+   * along a ray.
+   *
+   * The octree is descended towards the point down to the VoxelBlock
+   * containing it. The data the parent of each Node or VoxelBlock stores for
+   * it in se::Node::childData() is a conservative summary of the octant,
+   * maintained by the voxel implementation during upward propagation, e.g.
+   * the maximum occupancy or the minimum TSDF value it contains.
+   * is_empty(summary) must only return true if no surface can be found inside
+   * the octant.
+   *
+   * Only the part of the octant further than margin from its faces is
+   * skipped, so that the interpolation neighbours of the points skipped are
+   * also inside the octant.
+   *
+   * \param[in]  map          The octree to skip the empty space of.
+   * \param[in]  ray_origin_M The origin of the ray in the map frame [m].
+   * \param[in]  ray_dir_M    The direction of the ray in the map frame.
+   * \param[in]  t            The current distance along the ray [m].
+   * \param[in]  margin       The distance to keep from the octant faces [m].
+   * \param[in]  is_empty     Unary predicate on the octant summary data.
+   * \param[out] t_next       The distance along the ray from which it makes
+   *                          sense to call skip_empty_space() again [m].
+   * \return The distance along the ray to continue marching from [m]. It is t
+   * if no octant could be skipped.
+   */
+  template <typename T, typename EmptyPredicateT>
+  float skip_empty_space(const Octree<T>&       map,
+                         const Eigen::Vector3f& ray_origin_M,
+                         const Eigen::Vector3f& ray_dir_M,
+                         const float            t,
+                         const float            margin,
+                         EmptyPredicateT        is_empty,
+                         float&                 t_next) {
+
+    t_next = t;
+    const Eigen::Vector3f point_M = ray_origin_M + t * ray_dir_M;
+    const Node<T>* node = map.root();
+    if (!node || !map.containsPoint(point_M)) {
+      return t;
+    }
+
+    const float voxel_dim = map.voxelDim();
+    const Eigen::Vector3i voxel_coord = map.pointToVoxel(point_M);
+    for (int node_size = map.size() >> 1; node_size >= static_cast<int>(Octree<T>::block_size);
+        node_size >>= 1) {
+      const int child_idx = ((voxel_coord.x() & node_size) > 0)
+          + 2 * ((voxel_coord.y() & node_size) > 0) + 4 * ((voxel_coord.z() & node_size) > 0);
+      const Node<T>* child = node->child(child_idx);
+      // Octants smaller than twice the margin can't be skipped.
+      const bool empty = 2.f * margin < voxel_dim * node_size
+          && is_empty(node->childrenData()[child_idx]);
+      if (!empty && child && !child->isBlock()) {
+        node = child;
+        continue;
+      }
+
+      // Intersect the ray with the octant of the child and, if it's empty,
+      // with the octant shrunk by margin on all sides.
+      const Eigen::Vector3i octant_coord = (voxel_coord / node_size) * node_size;
+      const float shrink = empty ? margin : 0.f;
+      float t_entry = -std::numeric_limits<float>::infinity();
+      float t_exit = std::numeric_limits<float>::infinity();
+      float t_exit_octant = std::numeric_limits<float>::infinity();
+      for (int i = 0; i < 3; ++i) {
+        const float min_M = voxel_dim * octant_coord[i];
+        const float max_M = voxel_dim * (octant_coord[i] + node_size);
+        if (ray_dir_M[i] == 0.f) {
+          if (ray_origin_M[i] < min_M + shrink || ray_origin_M[i] > max_M - shrink) {
+            t_entry = std::numeric_limits<float>::infinity();
+          }
+          continue;
+        }
+        const float t_min = (min_M + shrink - ray_origin_M[i]) / ray_dir_M[i];
+        const float t_max = (max_M - shrink - ray_origin_M[i]) / ray_dir_M[i];
+        t_entry = std::max(t_entry, std::min(t_min, t_max));
+        t_exit = std::min(t_exit, std::max(t_min, t_max));
+        t_exit_octant = std::min(t_exit_octant,
+            (((ray_dir_M[i] > 0.f) ? max_M : min_M) - ray_origin_M[i]) / ray_dir_M[i]);
+      }
+
+      if (!empty) {
+        // A VoxelBlock or unallocated octant that may contain a surface or
+        // is too small to be skipped.
+        t_next = t_exit_octant;
+        return t;
+      }
+      if (t_entry > t && t_entry < t_exit) {
+        // Not inside the shrunk octant yet, try again once the ray enters it.
+        t_next = t_entry;
+        return t;
+      }
+      if (t_entry > t_exit || t >= t_exit) {
+        // The ray misses the shrunk octant or has already left it.
+        t_next = t_exit_octant;
+        return t;
+      }
+      t_next = t_exit_octant;
+      return t_exit;
+    }
+    return t;
+  }
+} // namespace se
+
+#endif // EMPTY_SPACE_SKIPPING_HPP
+
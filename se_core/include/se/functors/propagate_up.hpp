@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef PROPAGATE_UP_HPP
+#define PROPAGATE_UP_HPP
+
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace se {
+  namespace functor {
+    namespace internal {
+      /*! \brief Store the unique, non-null parents of octants in parents.
+       */
+      template <typename NodeT, typename OctantT>
+      void unique_parents(std::vector<NodeT*>&        parents,
+                          const std::vector<OctantT*>& octants) {
+        parents.clear();
+        parents.reserve(octants.size());
+        for (const auto& octant : octants) {
+          if (octant->parent()) {
+            parents.push_back(octant->parent());
+          }
+        }
+        std::sort(parents.begin(), parents.end());
+        parents.erase(std::unique(parents.begin(), parents.end()), parents.end());
+      }
+    }
+
+
+
+    /*! \brief Apply node_op to every ancestor of the octants in
+     * octant_list exactly once, starting from the parents of the octants and
+     * moving up towards the root one depth at a time.
+     *
+     * All the nodes of a single depth are processed in parallel, and a depth
+     * is only processed once the ones below it are done. This means node_op
+     * may read from the node's children and write to the node itself or to
+     * its own slot in node->parent()->childData(), but nothing else. The
+     * octants may be VoxelBlocks or Nodes of different depths.
+     *
+     * \param[in] octant_list The updated octants.
+     * \param[in] node_op     Unary functor called with a se::Node pointer.
+     */
+    template <typename OctantT, typename NodeOp>
+    void propagate_up(const std::vector<OctantT*>& octant_list,
+                      NodeOp                       node_op) {
+      using NodeType = typename std::remove_pointer<typename std::remove_reference<
+          decltype(std::declval<OctantT*>()->parent())>::type>::type;
+
+      std::vector<NodeType*> pending;
+      std::vector<NodeType*> level;
+      std::vector<NodeType*> parents;
+      internal::unique_parents(pending, octant_list);
+      while (!pending.empty()) {
+        // Only process the deepest pending nodes, the others may be ancestors
+        // of them.
+        const auto min_size = (*std::min_element(pending.begin(), pending.end(),
+            [](const NodeType* a, const NodeType* b) { return a->size() < b->size(); }))->size();
+        const auto level_end = std::partition(pending.begin(), pending.end(),
+            [min_size](const NodeType* node) { return node->size() == min_size; });
+        level.assign(pending.begin(), level_end);
+        pending.erase(pending.begin(), level_end);
+        const int n = level.size();
+#pragma omp parallel for
+        for (int i = 0; i < n; ++i) {
+          node_op(level[i]);
+        }
+        internal::unique_parents(parents, level);
+        pending.insert(pending.end(), parents.begin(), parents.end());
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+      }
+    }
+  }
+}
+#endif
+
@@ -5,11 +5,15 @@
 
 #ifndef MESH_IO_H
 #define MESH_IO_H
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <memory>
 #include <sstream>
 #include <iostream>
 #include "se/utils/math_utils.h"
 #include <algorithm>
+#include "se/algorithms/meshing.hpp"
 
 namespace se {
 
@@ -67,6 +71,105 @@ namespace se {
   static int save_mesh_obj(const std::vector<Triangle> &mesh,
                            const std::string filename);
 
+  /**
+   * \brief Save an indexed mesh as a VTK file. Each vertex is only written
+   * once.
+   *
+   * \param[in] mesh       The mesh in map frame to be saved.
+   * \param[in] filename   The output filename.
+   * \param[in] T_WM       The transformation from map to world frame.
+   * \param[in] point_data The scalar values of the vertices.
+   * \param[in] cell_data  The scalar values of the faces.
+   * \param[out] file_size The size of the written file in bytes if not
+   *                       nullptr.
+   * \return 0 on success, nonzero on error.
+   */
+  static int save_mesh_vtk(const IndexedMesh &mesh,
+                           const std::string filename,
+                           const Eigen::Matrix4f &T_WM,
+                           const float *point_data = nullptr,
+                           const float *cell_data = nullptr,
+                           size_t *file_size = nullptr);
+
+  /**
+   * \brief Save an indexed mesh as a PLY file. Each vertex is only written
+   * once.
+   *
+   * \param[in] mesh       The mesh in map frame to be saved.
+   * \param[in] filename   The output filename.
+   * \param[in] T_WM       The transformation from map to world frame.
+   * \param[in] point_data The scalar values of the vertices.
+   * \param[in] cell_data  The scalar values of the faces.
+   * \param[out] file_size The size of the written file in bytes if not
+   *                       nullptr.
+   * \return 0 on success, nonzero on error.
+   */
+  static int save_mesh_ply(const IndexedMesh &mesh,
+                           const std::string filename,
+                           const Eigen::Matrix4f &T_WM,
+                           const float *point_data = nullptr,
+                           const float *cell_data = nullptr,
+                           size_t *file_size = nullptr);
+
+  /**
+   * \brief Save an indexed mesh as a OBJ file. Each vertex is only written
+   * once.
+   *
+   * \param[in] mesh     The mesh to be saved.
+   * \param[in] filename The output filename.
+   * \return 0 on success, nonzero on error.
+   */
+  static int save_mesh_obj(const IndexedMesh &mesh,
+                           const std::string filename);
+
+  /**
+   * \brief Save an indexed mesh as a binary little-endian PLY file. The
+   * normalised vertex normals are written if the mesh has normals.
+   *
+   * The file is formatted in parallel into a single buffer and written with
+   * a single write, which is much faster than save_mesh_ply() for large
+   * meshes.
+   *
+   * \param[in] mesh       The mesh in map frame to be saved.
+   * \param[in] filename   The output filename.
+   * \param[in] T_WM       The transformation from map to world frame.
+   * \param[in] point_data The scalar values of the vertices.
+   * \param[in] cell_data  The scalar values of the faces.
+   * \param[out] file_size The size of the written file in bytes if not
+   *                       nullptr.
+   * \return 0 on success, nonzero on error.
+   */
+  static int save_mesh_ply_binary(const IndexedMesh &mesh,
+                                  const std::string filename,
+                                  const Eigen::Matrix4f &T_WM,
+                                  const float *point_data = nullptr,
+                                  const float *cell_data = nullptr,
+                                  size_t *file_size = nullptr);
+
+  /**
+   * \brief Save an indexed mesh as a binary VTK file. The normalised vertex
+   * normals are written if the mesh has normals.
+   *
+   * The file is formatted in parallel into a single buffer and written with
+   * a single write. As required by the legacy VTK file format, the binary
+   * data is big-endian.
+   *
+   * \param[in] mesh       The mesh in map frame to be saved.
+   * \param[in] filename   The output filename.
+   * \param[in] T_WM       The transformation from map to world frame.
+   * \param[in] point_data The scalar values of the vertices.
+   * \param[in] cell_data  The scalar values of the faces.
+   * \param[out] file_size The size of the written file in bytes if not
+   *                       nullptr.
+   * \return 0 on success, nonzero on error.
+   */
+  static int save_mesh_vtk_binary(const IndexedMesh &mesh,
+                                  const std::string filename,
+                                  const Eigen::Matrix4f &T_WM,
+                                  const float *point_data = nullptr,
+                                  const float *cell_data = nullptr,
+                                  size_t *file_size = nullptr);
+
 }
 
 #include "meshing_io_impl.hpp"
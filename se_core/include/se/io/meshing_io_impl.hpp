@@ -6,6 +6,92 @@
 #ifndef __MESHING_IO_IMPL_HPP
 #define __MESHING_IO_IMPL_HPP
 
+namespace se {
+  namespace internal {
+    /* Store the 4 bytes of value at dst in little-endian order, independent of
+     * the host byte order, and return the address after them. */
+    template <typename T>
+    inline char* store_le(char* dst, const T value) {
+      static_assert(sizeof(T) == 4, "Only 4-byte values are supported");
+      uint32_t bits;
+      std::memcpy(&bits, &value, 4);
+      dst[0] = static_cast<char>(bits);
+      dst[1] = static_cast<char>(bits >> 8);
+      dst[2] = static_cast<char>(bits >> 16);
+      dst[3] = static_cast<char>(bits >> 24);
+      return dst + 4;
+    }
+
+    /* Store the 4 bytes of value at dst in big-endian order, independent of
+     * the host byte order, and return the address after them. */
+    template <typename T>
+    inline char* store_be(char* dst, const T value) {
+      static_assert(sizeof(T) == 4, "Only 4-byte values are supported");
+      uint32_t bits;
+      std::memcpy(&bits, &value, 4);
+      dst[0] = static_cast<char>(bits >> 24);
+      dst[1] = static_cast<char>(bits >> 16);
+      dst[2] = static_cast<char>(bits >> 8);
+      dst[3] = static_cast<char>(bits);
+      return dst + 4;
+    }
+
+    /* Copy text to dst and return the address after it. */
+    inline char* store_text(char* dst, const std::string& text) {
+      std::memcpy(dst, text.data(), text.size());
+      return dst + text.size();
+    }
+
+    /* The unit normal of vertex vertex_idx in world frame, zero if the
+     * normals of its triangles cancel out. */
+    inline Eigen::Vector3f vertex_normal_W(const IndexedMesh&     mesh,
+                                           const size_t           vertex_idx,
+                                           const Eigen::Matrix3f& R_WM) {
+      const Eigen::Vector3f normal_W = R_WM * mesh.normals[vertex_idx];
+      const float norm = normal_W.norm();
+      return (norm > 0.f) ? Eigen::Vector3f(normal_W / norm) : Eigen::Vector3f::Zero();
+    }
+
+    /* Write the size bytes of buffer to file with a single write and store
+     * size in file_size if it is not nullptr. */
+    inline int write_buffer(std::ofstream&     file,
+                            const std::string& filename,
+                            const char*        buffer,
+                            const size_t       size,
+                            size_t*            file_size) {
+      file.write(buffer, size);
+      file.close();
+      if (file.fail()) {
+        std::cerr << "Unable to write file " << filename << "\n";
+        return 1;
+      }
+      if (file_size != nullptr) {
+        *file_size = size;
+      }
+      return 0;
+    }
+
+    /* Close the text file and store its size in file_size if it is not
+     * nullptr. */
+    inline int close_text_file(std::ofstream&     file,
+                               const std::string& filename,
+                               size_t*            file_size) {
+      const std::streamoff size = file.tellp();
+      file.close();
+      if (file.fail()) {
+        std::cerr << "Unable to write file " << filename << "\n";
+        return 1;
+      }
+      if (file_size != nullptr) {
+        *file_size = size;
+      }
+      return 0;
+    }
+  } // namespace internal
+} // namespace se
+
+
+
 int se::save_mesh_vtk(const std::vector<Triangle>& mesh,
                       const std::string            filename,
                       const Eigen::Matrix4f&       T_WM,
@@ -205,4 +291,342 @@ int se::save_mesh_obj(const std::vector<Triangle>& mesh,
   return 0;
 }
 
+
+
+int se::save_mesh_vtk(const IndexedMesh&     mesh,
+                      const std::string      filename,
+                      const Eigen::Matrix4f& T_WM,
+                      const float*           point_data,
+                      const float*           cell_data,
+                      size_t*                file_size) {
+
+  // Open the file for writing.
+  std::ofstream file (filename.c_str());
+  if (!file.is_open()) {
+    std::cerr << "Unable to write file " << filename << "\n";
+    return 1;
+  }
+
+  const size_t num_vertices = mesh.vertexes.size();
+  const size_t num_faces = mesh.numTriangles();
+
+  file << "# vtk DataFile Version 1.0\n";
+  file << "vtk mesh generated from KFusion\n";
+  file << "ASCII\n";
+  file << "DATASET POLYDATA\n";
+
+  file << "POINTS " << num_vertices << " FLOAT\n";
+  for (const auto& vertex_M : mesh.vertexes) {
+    const Eigen::Vector3f vertex_W = (T_WM * vertex_M.homogeneous()).head(3);
+    file << vertex_W.x() << " " << vertex_W.y() << " " << vertex_W.z() << "\n";
+  }
+
+  file << "POLYGONS " << num_faces << " " << num_faces * 4 << "\n";
+  for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+    file << "3 " << mesh.indices[i] << " " << mesh.indices[i + 1] << " " << mesh.indices[i + 2] << "\n";
+  }
+  file << "\n";
+
+  if (point_data != nullptr) {
+    file << "POINT_DATA " << num_vertices << "\n";
+    file << "SCALARS vertex_scalars float 1\n";
+    file << "LOOKUP_TABLE default\n";
+    for (size_t i = 0; i < num_vertices; ++i) {
+      file << point_data[i] << "\n";
+    }
+  }
+
+  if (cell_data != nullptr) {
+    file << "CELL_DATA " << num_faces << "\n";
+    file << "SCALARS cell_scalars float 1\n";
+    file << "LOOKUP_TABLE default\n";
+    for (size_t i = 0; i < num_faces; ++i) {
+      file << cell_data[i] << "\n";
+    }
+  }
+
+  return internal::close_text_file(file, filename, file_size);
+}
+
+
+
+int se::save_mesh_ply(const IndexedMesh&     mesh,
+                      const std::string      filename,
+                      const Eigen::Matrix4f& T_WM,
+                      const float*           point_data,
+                      const float*           cell_data,
+                      size_t*                file_size) {
+
+  // Open the file for writing.
+  std::ofstream file (filename.c_str());
+  if (!file.is_open()) {
+    std::cerr << "Unable to write file " << filename << "\n";
+    return 1;
+  }
+
+  const bool has_point_data = point_data != nullptr;
+  const bool has_cell_data = cell_data != nullptr;
+  const size_t num_vertices = mesh.vertexes.size();
+  const size_t num_faces = mesh.numTriangles();
+
+  // Write header
+  file << "ply\n";
+  file << "format ascii 1.0\n";
+  file << "comment Generated by supereight\n";
+  file << "element vertex " << num_vertices << "\n";
+  file << "property float x\n";
+  file << "property float y\n";
+  file << "property float z\n";
+  if (has_point_data) {
+    file << "property float vertex_value\n";
+  }
+  file << "element face " << num_faces << "\n";
+  file << "property list uchar int vertex_index\n";
+  if (has_cell_data) {
+    file << "property float face_value\n";
+  }
+  file << "end_header\n";
+
+  // Write vertices and vertex data
+  for (size_t i = 0; i < num_vertices; ++i) {
+    const Eigen::Vector3f vertex_W = (T_WM * mesh.vertexes[i].homogeneous()).head(3);
+    file << vertex_W.x() << " " << vertex_W.y() << " " << vertex_W.z();
+    if (has_point_data) {
+      file << " " << point_data[i] << "\n";
+    } else {
+      file << "\n";
+    }
+  }
+
+  // Write faces and face data
+  for (size_t i = 0; i < num_faces; ++i) {
+    file << "3 " << mesh.indices[3*i] << " " << mesh.indices[3*i + 1] << " " << mesh.indices[3*i + 2];
+    if (has_cell_data) {
+      file << " " << cell_data[i] << "\n";
+    } else {
+      file << "\n";
+    }
+  }
+
+  return internal::close_text_file(file, filename, file_size);
+}
+
+
+
+int se::save_mesh_obj(const IndexedMesh& mesh,
+                      const std::string  filename) {
+
+  // Open the file for writing.
+  std::ofstream file (filename.c_str());
+  if (!file.is_open()) {
+    std::cerr << "Unable to write file " << filename << "\n";
+    return 1;
+  }
+
+  file << "# OBJ file format with ext .obj\n";
+  file << "# vertex count = " << mesh.vertexes.size() << "\n";
+  file << "# face count = " << mesh.numTriangles() << "\n";
+  for (const auto& vertex_M : mesh.vertexes) {
+    file << "v " << vertex_M.x() << " " << vertex_M.y() << " " << vertex_M.z() << "\n";
+  }
+  // OBJ vertex indices start from 1.
+  for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+    file << "f " << mesh.indices[i] + 1 << " " << mesh.indices[i + 1] + 1
+         << " " << mesh.indices[i + 2] + 1 << "\n";
+  }
+
+  file.close();
+  return 0;
+}
+
+
+
+int se::save_mesh_ply_binary(const IndexedMesh&     mesh,
+                             const std::string      filename,
+                             const Eigen::Matrix4f& T_WM,
+                             const float*           point_data,
+                             const float*           cell_data,
+                             size_t*                file_size) {
+
+  // Open the file for writing.
+  std::ofstream file (filename.c_str(), std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Unable to write file " << filename << "\n";
+    return 1;
+  }
+
+  const bool has_normals = !mesh.vertexes.empty() && mesh.normals.size() == mesh.vertexes.size();
+  const bool has_point_data = point_data != nullptr;
+  const bool has_cell_data = cell_data != nullptr;
+  const size_t num_vertices = mesh.vertexes.size();
+  const size_t num_faces = mesh.numTriangles();
+
+  std::stringstream header;
+  header << "ply\n";
+  header << "format binary_little_endian 1.0\n";
+  header << "comment Generated by supereight\n";
+  header << "element vertex " << num_vertices << "\n";
+  header << "property float x\n";
+  header << "property float y\n";
+  header << "property float z\n";
+  if (has_normals) {
+    header << "property float nx\n";
+    header << "property float ny\n";
+    header << "property float nz\n";
+  }
+  if (has_point_data) {
+    header << "property float vertex_value\n";
+  }
+  header << "element face " << num_faces << "\n";
+  header << "property list uchar int vertex_index\n";
+  if (has_cell_data) {
+    header << "property float face_value\n";
+  }
+  header << "end_header\n";
+  const std::string header_str = header.str();
+
+  // Each vertex and face has a fixed size so they can be formatted in
+  // parallel directly at their position in the file.
+  const size_t vertex_size = 4 * (3 + (has_normals ? 3 : 0) + (has_point_data ? 1 : 0));
+  const size_t face_size = 1 + 4 * (3 + (has_cell_data ? 1 : 0));
+  const size_t vertexes_offset = header_str.size();
+  const size_t faces_offset = vertexes_offset + num_vertices * vertex_size;
+  const size_t buffer_size = faces_offset + num_faces * face_size;
+  std::unique_ptr<char[]> buffer (new char[buffer_size]);
+  internal::store_text(buffer.get(), header_str);
+
+  const Eigen::Matrix3f R_WM = T_WM.topLeftCorner<3, 3>();
+#pragma omp parallel for
+  for (size_t i = 0; i < num_vertices; ++i) {
+    char* dst = buffer.get() + vertexes_offset + i * vertex_size;
+    const Eigen::Vector3f vertex_W = (T_WM * mesh.vertexes[i].homogeneous()).head(3);
+    dst = internal::store_le(dst, vertex_W.x());
+    dst = internal::store_le(dst, vertex_W.y());
+    dst = internal::store_le(dst, vertex_W.z());
+    if (has_normals) {
+      const Eigen::Vector3f normal_W = internal::vertex_normal_W(mesh, i, R_WM);
+      dst = internal::store_le(dst, normal_W.x());
+      dst = internal::store_le(dst, normal_W.y());
+      dst = internal::store_le(dst, normal_W.z());
+    }
+    if (has_point_data) {
+      internal::store_le(dst, point_data[i]);
+    }
+  }
+
+#pragma omp parallel for
+  for (size_t i = 0; i < num_faces; ++i) {
+    char* dst = buffer.get() + faces_offset + i * face_size;
+    *dst++ = 3;
+    for (int v = 0; v < 3; ++v) {
+      dst = internal::store_le(dst, static_cast<int32_t>(mesh.indices[3 * i + v]));
+    }
+    if (has_cell_data) {
+      internal::store_le(dst, cell_data[i]);
+    }
+  }
+
+  return internal::write_buffer(file, filename, buffer.get(), buffer_size, file_size);
+}
+
+
+
+int se::save_mesh_vtk_binary(const IndexedMesh&     mesh,
+                             const std::string      filename,
+                             const Eigen::Matrix4f& T_WM,
+                             const float*           point_data,
+                             const float*           cell_data,
+                             size_t*                file_size) {
+
+  // Open the file for writing.
+  std::ofstream file (filename.c_str(), std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Unable to write file " << filename << "\n";
+    return 1;
+  }
+
+  const bool has_normals = !mesh.vertexes.empty() && mesh.normals.size() == mesh.vertexes.size();
+  const bool has_point_data = point_data != nullptr;
+  const bool has_cell_data = cell_data != nullptr;
+  const size_t num_vertices = mesh.vertexes.size();
+  const size_t num_faces = mesh.numTriangles();
+
+  // The text preceding each binary section.
+  std::stringstream points_header;
+  points_header << "# vtk DataFile Version 3.0\n";
+  points_header << "vtk mesh generated from KFusion\n";
+  points_header << "BINARY\n";
+  points_header << "DATASET POLYDATA\n";
+  points_header << "POINTS " << num_vertices << " float\n";
+  std::stringstream polygons_header;
+  polygons_header << "\nPOLYGONS " << num_faces << " " << num_faces * 4 << "\n";
+  std::stringstream point_data_header;
+  if (has_point_data || has_normals) {
+    point_data_header << "\nPOINT_DATA " << num_vertices << "\n";
+  }
+  if (has_point_data) {
+    point_data_header << "SCALARS vertex_scalars float 1\n";
+    point_data_header << "LOOKUP_TABLE default\n";
+  }
+  const std::string normals_header = !has_normals ? ""
+      : (has_point_data ? "\nNORMALS normals float\n" : "NORMALS normals float\n");
+  std::stringstream cell_data_header;
+  if (has_cell_data) {
+    cell_data_header << "\nCELL_DATA " << num_faces << "\n";
+    cell_data_header << "SCALARS cell_scalars float 1\n";
+    cell_data_header << "LOOKUP_TABLE default\n";
+  }
+
+  const size_t points_offset = points_header.str().size();
+  const size_t polygons_offset = points_offset + 12 * num_vertices + polygons_header.str().size();
+  const size_t point_data_offset = polygons_offset + 16 * num_faces + point_data_header.str().size();
+  const size_t normals_offset = point_data_offset + (has_point_data ? 4 * num_vertices : 0)
+      + normals_header.size();
+  const size_t cell_data_offset = normals_offset + (has_normals ? 12 * num_vertices : 0)
+      + cell_data_header.str().size();
+  const size_t buffer_size = cell_data_offset + (has_cell_data ? 4 * num_faces : 0) + 1;
+  std::unique_ptr<char[]> buffer (new char[buffer_size]);
+  internal::store_text(buffer.get(), points_header.str());
+  internal::store_text(buffer.get() + points_offset + 12 * num_vertices, polygons_header.str());
+  internal::store_text(buffer.get() + polygons_offset + 16 * num_faces, point_data_header.str());
+  internal::store_text(buffer.get() + normals_offset - normals_header.size(), normals_header);
+  internal::store_text(buffer.get() + cell_data_offset - cell_data_header.str().size(),
+      cell_data_header.str());
+  buffer[buffer_size - 1] = '\n';
+
+  const Eigen::Matrix3f R_WM = T_WM.topLeftCorner<3, 3>();
+#pragma omp parallel for
+  for (size_t i = 0; i < num_vertices; ++i) {
+    const Eigen::Vector3f vertex_W = (T_WM * mesh.vertexes[i].homogeneous()).head(3);
+    char* dst = buffer.get() + points_offset + 12 * i;
+    dst = internal::store_be(dst, vertex_W.x());
+    dst = internal::store_be(dst, vertex_W.y());
+    internal::store_be(dst, vertex_W.z());
+    if (has_point_data) {
+      internal::store_be(buffer.get() + point_data_offset + 4 * i, point_data[i]);
+    }
+    if (has_normals) {
+      const Eigen::Vector3f normal_W = internal::vertex_normal_W(mesh, i, R_WM);
+      dst = buffer.get() + normals_offset + 12 * i;
+      dst = internal::store_be(dst, normal_W.x());
+      dst = internal::store_be(dst, normal_W.y());
+      internal::store_be(dst, normal_W.z());
+    }
+  }
+
+#pragma omp parallel for
+  for (size_t i = 0; i < num_faces; ++i) {
+    char* dst = buffer.get() + polygons_offset + 16 * i;
+    dst = internal::store_be(dst, static_cast<int32_t>(3));
+    for (int v = 0; v < 3; ++v) {
+      dst = internal::store_be(dst, static_cast<int32_t>(mesh.indices[3 * i + v]));
+    }
+    if (has_cell_data) {
+      internal::store_be(buffer.get() + cell_data_offset + 4 * i, cell_data[i]);
+    }
+  }
+
+  return internal::write_buffer(file, filename, buffer.get(), buffer_size, file_size);
+}
+
 #endif // __MESHING_IO_IMPL_HPP
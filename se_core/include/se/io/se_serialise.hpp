@@ -31,6 +31,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #ifndef SE_SERIALISE_HPP
 #define SE_SERIALISE_HPP
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include "../octree_defines.h"
 #include "Eigen/Dense"
@@ -136,6 +138,8 @@ namespace se {
      */
     template <typename T>
     std::ofstream& serialise(std::ofstream& out, VoxelBlockFull<T>& block) {
+      // Bring all outdated scales up to date before writing them.
+      block.propagateDirty(VoxelBlockFull<T>::max_scale);
       out.write(reinterpret_cast<char *>(&block.code_), sizeof(key_t));
       out.write(reinterpret_cast<char *>(&block.size_), sizeof(int));
       out.write(reinterpret_cast<char *>(&block.children_mask_), sizeof(unsigned char));
@@ -229,6 +233,284 @@ namespace se {
         }
       }
     }
+
+
+
+    /*
+     * The map file format written by Octree::save(). All values are in host
+     * byte order.
+     *
+     * MapFileHeader
+     * Node records in memory pool order, i.e. each parent before its children
+     * MapFileBlockEntry per VoxelBlock sorted by Morton code
+     * VoxelBlock records in the same order, each aligned to map_file_alignment
+     *
+     * The records are written by the serialise(char*, ...) functions below,
+     * so the file can be memory mapped and each VoxelBlock read independently.
+     */
+    constexpr char map_file_magic[8] = {'S', 'E', 'O', 'C', 'T', 'R', 'E', 'E'};
+    constexpr uint32_t map_file_version = 1;
+    constexpr size_t map_file_alignment = 64;
+
+    struct MapFileHeader {
+      char     magic[8];
+      uint32_t version;
+      uint32_t voxel_data_size;
+      uint32_t block_size;
+      int32_t  size;
+      float    dim;
+      uint32_t padding;
+      uint64_t num_nodes;
+      uint64_t num_blocks;
+      uint64_t nodes_offset;
+      uint64_t block_index_offset;
+      uint64_t file_size;
+    };
+
+    struct MapFileBlockEntry {
+      key_t    code;
+      uint64_t offset;
+    };
+
+    inline size_t map_file_align(const size_t offset) {
+      return (offset + map_file_alignment - 1) / map_file_alignment * map_file_alignment;
+    }
+
+    template <typename FieldT>
+    inline char* write_field(char* out, const FieldT& field) {
+      std::memcpy(out, reinterpret_cast<const char *>(&field), sizeof(FieldT));
+      return out + sizeof(FieldT);
+    }
+
+    template <typename FieldT>
+    inline const char* read_field(const char* in, FieldT& field) {
+      std::memcpy(reinterpret_cast<char *>(&field), in, sizeof(FieldT));
+      return in + sizeof(FieldT);
+    }
+
+    /**
+     * \brief The number of bytes serialise(char*, node) writes.
+     */
+    template <typename T>
+    size_t serialised_size(const Node<T>& node) {
+      return sizeof(key_t) + sizeof(int) + sizeof(unsigned char) + sizeof(unsigned int)
+          + sizeof(bool) + sizeof(node.children_data_);
+    }
+
+    /**
+     * \brief Write node's data to the memory at out, in the same layout as
+     * serialise(std::ofstream&, node).
+     *
+     * \param[out] out  The memory to write to, serialised_size(node) bytes
+     * \param[in]  node The node to be serialised
+     * \return The address after the written data.
+     */
+    template <typename T>
+    char* serialise(char* out, Node<T>& node) {
+      out = write_field(out, node.code_);
+      out = write_field(out, node.size_);
+      out = write_field(out, node.children_mask_);
+      out = write_field(out, node.timestamp_);
+      out = write_field(out, node.active_);
+      return write_field(out, node.children_data_);
+    }
+
+    /**
+     * \brief Read node's data from the memory at in.
+     *
+     * \param[out] node The node to be deserialised
+     * \param[in]  in   The memory written by serialise(char*, node)
+     * \return The address after the read data.
+     */
+    template <typename T>
+    const char* deserialise(Node<T>& node, const char* in) {
+      in = read_field(in, node.code_);
+      in = read_field(in, node.size_);
+      in = read_field(in, node.children_mask_);
+      in = read_field(in, node.timestamp_);
+      in = read_field(in, node.active_);
+      return read_field(in, node.children_data_);
+    }
+
+    /**
+     * \brief The number of bytes at the start of a VoxelBlock record written
+     * by serialise(char*, block) needed to read its minimum scale with
+     * read_block_min_scale().
+     */
+    template <typename T>
+    size_t block_min_scale_end() {
+      return serialised_size(Node<T>()) + sizeof(Eigen::Vector3i) + sizeof(int);
+    }
+
+    /**
+     * \brief Read the minimum scale of the VoxelBlock record at in. The size
+     * of the records of VoxelBlockSingle depends on it.
+     */
+    template <typename T>
+    int read_block_min_scale(const char* in) {
+      int min_scale;
+      read_field(in + block_min_scale_end<T>() - sizeof(int), min_scale);
+      return min_scale;
+    }
+
+    /**
+     * \brief The number of bytes serialise(char*, block) writes.
+     */
+    template <typename T>
+    size_t serialised_size(const VoxelBlockFinest<T>& block) {
+      return sizeof(key_t) + sizeof(int) + sizeof(unsigned char) + sizeof(unsigned int)
+          + sizeof(bool) + sizeof(block.children_data_) + sizeof(Eigen::Vector3i) + 2 * sizeof(int)
+          + sizeof(block.block_data_);
+    }
+
+    /**
+     * \brief Write VoxelBlock's data to the memory at out.
+     */
+    template <typename T>
+    char* serialise(char* out, VoxelBlockFinest<T>& block) {
+      out = write_field(out, block.code_);
+      out = write_field(out, block.size_);
+      out = write_field(out, block.children_mask_);
+      out = write_field(out, block.timestamp_);
+      out = write_field(out, block.active_);
+      out = write_field(out, block.children_data_);
+      out = write_field(out, block.coordinates_);
+      out = write_field(out, block.min_scale_);
+      out = write_field(out, block.current_scale_);
+      return write_field(out, block.block_data_);
+    }
+
+    /**
+     * \brief Read VoxelBlock's data from the memory at in.
+     */
+    template <typename T>
+    const char* deserialise(VoxelBlockFinest<T>& block, const char* in) {
+      in = read_field(in, block.code_);
+      in = read_field(in, block.size_);
+      in = read_field(in, block.children_mask_);
+      in = read_field(in, block.timestamp_);
+      in = read_field(in, block.active_);
+      in = read_field(in, block.children_data_);
+      in = read_field(in, block.coordinates_);
+      in = read_field(in, block.min_scale_);
+      in = read_field(in, block.current_scale_);
+      return read_field(in, block.block_data_);
+    }
+
+    /**
+     * \brief The number of bytes serialise(char*, block) writes.
+     */
+    template <typename T>
+    size_t serialised_size(const VoxelBlockFull<T>& block) {
+      return sizeof(key_t) + sizeof(int) + sizeof(unsigned char) + sizeof(unsigned int)
+          + sizeof(bool) + sizeof(block.children_data_) + sizeof(Eigen::Vector3i) + 2 * sizeof(int)
+          + sizeof(block.block_data_);
+    }
+
+    /**
+     * \brief Write VoxelBlock's data to the memory at out.
+     */
+    template <typename T>
+    char* serialise(char* out, VoxelBlockFull<T>& block) {
+      // Bring all outdated scales up to date before writing them.
+      block.propagateDirty(VoxelBlockFull<T>::max_scale);
+      out = write_field(out, block.code_);
+      out = write_field(out, block.size_);
+      out = write_field(out, block.children_mask_);
+      out = write_field(out, block.timestamp_);
+      out = write_field(out, block.active_);
+      out = write_field(out, block.children_data_);
+      out = write_field(out, block.coordinates_);
+      out = write_field(out, block.min_scale_);
+      out = write_field(out, block.current_scale_);
+      return write_field(out, block.block_data_);
+    }
+
+    /**
+     * \brief Read VoxelBlock's data from the memory at in.
+     */
+    template <typename T>
+    const char* deserialise(VoxelBlockFull<T>& block, const char* in) {
+      in = read_field(in, block.code_);
+      in = read_field(in, block.size_);
+      in = read_field(in, block.children_mask_);
+      in = read_field(in, block.timestamp_);
+      in = read_field(in, block.active_);
+      in = read_field(in, block.children_data_);
+      in = read_field(in, block.coordinates_);
+      in = read_field(in, block.min_scale_);
+      in = read_field(in, block.current_scale_);
+      return read_field(in, block.block_data_);
+    }
+
+    /**
+     * \brief The number of bytes serialise(char*, block) writes.
+     */
+    template <typename T>
+    size_t serialised_size(const VoxelBlockSingle<T>& block) {
+      size_t size = sizeof(key_t) + sizeof(int) + sizeof(unsigned char) + sizeof(unsigned int)
+          + sizeof(bool) + sizeof(block.children_data_) + sizeof(Eigen::Vector3i) + 2 * sizeof(int)
+          + sizeof(typename T::VoxelData);
+      if (block.min_scale() != -1) {
+        for (int scale = VoxelBlockSingle<T>::max_scale; scale >= block.min_scale(); scale--) {
+          size += se::math::cu(block.size_li >> scale) * sizeof(typename T::VoxelData);
+        }
+      }
+      return size;
+    }
+
+    /**
+     * \brief Write VoxelBlock's data to the memory at out.
+     */
+    template <typename T>
+    char* serialise(char* out, VoxelBlockSingle<T>& block) {
+      out = write_field(out, block.code_);
+      out = write_field(out, block.size_);
+      out = write_field(out, block.children_mask_);
+      out = write_field(out, block.timestamp_);
+      out = write_field(out, block.active_);
+      out = write_field(out, block.children_data_);
+      out = write_field(out, block.coordinates_);
+      out = write_field(out, block.min_scale_);
+      out = write_field(out, block.current_scale_);
+      out = write_field(out, block.init_data_);
+      if (block.min_scale() != -1) {
+        for (int scale = VoxelBlockSingle<T>::max_scale; scale >= block.min_scale(); scale--) {
+          const size_t num_bytes = se::math::cu(block.size_li >> scale) * sizeof(typename T::VoxelData);
+          std::memcpy(out, block.blockData()[VoxelBlockSingle<T>::max_scale - scale], num_bytes);
+          out += num_bytes;
+        }
+      }
+      return out;
+    }
+
+    /**
+     * \brief Read VoxelBlock's data from the memory at in. The block must
+     * not have any allocated scales.
+     */
+    template <typename T>
+    const char* deserialise(VoxelBlockSingle<T>& block, const char* in) {
+      in = read_field(in, block.code_);
+      in = read_field(in, block.size_);
+      in = read_field(in, block.children_mask_);
+      in = read_field(in, block.timestamp_);
+      in = read_field(in, block.active_);
+      in = read_field(in, block.children_data_);
+      in = read_field(in, block.coordinates_);
+      in = read_field(in, block.min_scale_);
+      in = read_field(in, block.current_scale_);
+      in = read_field(in, block.init_data_);
+      if (block.min_scale() != -1) {
+        for (int scale = VoxelBlockSingle<T>::max_scale; scale >= block.min_scale(); scale--) {
+          const int num_voxels_at_scale = se::math::cu(block.size_li >> scale);
+          typename T::VoxelData* block_data_at_scale = new typename T::VoxelData[num_voxels_at_scale];
+          std::memcpy(block_data_at_scale, in, num_voxels_at_scale * sizeof(typename T::VoxelData));
+          block.blockData().push_back(block_data_at_scale);
+          in += num_voxels_at_scale * sizeof(typename T::VoxelData);
+        }
+      }
+      return in;
+    }
   }
 }
 #endif
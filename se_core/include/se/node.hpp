@@ -122,6 +122,9 @@ private:
   void initFromNode(const Node<T>& node);
   friend std::ofstream& internal::serialise <> (std::ofstream& out, Node& node);
   friend void internal::deserialise <> (Node& node, std::ifstream& in);
+  friend size_t internal::serialised_size <> (const Node& node);
+  friend char* internal::serialise <> (char* out, Node& node);
+  friend const char* internal::deserialise <> (Node& node, const char* in);
 };
 
 /*! \brief A leaf node of the Octree. Each VoxelBlock contains compute_num_voxels() voxels
@@ -161,6 +164,15 @@ public:
   int min_scale() const { return min_scale_; }
   void min_scale(const int s) { min_scale_ = s; }
 
+  /*! \brief Mark all scales coarser than scale as outdated. Outdated scales
+   * are recomputed from the finer ones the first time they are read, see
+   * VoxelBlockFull::data().
+   */
+  void dirtyAbove(const int scale);
+  /*! \brief Whether scale is outdated.
+   */
+  bool dirty(const int scale) const;
+
   virtual VoxelData data(const Eigen::Vector3i& voxel_coord) const = 0;
   virtual void setData(const Eigen::Vector3i& voxel_coord, const VoxelData& voxel_data) = 0;
 
@@ -193,6 +205,15 @@ protected:
   Eigen::Vector3i coordinates_;
   int current_scale_;
   int min_scale_;
+  // Bit s is set if scale s is outdated. The most significant bit is used
+  // to lock the block while outdated scales are being recomputed.
+  mutable std::atomic<unsigned char> dirty_scales_;
+  static constexpr unsigned char dirty_lock_bit_ = 1 << 7;
+  static_assert(max_scale < 7, "The dirty bits of all scales must be below dirty_lock_bit_");
+
+  void lockDirty() const;
+  void unlockDirty() const;
+  void clearDirty(const int scale) const;
 
 private:
   // Internal copy helper function
@@ -250,6 +271,9 @@ private:
   friend std::ofstream& internal::serialise <> (std::ofstream& out,
                                                 VoxelBlockFinest& node);
   friend void internal::deserialise <> (VoxelBlockFinest& node, std::ifstream& in);
+  friend size_t internal::serialised_size <> (const VoxelBlockFinest& node);
+  friend char* internal::serialise <> (char* out, VoxelBlockFinest& node);
+  friend const char* internal::deserialise <> (VoxelBlockFinest& node, const char* in);
 };
 
 
@@ -290,6 +314,8 @@ public:
 private:
   // Internal copy helper function
   void initFromBlock(const VoxelBlockFull<T>& block);
+  // Recompute all outdated scales up to and including scale.
+  void propagateDirty(const int scale) const;
 
   static constexpr size_t compute_num_voxels() {
     size_t voxel_count = 0;
@@ -307,6 +333,9 @@ private:
   friend std::ofstream& internal::serialise <> (std::ofstream& out,
                                                 VoxelBlockFull& node);
   friend void internal::deserialise <> (VoxelBlockFull& node, std::ifstream& in);
+  friend size_t internal::serialised_size <> (const VoxelBlockFull& node);
+  friend char* internal::serialise <> (char* out, VoxelBlockFull& node);
+  friend const char* internal::deserialise <> (VoxelBlockFull& node, const char* in);
 };
 
 
@@ -365,6 +394,9 @@ private:
 
   friend std::ofstream& internal::serialise <> (std::ofstream& out, VoxelBlockSingle& node);
   friend void internal::deserialise <> (VoxelBlockSingle& node, std::ifstream& in);
+  friend size_t internal::serialised_size <> (const VoxelBlockSingle& node);
+  friend char* internal::serialise <> (char* out, VoxelBlockSingle& node);
+  friend const char* internal::deserialise <> (VoxelBlockSingle& node, const char* in);
 };
 
 } // namespace se
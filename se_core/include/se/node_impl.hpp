@@ -134,7 +134,8 @@ VoxelBlock<T>::VoxelBlock(const int current_scale,
                           const int min_scale) :
     coordinates_(Eigen::Vector3i::Constant(0)),
     current_scale_(current_scale),
-    min_scale_(min_scale) {}
+    min_scale_(min_scale),
+    dirty_scales_(0) {}
 
 template <typename T>
 VoxelBlock<T>::VoxelBlock(const VoxelBlock<T>& block) {
@@ -203,9 +204,54 @@ void VoxelBlock<T>::initFromBlock(const VoxelBlock<T>& block) {
   coordinates_   = block.coordinates();
   min_scale_     = block.min_scale();
   current_scale_ = block.current_scale();
+  dirty_scales_  = block.dirty_scales_.load() & ~dirty_lock_bit_;
   std::copy(block.childrenData(), block.childrenData() + 8, this->children_data_);
 }
 
+template <typename T>
+inline void VoxelBlock<T>::dirtyAbove(const int scale) {
+  const unsigned char all_scales = (1 << (max_scale + 1)) - 1;
+  const unsigned char finer_scales = (1 << (scale + 1)) - 1;
+  dirty_scales_.fetch_or(all_scales & ~finer_scales, std::memory_order_release);
+}
+
+template <typename T>
+inline bool VoxelBlock<T>::dirty(const int scale) const {
+  return dirty_scales_.load(std::memory_order_acquire) & (1 << scale);
+}
+
+template <typename T>
+inline void VoxelBlock<T>::lockDirty() const {
+  while (dirty_scales_.fetch_or(dirty_lock_bit_, std::memory_order_acquire) & dirty_lock_bit_) {}
+}
+
+template <typename T>
+inline void VoxelBlock<T>::unlockDirty() const {
+  dirty_scales_.fetch_and(static_cast<unsigned char>(~dirty_lock_bit_), std::memory_order_release);
+}
+
+template <typename T>
+inline void VoxelBlock<T>::clearDirty(const int scale) const {
+  dirty_scales_.fetch_and(static_cast<unsigned char>(~(1 << scale)), std::memory_order_release);
+}
+
+
+
+namespace internal {
+  /*! \brief Recompute scale of block from scale - 1 using
+   * T::propagateBlockScale(). Voxel types without that function never mark
+   * scales as dirty, so nothing is done for them.
+   */
+  template <typename T, typename BlockT>
+  inline auto propagate_block_scale(BlockT* block, const int scale, int)
+      -> decltype(T::propagateBlockScale(block, scale)) {
+    T::propagateBlockScale(block, scale);
+  }
+
+  template <typename T, typename BlockT>
+  inline void propagate_block_scale(BlockT*, const int, long) {}
+}
+
 
 
 // Voxel block finest scale allocation implementation
@@ -330,6 +376,7 @@ VoxelBlockFull<T>::data(const Eigen::Vector3i& voxel_coord) const {
 template <typename T>
 inline typename VoxelBlock<T>::VoxelData
 VoxelBlockFull<T>::data(const Eigen::Vector3i& voxel_coord, const int scale) const {
+  propagateDirty(scale);
   Eigen::Vector3i voxel_offset = voxel_coord - this->coordinates_;
   int scale_offset = 0;
   int scale_tmp = 0;
@@ -389,6 +436,7 @@ inline void VoxelBlockFull<T>::setData(const int voxel_idx, const VoxelData& vox
 template <typename T>
 inline typename VoxelBlock<T>::VoxelData
 VoxelBlockFull<T>::data(const int voxel_idx, const int scale) const {
+  propagateDirty(scale);
   return block_data_[this->scaleOffset(scale) + voxel_idx];
 }
 
@@ -409,10 +457,28 @@ void VoxelBlockFull<T>::initFromBlock(const VoxelBlockFull<T>& block) {
   this->coordinates_   = block.coordinates();
   this->min_scale_     = block.min_scale();
   this->current_scale_ = block.current_scale();
+  this->dirty_scales_  = block.dirty_scales_.load() & ~this->dirty_lock_bit_;
   std::copy(block.childrenData(), block.childrenData() + 8, this->children_data_);
   std::copy(block.blockData(), block.blockData() + num_voxels_in_block, blockData());
 }
 
+template <typename T>
+inline void VoxelBlockFull<T>::propagateDirty(const int scale) const {
+  if (!this->dirty(scale)) {
+    return;
+  }
+  this->lockDirty();
+  // Scales are recomputed from fine to coarse and each one is marked clean
+  // before moving on, so reading it from the next scale does not recurse.
+  for (int s = 1; s <= scale; ++s) {
+    if (this->dirty(s)) {
+      internal::propagate_block_scale<T>(const_cast<VoxelBlockFull<T>*>(this), s, 0);
+      this->clearDirty(s);
+    }
+  }
+  this->unlockDirty();
+}
+
 
 
 // Voxel block single scale allocation implementation
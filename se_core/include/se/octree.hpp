@@ -34,7 +34,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cstring>
 #include <algorithm>
+#include <unordered_map>
 #include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "utils/math_utils.h"
 #include "octree_defines.h"
 #include "utils/morton_utils.hpp"
@@ -656,6 +661,106 @@ public:
                               bool&                  is_valid,
                               const int              min_scale = 1) const;
 
+  /*! \brief Interpolate a voxel value and compute its gradient at the
+   * supplied voxel coordinates.
+   *
+   * The value and the gradient are computed from a single gather of the
+   * neighbouring voxels. They are equivalent to calling interp() and then
+   * grad() with the scale returned by interp() as the minimum scale.
+   *
+   * \param[in]  voxel_coord_f The coordinates of the voxel. Each component
+   *                           must be in the interval [0, size).
+   * \param[in]  select_value  Lambda value to select the value to interpolate
+   *                           from the voxel data.
+   * \param[out] gradient      The gradient of the selected value.
+   * \param[in]  min_scale     The minimum scale at which the interpolation is
+   *                           performed.
+   * \return The interpolated value and the scale it was interpolated at.
+   */
+  template <typename ValueSelector>
+  std::pair<float, int> interpGrad(const Eigen::Vector3f& voxel_coord_f,
+                                   ValueSelector          select_value,
+                                   Eigen::Vector3f&       gradient,
+                                   const int              min_scale = 0) const;
+
+  /*! \brief Interpolate a voxel value and compute its gradient at the
+   * supplied voxel coordinates.
+   *
+   * \param[in]  voxel_coord_f      The coordinates of the voxel. Each
+   *                                component must be in the interval [0,
+   *                                size).
+   * \param[in]  select_node_value  Lambda value to select the value to
+   *                                interpolate from the node data.
+   * \param[in]  select_voxel_value Lambda value to select the value to
+   *                                interpolate from the voxel data.
+   * \param[out] gradient           The gradient of the selected value.
+   * \param[in]  min_scale          The minimum scale at which the
+   *                                interpolation is performed.
+   * \return The interpolated value and the scale it was interpolated at.
+   */
+  template <typename NodeValueSelector, typename VoxelValueSelector>
+  std::pair<float, int> interpGrad(const Eigen::Vector3f& voxel_coord_f,
+                                   NodeValueSelector      select_node_value,
+                                   VoxelValueSelector     select_voxel_value,
+                                   Eigen::Vector3f&       gradient,
+                                   const int              min_scale = 0) const;
+
+  /*! \brief Interpolate a voxel value and compute its gradient at the
+   * supplied voxel coordinates.
+   *
+   * \param[in]  voxel_coord_f      The coordinates of the voxel. Each
+   *                                component must be in the interval [0,
+   *                                size).
+   * \param[in]  select_node_value  Lambda value to select the value to
+   *                                interpolate from the node data.
+   * \param[in]  select_voxel_value Lambda value to select the value to
+   *                                interpolate from the voxel data.
+   * \param[out] gradient           The gradient of the selected value.
+   * \param[in]  min_scale          The minimum scale at which the
+   *                                interpolation is performed.
+   * \param[out] is_valid           False when the interpolation uses data from
+   *                                voxels which haven't been integrated into.
+   *                                The gradient is not computed in that case.
+   * \return The interpolated value and the scale it was interpolated at.
+   */
+  template <typename NodeValueSelector, typename VoxelValueSelector>
+  std::pair<float, int> interpGrad(const Eigen::Vector3f& voxel_coord_f,
+                                   NodeValueSelector      select_node_value,
+                                   VoxelValueSelector     select_voxel_value,
+                                   Eigen::Vector3f&       gradient,
+                                   const int              min_scale,
+                                   bool&                  is_valid) const;
+
+  /*! \brief Interpolate a voxel value and compute its gradient at the
+   * supplied 3D point. See interpGrad().
+   */
+  template <typename ValueSelector>
+  std::pair<float, int> interpGradAtPoint(const Eigen::Vector3f& point_M,
+                                          ValueSelector          select_value,
+                                          Eigen::Vector3f&       gradient,
+                                          const int              min_scale = 0) const;
+
+  /*! \brief Interpolate a voxel value and compute its gradient at the
+   * supplied 3D point. See interpGrad().
+   */
+  template <typename NodeValueSelector, typename VoxelValueSelector>
+  std::pair<float, int> interpGradAtPoint(const Eigen::Vector3f& point_M,
+                                          NodeValueSelector      select_node_value,
+                                          VoxelValueSelector     select_voxel_value,
+                                          Eigen::Vector3f&       gradient,
+                                          const int              min_scale = 0) const;
+
+  /*! \brief Interpolate a voxel value and compute its gradient at the
+   * supplied 3D point. See interpGrad().
+   */
+  template <typename NodeValueSelector, typename VoxelValueSelector>
+  std::pair<float, int> interpGradAtPoint(const Eigen::Vector3f& point_M,
+                                          NodeValueSelector      select_node_value,
+                                          VoxelValueSelector     select_voxel_value,
+                                          Eigen::Vector3f&       gradient,
+                                          const int              min_scale,
+                                          bool&                  is_valid) const;
+
   /*! \brief Get the list of allocated block. If the active switch is set to
    * true then only the visible blocks are retrieved.
    * \param block_list output vector of allocated blocks
@@ -688,7 +793,20 @@ public:
    */
   bool allocate(key_t *keys, int num_elem);
 
+  /*! \brief Save the octree to a binary map file.
+   *
+   * The file contains a versioned header, the nodes, an index of the
+   * VoxelBlocks sorted by Morton code and the VoxelBlocks, each aligned to
+   * internal::map_file_alignment bytes. It is written through a memory
+   * mapping with the VoxelBlocks serialised in parallel.
+   */
   void save(const std::string& filename);
+
+  /*! \brief Load an octree saved with save(). The file is memory mapped, the
+   * octree structure is rebuilt without descending from the root for each
+   * octant and the VoxelBlocks are deserialised in parallel. Files written
+   * by previous versions of save() are loaded too.
+   */
   void load(const std::string& filename);
 
   /*! \brief Counts the number of blocks allocated
@@ -750,12 +868,23 @@ private:
                            ValuesGetter           get_values,
                            const int              min_scale) const;
 
+  template <typename NodeValueSelector, typename VoxelValueSelector>
+  std::pair<float, int> interpGradImpl(const Eigen::Vector3f& voxel_coord_f,
+                                       NodeValueSelector      select_node_value,
+                                       VoxelValueSelector     select_voxel_value,
+                                       Eigen::Vector3f&       gradient,
+                                       const int              min_scale,
+                                       bool*                  is_valid) const;
+
   // Parallel allocation of a given tree depth for a set of input keys.
   // Pre: depth above target_depth must have been already allocated
   bool allocate_depth(key_t * keys, int num_tasks, int target_depth);
 
   void reserveBuffers(const int n);
 
+  // Load a file written before the map file format was versioned.
+  void loadUnversioned(const std::string& filename);
+
   // General helpers
 
   int blockCountRecursive(Node<T>*);
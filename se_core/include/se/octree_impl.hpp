@@ -912,6 +912,212 @@ Eigen::Vector3f Octree<T>::gradImpl(const Eigen::Vector3f& voxel_coord_f,
 
 
 
+template <typename T>
+template <typename ValueSelector>
+std::pair<float, int> Octree<T>::interpGrad(const Eigen::Vector3f& voxel_coord_f,
+                                            ValueSelector          select_value,
+                                            Eigen::Vector3f&       gradient,
+                                            const int              min_scale) const {
+  return interpGradImpl(voxel_coord_f, select_value, select_value, gradient, min_scale, nullptr);
+}
+
+
+
+template <typename T>
+template <typename NodeValueSelector, typename VoxelValueSelector>
+std::pair<float, int> Octree<T>::interpGrad(const Eigen::Vector3f& voxel_coord_f,
+                                            NodeValueSelector      select_node_value,
+                                            VoxelValueSelector     select_voxel_value,
+                                            Eigen::Vector3f&       gradient,
+                                            const int              min_scale) const {
+  return interpGradImpl(voxel_coord_f, select_node_value, select_voxel_value, gradient,
+      min_scale, nullptr);
+}
+
+
+
+template <typename T>
+template <typename NodeValueSelector, typename VoxelValueSelector>
+std::pair<float, int> Octree<T>::interpGrad(const Eigen::Vector3f& voxel_coord_f,
+                                            NodeValueSelector      select_node_value,
+                                            VoxelValueSelector     select_voxel_value,
+                                            Eigen::Vector3f&       gradient,
+                                            const int              min_scale,
+                                            bool&                  is_valid) const {
+  return interpGradImpl(voxel_coord_f, select_node_value, select_voxel_value, gradient,
+      min_scale, &is_valid);
+}
+
+
+
+template <typename T>
+template <typename ValueSelector>
+inline std::pair<float, int> Octree<T>::interpGradAtPoint(
+    const Eigen::Vector3f& point_M,
+    ValueSelector          select_value,
+    Eigen::Vector3f&       gradient,
+    const int              min_scale) const {
+  const Eigen::Vector3f voxel_coord_f = inverse_voxel_dim_ * point_M;
+  return interpGrad(voxel_coord_f, select_value, gradient, min_scale);
+}
+
+
+
+template <typename T>
+template <typename NodeValueSelector, typename VoxelValueSelector>
+inline std::pair<float, int> Octree<T>::interpGradAtPoint(
+    const Eigen::Vector3f& point_M,
+    NodeValueSelector      select_node_value,
+    VoxelValueSelector     select_voxel_value,
+    Eigen::Vector3f&       gradient,
+    const int              min_scale) const {
+  const Eigen::Vector3f voxel_coord_f = inverse_voxel_dim_ * point_M;
+  return interpGrad(voxel_coord_f, select_node_value, select_voxel_value, gradient, min_scale);
+}
+
+
+
+template <typename T>
+template <typename NodeValueSelector, typename VoxelValueSelector>
+inline std::pair<float, int> Octree<T>::interpGradAtPoint(
+    const Eigen::Vector3f& point_M,
+    NodeValueSelector      select_node_value,
+    VoxelValueSelector     select_voxel_value,
+    Eigen::Vector3f&       gradient,
+    const int              min_scale,
+    bool&                  is_valid) const {
+  const Eigen::Vector3f voxel_coord_f = inverse_voxel_dim_ * point_M;
+  return interpGrad(voxel_coord_f, select_node_value, select_voxel_value, gradient, min_scale,
+      is_valid);
+}
+
+
+
+template <typename T>
+template <typename NodeValueSelector, typename VoxelValueSelector>
+std::pair<float, int> Octree<T>::interpGradImpl(const Eigen::Vector3f& voxel_coord_f,
+                                                NodeValueSelector      select_node_value,
+                                                VoxelValueSelector     select_voxel_value,
+                                                Eigen::Vector3f&       gradient,
+                                                const int              min_scale,
+                                                bool*                  is_valid) const {
+
+  auto select_weight = [](const auto& data) { return data.y; };
+
+  typedef decltype(select_voxel_value(T::initData())) value_t;
+
+  // Find the scale to interpolate at and gather the 8 voxels around the
+  // point exactly like interp() does.
+  gradient = Eigen::Vector3f::Zero();
+  int iter = 0;
+  int target_scale = min_scale;
+  int gather_scale = min_scale;
+  value_t inner_values[8] = { select_voxel_value(T::initData()) };
+  Eigen::Vector3f factor;
+  Eigen::Vector3i base_coord;
+  while (iter < 3) {
+    const int stride = 1 << target_scale;
+    const Eigen::Vector3f scaled_voxel_coord_f = 1.f / stride * voxel_coord_f - sample_offset_frac_;
+    factor = math::fracf(scaled_voxel_coord_f);
+    base_coord = stride * scaled_voxel_coord_f.template cast<int>();
+    if ((base_coord.array() < 0).any() ||
+        ((base_coord + Eigen::Vector3i::Constant(stride)).array() >= size_).any()) {
+      if (is_valid) {
+        *is_valid = false;
+      }
+      return {select_voxel_value(T::initData()), target_scale};
+    }
+    gather_scale = target_scale;
+    const int interp_scale = internal::gather_values(*this, base_coord, target_scale,
+        select_node_value, select_voxel_value, inner_values);
+    if (interp_scale == target_scale) {
+      break;
+    } else {
+      target_scale = interp_scale;
+    }
+    iter++;
+  }
+
+  if (is_valid) {
+    typedef decltype(select_weight(T::initData())) weight_t;
+    weight_t inner_weights[8];
+    internal::gather_values(*this, base_coord, gather_scale, select_weight, select_weight,
+        inner_weights);
+    for (int i = 0; i < 8; ++i) {
+      if (inner_weights[i] == 0) {
+        *is_valid = false;
+        return {select_voxel_value(T::initData()), -1};
+      }
+    }
+    *is_valid = true;
+  }
+
+  // Complete the 4x4x4 neighbourhood grad() uses with the 24 voxels adjacent
+  // to the faces of the 2x2x2 cube gathered so far. The corners and edges of
+  // the neighbourhood aren't needed. values[x][y][z] is the voxel at
+  // base_coord + stride * (x - 1, y - 1, z - 1), clamped to the map.
+  const int stride = 1 << gather_scale;
+  value_t values[4][4][4];
+  for (int i = 0; i < 8; ++i) {
+    const Eigen::Vector3i& offset = internal::interp_offsets[i];
+    values[offset.x() + 1][offset.y() + 1][offset.z() + 1] = inner_values[i];
+  }
+  VoxelBlockType* block = fetch(base_coord.x(), base_coord.y(), base_coord.z());
+  auto get_value = [&](const int x, const int y, const int z) {
+    const Eigen::Vector3i voxel_coord = (base_coord + stride * Eigen::Vector3i(x - 1, y - 1, z - 1))
+        .cwiseMax(Eigen::Vector3i::Zero()).cwiseMin(Eigen::Vector3i::Constant(size_ - 1));
+    VoxelData data;
+    const unsigned int scale = get(voxel_coord, block, data, gather_scale);
+    values[x][y][z] = (scale > VoxelBlockType::max_scale)
+        ? select_node_value(data) : select_voxel_value(data);
+  };
+  for (int j = 1; j <= 2; ++j) {
+    for (int k = 1; k <= 2; ++k) {
+      get_value(0, j, k);
+      get_value(3, j, k);
+      get_value(j, 0, k);
+      get_value(j, 3, k);
+      get_value(j, k, 0);
+      get_value(j, k, 3);
+    }
+  }
+
+  // Central differences along each axis, trilinearly interpolated.
+  const Eigen::Vector3f inv_factor = Eigen::Vector3f::Ones() - factor;
+  for (int j = 1; j <= 2; ++j) {
+    const float w_x = (j == 1) ? inv_factor.x() : factor.x();
+    const float w_y = (j == 1) ? inv_factor.y() : factor.y();
+    for (int k = 1; k <= 2; ++k) {
+      const float w_y_k = (k == 1) ? inv_factor.y() : factor.y();
+      const float w_z = (k == 1) ? inv_factor.z() : factor.z();
+      gradient.x() += w_y * w_z
+          * ((values[2][j][k] - values[0][j][k]) * inv_factor.x()
+          +  (values[3][j][k] - values[1][j][k]) * factor.x());
+      gradient.y() += w_x * w_z
+          * ((values[j][2][k] - values[j][0][k]) * inv_factor.y()
+          +  (values[j][3][k] - values[j][1][k]) * factor.y());
+      gradient.z() += w_x * w_y_k
+          * ((values[j][k][2] - values[j][k][0]) * inv_factor.z()
+          +  (values[j][k][3] - values[j][k][1]) * factor.z());
+    }
+  }
+  gradient *= 0.5f * voxel_dim_;
+
+  return {(((inner_values[0] * (1 - factor.x())
+          + inner_values[1] * factor.x()) * (1 - factor.y())
+          + (inner_values[2] * (1 - factor.x())
+          + inner_values[3] * factor.x()) * factor.y())
+          * (1 - factor.z())
+          + ((inner_values[4] * (1 - factor.x())
+          + inner_values[5] * factor.x())
+          * (1 - factor.y())
+          + (inner_values[6] * (1 - factor.x())
+          + inner_values[7] * factor.x())
+          * factor.y()) * factor.z()), target_scale};
+}
+
+
+
 template <typename T>
 int Octree<T>::blockCount(){
   return pool_.blockBufferSize();
@@ -1091,21 +1297,77 @@ void Octree<T>::getAllocatedBlockList(Node<T>* ,
 
 template <typename T>
 void Octree<T>::save(const std::string& filename) {
-  std::ofstream os (filename, std::ios::binary);
-  os.write(reinterpret_cast<char *>(&size_), sizeof(size_));
-  os.write(reinterpret_cast<char *>(&dim_), sizeof(dim_));
 
   auto& node_buffer = pool_.nodeBuffer();
-  size_t num_nodes = node_buffer.size();
-  os.write(reinterpret_cast<char *>(&num_nodes), sizeof(size_t));
-  for(size_t i = 0; i < num_nodes; ++i)
-    internal::serialise(os, *node_buffer[i]);
-
   auto& block_buffer = pool_.blockBuffer();
-  size_t num_blocks = block_buffer.size();
-  os.write(reinterpret_cast<char *>(&num_blocks), sizeof(size_t));
-  for(size_t i = 0; i < num_blocks; ++i)
-    internal::serialise(os, *block_buffer[i]);
+  const size_t num_nodes = node_buffer.size();
+  const size_t num_blocks = block_buffer.size();
+  std::vector<VoxelBlockType*> block_list (num_blocks);
+  for (size_t i = 0; i < num_blocks; ++i) {
+    block_list[i] = block_buffer[i];
+  }
+  auto code_less = [](const VoxelBlockType* lhs, const VoxelBlockType* rhs) {
+    return lhs->code() < rhs->code();
+  };
+#if defined(_OPENMP) && !defined(__clang__)
+  __gnu_parallel::sort(block_list.begin(), block_list.end(), code_less);
+#else
+  std::sort(block_list.begin(), block_list.end(), code_less);
+#endif
+
+  // Compute the file layout.
+  internal::MapFileHeader header = {};
+  std::memcpy(header.magic, internal::map_file_magic, sizeof(header.magic));
+  header.version = internal::map_file_version;
+  header.voxel_data_size = sizeof(typename T::VoxelData);
+  header.block_size = block_size;
+  header.size = size_;
+  header.dim = dim_;
+  header.num_nodes = num_nodes;
+  header.num_blocks = num_blocks;
+  header.nodes_offset = sizeof(header);
+  const size_t node_record_size = (num_nodes > 0) ? internal::serialised_size(*node_buffer[0]) : 0;
+  header.block_index_offset = internal::map_file_align(header.nodes_offset + num_nodes * node_record_size);
+  std::vector<internal::MapFileBlockEntry> block_index (num_blocks);
+  size_t offset = internal::map_file_align(
+      header.block_index_offset + num_blocks * sizeof(internal::MapFileBlockEntry));
+  for (size_t i = 0; i < num_blocks; ++i) {
+    block_index[i].code = block_list[i]->code();
+    block_index[i].offset = offset;
+    offset = internal::map_file_align(offset + internal::serialised_size(*block_list[i]));
+  }
+  header.file_size = offset;
+
+  // Reserve the blocks of the whole file up front. Only growing it with
+  // ftruncate() would leave a sparse file and running out of disk space
+  // while writing to the mapping would then raise SIGBUS.
+  const int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ::posix_fallocate(fd, 0, header.file_size) != 0) {
+    std::cerr << "Unable to write file " << filename << "\n";
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return;
+  }
+  void* mapping = ::mmap(nullptr, header.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Unable to write file " << filename << "\n";
+    return;
+  }
+  char* file = static_cast<char*>(mapping);
+
+  std::memcpy(file, &header, sizeof(header));
+  for (size_t i = 0; i < num_nodes; ++i) {
+    internal::serialise(file + header.nodes_offset + i * node_record_size, *node_buffer[i]);
+  }
+  std::memcpy(file + header.block_index_offset, block_index.data(),
+      num_blocks * sizeof(internal::MapFileBlockEntry));
+#pragma omp parallel for
+  for (size_t i = 0; i < num_blocks; ++i) {
+    internal::serialise(file + block_index[i].offset, *block_list[i]);
+  }
+  ::munmap(mapping, header.file_size);
 }
 
 
@@ -1113,6 +1375,136 @@ void Octree<T>::save(const std::string& filename) {
 template <typename T>
 void Octree<T>::load(const std::string& filename) {
   std::cout << "Loading octree from disk... " << filename << std::endl;
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  struct stat file_stat;
+  if (fd < 0 || ::fstat(fd, &file_stat) != 0) {
+    std::cerr << "Unable to read file " << filename << "\n";
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return;
+  }
+  const size_t file_size = file_stat.st_size;
+  internal::MapFileHeader header;
+  if (file_size < sizeof(header) || ::pread(fd, &header, sizeof(header), 0) != sizeof(header)
+      || std::memcmp(header.magic, internal::map_file_magic, sizeof(header.magic)) != 0) {
+    ::close(fd);
+    loadUnversioned(filename);
+    return;
+  }
+  if (header.version != internal::map_file_version
+      || header.voxel_data_size != sizeof(typename T::VoxelData)
+      || header.block_size != static_cast<uint32_t>(block_size)
+      || header.file_size != file_size) {
+    std::cerr << "Incompatible map file " << filename << " of version " << header.version << "\n";
+    ::close(fd);
+    return;
+  }
+  // The map size must be valid and the node records and the block index must
+  // be inside the file.
+  const size_t node_record_size = internal::serialised_size(Node<T>());
+  const size_t block_entry_size = sizeof(internal::MapFileBlockEntry);
+  if (header.size < static_cast<int32_t>(block_size) || (header.size & (header.size - 1)) != 0
+      || header.nodes_offset > file_size
+      || header.num_nodes > (file_size - header.nodes_offset) / node_record_size
+      || header.block_index_offset > file_size
+      || header.block_index_offset % alignof(internal::MapFileBlockEntry) != 0
+      || header.num_blocks > (file_size - header.block_index_offset) / block_entry_size) {
+    std::cerr << "Malformed map file " << filename << "\n";
+    ::close(fd);
+    return;
+  }
+  void* mapping = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    std::cerr << "Unable to read file " << filename << "\n";
+    return;
+  }
+  const char* file = static_cast<const char*>(mapping);
+  const internal::MapFileBlockEntry* block_index =
+      reinterpret_cast<const internal::MapFileBlockEntry*>(file + header.block_index_offset);
+
+  // Check the records before modifying the octree. Each node's parent must
+  // precede it and each block record must be inside the file.
+  const int voxel_depth = se::math::log2_const(header.size);
+  std::unordered_set<key_t> node_codes;
+  node_codes.reserve(header.num_nodes);
+  bool valid = true;
+  for (size_t i = 0; i < header.num_nodes && valid; ++i) {
+    key_t code;
+    internal::read_field(file + header.nodes_offset + i * node_record_size, code);
+    valid = keyops::depth(code) == 0 || node_codes.count(se::parent(code, voxel_depth)) > 0;
+    node_codes.insert(code);
+  }
+  VoxelBlockType record_block;
+  const int block_depth = voxel_depth - se::math::log2_const(block_size);
+  const size_t min_scale_end = internal::block_min_scale_end<T>();
+  for (size_t i = 0; i < header.num_blocks && valid; ++i) {
+    const size_t offset = block_index[i].offset;
+    valid = keyops::depth(block_index[i].code) == block_depth
+        && node_codes.count(se::parent(block_index[i].code, voxel_depth)) > 0
+        && offset <= file_size
+        && file_size - offset >= min_scale_end;
+    if (valid) {
+      const int min_scale = internal::read_block_min_scale<T>(file + offset);
+      valid = min_scale >= -1 && min_scale <= static_cast<int>(VoxelBlockType::max_scale);
+      record_block.min_scale(min_scale);
+      valid = valid && file_size - offset >= internal::serialised_size(record_block);
+    }
+  }
+  if (!valid) {
+    std::cerr << "Malformed map file " << filename << "\n";
+    ::munmap(mapping, file_size);
+    return;
+  }
+
+  init(header.size, header.dim);
+  pool_.reserveNodes(header.num_nodes);
+  pool_.reserveBlocks(header.num_blocks);
+  std::cout << "Reading " << header.num_nodes << " nodes " << std::endl;
+
+  // Each parent precedes its children, so they can be linked directly.
+  std::unordered_map<key_t, Node<T>*> nodes;
+  nodes.reserve(header.num_nodes);
+  for (size_t i = 0; i < header.num_nodes; ++i) {
+    Node<T> node;
+    internal::deserialise(node, file + header.nodes_offset + i * node_record_size);
+    if (keyops::depth(node.code()) == 0) {
+      *root_ = node;
+      nodes[node.code()] = root_;
+      continue;
+    }
+    Node<T>* parent = nodes.at(se::parent(node.code(), voxel_depth_));
+    Node<T>* child = pool_.acquireNode(&node);
+    const int child_idx = se::child_idx(node.code(), voxel_depth_);
+    child->parent() = parent;
+    parent->child(child_idx) = child;
+    parent->children_mask(parent->children_mask() | (1 << child_idx));
+    nodes[node.code()] = child;
+  }
+
+  std::cout << "Reading " << header.num_blocks << " blocks " << std::endl;
+  std::vector<VoxelBlockType*> block_list (header.num_blocks);
+  for (size_t i = 0; i < header.num_blocks; ++i) {
+    Node<T>* parent = nodes.at(se::parent(block_index[i].code, voxel_depth_));
+    VoxelBlockType* block = pool_.acquireBlock();
+    const int child_idx = se::child_idx(block_index[i].code, voxel_depth_);
+    block->parent() = parent;
+    parent->child(child_idx) = block;
+    parent->children_mask(parent->children_mask() | (1 << child_idx));
+    block_list[i] = block;
+  }
+#pragma omp parallel for
+  for (size_t i = 0; i < header.num_blocks; ++i) {
+    internal::deserialise(*block_list[i], file + block_index[i].offset);
+  }
+  ::munmap(mapping, file_size);
+}
+
+
+
+template <typename T>
+void Octree<T>::loadUnversioned(const std::string& filename) {
   std::ifstream is (filename, std::ios::binary);
   int size;
   float dim;
@@ -0,0 +1,275 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <se/algorithms/mesh_cache.hpp>
+#include <se/algorithms/meshing.hpp>
+#include <se/octree.hpp>
+
+struct TestVoxelT {
+  struct VoxelData {
+    float x;
+    float y;
+  };
+  static inline VoxelData invalid(){ return {0.f, 0.f}; }
+  static inline VoxelData initData(){ return {1.f, 0.f}; }
+
+  static float selectValue(const TestVoxelT::VoxelData& data) {
+    return data.x;
+  };
+
+  static bool isInside(const TestVoxelT::VoxelData& data) {
+    return data.x < 0.f;
+  };
+
+  using VoxelBlockType = se::VoxelBlockFull<TestVoxelT>;
+
+  using MemoryPoolType = se::PagedMemoryPool<TestVoxelT>;
+  template <typename BufferT>
+  using MemoryBufferType = se::PagedMemoryBuffer<BufferT>;
+};
+
+using VoxelBlockType = TestVoxelT::VoxelBlockType;
+using OctreeType = se::Octree<TestVoxelT>;
+
+
+
+/* Sort the triangles by their vertices so that meshes created in a different
+ * order can be compared. */
+std::vector<std::array<float, 9>> sortedTriangles(const std::vector<se::Triangle>& mesh) {
+  std::vector<std::array<float, 9>> triangles;
+  for (const auto& triangle : mesh) {
+    std::array<float, 9> t;
+    for (int v = 0; v < 3; ++v) {
+      for (int i = 0; i < 3; ++i) {
+        t[3 * v + i] = triangle.vertexes[v][i];
+      }
+    }
+    triangles.push_back(t);
+  }
+  std::sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+std::vector<std::array<float, 9>> sortedTriangles(const se::IndexedMesh& mesh) {
+  std::vector<se::Triangle> triangles;
+  mesh.toTriangles(triangles);
+  return sortedTriangles(triangles);
+}
+
+
+
+// A sphere inside a cube of 4x4x4 allocated VoxelBlocks.
+class MeshCacheTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      octree_.init(64, 64);
+      std::vector<se::key_t> allocation_list;
+      for (int z = 16; z < 48; z += VoxelBlockType::size_li) {
+        for (int y = 16; y < 48; y += VoxelBlockType::size_li) {
+          for (int x = 16; x < 48; x += VoxelBlockType::size_li) {
+            allocation_list.push_back(octree_.hash(x, y, z));
+          }
+        }
+      }
+      octree_.allocate(allocation_list.data(), allocation_list.size());
+      std::vector<VoxelBlockType*> block_list;
+      octree_.getBlockList(block_list, false);
+      for (auto block : block_list) {
+        setSphere(block, 10.f);
+      }
+    }
+
+    void setSphere(VoxelBlockType* block, const float radius) {
+      const int block_size = VoxelBlockType::size_li;
+      const Eigen::Vector3f centre = Eigen::Vector3f::Constant(32.f);
+      for (int z = 0; z < block_size; ++z) {
+        for (int y = 0; y < block_size; ++y) {
+          for (int x = 0; x < block_size; ++x) {
+            const Eigen::Vector3i voxel_coord = block->coordinates() + Eigen::Vector3i(x, y, z);
+            const float sdf = (voxel_coord.cast<float>() - centre).norm() - radius;
+            block->setData(voxel_coord, 0, {se::math::clamp(sdf / 4.f, -1.f, 1.f), 1.f});
+          }
+        }
+      }
+    }
+
+    OctreeType octree_;
+};
+
+
+
+TEST_F(MeshCacheTest, MatchesMarchingCube) {
+  auto mesh_block = [](OctreeType& map, const VoxelBlockType* block, se::IndexedMesh& mesh) {
+    se::algorithms::marching_cube_block(map, block, TestVoxelT::selectValue, TestVoxelT::isInside, mesh);
+  };
+  se::MeshCache<TestVoxelT> mesh_cache;
+  EXPECT_EQ(mesh_cache.update(octree_, mesh_block), 64u);
+  EXPECT_EQ(mesh_cache.size(), 64u);
+  EXPECT_EQ(mesh_cache.updatedBlocks().size(), 64u);
+  EXPECT_TRUE(mesh_cache.removedBlocks().empty());
+
+  std::vector<se::Triangle> expected_mesh;
+  se::algorithms::marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, expected_mesh);
+  ASSERT_FALSE(expected_mesh.empty());
+  se::IndexedMesh mesh;
+  mesh_cache.mesh(mesh);
+  EXPECT_EQ(sortedTriangles(mesh), sortedTriangles(expected_mesh));
+  se::IndexedMesh delta_mesh;
+  mesh_cache.deltaMesh(delta_mesh);
+  EXPECT_EQ(sortedTriangles(delta_mesh), sortedTriangles(expected_mesh));
+}
+
+
+
+TEST_F(MeshCacheTest, MatchesDualMarchingCube) {
+  auto mesh_block = [](OctreeType& map, const VoxelBlockType* block, se::IndexedMesh& mesh) {
+    se::algorithms::dual_marching_cube_block(map, block, TestVoxelT::selectValue, TestVoxelT::isInside, mesh);
+  };
+  se::MeshCache<TestVoxelT> mesh_cache;
+  mesh_cache.update(octree_, mesh_block);
+
+  std::vector<se::Triangle> expected_mesh;
+  se::algorithms::dual_marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, expected_mesh);
+  ASSERT_FALSE(expected_mesh.empty());
+  se::IndexedMesh mesh;
+  mesh_cache.mesh(mesh);
+  EXPECT_EQ(sortedTriangles(mesh), sortedTriangles(expected_mesh));
+}
+
+
+
+TEST_F(MeshCacheTest, OnlyUpdatedBlocks) {
+  auto mesh_block = [](OctreeType& map, const VoxelBlockType* block, se::IndexedMesh& mesh) {
+    se::algorithms::marching_cube_block(map, block, TestVoxelT::selectValue, TestVoxelT::isInside, mesh);
+  };
+  se::MeshCache<TestVoxelT> mesh_cache;
+  mesh_cache.update(octree_, mesh_block);
+
+  // Nothing changed.
+  EXPECT_EQ(mesh_cache.update(octree_, mesh_block), 0u);
+  EXPECT_TRUE(mesh_cache.updatedBlocks().empty());
+  se::IndexedMesh delta_mesh;
+  mesh_cache.deltaMesh(delta_mesh);
+  EXPECT_EQ(delta_mesh.numTriangles(), 0u);
+
+  // Grow the sphere inside a single VoxelBlock on the surface. It and its 17
+  // allocated neighbours are meshed again.
+  VoxelBlockType* block = octree_.fetch(32, 32, 40);
+  ASSERT_NE(block, nullptr);
+  setSphere(block, 12.f);
+  block->timestamp(1);
+  EXPECT_EQ(mesh_cache.update(octree_, mesh_block), 18u);
+  const std::vector<se::key_t>& updated_blocks = mesh_cache.updatedBlocks();
+  EXPECT_NE(std::find(updated_blocks.begin(), updated_blocks.end(), octree_.hash(32, 32, 40)),
+      updated_blocks.end());
+  EXPECT_NE(std::find(updated_blocks.begin(), updated_blocks.end(), octree_.hash(24, 24, 32)),
+      updated_blocks.end());
+  EXPECT_EQ(std::find(updated_blocks.begin(), updated_blocks.end(), octree_.hash(16, 32, 40)),
+      updated_blocks.end());
+
+  std::vector<se::Triangle> expected_mesh;
+  se::algorithms::marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, expected_mesh);
+  se::IndexedMesh mesh;
+  mesh_cache.mesh(mesh);
+  EXPECT_EQ(sortedTriangles(mesh), sortedTriangles(expected_mesh));
+
+  // The same timestamp isn't meshed again.
+  EXPECT_EQ(mesh_cache.update(octree_, mesh_block), 0u);
+}
+
+
+
+TEST_F(MeshCacheTest, NodeDataUpdates) {
+  auto mesh_block = [](OctreeType& map, const VoxelBlockType* block, se::IndexedMesh& mesh) {
+    se::algorithms::marching_cube_block(map, block, TestVoxelT::selectValue, TestVoxelT::isInside, mesh);
+  };
+  se::MeshCache<TestVoxelT> mesh_cache;
+  mesh_cache.update(octree_, mesh_block);
+
+  // Mark the unallocated Node child at (48, 32, 32) as occupied without
+  // changing any VoxelBlock timestamp. The 9 VoxelBlocks next to it are
+  // meshed again.
+  se::Node<TestVoxelT>* node = octree_.fetchNode(32, 32, 32, 1);
+  ASSERT_NE(node, nullptr);
+  const int child_idx = 1;
+  ASSERT_EQ(node->child(child_idx), nullptr);
+  node->childData(child_idx, {-1.f, 1.f});
+  EXPECT_EQ(mesh_cache.update(octree_, mesh_block), 9u);
+  const std::vector<se::key_t>& updated_blocks = mesh_cache.updatedBlocks();
+  EXPECT_NE(std::find(updated_blocks.begin(), updated_blocks.end(), octree_.hash(40, 32, 40)),
+      updated_blocks.end());
+  EXPECT_EQ(std::find(updated_blocks.begin(), updated_blocks.end(), octree_.hash(32, 32, 40)),
+      updated_blocks.end());
+
+  std::vector<se::Triangle> expected_mesh;
+  se::algorithms::marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, expected_mesh);
+  se::IndexedMesh mesh;
+  mesh_cache.mesh(mesh);
+  EXPECT_EQ(sortedTriangles(mesh), sortedTriangles(expected_mesh));
+
+  EXPECT_EQ(mesh_cache.update(octree_, mesh_block), 0u);
+}
+
+
+
+TEST_F(MeshCacheTest, IndexedMarchingCube) {
+  std::vector<se::Triangle> expected_mesh;
+  se::algorithms::marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, expected_mesh);
+  se::IndexedMesh mesh;
+  se::algorithms::marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, mesh);
+  EXPECT_EQ(sortedTriangles(mesh), sortedTriangles(expected_mesh));
+  // The sphere is closed, so each vertex is shared by several triangles.
+  EXPECT_LT(2 * mesh.vertexes.size(), 3 * mesh.numTriangles());
+  EXPECT_EQ(mesh.vertexes.size(), mesh.vertex_keys.size());
+
+  // Meshing the cache gives the same vertices.
+  auto mesh_block = [](OctreeType& map, const VoxelBlockType* block, se::IndexedMesh& mesh) {
+    se::algorithms::marching_cube_block(map, block, TestVoxelT::selectValue, TestVoxelT::isInside, mesh);
+  };
+  se::MeshCache<TestVoxelT> mesh_cache;
+  mesh_cache.update(octree_, mesh_block);
+  se::IndexedMesh cache_mesh;
+  mesh_cache.mesh(cache_mesh);
+  EXPECT_EQ(cache_mesh.vertexes.size(), mesh.vertexes.size());
+  EXPECT_EQ(cache_mesh.numTriangles(), mesh.numTriangles());
+}
+
+
+
+TEST_F(MeshCacheTest, IndexedDualMarchingCube) {
+  std::vector<se::Triangle> expected_mesh;
+  se::algorithms::dual_marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, expected_mesh);
+  se::IndexedMesh mesh;
+  se::algorithms::dual_marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, mesh);
+  EXPECT_EQ(sortedTriangles(mesh), sortedTriangles(expected_mesh));
+  EXPECT_LT(2 * mesh.vertexes.size(), 3 * mesh.numTriangles());
+}
+
+
+
+TEST_F(MeshCacheTest, Deterministic) {
+  se::IndexedMesh mesh;
+  se::algorithms::marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, mesh);
+  for (int i = 0; i < 3; ++i) {
+    se::IndexedMesh other_mesh;
+    se::algorithms::marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, other_mesh);
+    EXPECT_EQ(other_mesh.vertexes, mesh.vertexes);
+    EXPECT_EQ(other_mesh.indices, mesh.indices);
+  }
+  std::vector<se::Triangle> triangles;
+  se::algorithms::marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, triangles);
+  std::vector<se::Triangle> other_triangles;
+  se::algorithms::marching_cube(octree_, TestVoxelT::selectValue, TestVoxelT::isInside, other_triangles);
+  ASSERT_EQ(other_triangles.size(), triangles.size());
+  for (size_t i = 0; i < triangles.size(); ++i) {
+    for (int v = 0; v < 3; ++v) {
+      EXPECT_EQ(other_triangles[i].vertexes[v], triangles[i].vertexes[v]);
+    }
+  }
+}
@@ -26,7 +26,11 @@
   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <limits>
+#include <map>
 #include <random>
+#include <utility>
 
 #include <gtest/gtest.h>
 
@@ -36,6 +40,8 @@
 #include <se/utils/math_utils.h>
 #include <se/utils/morton_utils.hpp>
 
+#include "dual_marching_cube_reference.hpp"
+
 struct TestVoxelT {
   struct VoxelData {
     float x;
@@ -4140,3 +4146,188 @@ TEST(MeshingTest, WallCrossesZCoarseToFineAlongY) {
   se::algorithms::dual_marching_cube(octree, TestVoxelT::selectValue, TestVoxelT::isInside, mesh);
   save_mesh_vtk(mesh, filename.c_str(), se::math::to_inverse_transformation(T_MW));
 }
+
+TEST(MeshingTest, DualCornerNeighbours) {
+  const int block_size = VoxelBlockType::size_li;
+  const int crossings[3] = {block_size / 2, 0, block_size};
+  for (int case_x = 0; case_x < 3; ++case_x) {
+    for (int case_y = 0; case_y < 3; ++case_y) {
+      for (int case_z = 0; case_z < 3; ++case_z) {
+        const Eigen::Vector3i primal_corner_rel (crossings[case_x], crossings[case_y], crossings[case_z]);
+        const int case_idx = se::meshing::dual_neighbour_case(primal_corner_rel, block_size);
+        EXPECT_EQ(case_idx, 9 * case_x + 3 * case_y + case_z);
+        // Each dual corner must lie inside the neighbour the table assigns it to.
+        for (int corner_idx = 0; corner_idx < 8; ++corner_idx) {
+          const Eigen::Vector3i dual_corner_rel = primal_corner_rel + se::meshing::logical_dual_offset[corner_idx];
+          const Eigen::Vector3i neighbour_offset = (dual_corner_rel.array() < 0).cast<int>() * -1
+              + (dual_corner_rel.array() >= block_size).cast<int>();
+          EXPECT_EQ(se::meshing::dual_corner_neighbours[case_idx][corner_idx],
+              se::meshing::neighbour_block_idx(neighbour_offset.x(), neighbour_offset.y(), neighbour_offset.z()));
+        }
+      }
+    }
+  }
+}
+
+// A sphere of radius 20 in a 64x64x64 map, sampled at every VoxelBlock scale.
+// The VoxelBlocks with x index i are at scale
+// block_scales[i % block_scales.size()].
+void setSphere(se::Octree<TestVoxelT>& octree, const std::vector<int>& block_scales) {
+  const int block_size = VoxelBlockType::size_li;
+  octree.init(64, 64);
+  std::vector<se::key_t> allocation_list;
+  for (int z = 0; z < 64; z += block_size) {
+    for (int y = 0; y < 64; y += block_size) {
+      for (int x = 0; x < 64; x += block_size) {
+        allocation_list.push_back(octree.hash(x, y, z));
+      }
+    }
+  }
+  octree.allocate(allocation_list.data(), allocation_list.size());
+
+  auto sphere = [](const Eigen::Vector3f& point) {
+    return TestVoxelT::VoxelData{(point - Eigen::Vector3f::Constant(32.f)).norm() - 20.f, 1.f};
+  };
+  std::vector<VoxelBlockType*> block_list;
+  octree.getBlockList(block_list, false);
+  for (size_t i = 0; i < block_list.size(); ++i) {
+    VoxelBlockType* block = block_list[i];
+    const int block_scale = block_scales[(block->coordinates().x() / block_size) % block_scales.size()];
+    block->current_scale(block_scale);
+    block->min_scale(block_scale);
+    for (int scale = block_scale; scale <= static_cast<int>(VoxelBlockType::max_scale); ++scale) {
+      const int stride = 1 << scale;
+      for (int z = 0; z < block_size; z += stride) {
+        for (int y = 0; y < block_size; y += stride) {
+          for (int x = 0; x < block_size; x += stride) {
+            const Eigen::Vector3i voxel_coord = block->coordinates() + Eigen::Vector3i(x, y, z);
+            block->setData(voxel_coord, scale, sphere(voxel_coord.cast<float>() + Eigen::Vector3f::Constant(stride / 2.f)));
+          }
+        }
+      }
+    }
+  }
+}
+
+// Each edge of a closed mesh without cracks is shared by exactly 2 triangles.
+// The triangles collapsed to an edge where the dual cells change scale are
+// ignored.
+bool isWatertight(const se::IndexedMesh& mesh) {
+  std::map<std::pair<uint32_t, uint32_t>, int> edge_counts;
+  for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+    if (mesh.indices[i] == mesh.indices[i + 1] || mesh.indices[i + 1] == mesh.indices[i + 2]
+        || mesh.indices[i + 2] == mesh.indices[i]) {
+      continue;
+    }
+    for (int v = 0; v < 3; ++v) {
+      const uint32_t idx_0 = mesh.indices[i + v];
+      const uint32_t idx_1 = mesh.indices[i + (v + 1) % 3];
+      edge_counts[std::make_pair(std::min(idx_0, idx_1), std::max(idx_0, idx_1))]++;
+    }
+  }
+  for (const auto& edge_count : edge_counts) {
+    if (edge_count.second != 2) {
+      return false;
+    }
+  }
+  return !edge_counts.empty();
+}
+
+TEST(MeshingTest, LevelOfDetail) {
+  se::Octree<TestVoxelT> octree;
+  setSphere(octree, {0});
+  se::IndexedMesh full_mesh;
+  se::algorithms::dual_marching_cube(octree, TestVoxelT::selectValue, TestVoxelT::isInside, full_mesh);
+  EXPECT_TRUE(isWatertight(full_mesh));
+
+  size_t prev_num_triangles = full_mesh.numTriangles();
+  for (int min_scale = 1; min_scale <= static_cast<int>(VoxelBlockType::max_scale); ++min_scale) {
+    se::IndexedMesh mesh;
+    se::algorithms::dual_marching_cube(octree, TestVoxelT::selectValue, TestVoxelT::isInside, mesh, min_scale);
+    EXPECT_TRUE(isWatertight(mesh)) << "min_scale " << min_scale;
+    // Each scale has about a quarter of the triangles of the previous one.
+    EXPECT_LT(2 * mesh.numTriangles(), prev_num_triangles) << "min_scale " << min_scale;
+    prev_num_triangles = mesh.numTriangles();
+
+    std::vector<se::Triangle> triangles;
+    se::algorithms::dual_marching_cube(octree, TestVoxelT::selectValue, TestVoxelT::isInside, triangles, min_scale);
+    EXPECT_EQ(triangles.size(), mesh.numTriangles());
+  }
+}
+
+TEST(MeshingTest, LevelOfDetailMatchesFullResolution) {
+  se::Octree<TestVoxelT> octree;
+  setSphere(octree, {0});
+  se::IndexedMesh full_mesh;
+  se::algorithms::dual_marching_cube(octree, TestVoxelT::selectValue, TestVoxelT::isInside, full_mesh);
+  const Eigen::Vector3f centre = Eigen::Vector3f::Constant(32.f);
+  float full_mean_radius = 0.f;
+  for (const auto& vertex : full_mesh.vertexes) {
+    full_mean_radius += (vertex - centre).norm();
+  }
+  full_mean_radius /= full_mesh.vertexes.size();
+
+  // Values above the coarsest VoxelBlock scale are meshed at that scale.
+  for (int min_scale = 1; min_scale <= static_cast<int>(VoxelBlockType::max_scale) + 1; ++min_scale) {
+    se::IndexedMesh mesh;
+    se::algorithms::dual_marching_cube(octree, TestVoxelT::selectValue, TestVoxelT::isInside, mesh, min_scale);
+    ASSERT_FALSE(mesh.vertexes.empty()) << "min_scale " << min_scale;
+    // Every vertex of the coarse mesh lies close to the full resolution mesh.
+    const float tolerance = 0.5f * (1 << std::min(min_scale, static_cast<int>(VoxelBlockType::max_scale)));
+    float mean_radius = 0.f;
+    for (const auto& vertex : mesh.vertexes) {
+      float min_dist = std::numeric_limits<float>::max();
+      for (const auto& full_vertex : full_mesh.vertexes) {
+        min_dist = std::min(min_dist, (vertex - full_vertex).norm());
+      }
+      EXPECT_LT(min_dist, tolerance) << "min_scale " << min_scale;
+      mean_radius += (vertex - centre).norm();
+    }
+    mean_radius /= mesh.vertexes.size();
+    // The coarse surface is not biased inwards or outwards.
+    EXPECT_NEAR(mean_radius, full_mean_radius, 0.25f) << "min_scale " << min_scale;
+  }
+}
+
+TEST(MeshingTest, LevelOfDetailMixedScales) {
+  se::Octree<TestVoxelT> octree;
+  // Neighbouring VoxelBlocks differ by at most one scale.
+  setSphere(octree, {0, 0, 1, 1, 2, 2, 3, 3});
+  for (int min_scale = 0; min_scale <= 3; ++min_scale) {
+    se::IndexedMesh mesh;
+    se::algorithms::dual_marching_cube(octree, TestVoxelT::selectValue, TestVoxelT::isInside, mesh, min_scale);
+    EXPECT_TRUE(isWatertight(mesh)) << "min_scale " << min_scale;
+  }
+}
+
+TEST(MeshingTest, DualMarchingCubeMatchesReference) {
+  const std::vector<std::vector<int>> block_scale_cases = {{0}, {0, 0, 1, 1, 2, 2, 3, 3}, {0, 3, 1, 2}};
+  for (const auto& block_scales : block_scale_cases) {
+    se::Octree<TestVoxelT> octree;
+    setSphere(octree, block_scales);
+    std::vector<VoxelBlockType*> block_list;
+    octree.getBlockList(block_list, false);
+    se::IndexedMesh mesh;
+    se::IndexedMesh reference_mesh;
+    se::meshing::IndexedMeshBuilder mesh_builder (mesh);
+    se::meshing::IndexedMeshBuilder reference_mesh_builder (reference_mesh);
+    for (const auto* block : block_list) {
+      se::meshing::dual_marching_cube_block(octree, block, TestVoxelT::selectValue, TestVoxelT::isInside,
+          [&](const Eigen::Vector3f vertexes[3], const se::meshing::EdgeKey vertex_keys[3]) {
+            mesh_builder.addTriangle(vertexes, vertex_keys);
+          }, 0);
+      se::meshing::reference::dual_marching_cube_block(octree, block, TestVoxelT::selectValue, TestVoxelT::isInside,
+          [&](const Eigen::Vector3f vertexes[3], const se::meshing::EdgeKey vertex_keys[3]) {
+            reference_mesh_builder.addTriangle(vertexes, vertex_keys);
+          });
+    }
+    // The meshes must be identical, not just close.
+    ASSERT_GT(reference_mesh.numTriangles(), 0u);
+    EXPECT_EQ(mesh.indices, reference_mesh.indices);
+    ASSERT_EQ(mesh.vertexes.size(), reference_mesh.vertexes.size());
+    for (size_t i = 0; i < mesh.vertexes.size(); ++i) {
+      EXPECT_EQ(mesh.vertexes[i], reference_mesh.vertexes[i]) << "vertex " << i;
+      EXPECT_TRUE(mesh.vertex_keys[i] == reference_mesh.vertex_keys[i]) << "vertex " << i;
+    }
+  }
+}
@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <vector>
+
+#include <se/functors/propagate_up.hpp>
+#include <se/octree.hpp>
+
+struct TestVoxelT {
+  typedef float VoxelData;
+  static inline VoxelData invalid(){ return 0.f; }
+  static inline VoxelData initData(){ return 0.f; }
+
+  using VoxelBlockType = se::VoxelBlockFull<TestVoxelT>;
+
+  using MemoryPoolType = se::PagedMemoryPool<TestVoxelT>;
+  template <typename BufferT>
+  using MemoryBufferType = se::PagedMemoryBuffer<BufferT>;
+};
+
+class PropagateUpTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      octree_.init(512, 5.f);
+      std::vector<se::key_t> allocation_list;
+      for (int z = 0; z < octree_.size(); z += 72) {
+        for (int y = 0; y < octree_.size(); y += 40) {
+          for (int x = 0; x < octree_.size(); x += 24) {
+            allocation_list.push_back(octree_.hash(x, y, z, octree_.blockDepth()));
+          }
+        }
+      }
+      octree_.allocate(allocation_list.data(), allocation_list.size());
+      octree_.getBlockList(block_list_, false);
+    }
+
+  typedef se::Octree<TestVoxelT> OctreeF;
+  OctreeF octree_;
+  std::vector<TestVoxelT::VoxelBlockType*> block_list_;
+};
+
+TEST_F(PropagateUpTest, VisitsEachAncestorOnce) {
+  std::atomic<int> unordered_visits(0);
+  se::functor::propagate_up(block_list_, [&](se::Node<TestVoxelT>* node) {
+    // All the child nodes must have been processed before their parent.
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      const se::Node<TestVoxelT>* child = node->child(child_idx);
+      if (child && !child->isBlock() && child->timestamp() != 1) {
+        unordered_visits++;
+      }
+    }
+    node->timestamp(node->timestamp() + 1);
+  });
+  EXPECT_EQ(unordered_visits, 0);
+
+  auto& node_buffer = octree_.pool().nodeBuffer();
+  for (unsigned int i = 0; i < node_buffer.size(); ++i) {
+    EXPECT_EQ(node_buffer[i]->timestamp(), 1u);
+  }
+}
+
+TEST_F(PropagateUpTest, AggregatesToRoot) {
+  for (auto* block : block_list_) {
+    const int child_idx = se::child_idx(block->code(), octree_.voxelDepth());
+    block->parent()->childData(child_idx, 1.f);
+  }
+  se::functor::propagate_up(block_list_, [&](se::Node<TestVoxelT>* node) {
+    if (!node->parent()) {
+      return;
+    }
+    float sum = 0.f;
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      sum += node->childData(child_idx);
+    }
+    const int child_idx = se::child_idx(node->code(), octree_.voxelDepth());
+    node->parent()->childData(child_idx, sum);
+  });
+
+  float root_sum = 0.f;
+  for (int child_idx = 0; child_idx < 8; ++child_idx) {
+    root_sum += octree_.root()->childData(child_idx);
+  }
+  EXPECT_EQ(root_sum, static_cast<float>(block_list_.size()));
+}
+
+TEST_F(PropagateUpTest, MixedDepths) {
+  // Blocks and nodes of every depth, so that some octants are ancestors of
+  // others.
+  std::vector<se::Node<TestVoxelT>*> octant_list (block_list_.begin(), block_list_.end());
+  auto& node_buffer = octree_.pool().nodeBuffer();
+  for (unsigned int i = 0; i < node_buffer.size(); i += 3) {
+    octant_list.push_back(node_buffer[i]);
+  }
+  std::atomic<int> unordered_visits(0);
+  se::functor::propagate_up(octant_list, [&](se::Node<TestVoxelT>* node) {
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      const se::Node<TestVoxelT>* child = node->child(child_idx);
+      if (child && !child->isBlock() && child->timestamp() != 1) {
+        unordered_visits++;
+      }
+    }
+    node->timestamp(node->timestamp() + 1);
+  });
+  EXPECT_EQ(unordered_visits, 0);
+
+  for (unsigned int i = 0; i < node_buffer.size(); ++i) {
+    EXPECT_EQ(node_buffer[i]->timestamp(), 1u);
+  }
+}
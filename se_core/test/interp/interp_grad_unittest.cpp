@@ -0,0 +1,120 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <cmath>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include <se/functors/axis_aligned_functor.hpp>
+#include <se/octree.hpp>
+
+
+
+// Create a voxel trait storing a value and a weight.
+struct TestVoxelT {
+  struct VoxelData {
+    float x;
+    int   y;
+  };
+  static inline VoxelData invalid(){ return {1.f, 0}; }
+  static inline VoxelData initData(){ return {1.f, 0}; }
+
+  using VoxelBlockType = se::VoxelBlockFull<TestVoxelT>;
+
+  using MemoryPoolType = se::PagedMemoryPool<TestVoxelT>;
+  template <typename BufferT>
+  using MemoryBufferType = se::PagedMemoryBuffer<BufferT>;
+
+  static float selectNodeValue(const VoxelData& data) { return data.x; }
+  static float selectVoxelValue(const VoxelData& data) { return data.x; }
+};
+
+
+
+class InterpGradTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      octree_.init(64, 6.4f);
+      // Allocate 2x2x2 VoxelBlocks in the middle of the map.
+      std::vector<se::key_t> allocation_list;
+      for (int z = 16; z < 32; z += 8) {
+        for (int y = 16; y < 32; y += 8) {
+          for (int x = 16; x < 32; x += 8) {
+            allocation_list.push_back(octree_.hash(x, y, z));
+          }
+        }
+      }
+      octree_.allocate(allocation_list.data(), allocation_list.size());
+
+      auto smooth_field = [](auto& handler, const Eigen::Vector3i& voxel_coord) {
+        const Eigen::Vector3f p = voxel_coord.cast<float>();
+        handler.set({std::sin(0.3f * p.x()) + 0.01f * p.y() * p.y() - 0.2f * p.z(), 1});
+      };
+      se::functor::axis_aligned_map(octree_, smooth_field);
+      // Mark a slab of voxels as not integrated into.
+      auto unobserved = [](auto& handler, const Eigen::Vector3i&) {
+        auto data = handler.get();
+        data.y = 0;
+        handler.set(data);
+      };
+      se::functor::axis_aligned_map(octree_, unobserved,
+          Eigen::Vector3i(16, 16, 16), Eigen::Vector3i(20, 32, 32));
+    }
+
+    se::Octree<TestVoxelT> octree_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(InterpGradTest, MatchesInterpAndGrad) {
+  std::mt19937 gen(1);
+  // Sample both inside the VoxelBlocks and around them where the neighbours
+  // are in unallocated Nodes.
+  std::uniform_real_distribution<float> coord_dist(12.f, 36.f);
+  for (int i = 0; i < 1000; ++i) {
+    const Eigen::Vector3f voxel_coord_f(coord_dist(gen), coord_dist(gen), coord_dist(gen));
+    const auto interp_res = octree_.interp(voxel_coord_f,
+        TestVoxelT::selectNodeValue, TestVoxelT::selectVoxelValue);
+    const Eigen::Vector3f grad = octree_.grad(voxel_coord_f,
+        TestVoxelT::selectNodeValue, TestVoxelT::selectVoxelValue, interp_res.second);
+
+    Eigen::Vector3f fused_grad;
+    const auto fused_res = octree_.interpGrad(voxel_coord_f,
+        TestVoxelT::selectNodeValue, TestVoxelT::selectVoxelValue, fused_grad);
+    EXPECT_EQ(fused_res.first, interp_res.first);
+    EXPECT_EQ(fused_res.second, interp_res.second);
+    EXPECT_NEAR((fused_grad - grad).norm(), 0.f, 1e-5f);
+  }
+}
+
+
+
+TEST_F(InterpGradTest, IsValid) {
+  std::mt19937 gen(2);
+  std::uniform_real_distribution<float> coord_dist(16.f, 31.f);
+  int num_valid = 0;
+  for (int i = 0; i < 1000; ++i) {
+    const Eigen::Vector3f point_M = octree_.voxelDim()
+        * Eigen::Vector3f(coord_dist(gen), coord_dist(gen), coord_dist(gen));
+    bool is_valid = false;
+    const auto interp_res = octree_.interpAtPoint(point_M,
+        TestVoxelT::selectNodeValue, TestVoxelT::selectVoxelValue, 0, is_valid);
+
+    Eigen::Vector3f fused_grad;
+    bool fused_is_valid = !is_valid;
+    const auto fused_res = octree_.interpGradAtPoint(point_M,
+        TestVoxelT::selectNodeValue, TestVoxelT::selectVoxelValue, fused_grad, 0, fused_is_valid);
+    ASSERT_EQ(fused_is_valid, is_valid);
+    EXPECT_EQ(fused_res.first, interp_res.first);
+    EXPECT_EQ(fused_res.second, interp_res.second);
+    num_valid += is_valid;
+  }
+  // Both valid and invalid points were tested.
+  EXPECT_GT(num_valid, 0);
+  EXPECT_LT(num_valid, 1000);
+}
+
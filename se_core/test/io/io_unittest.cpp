@@ -29,9 +29,13 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+#include <cstddef>
+#include <cstring>
 #include <fstream>
+#include <iterator>
 #include <random>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -223,11 +227,15 @@ TEST(SerialiseUnitTestFull, SerialiseBlock) {
   se::Octree<TestVoxelFullT> octree_copy;
   octree_copy.load(filename);
 
+  // The loaded VoxelBlocks are in Morton order.
   auto &block_buffer_base = octree.pool().blockBuffer();
-  auto &block_buffer_copy = octree_copy.pool().blockBuffer();
+  ASSERT_EQ(block_buffer_base.size(), octree_copy.pool().blockBuffer().size());
   for (size_t i = 0; i < block_buffer_base.size(); i++) {
+    const Eigen::Vector3i block_coord = block_buffer_base[i]->coordinates();
+    auto block_copy = octree_copy.fetch(block_coord.x(), block_coord.y(), block_coord.z());
+    ASSERT_NE(block_copy, nullptr);
     for (unsigned voxel_idx = 0; voxel_idx < TestVoxelFullT::VoxelBlockType::size_cu; voxel_idx++) {
-      ASSERT_EQ(block_buffer_base[i]->data(voxel_idx), block_buffer_copy[i]->data(voxel_idx));
+      ASSERT_EQ(block_buffer_base[i]->data(voxel_idx), block_copy->data(voxel_idx));
     }
   }
 }
@@ -395,10 +403,148 @@ TEST(SerialiseUnitTestSingle, SerialiseBlock) {
   se::Octree<TestVoxelSingleT> octree_copy;
   octree_copy.load(filename);
 
+  // The loaded VoxelBlocks are in Morton order.
   auto &block_buffer_base = octree.pool().blockBuffer();
-  auto &block_buffer_copy = octree_copy.pool().blockBuffer();
+  ASSERT_EQ(block_buffer_base.size(), octree_copy.pool().blockBuffer().size());
   for (size_t i = 0; i < block_buffer_base.size(); i++) {
+    const Eigen::Vector3i block_coord = block_buffer_base[i]->coordinates();
+    auto block_copy = octree_copy.fetch(block_coord.x(), block_coord.y(), block_coord.z());
+    ASSERT_NE(block_copy, nullptr);
     for (unsigned voxel_idx = 0; voxel_idx < TestVoxelSingleT::VoxelBlockType::size_cu; voxel_idx++) {
+      ASSERT_EQ(block_buffer_base[i]->data(voxel_idx), block_copy->data(voxel_idx));
+    }
+  }
+}
+
+TEST(SerialiseUnitTestFull, MapFileLayout) {
+  se::Octree<TestVoxelFullT> octree;
+  octree.init(1024, 10.f);
+  std::mt19937 gen(1); //Standard mersenne_twister_engine seeded with constant
+  std::uniform_int_distribution<> dis(0, octree.size() - 1);
+  for (int j = 0; j < 20; ++j) {
+    octree.insert(dis(gen), dis(gen), dis(gen), octree.blockDepth());
+  }
+  octree.root()->childData(3, 7.f);
+  std::string filename = "map-file-test.bin";
+  octree.save(filename);
+
+  std::ifstream is (filename, std::ios::binary);
+  const std::string file ((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+  se::internal::MapFileHeader header;
+  ASSERT_GE(file.size(), sizeof(header));
+  std::memcpy(&header, file.data(), sizeof(header));
+  EXPECT_EQ(std::string(header.magic, 8), "SEOCTREE");
+  EXPECT_EQ(header.version, se::internal::map_file_version);
+  EXPECT_EQ(header.file_size, file.size());
+  EXPECT_EQ(header.num_nodes, octree.pool().nodeBuffer().size());
+  ASSERT_EQ(header.num_blocks, octree.pool().blockBuffer().size());
+  EXPECT_EQ(header.block_index_offset % se::internal::map_file_alignment, 0u);
+
+  // The block index is sorted by Morton code and the blocks are aligned.
+  std::vector<se::internal::MapFileBlockEntry> block_index (header.num_blocks);
+  std::memcpy(block_index.data(), file.data() + header.block_index_offset,
+      header.num_blocks * sizeof(se::internal::MapFileBlockEntry));
+  for (size_t i = 0; i < block_index.size(); ++i) {
+    EXPECT_EQ(block_index[i].offset % se::internal::map_file_alignment, 0u);
+    if (i > 0) {
+      EXPECT_LT(block_index[i - 1].code, block_index[i].code);
+      EXPECT_LT(block_index[i - 1].offset, block_index[i].offset);
+    }
+  }
+
+  se::Octree<TestVoxelFullT> octree_copy;
+  octree_copy.load(filename);
+  EXPECT_EQ(octree_copy.root()->childData(3), 7.f);
+  EXPECT_EQ(octree_copy.blockCount(), octree.blockCount());
+  EXPECT_EQ(octree_copy.nodeCount(), octree.nodeCount());
+}
+
+TEST(SerialiseUnitTestFull, LoadMalformed) {
+  se::Octree<TestVoxelFullT> octree;
+  octree.init(1024, 10.f);
+  std::mt19937 gen(1); //Standard mersenne_twister_engine seeded with constant
+  std::uniform_int_distribution<> dis(0, octree.size() - 1);
+  for (int j = 0; j < 20; ++j) {
+    octree.insert(dis(gen), dis(gen), dis(gen), octree.blockDepth());
+  }
+  std::string filename = "map-file-malformed-test.bin";
+  octree.save(filename);
+  std::ifstream is (filename, std::ios::binary);
+  const std::string file ((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+  is.close();
+  se::internal::MapFileHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+
+  // Write a copy of the file with one field changed and try to load it.
+  auto load_modified = [&](const size_t field_offset, const uint64_t value) {
+    std::string modified_file = file;
+    std::memcpy(&modified_file[field_offset], &value, sizeof(value));
+    std::ofstream os (filename, std::ios::binary);
+    os.write(modified_file.data(), modified_file.size());
+    os.close();
+    se::Octree<TestVoxelFullT> octree_copy;
+    octree_copy.load(filename);
+    return octree_copy.blockCount();
+  };
+  const size_t entry_offset = header.block_index_offset + 5 * sizeof(se::internal::MapFileBlockEntry);
+  EXPECT_EQ(load_modified(offsetof(se::internal::MapFileHeader, num_nodes), 1000 * header.num_nodes), 0);
+  EXPECT_EQ(load_modified(offsetof(se::internal::MapFileHeader, num_blocks), 1000 * header.num_blocks), 0);
+  EXPECT_EQ(load_modified(offsetof(se::internal::MapFileHeader, nodes_offset), file.size() + 1), 0);
+  EXPECT_EQ(load_modified(offsetof(se::internal::MapFileHeader, block_index_offset), file.size() - 8), 0);
+  // A block outside the file.
+  EXPECT_EQ(load_modified(entry_offset + offsetof(se::internal::MapFileBlockEntry, offset),
+      file.size() - se::internal::map_file_alignment), 0);
+  // A block whose parent isn't in the file.
+  Eigen::Vector3i block_coord (0, 0, 0);
+  while (octree.fetchNode(block_coord.x(), block_coord.y(), block_coord.z(), octree.blockDepth() - 1)) {
+    block_coord.x() += 2 * TestVoxelFullT::VoxelBlockType::size_li;
+  }
+  EXPECT_EQ(load_modified(entry_offset, octree.hash(block_coord.x(), block_coord.y(), block_coord.z())), 0);
+  // The unmodified file loads.
+  EXPECT_EQ(load_modified(offsetof(se::internal::MapFileHeader, num_blocks), header.num_blocks),
+      octree.blockCount());
+}
+
+TEST(SerialiseUnitTestFull, LoadUnversioned) {
+  se::Octree<TestVoxelFullT> octree;
+  octree.init(1024, 10.f);
+  std::mt19937 gen(1); //Standard mersenne_twister_engine seeded with constant
+  std::uniform_int_distribution<> dis(0, octree.size() - 1);
+  for (int j = 0; j < 20; ++j) {
+    Eigen::Vector3i voxel_coord(dis(gen), dis(gen), dis(gen));
+    octree.insert(voxel_coord.x(), voxel_coord.y(), voxel_coord.z(), octree.blockDepth());
+    auto block = octree.fetch(voxel_coord.x(), voxel_coord.y(), voxel_coord.z());
+    for (unsigned voxel_idx = 0; voxel_idx < TestVoxelFullT::VoxelBlockType::size_cu; ++voxel_idx)
+      block->setData(voxel_idx, dis(gen));
+  }
+
+  // The file layout written before the map file format was versioned.
+  std::string filename = "unversioned-test.bin";
+  {
+    std::ofstream os (filename, std::ios::binary);
+    int size = octree.size();
+    float dim = octree.dim();
+    os.write(reinterpret_cast<char *>(&size), sizeof(size));
+    os.write(reinterpret_cast<char *>(&dim), sizeof(dim));
+    auto& node_buffer = octree.pool().nodeBuffer();
+    size_t num_nodes = node_buffer.size();
+    os.write(reinterpret_cast<char *>(&num_nodes), sizeof(size_t));
+    for (size_t i = 0; i < num_nodes; ++i)
+      se::internal::serialise(os, *node_buffer[i]);
+    auto& block_buffer = octree.pool().blockBuffer();
+    size_t num_blocks = block_buffer.size();
+    os.write(reinterpret_cast<char *>(&num_blocks), sizeof(size_t));
+    for (size_t i = 0; i < num_blocks; ++i)
+      se::internal::serialise(os, *block_buffer[i]);
+  }
+
+  se::Octree<TestVoxelFullT> octree_copy;
+  octree_copy.load(filename);
+  auto &block_buffer_base = octree.pool().blockBuffer();
+  auto &block_buffer_copy = octree_copy.pool().blockBuffer();
+  ASSERT_EQ(block_buffer_base.size(), block_buffer_copy.size());
+  for (size_t i = 0; i < block_buffer_base.size(); i++) {
+    for (unsigned voxel_idx = 0; voxel_idx < TestVoxelFullT::VoxelBlockType::size_cu; voxel_idx++) {
       ASSERT_EQ(block_buffer_base[i]->data(voxel_idx), block_buffer_copy[i]->data(voxel_idx));
     }
   }
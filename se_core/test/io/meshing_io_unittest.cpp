@@ -0,0 +1,237 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <se/algorithms/meshing.hpp>
+#include <se/io/meshing_io.hpp>
+
+template <typename T>
+T load_le(const char* src) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(src);
+  const uint32_t bits = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+  T value;
+  std::memcpy(&value, &bits, 4);
+  return value;
+}
+
+template <typename T>
+T load_be(const char* src) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(src);
+  const uint32_t bits = (static_cast<uint32_t>(bytes[0]) << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+  T value;
+  std::memcpy(&value, &bits, 4);
+  return value;
+}
+
+std::string readFile(const std::string& filename) {
+  std::ifstream file (filename, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+
+
+// A tetrahedron with outward facing triangles. The normals of its vertices
+// other than the origin are the axes.
+class MeshingIOTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      const Eigen::Vector3f points[4] = {Eigen::Vector3f(0.f, 0.f, 0.f), Eigen::Vector3f(1.f, 0.f, 0.f),
+                                         Eigen::Vector3f(0.f, 1.f, 0.f), Eigen::Vector3f(0.f, 0.f, 1.f)};
+      const int faces[4][3] = {{0, 2, 1}, {0, 1, 3}, {0, 3, 2}, {1, 2, 3}};
+      se::meshing::IndexedMeshBuilder mesh_builder (mesh_);
+      for (const auto& face : faces) {
+        Eigen::Vector3f vertexes[3];
+        se::meshing::EdgeKey vertex_keys[3];
+        for (int v = 0; v < 3; ++v) {
+          vertexes[v] = points[face[v]];
+          const Eigen::Vector3i coord = (2.f * points[face[v]]).cast<int>();
+          vertex_keys[v] = se::meshing::edge_key(coord, coord);
+        }
+        mesh_builder.addTriangle(vertexes, vertex_keys);
+      }
+
+      // Rotate by 90 degrees around z and translate.
+      T_WM_ << 0.f, -1.f, 0.f, 1.f,
+               1.f,  0.f, 0.f, 2.f,
+               0.f,  0.f, 1.f, 3.f,
+               0.f,  0.f, 0.f, 1.f;
+      for (size_t i = 0; i < mesh_.vertexes.size(); ++i) {
+        point_data_[i] = 10.f + i;
+      }
+      for (size_t i = 0; i < mesh_.numTriangles(); ++i) {
+        cell_data_[i] = 20.f + i;
+      }
+    }
+
+    se::IndexedMesh mesh_;
+    Eigen::Matrix4f T_WM_;
+    float point_data_[4];
+    float cell_data_[4];
+};
+
+
+
+TEST_F(MeshingIOTest, Normals) {
+  ASSERT_EQ(mesh_.vertexes.size(), 4u);
+  ASSERT_EQ(mesh_.normals.size(), 4u);
+  for (size_t i = 1; i < mesh_.vertexes.size(); ++i) {
+    EXPECT_TRUE(mesh_.normals[i].normalized().isApprox(mesh_.vertexes[i]));
+  }
+
+  // Appending meshes sums the normals of the shared vertices.
+  se::IndexedMesh first_half;
+  se::IndexedMesh second_half;
+  se::meshing::IndexedMeshBuilder first_builder (first_half);
+  se::meshing::IndexedMeshBuilder second_builder (second_half);
+  for (size_t i = 0; i < mesh_.indices.size(); i += 3) {
+    Eigen::Vector3f vertexes[3];
+    se::meshing::EdgeKey vertex_keys[3];
+    for (int v = 0; v < 3; ++v) {
+      vertexes[v] = mesh_.vertexes[mesh_.indices[i + v]];
+      vertex_keys[v] = mesh_.vertex_keys[mesh_.indices[i + v]];
+    }
+    (i < 6 ? first_builder : second_builder).addTriangle(vertexes, vertex_keys);
+  }
+  se::IndexedMesh merged_mesh;
+  se::meshing::IndexedMeshBuilder merged_builder (merged_mesh);
+  merged_builder.append(first_half);
+  merged_builder.append(second_half);
+  EXPECT_EQ(merged_mesh.vertexes, mesh_.vertexes);
+  EXPECT_EQ(merged_mesh.normals, mesh_.normals);
+}
+
+
+
+TEST_F(MeshingIOTest, BinaryPLY) {
+  const std::string filename = "meshing_io_unittest.ply";
+  ASSERT_EQ(se::save_mesh_ply_binary(mesh_, filename, T_WM_, point_data_, cell_data_), 0);
+  const std::string file = readFile(filename);
+  const std::string end_header = "end_header\n";
+  const size_t header_size = file.find(end_header) + end_header.size();
+  ASSERT_NE(file.find(end_header), std::string::npos);
+  const std::string header = file.substr(0, header_size);
+  EXPECT_NE(header.find("format binary_little_endian 1.0\n"), std::string::npos);
+  EXPECT_NE(header.find("element vertex 4\n"), std::string::npos);
+  EXPECT_NE(header.find("property float nz\n"), std::string::npos);
+  EXPECT_NE(header.find("element face 4\n"), std::string::npos);
+  // x y z nx ny nz vertex_value, 3 vertex_index face_value
+  const size_t vertex_size = 7 * 4;
+  const size_t face_size = 1 + 4 * 4;
+  ASSERT_EQ(file.size(), header_size + 4 * vertex_size + 4 * face_size);
+
+  const Eigen::Matrix3f R_WM = T_WM_.topLeftCorner<3, 3>();
+  for (size_t i = 0; i < mesh_.vertexes.size(); ++i) {
+    const char* vertex = file.data() + header_size + i * vertex_size;
+    const Eigen::Vector3f vertex_W = (T_WM_ * mesh_.vertexes[i].homogeneous()).head(3);
+    const Eigen::Vector3f normal_W = R_WM * mesh_.normals[i].normalized();
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_FLOAT_EQ(load_le<float>(vertex + 4 * j), vertex_W[j]);
+      EXPECT_FLOAT_EQ(load_le<float>(vertex + 12 + 4 * j), normal_W[j]);
+    }
+    EXPECT_FLOAT_EQ(load_le<float>(vertex + 24), point_data_[i]);
+  }
+  for (size_t i = 0; i < mesh_.numTriangles(); ++i) {
+    const char* face = file.data() + header_size + 4 * vertex_size + i * face_size;
+    EXPECT_EQ(face[0], 3);
+    for (int v = 0; v < 3; ++v) {
+      EXPECT_EQ(load_le<int32_t>(face + 1 + 4 * v), static_cast<int32_t>(mesh_.indices[3 * i + v]));
+    }
+    EXPECT_FLOAT_EQ(load_le<float>(face + 13), cell_data_[i]);
+  }
+}
+
+
+
+TEST_F(MeshingIOTest, BinaryVTK) {
+  const std::string filename = "meshing_io_unittest.vtk";
+  ASSERT_EQ(se::save_mesh_vtk_binary(mesh_, filename, T_WM_, point_data_, cell_data_), 0);
+  const std::string file = readFile(filename);
+  EXPECT_NE(file.find("BINARY\n"), std::string::npos);
+
+  const std::string points_header = "POINTS 4 float\n";
+  const size_t points_offset = file.find(points_header) + points_header.size();
+  ASSERT_NE(file.find(points_header), std::string::npos);
+  for (size_t i = 0; i < mesh_.vertexes.size(); ++i) {
+    const Eigen::Vector3f vertex_W = (T_WM_ * mesh_.vertexes[i].homogeneous()).head(3);
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_FLOAT_EQ(load_be<float>(file.data() + points_offset + 12 * i + 4 * j), vertex_W[j]);
+    }
+  }
+
+  const std::string polygons_header = "\nPOLYGONS 4 16\n";
+  const size_t polygons_offset = points_offset + 12 * 4;
+  ASSERT_EQ(file.compare(polygons_offset, polygons_header.size(), polygons_header), 0);
+  for (size_t i = 0; i < mesh_.numTriangles(); ++i) {
+    const char* polygon = file.data() + polygons_offset + polygons_header.size() + 16 * i;
+    EXPECT_EQ(load_be<int32_t>(polygon), 3);
+    for (int v = 0; v < 3; ++v) {
+      EXPECT_EQ(load_be<int32_t>(polygon + 4 + 4 * v), static_cast<int32_t>(mesh_.indices[3 * i + v]));
+    }
+  }
+
+  const std::string scalars_header = "LOOKUP_TABLE default\n";
+  const size_t scalars_offset = file.find(scalars_header) + scalars_header.size();
+  ASSERT_NE(file.find("POINT_DATA 4\n"), std::string::npos);
+  for (size_t i = 0; i < mesh_.vertexes.size(); ++i) {
+    EXPECT_FLOAT_EQ(load_be<float>(file.data() + scalars_offset + 4 * i), point_data_[i]);
+  }
+
+  const std::string normals_header = "\nNORMALS normals float\n";
+  const size_t normals_offset = scalars_offset + 4 * 4;
+  ASSERT_EQ(file.compare(normals_offset, normals_header.size(), normals_header), 0);
+  const Eigen::Matrix3f R_WM = T_WM_.topLeftCorner<3, 3>();
+  for (size_t i = 0; i < mesh_.vertexes.size(); ++i) {
+    const Eigen::Vector3f normal_W = R_WM * mesh_.normals[i].normalized();
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_FLOAT_EQ(load_be<float>(file.data() + normals_offset + normals_header.size() + 12 * i + 4 * j),
+          normal_W[j]);
+    }
+  }
+
+  const std::string cell_data_header = "\nCELL_DATA 4\nSCALARS cell_scalars float 1\nLOOKUP_TABLE default\n";
+  const size_t cell_data_offset = normals_offset + normals_header.size() + 12 * 4;
+  ASSERT_EQ(file.compare(cell_data_offset, cell_data_header.size(), cell_data_header), 0);
+  for (size_t i = 0; i < mesh_.numTriangles(); ++i) {
+    EXPECT_FLOAT_EQ(load_be<float>(file.data() + cell_data_offset + cell_data_header.size() + 4 * i),
+        cell_data_[i]);
+  }
+  EXPECT_EQ(file.size(), cell_data_offset + cell_data_header.size() + 4 * 4 + 1);
+  EXPECT_EQ(file.back(), '\n');
+}
+
+
+
+TEST_F(MeshingIOTest, WithoutNormals) {
+  mesh_.normals.clear();
+  const std::string filename = "meshing_io_unittest_without_normals.ply";
+  ASSERT_EQ(se::save_mesh_ply_binary(mesh_, filename, T_WM_), 0);
+  const std::string file = readFile(filename);
+  EXPECT_EQ(file.find("property float nx\n"), std::string::npos);
+  const std::string end_header = "end_header\n";
+  EXPECT_EQ(file.size(), file.find(end_header) + end_header.size() + 4 * 12 + 4 * 13);
+}
+
+
+
+TEST_F(MeshingIOTest, FileSize) {
+  const std::string filename_ply = "meshing_io_unittest_file_size.ply";
+  const std::string filename_vtk = "meshing_io_unittest_file_size.vtk";
+  size_t file_size = 0;
+  ASSERT_EQ(se::save_mesh_ply_binary(mesh_, filename_ply, T_WM_, point_data_, cell_data_, &file_size), 0);
+  EXPECT_EQ(file_size, readFile(filename_ply).size());
+  ASSERT_EQ(se::save_mesh_vtk_binary(mesh_, filename_vtk, T_WM_, point_data_, cell_data_, &file_size), 0);
+  EXPECT_EQ(file_size, readFile(filename_vtk).size());
+  ASSERT_EQ(se::save_mesh_ply(mesh_, filename_ply, T_WM_, point_data_, cell_data_, &file_size), 0);
+  EXPECT_EQ(file_size, readFile(filename_ply).size());
+  ASSERT_EQ(se::save_mesh_vtk(mesh_, filename_vtk, T_WM_, point_data_, cell_data_, &file_size), 0);
+  EXPECT_EQ(file_size, readFile(filename_vtk).size());
+  // Writing to a missing directory fails.
+  EXPECT_NE(se::save_mesh_ply_binary(mesh_, "missing_directory/mesh.ply", T_WM_), 0);
+}
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <gtest/gtest.h>
+
+#include <se/node.hpp>
+
+
+
+// Each voxel stores the sum of its children, computed lazily.
+struct SumVoxelT {
+  typedef int VoxelData;
+
+  static inline VoxelData invalid(){ return 0; }
+  static inline VoxelData initData(){ return 0; }
+
+  using VoxelBlockType = se::VoxelBlockFull<SumVoxelT>;
+
+  static int num_propagations;
+
+  static void propagateBlockScale(VoxelBlockType* block, const int scale) {
+    const int size = VoxelBlockType::size_li;
+    const int stride = VoxelBlockType::scaleVoxelSize(scale);
+    const int child_stride = stride / 2;
+    for (int z = 0; z < size; z += stride) {
+      for (int y = 0; y < size; y += stride) {
+        for (int x = 0; x < size; x += stride) {
+          const Eigen::Vector3i voxel_coord = block->coordinates() + Eigen::Vector3i(x, y, z);
+          int sum = 0;
+          for (int k = 0; k < stride; k += child_stride) {
+            for (int j = 0; j < stride; j += child_stride) {
+              for (int i = 0; i < stride; i += child_stride) {
+                sum += block->data(voxel_coord + Eigen::Vector3i(i, j, k), scale - 1);
+              }
+            }
+          }
+          block->setData(voxel_coord, scale, sum);
+        }
+      }
+    }
+    num_propagations++;
+  }
+};
+
+int SumVoxelT::num_propagations = 0;
+
+
+
+class VoxelBlockDirtyTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      SumVoxelT::num_propagations = 0;
+      block_.size(SumVoxelT::VoxelBlockType::size_li);
+      block_.coordinates(Eigen::Vector3i(8, 16, 24));
+      for (int voxel_idx = 0; voxel_idx < SumVoxelT::VoxelBlockType::scaleNumVoxels(0); ++voxel_idx) {
+        block_.setData(voxel_idx, 1);
+      }
+      block_.dirtyAbove(0);
+    }
+
+  SumVoxelT::VoxelBlockType block_;
+};
+
+
+
+TEST_F(VoxelBlockDirtyTest, DirtyAbove) {
+  EXPECT_FALSE(block_.dirty(0));
+  for (int scale = 1; scale <= static_cast<int>(SumVoxelT::VoxelBlockType::max_scale); ++scale) {
+    EXPECT_TRUE(block_.dirty(scale));
+  }
+  EXPECT_EQ(SumVoxelT::num_propagations, 0);
+}
+
+
+
+TEST_F(VoxelBlockDirtyTest, PropagateOnRead) {
+  // Reading scale 2 only recomputes scales 1 and 2.
+  EXPECT_EQ(block_.data(block_.coordinates(), 2), 64);
+  EXPECT_EQ(SumVoxelT::num_propagations, 2);
+  EXPECT_FALSE(block_.dirty(1));
+  EXPECT_FALSE(block_.dirty(2));
+  EXPECT_TRUE(block_.dirty(3));
+
+  // Clean scales are not recomputed.
+  EXPECT_EQ(block_.data(0, 1), 8);
+  EXPECT_EQ(SumVoxelT::num_propagations, 2);
+
+  EXPECT_EQ(block_.data(0, 3), 512);
+  EXPECT_EQ(SumVoxelT::num_propagations, 3);
+  EXPECT_FALSE(block_.dirty(3));
+}
+
+
+
+TEST_F(VoxelBlockDirtyTest, FinerScalesStayClean) {
+  block_.data(0, 3);
+  block_.dirtyAbove(2);
+  EXPECT_FALSE(block_.dirty(1));
+  EXPECT_FALSE(block_.dirty(2));
+  EXPECT_TRUE(block_.dirty(3));
+}
@@ -0,0 +1,124 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <functional>
+
+#include <gtest/gtest.h>
+
+#include <se/octree.hpp>
+#include <se/empty_space_skipping.hpp>
+
+
+
+// Create a voxel trait storing a single float value.
+struct TestVoxelT {
+  typedef float VoxelData;
+  static inline VoxelData invalid(){ return -1.f; }
+  static inline VoxelData initData(){ return 0.f; }
+
+  using VoxelBlockType = se::VoxelBlockFull<TestVoxelT>;
+
+  using MemoryPoolType = se::PagedMemoryPool<TestVoxelT>;
+  template <typename BufferT>
+  using MemoryBufferType = se::PagedMemoryBuffer<BufferT>;
+};
+
+
+
+class EmptySpaceSkippingTest : public ::testing::Test {
+  protected:
+    virtual void SetUp() {
+      octree_.init(res_, dim_);
+      // Allocate the VoxelBlock at the origin, this creates the Nodes of size
+      // 32 and 16 containing it.
+      se::key_t key = octree_.hash(0, 0, 0);
+      octree_.allocate(&key, 1);
+    }
+
+    se::Octree<TestVoxelT> octree_;
+    const int res_ = 64;
+    const float dim_ = 6.4f;
+    const float voxel_dim_ = dim_ / res_;
+    const float margin_ = voxel_dim_;
+    const Eigen::Vector3f ray_dir_M_ = Eigen::Vector3f::UnitX();
+    std::function<bool(const float&)> is_empty_ = [](const float& data) { return data > 0.5f; };
+};
+
+
+
+TEST_F(EmptySpaceSkippingTest, NoSummaryNoSkip) {
+  const Eigen::Vector3f ray_origin_M(0.5f, 1.6f, 1.6f);
+  float t_next;
+  const float t = se::skip_empty_space(octree_, ray_origin_M, ray_dir_M_, 0.f, margin_,
+      is_empty_, t_next);
+  EXPECT_EQ(t, 0.f);
+  // The point is in an unallocated octant of size 16 at x in [0, 1.6).
+  EXPECT_NEAR(t_next, 1.1f, 1e-5f);
+}
+
+
+
+TEST_F(EmptySpaceSkippingTest, SkipEmptyNode) {
+  octree_.root()->childData(0, 1.f);
+  const Eigen::Vector3f ray_origin_M(0.5f, 1.6f, 1.6f);
+  float t_next;
+  const float t = se::skip_empty_space(octree_, ray_origin_M, ray_dir_M_, 0.f, margin_,
+      is_empty_, t_next);
+  // Stop margin before the face at x = 3.2.
+  EXPECT_NEAR(t, 2.6f, 1e-5f);
+  EXPECT_NEAR(t_next, 2.7f, 1e-5f);
+}
+
+
+
+TEST_F(EmptySpaceSkippingTest, KeepMarginFromFaces) {
+  octree_.root()->childData(0, 1.f);
+  // Within margin from the face at x = 0.
+  const Eigen::Vector3f ray_origin_M(0.05f, 1.6f, 1.6f);
+  float t_next;
+  float t = se::skip_empty_space(octree_, ray_origin_M, ray_dir_M_, 0.f, margin_,
+      is_empty_, t_next);
+  EXPECT_EQ(t, 0.f);
+  EXPECT_NEAR(t_next, 0.05f, 1e-5f);
+  // Within margin from the face at y = 0, which the ray doesn't cross.
+  const Eigen::Vector3f grazing_ray_origin_M(0.5f, 0.05f, 1.6f);
+  t = se::skip_empty_space(octree_, grazing_ray_origin_M, ray_dir_M_, 0.f, margin_,
+      is_empty_, t_next);
+  EXPECT_EQ(t, 0.f);
+  EXPECT_NEAR(t_next, 2.7f, 1e-5f);
+}
+
+
+
+TEST_F(EmptySpaceSkippingTest, SkipEmptyChild) {
+  // The Node of size 32 at the origin is not empty but its child of size 16
+  // at x in [1.6, 3.2) is.
+  se::Node<TestVoxelT>* node = octree_.root()->child(0);
+  ASSERT_NE(node, nullptr);
+  node->childData(1, 1.f);
+  const Eigen::Vector3f ray_origin_M(1.f, 0.8f, 0.8f);
+  float t_next;
+  float t = se::skip_empty_space(octree_, ray_origin_M, ray_dir_M_, 1.f, margin_,
+      is_empty_, t_next);
+  EXPECT_NEAR(t, 2.1f, 1e-5f);
+  EXPECT_NEAR(t_next, 2.2f, 1e-5f);
+  // Inside the VoxelBlock at the origin the ray can't skip anything until it
+  // leaves it.
+  t = se::skip_empty_space(octree_, Eigen::Vector3f(0.2f, 0.4f, 0.4f), ray_dir_M_, 0.f,
+      margin_, is_empty_, t_next);
+  EXPECT_EQ(t, 0.f);
+  EXPECT_NEAR(t_next, 0.6f, 1e-5f);
+}
+
+
+
+TEST_F(EmptySpaceSkippingTest, SmallOctantsNotSkipped) {
+  octree_.root()->childData(0, 1.f);
+  const Eigen::Vector3f ray_origin_M(0.5f, 1.6f, 1.6f);
+  float t_next;
+  // The octant is 3.2 m wide.
+  const float t = se::skip_empty_space(octree_, ray_origin_M, ray_dir_M_, 0.f, 1.6f,
+      is_empty_, t_next);
+  EXPECT_EQ(t, 0.f);
+}
+
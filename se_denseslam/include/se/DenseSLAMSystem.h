@@ -39,6 +39,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <mutex>
 
 #include <yaml-cpp/yaml.h>
 #include <Eigen/Dense>
@@ -48,14 +49,19 @@
 #include "se/timings.h"
 #include "se/config.h"
 #include "se/octree.hpp"
+#include "se/algorithms/mesh_cache.hpp"
 #include "se/image/image.hpp"
+#include "se/integration_frame.hpp"
 #include "se/sensor_implementation.hpp"
 #include "se/voxel_implementations.hpp"
+#include "async_renderer.hpp"
 #include "preprocessing.hpp"
 #include "tracking.hpp"
 
 
 
+struct RaycastView; // Defined in rendering.hpp
+
 class DenseSLAMSystem {
   using VoxelBlockType = typename VoxelImpl::VoxelType::VoxelBlockType;
 
@@ -88,6 +94,8 @@ class DenseSLAMSystem {
     Eigen::Matrix4f raycast_T_MC_; // Raycasting camera pose in map frame
     se::Image<Eigen::Vector3f> surface_point_cloud_M_;
     se::Image<Eigen::Vector3f> surface_normals_M_;
+    se::Image<int> surface_scale_image_; // The scale each surface point was found at
+    se::Image<float> predicted_raycast_t_image_; // Used when config_.raycast_temporal_coherence is set
 
     // Rendering
     Eigen::Matrix4f* render_T_MC_; // Rendering camera pose in map frame
@@ -96,7 +104,14 @@ class DenseSLAMSystem {
     // Map
     Eigen::Matrix4f T_MW_; // Constant world to map frame transformation
     std::vector<se::key_t> allocation_list_;
+    se::IntegrationBatch integration_batch_;
+    std::unique_ptr<SensorImpl> integration_batch_sensor_; // The sensor of the frames in integration_batch_
     std::shared_ptr<se::Octree<VoxelImpl::VoxelType> > map_;
+    std::mutex map_mutex_; // Locked while modifying the map
+    se::MeshCache<VoxelImpl::VoxelType> mesh_cache_; // The mesh of each VoxelBlock
+
+    // Used when config_.async_render is set
+    std::unique_ptr<se::AsyncRenderer> async_renderer_;
 
   public:
     /**
@@ -139,6 +154,11 @@ class DenseSLAMSystem {
                     const se::Configuration& config,
                     const std::string        voxel_impl_yaml_path = "");
 
+    /**
+     * Integrate any frames still queued for batched integration.
+     */
+    ~DenseSLAMSystem();
+
     /**
      * Preprocess a single depth frame and add it to the pipeline.
      * This is the first stage of the pipeline.
@@ -155,6 +175,26 @@ class DenseSLAMSystem {
                          const Eigen::Vector2i& input_depth_image_res,
                          const bool             filter_depth_image);
 
+    /**
+     * Same as the overload above for depth frames in the integer units of the
+     * sensor, e.g. millimetres. The unit conversion is done while
+     * downsampling so the frame doesn't need to be converted to float first.
+     *
+     * \param[in] input_depth Pointer to the depth frame data. Each pixel is
+     * represented by a single uint16_t, 0 for invalid measurements.
+     * \param[in] input_res Size of the depth frame in pixels (width and
+     * height).
+     * \param[in] depth_scale The factor converting the depth values to
+     * meters, e.g. 0.001 for millimetres.
+     * \param[in] filter_depth Whether to filter the depth frame using a
+     * bilateral filter to reduce the measurement noise.
+     * \return true (does not fail).
+     */
+    bool preprocessDepth(const uint16_t*        input_depth_image_data,
+                         const Eigen::Vector2i& input_depth_image_res,
+                         const float            depth_scale,
+                         const bool             filter_depth_image);
+
     /**
      * Preprocess an RGBA frame and add it to the pipeline.
      * This is the first stage of the pipeline.
@@ -180,14 +220,29 @@ class DenseSLAMSystem {
 	 * \param[in] k The intrinsic camera parameters. See
 	 * se::Configuration.camera for details.
      * \param[in] icp_threshold The ICP convergence threshold.
+     * \param[in] store_tracking_result Keep the per pixel tracking data used
+     * by DenseSLAMSystem::renderTrack. It can be skipped when the tracking
+     * result isn't rendered.
      * \return true if the camera pose was updated and false if it wasn't.
      */
     bool track(const SensorImpl& sensor,
-               const float       icp_threshold);
+               const float       icp_threshold,
+               const bool        store_tracking_result = true);
+
+    /**
+     * Whether DenseSLAMSystem::track aligns the input directly to the signed
+     * distance field of the map, see se::Configuration::sdf_tracking. When
+     * true, DenseSLAMSystem::raycast is only needed for rendering.
+     */
+    bool usesSDFTracking() const {
+      return config_.sdf_tracking && se::supportsSDFTracking<VoxelImpl>::value;
+    }
 
     /**
      * Integrate the 3D reconstruction resulting from the current frame to the
      * existing reconstruction. This is the third stage of the pipeline.
+     * If se::Configuration::integration_batch_size is greater than 1 the
+     * frame is only queued and the map is updated once the batch is full.
      *
      * \param[in] k The intrinsic camera parameters. See
      * se::Configuration.camera for details.
@@ -199,6 +254,17 @@ class DenseSLAMSystem {
     bool integrate(const SensorImpl& sensor,
                    const unsigned    frame);
 
+    /**
+     * Integrate the frames queued by DenseSLAMSystem::integrate when
+     * se::Configuration::integration_batch_size is greater than 1. Called
+     * before meshing or saving the map and on destruction. Should be called
+     * once there are no more frames, e.g. when the input ends, so that the
+     * map contains all of them.
+     *
+     * \return true if any queued frames were integrated, false otherwise.
+     */
+    bool flushIntegration();
+
     /**
      * Raycast the map from the current pose to create a point cloud (point cloud
      * map) and respective normal vectors (normal map). The point cloud and normal
@@ -208,6 +274,12 @@ class DenseSLAMSystem {
      * @note Raycast is not performed on the first 3 frames (those with an
      * index up to 2).
      *
+     * If se::Configuration::raycast_temporal_coherence is set the rays are
+     * started just before the surface hits predicted from the previous
+     * raycast and the number of seeded rays, the number of seeded rays that
+     * fell back to a full march and the mean prediction error are sampled to
+     * se::perfstats.
+     *
      * \param[in] k The intrinsic camera parameters. See
      * se::Configuration.camera for details.
      * \param[in] mu TSDF truncation bound. See se::Configuration.mu for more
@@ -216,14 +288,62 @@ class DenseSLAMSystem {
      */
     bool raycast(const SensorImpl& sensor);
 
+    /**
+     * Raycast the map from a batch of camera poses, e.g. to evaluate
+     * candidate views when planning, see raycastViewsKernel(). The state used
+     * for tracking is not modified. The map is locked while raycasting so
+     * this may be called from a thread other than the one processing frames.
+     * No durations are sampled into se::perfstats, which isn't thread-safe.
+     *
+     * \param[in]  T_WCs               The camera poses in world frame.
+     * \param[in]  sensor              The sensor to raycast with. Its image
+     *                                 resolution is divided by
+     *                                 downsampling_factor.
+     * \param[out] views               The depth and scale images and the
+     *                                 unknown sample count of each pose.
+     * \param[in]  downsampling_factor The factor to reduce the image
+     *                                 resolution by.
+     * \param[in]  unknown_sample_dist The distance between the samples along
+     *                                 each ray that unobserved space is counted
+     *                                 at in meters. No samples are taken if it
+     *                                 is not positive.
+     */
+    void raycastViews(const std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>>& T_WCs,
+                      const SensorImpl&                                                        sensor,
+                      std::vector<RaycastView>&                                                views,
+                      const int                                                                downsampling_factor = 1,
+                      const float                                                              unknown_sample_dist = 0.f);
+
     /** \brief Export a mesh of the current state of the map.
      *
      * \param[in] filename   The name of the file where the mesh will be saved.
      *                       A PLY mesh will be saved if it ends in `.ply`,
      *                       otherwise a VTK mesh will be saved.
      * \param[in] print_path Print the filename to stdout before saving.
+     * \param[in] min_scale  The finest scale to mesh at. Values above 0
+     *                       create a lighter level-of-detail mesh from the
+     *                       coarser scales of the multi-resolution voxel
+     *                       implementations without using the mesh cache.
+     * \param[in] binary     Save a binary mesh containing the vertex normals
+     *                       instead of an ASCII one.
+     * \return 0 on success, nonzero on error.
      */
-    void dumpMesh(const std::string filename, const bool print_path = false);
+    int dumpMesh(const std::string filename,
+                 const bool        print_path = false,
+                 const int         min_scale = 0,
+                 const bool        binary = true);
+
+    /** \brief Mesh the parts of the map updated since the last call.
+     *
+     * Only the VoxelBlocks integrated into since the previous call, and
+     * their neighbours, are meshed. Use se::MeshCache::mesh() to get the
+     * whole mesh or se::MeshCache::deltaMesh(),
+     * se::MeshCache::updatedBlocks() and se::MeshCache::removedBlocks()
+     * to get just the changes.
+     *
+     * \return The mesh of the map split by VoxelBlock.
+     */
+    const se::MeshCache<VoxelImpl::VoxelType>& updateMesh();
 
     /** \brief Export the octree structure and slices.
      *
@@ -308,6 +428,34 @@ class DenseSLAMSystem {
     void renderRGBA(uint32_t*              output_RGBA_image_data,
                     const Eigen::Vector2i& output_RGBA_image_res);
 
+    /**
+     * Render the RGB, depth and tracking images and optionally the 3D
+     * reconstruction in a background thread from a copy of the current
+     * pipeline state, see se::AsyncRenderer. Requires
+     * se::Configuration::async_render. The request is dropped if the previous
+     * render hasn't completed yet.
+     *
+     * \param[in] sensor        The sensor the current frame was captured with.
+     * \param[in] render_volume Whether to also render the 3D reconstruction.
+     * \return True if the render was started, false if it was dropped.
+     */
+    bool requestRender(const SensorImpl& sensor,
+                       const bool        render_volume);
+
+    /**
+     * Copy the images of the latest render completed in the background. The
+     * arrays must be allocated before calling this function, one uint32_t per
+     * pixel of DenseSLAMSystem::getImageResolution(). The volume render is
+     * the latest one requested.
+     *
+     * \return The number of renders completed so far. No images are copied
+     * if it is 0.
+     */
+    size_t renderedImages(uint32_t* rgba_render,
+                          uint32_t* depth_render,
+                          uint32_t* track_render,
+                          uint32_t* volume_render);
+
     //
     // Getters
     //
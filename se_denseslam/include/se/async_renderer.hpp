@@ -0,0 +1,163 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef __ASYNC_RENDERER_HPP
+#define __ASYNC_RENDERER_HPP
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "se/image/image.hpp"
+#include "se/octree.hpp"
+#include "se/sensor_implementation.hpp"
+#include "se/voxel_implementations.hpp"
+#include "tracking.hpp"
+
+
+
+namespace se {
+
+  /*! \brief Render the pipeline outputs in a background thread.
+   *
+   * The inputs of a render are copied by the pipeline into
+   * AsyncRenderer::inputs() and rendered in the background into the back of
+   * two output buffers, which is swapped with the front buffer once the render
+   * is complete. Requests made while a render is in progress are dropped
+   * instead of queued so that the thread requesting renders never waits for
+   * them.
+   *
+   * The map is only read when the volume is rendered from a viewpoint other
+   * than the one of the tracking raycast. The map is then locked using the
+   * mutex supplied on construction, which must also be locked by the pipeline
+   * while modifying the map. The renderer never waits for the mutex. If the
+   * map is being modified the volume render is skipped and the previous one
+   * is kept.
+   */
+  class AsyncRenderer {
+    public:
+      typedef se::Octree<VoxelImpl::VoxelType> OctreeType;
+
+      /*! \brief The snapshot of the pipeline state a render is made from.
+       */
+      struct Inputs {
+        se::Image<uint32_t> rgba_image;
+        se::Image<float> depth_image;
+        std::vector<TrackData> tracking_result;
+        se::Image<Eigen::Vector3f> surface_point_cloud_M;
+        se::Image<Eigen::Vector3f> surface_normals_M;
+        se::Image<int> surface_scale_image;
+        Eigen::Matrix4f raycast_T_MC;
+        Eigen::Matrix4f render_T_MC;
+        bool render_volume;
+
+        Inputs(const Eigen::Vector2i& image_res);
+
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+      };
+
+      AsyncRenderer(const Eigen::Vector2i&      image_res,
+                    std::shared_ptr<OctreeType> map,
+                    std::mutex&                 map_mutex);
+
+      /*! \brief Wait for the render in progress, if any, and stop the
+       * background thread.
+       */
+      ~AsyncRenderer();
+
+      AsyncRenderer(const AsyncRenderer&) = delete;
+      AsyncRenderer& operator=(const AsyncRenderer&) = delete;
+
+      /*! \return Whether a render is in progress. The inputs may only be
+       * modified while it's not.
+       */
+      bool busy() const {
+        return busy_;
+      }
+
+      Inputs& inputs() {
+        return inputs_;
+      }
+
+      /*! \brief Start rendering the current inputs in the background.
+       *
+       * \param[in] sensor The sensor the inputs were captured with.
+       * \return False if a render is already in progress, in which case the
+       * request is dropped.
+       */
+      bool request(const SensorImpl& sensor);
+
+      /*! \brief Block until the render in progress, if any, is complete.
+       */
+      void wait();
+
+      /*! \brief Copy the images of the latest complete render. The arrays must
+       * be allocated by the caller, one uint32_t per pixel of the image
+       * resolution the renderer was constructed with. Any of them may be
+       * nullptr to skip copying it.
+       *
+       * \return The number of renders completed so far. No images are copied
+       * if it's 0.
+       */
+      size_t copyOutputs(uint32_t* rgba_render,
+                         uint32_t* depth_render,
+                         uint32_t* track_render,
+                         uint32_t* volume_render);
+
+      /*! \return The number of volume renders skipped so far because the
+       * map was being modified.
+       */
+      size_t numSkippedVolumeRenders() const {
+        return num_skipped_volume_renders_;
+      }
+
+    private:
+      struct Outputs {
+        std::vector<uint32_t> rgba_render;
+        std::vector<uint32_t> depth_render;
+        std::vector<uint32_t> track_render;
+        std::vector<uint32_t> volume_render;
+
+        Outputs(const size_t num_pixels);
+      };
+
+      void run();
+
+      void render(Outputs& outputs, const Outputs& previous_outputs);
+
+      const Eigen::Vector2i image_res_;
+      std::shared_ptr<OctreeType> map_;
+      std::mutex& map_mutex_;
+      Inputs inputs_;
+      std::unique_ptr<SensorImpl> sensor_;
+
+      // Double-buffered outputs. Only the background thread writes to the
+      // back buffer, the front one is swapped under output_mutex_.
+      std::array<Outputs, 2> outputs_;
+      int front_idx_;
+      size_t num_renders_;
+      std::atomic<size_t> num_skipped_volume_renders_;
+      std::mutex output_mutex_;
+
+      std::atomic<bool> busy_;
+      bool stop_;
+      std::mutex request_mutex_;
+      std::condition_variable request_cv_;
+      std::condition_variable done_cv_;
+      std::thread thread_;
+
+    public:
+      EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+} // namespace se
+
+#endif // __ASYNC_RENDERER_HPP
+
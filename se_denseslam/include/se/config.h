@@ -91,6 +91,16 @@ namespace se {
      */
     int integration_rate;
 
+    /**
+     * Integrate this many frames at once, visiting each VoxelBlock a single
+     * time per batch. Batching improves cache locality for high frame rate
+     * sensors but delays map updates, and thus raycasting for tracking, by up
+     * to integration_batch_size - 1 frames.
+     *
+     * <br>\em Default: 1
+     */
+    int integration_batch_size;
+
     /**
      * Render the 3D reconstruction every rendering_rate frames
      * \note configuration::enable_render == true (default) required.
@@ -323,12 +333,31 @@ namespace se {
      */
     bool enable_meshing;
 
+    /**
+     * Whether to save meshes in binary instead of ASCII format. Binary meshes
+     * are smaller and much faster to write.
+     *
+     * <br>\em Default: true
+     */
+    bool binary_mesh;
+
     /**
      * Whether to hide the GUI. Hiding the GUI results in faster operation.
      * <br>\em Default: true
      */
     bool enable_render;
 
+    /**
+     * Render the images shown by the GUI in a background thread instead of
+     * after processing each frame. Render requests made while the previous
+     * render is in progress are dropped, so the displayed images may lag
+     * behind the processed frames. Volume renders saved to
+     * output_render_file are always rendered synchronously.
+     *
+     * <br>\em Default: false
+     */
+    bool async_render;
+
     /*
      * TODO
      * <br>\em Default: ""
@@ -341,6 +370,36 @@ namespace se {
      */
     bool render_volume_fullsize;
 
+    /**
+     * Start each ray of the tracking raycast just before the surface hit
+     * predicted by reprojecting the previous raycast into the current view
+     * instead of at the near plane. Rays that miss the surface or have no
+     * prediction are marched from the near plane. Surfaces that appear more
+     * than raycast_seed_margin in front of the prediction, e.g. due to
+     * disocclusion, are missed.
+     *
+     * <br>\em Default: false
+     */
+    bool raycast_temporal_coherence;
+
+    /**
+     * The distance in meters before the predicted surface hit each ray is
+     * started at when raycast_temporal_coherence is enabled.
+     *
+     * <br>\em Default: 0.05
+     */
+    float raycast_seed_margin;
+
+    /**
+     * Track the input point cloud directly against the signed distance field
+     * of the map instead of against a raycast of it. The map is then only
+     * raycast for rendering. Only used with TSDF-based voxel implementations,
+     * the others always use projective ICP.
+     *
+     * <br>\em Default: false
+     */
+    bool sdf_tracking;
+
     /**
      * Whether to filter the depth input frames using a bilateral filter.
      * Filtering using a bilateral filter helps to reduce the measurement
@@ -359,6 +418,7 @@ namespace se {
         sensor_downsampling_factor(1),
         tracking_rate(1),
         integration_rate(1),
+        integration_batch_size(1),
         rendering_rate(4),
         meshing_rate(100),
         map_size(256, 256, 256),
@@ -384,9 +444,14 @@ namespace se {
         max_frame(-1),
         icp_threshold(1e-5),
         enable_meshing(false),
+        binary_mesh(true),
         enable_render(true),
+        async_render(false),
         output_render_file(""),
         render_volume_fullsize(false),
+        raycast_temporal_coherence(false),
+        raycast_seed_margin(0.05f),
+        sdf_tracking(false),
         bilateral_filter(false) {}
 
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -412,6 +477,7 @@ static std::ostream& operator<<(std::ostream& out, const se::Configuration& conf
   out << str_utils::bool_to_pretty_str(config.enable_benchmark,       "Enable benchmark") << "\n";
   out << str_utils::bool_to_pretty_str(config.enable_ground_truth,    "Enable ground truth") << "\n";
   out << str_utils::bool_to_pretty_str(config.enable_render,          "Enable render"      ) << "\n";
+  out << str_utils::bool_to_pretty_str(config.async_render,           "Async render"       ) << "\n";
   if (config.output_render_file != "") {
     out << str_utils::str_to_pretty_str(config.output_render_file,    "Output render file") << "\n";
   }
@@ -419,6 +485,7 @@ static std::ostream& operator<<(std::ostream& out, const se::Configuration& conf
   if (config.output_mesh_file != "") {
     out << str_utils::str_to_pretty_str(config.output_mesh_file,      "Output mesh file") << "\n";
   }
+  out << str_utils::bool_to_pretty_str(config.binary_mesh,            "Binary mesh"        ) << "\n";
   out << str_utils::bool_to_pretty_str(config.enable_structure,       "Enable structure"     ) << "\n";
   if (config.output_structure_file != "") {
     out << str_utils::str_to_pretty_str(config.output_structure_file, "Output structure file") << "\n";
@@ -426,6 +493,7 @@ static std::ostream& operator<<(std::ostream& out, const se::Configuration& conf
   out << "\n";
 
   out << str_utils::value_to_pretty_str(config.integration_rate,      "Integration rate") << "\n";
+  out << str_utils::value_to_pretty_str(config.integration_batch_size, "Integration batch size") << "\n";
   out << str_utils::value_to_pretty_str(config.rendering_rate,        "Rendering rate") << "\n";
   out << str_utils::value_to_pretty_str(config.meshing_rate,          "Meshing rate") << "\n";
   out << str_utils::value_to_pretty_str(config.fps,                   "FPS") << "\n";
@@ -437,6 +505,12 @@ static std::ostream& operator<<(std::ostream& out, const se::Configuration& conf
                                                                       "ICP pyramid levels") << "\n";
   out << str_utils::value_to_pretty_str(config.icp_threshold,         "ICP threshold") << "\n";
   out << str_utils::bool_to_pretty_str(config.render_volume_fullsize, "Render volume full-size") << "\n";
+  out << str_utils::bool_to_pretty_str(config.raycast_temporal_coherence,
+                                                                      "Raycast temporal coherence") << "\n";
+  if (config.raycast_temporal_coherence) {
+    out << str_utils::value_to_pretty_str(config.raycast_seed_margin, "Raycast seed margin", "meters") << "\n";
+  }
+  out << str_utils::bool_to_pretty_str(config.sdf_tracking,          "SDF tracking") << "\n";
   out << "\n";
 
   out << str_utils::header_to_pretty_str("MAP") << "\n";
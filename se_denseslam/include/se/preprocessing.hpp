@@ -38,6 +38,7 @@
 #define __PREPROCESSING_HPP
 
 #include <cstdint>
+#include <vector>
 
 #include <Eigen/Dense>
 
@@ -90,6 +91,17 @@ void downsampleDepthKernel(const float*           input_depth,
                            const Eigen::Vector2i& input_res,
                            se::Image<float>&      output_depth);
 
+/**
+ * Same as downsampleDepthKernel() above for depth in integer units as
+ * produced by most depth sensors, e.g. millimetres. The result is converted
+ * to metres by multiplying with depth_scale, e.g. 0.001. This avoids
+ * converting the whole input image to float first.
+ */
+void downsampleDepthKernel(const uint16_t*        input_depth,
+                           const Eigen::Vector2i& input_res,
+                           const float            depth_scale,
+                           se::Image<float>&      output_depth);
+
 
 
 void halfSampleRobustImageKernel(se::Image<float>&       out,
@@ -98,6 +110,32 @@ void halfSampleRobustImageKernel(se::Image<float>&       out,
                                  const int               r);
 
 
+
+/**
+ * Compute all levels of the depth, point cloud and normal pyramids used for
+ * tracking from the depth image in depth_pyramid[0]. The result is the same
+ * as calling halfSampleRobustImageKernel() with a radius of 1,
+ * depthToPointCloudKernel() and pointCloudToNormalKernel() on each level,
+ * but each level is computed in a single pass over its depth image. The
+ * points and normals are computed directly from the depth while the next
+ * depth level is half-sampled from the same rows.
+ *
+ * \param[in,out] depth_pyramid       The depth images of each level, the
+ *                                    first one is the input.
+ * \param[out]    point_cloud_pyramid The point clouds of each level.
+ * \param[out]    normals_pyramid     The normals of each level.
+ * \param[in]     sensor              The sensor model of the first level.
+ * \param[in]     e_d                 The maximum depth difference from the
+ *                                    top left pixel of the samples averaged
+ *                                    when half-sampling.
+ */
+void depthPyramidKernel(std::vector<se::Image<float> >&           depth_pyramid,
+                        std::vector<se::Image<Eigen::Vector3f> >& point_cloud_pyramid,
+                        std::vector<se::Image<Eigen::Vector3f> >& normals_pyramid,
+                        const SensorImpl&                         sensor,
+                        const float                               e_d);
+
+
 /**
  * Downsample an RGBA image and copy into an se::Image class.
  *
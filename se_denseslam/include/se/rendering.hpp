@@ -37,7 +37,10 @@
 #ifndef __RENDERING_HPP
 #define __RENDERING_HPP
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <vector>
 
 #include "se/utils/math_utils.h"
 #include "se/octree.hpp"
@@ -54,7 +57,6 @@
 
 namespace se {
   namespace internal {
-    static se::Image<int> scale_image(640, 480);
     static std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f>>
       color_map =
       {
@@ -72,54 +74,234 @@ namespace se {
 
 
 
+/**
+ * Statistics of a raycast seeded with predictRaycastKernel().
+ */
+struct RaycastStats {
+  /** The number of rays started just before the predicted surface hit. */
+  size_t num_seeded = 0;
+  /** The number of seeded rays that missed and were marched from the near plane. */
+  size_t num_fallback = 0;
+  /** The mean distance between the predicted and the actual surface hit of
+   * the seeded rays that didn't fall back, in meters. */
+  float mean_seed_error = 0.f;
+};
+
+
+
+/**
+ * Reproject the surface point cloud of a previous raycast into the view of
+ * T_MC. Each pixel of predicted_t_image is set to the ray parameter of the
+ * closest point projected onto it or to 0 if no point was projected onto it.
+ */
+void predictRaycastKernel(se::Image<float>&                 predicted_t_image,
+                          const se::Image<Eigen::Vector3f>& surface_point_cloud_M,
+                          const se::Image<Eigen::Vector3f>& surface_normals_M,
+                          const Eigen::Matrix4f&            T_MC,
+                          const SensorImpl&                 sensor);
+
+
+
+/**
+ * Raycast the map from raycast_T_MC. The scale the surface was hit at is
+ * written to surface_scale_image. If predicted_t_image is not nullptr,
+ * rays with a predicted surface hit t_pred are started at
+ * t_pred - seed_margin instead of at the near plane and are marched again
+ * from the near plane if they miss. Statistics of the seeded rays are
+ * written to stats if it is not nullptr.
+ */
 template<typename VoxelImplT>
 void raycastKernel(const se::Octree<typename VoxelImplT::VoxelType>& map,
                    se::Image<Eigen::Vector3f>&                       surface_point_cloud_M,
                    se::Image<Eigen::Vector3f>&                       surface_normals_M,
+                   se::Image<int>&                                   surface_scale_image,
                    const Eigen::Matrix4f&                            raycast_T_MC,
-                   const SensorImpl&                                 sensor) {
+                   const SensorImpl&                                 sensor,
+                   const se::Image<float>*                           predicted_t_image = nullptr,
+                   const float                                       seed_margin = 0.f,
+                   RaycastStats*                                     stats = nullptr) {
 
   TICKD("raycastKernel");
-#pragma omp parallel for
-  for (int y = 0; y < surface_point_cloud_M.height(); y++) {
-#pragma omp simd
-    for (int x = 0; x < surface_point_cloud_M.width(); x++) {
+  const int width = surface_point_cloud_M.width();
+  const int height = surface_point_cloud_M.height();
+  const Eigen::Matrix3f R_MC = se::math::to_rotation(raycast_T_MC);
+  const Eigen::Vector3f t_MC = se::math::to_translation(raycast_T_MC);
+  size_t num_seeded = 0;
+  size_t num_fallback = 0;
+  float seed_error_sum = 0.f;
+#pragma omp parallel for reduction(+:num_seeded, num_fallback, seed_error_sum)
+  for (int y = 0; y < height; y++) {
+#pragma omp simd reduction(+:num_seeded, num_fallback, seed_error_sum)
+    for (int x = 0; x < width; x++) {
       Eigen::Vector4f surface_intersection_M;
 
       const Eigen::Vector2i pixel(x, y);
       const Eigen::Vector2f pixel_f = pixel.cast<float>();
       Eigen::Vector3f ray_dir_C;
       sensor.model.backProject(pixel_f, &ray_dir_C);
-      const Eigen::Vector3f ray_dir_M = (se::math::to_rotation(raycast_T_MC) * ray_dir_C.normalized()).head(3);
-      const Eigen::Vector3f t_MC = se::math::to_translation(raycast_T_MC);
-
-      surface_intersection_M = VoxelImplT::raycast(map, t_MC, ray_dir_M, sensor.nearDist(ray_dir_C), sensor.farDist(ray_dir_C));
+      const Eigen::Vector3f ray_dir_M = R_MC * ray_dir_C.normalized();
+      const float t_near = sensor.nearDist(ray_dir_C);
+      const float t_far = sensor.farDist(ray_dir_C);
+
+      const float t_pred = (predicted_t_image) ? (*predicted_t_image)(x, y) : 0.f;
+      if (t_pred > 0.f) {
+        num_seeded++;
+        surface_intersection_M = VoxelImplT::raycast(map, t_MC, ray_dir_M,
+            std::max(t_pred - seed_margin, t_near), t_far);
+        // Some implementations also return Eigen::Vector4f::Zero() on a miss.
+        if (surface_intersection_M.w() >= 0.f && !surface_intersection_M.isZero()) {
+          seed_error_sum += std::fabs((surface_intersection_M.head<3>() - t_MC).norm() - t_pred);
+        } else {
+          num_fallback++;
+          surface_intersection_M = VoxelImplT::raycast(map, t_MC, ray_dir_M, t_near, t_far);
+        }
+      } else {
+        surface_intersection_M = VoxelImplT::raycast(map, t_MC, ray_dir_M, t_near, t_far);
+      }
       if (surface_intersection_M.w() >= 0.f) {
-        surface_point_cloud_M[x + y * surface_point_cloud_M.width()] = surface_intersection_M.head<3>();
-        Eigen::Vector3f surface_normal = map.gradAtPoint(surface_intersection_M.head<3>(),
-                                                         VoxelImplT::VoxelType::selectNodeValue,
-                                                         VoxelImplT::VoxelType::selectVoxelValue,
-                                                         static_cast<int>(surface_intersection_M.w() + 0.5f));
-        se::internal::scale_image(x, y) = static_cast<int>(surface_intersection_M.w());
+        surface_point_cloud_M[x + y * width] = surface_intersection_M.head<3>();
+        Eigen::Vector3f surface_normal;
+        map.interpGradAtPoint(surface_intersection_M.head<3>(),
+                              VoxelImplT::VoxelType::selectNodeValue,
+                              VoxelImplT::VoxelType::selectVoxelValue,
+                              surface_normal,
+                              static_cast<int>(surface_intersection_M.w() + 0.5f));
+        surface_scale_image[x + y * width] = static_cast<int>(surface_intersection_M.w());
         if (surface_normal.norm() == 0.f) {
-          surface_normals_M[pixel.x() + pixel.y() * surface_normals_M.width()] = Eigen::Vector3f(INVALID, 0.f, 0.f);
+          surface_normals_M[x + y * width] = Eigen::Vector3f(INVALID, 0.f, 0.f);
         } else {
           // Invert surface normals for TSDF representations.
-          surface_normals_M[pixel.x() + pixel.y() * surface_normals_M.width()] = VoxelImplT::invert_normals
+          surface_normals_M[x + y * width] = VoxelImplT::invert_normals
               ? (-1.f * surface_normal).normalized()
               : surface_normal.normalized();
         }
       } else {
-        surface_point_cloud_M[pixel.x() + pixel.y() * surface_point_cloud_M.width()] = Eigen::Vector3f::Zero();
-        surface_normals_M[pixel.x() + pixel.y() * surface_normals_M.width()] = Eigen::Vector3f(INVALID, 0.f, 0.f);
+        surface_point_cloud_M[x + y * width] = Eigen::Vector3f::Zero();
+        surface_normals_M[x + y * width] = Eigen::Vector3f(INVALID, 0.f, 0.f);
+        surface_scale_image[x + y * width] = 0;
       }
     }
   }
+  if (stats) {
+    stats->num_seeded = num_seeded;
+    stats->num_fallback = num_fallback;
+    const size_t num_seeded_hits = num_seeded - num_fallback;
+    stats->mean_seed_error = (num_seeded_hits > 0) ? seed_error_sum / num_seeded_hits : 0.f;
+  }
   TOCK("raycastKernel");
 }
 
 
 
+/**
+ * The result of raycasting the map from one view with raycastViewsKernel().
+ */
+struct RaycastView {
+  /** The depth measurement of each surface hit as returned by
+   * SensorImpl::measurementFromPoint(), 0 on a miss. */
+  se::Image<float> depth_image;
+  /** The scale of each surface hit, -1 on a miss. */
+  se::Image<int> scale_image;
+  /** The number of ray samples in unobserved space in front of the surface hits. */
+  size_t num_unknown_samples;
+
+  RaycastView(const Eigen::Vector2i& image_res)
+    : depth_image(image_res.x(), image_res.y(), 0.f),
+      scale_image(image_res.x(), image_res.y(), -1),
+      num_unknown_samples(0) {}
+};
+
+
+
+/**
+ * Raycast the map from each of the camera poses T_MCs, e.g. to evaluate
+ * candidate views when planning. The image resolution of the views is that
+ * of sensor, so a scaled copy of the sensor can be used to raycast at a
+ * reduced resolution. The ray directions are shared by all views and the
+ * rays of all views are traced in a single parallel loop. If
+ * unknown_sample_dist is positive, each ray is also sampled every
+ * unknown_sample_dist meters up to its surface hit or the far plane and
+ * samples inside the map that haven't been observed are counted. No
+ * durations are sampled into se::perfstats since this may run outside the
+ * thread processing frames.
+ */
+template<typename VoxelImplT>
+void raycastViewsKernel(const se::Octree<typename VoxelImplT::VoxelType>&                        map,
+                        const std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>>& T_MCs,
+                        const SensorImpl&                                                        sensor,
+                        std::vector<RaycastView>&                                                views,
+                        const float                                                              unknown_sample_dist = 0.f) {
+
+  const Eigen::Vector2i image_res(sensor.model.imageWidth(), sensor.model.imageHeight());
+  const int num_pixels = image_res.prod();
+  views.clear();
+  views.reserve(T_MCs.size());
+  for (size_t v = 0; v < T_MCs.size(); ++v) {
+    views.emplace_back(image_res);
+  }
+
+  // The ray directions and limits in the camera frame are the same for all views.
+  std::vector<Eigen::Vector3f, Eigen::aligned_allocator<Eigen::Vector3f>> ray_dirs_C (num_pixels);
+  std::vector<float> t_nears (num_pixels);
+  std::vector<float> t_fars (num_pixels);
+#pragma omp parallel for
+  for (int i = 0; i < num_pixels; i++) {
+    const Eigen::Vector2f pixel_f (i % image_res.x(), i / image_res.x());
+    Eigen::Vector3f ray_dir_C;
+    sensor.model.backProject(pixel_f, &ray_dir_C);
+    t_nears[i] = sensor.nearDist(ray_dir_C);
+    t_fars[i] = sensor.farDist(ray_dir_C);
+    ray_dirs_C[i] = ray_dir_C.normalized();
+  }
+
+  // Trace the rows of all views in a single loop so that small batches of
+  // large views and large batches of small views are both parallelised well.
+  const int num_rows = image_res.y() * T_MCs.size();
+  std::vector<size_t> num_unknown_samples (num_rows, 0);
+#pragma omp parallel for
+  for (int row_idx = 0; row_idx < num_rows; row_idx++) {
+    const int view_idx = row_idx / image_res.y();
+    const int y = row_idx % image_res.y();
+    const Eigen::Matrix3f R_MC = se::math::to_rotation(T_MCs[view_idx]);
+    const Eigen::Vector3f t_MC = se::math::to_translation(T_MCs[view_idx]);
+    RaycastView& view = views[view_idx];
+    for (int x = 0; x < image_res.x(); x++) {
+      const int pixel_idx = x + y * image_res.x();
+      const Eigen::Vector3f& ray_dir_C = ray_dirs_C[pixel_idx];
+      const Eigen::Vector3f ray_dir_M = R_MC * ray_dir_C;
+      const Eigen::Vector4f surface_intersection_M = VoxelImplT::raycast(map, t_MC, ray_dir_M,
+          t_nears[pixel_idx], t_fars[pixel_idx]);
+      // Some implementations also return Eigen::Vector4f::Zero() on a miss.
+      const bool hit = surface_intersection_M.w() >= 0.f && !surface_intersection_M.isZero();
+      float t_end = t_fars[pixel_idx];
+      if (hit) {
+        t_end = (surface_intersection_M.head<3>() - t_MC).norm();
+        view.depth_image[pixel_idx] = sensor.measurementFromPoint(t_end * ray_dir_C);
+        view.scale_image[pixel_idx] = static_cast<int>(surface_intersection_M.w());
+      }
+
+      if (unknown_sample_dist > 0.f) {
+        for (float t = t_nears[pixel_idx]; t < t_end; t += unknown_sample_dist) {
+          const Eigen::Vector3f point_M = t_MC + t * ray_dir_M;
+          if (!map.containsPoint(point_M)) {
+            continue;
+          }
+          typename VoxelImplT::VoxelType::VoxelData data;
+          map.getAtPoint(point_M, data);
+          if (!VoxelImplT::VoxelType::isValid(data)) {
+            num_unknown_samples[row_idx]++;
+          }
+        }
+      }
+    }
+  }
+  for (int row_idx = 0; row_idx < num_rows; row_idx++) {
+    views[row_idx / image_res.y()].num_unknown_samples += num_unknown_samples[row_idx];
+  }
+}
+
+
+
 void renderRGBAKernel(uint32_t*                  output_RGBA_image_data,
                       const Eigen::Vector2i&     output_RGBA_image_res,
                       const se::Image<uint32_t>& input_RGBA_image);
@@ -146,7 +328,8 @@ void renderVolumeKernel(uint32_t*                         volume_RGBA_image_data
                         const Eigen::Vector3f&            light_M,
                         const Eigen::Vector3f&            ambient_M,
                         const se::Image<Eigen::Vector3f>& surface_point_cloud_M,
-                        const se::Image<Eigen::Vector3f>& surface_normals_M) {
+                        const se::Image<Eigen::Vector3f>& surface_normals_M,
+                        const se::Image<int>&             surface_scale_image) {
   TICKD("renderVolumeKernel");
   const int h = volume_RGBA_image_res.y(); // clang complains if this is inside the for loop
   const int w = volume_RGBA_image_res.x(); // clang complains if this is inside the for loop
@@ -166,7 +349,7 @@ void renderVolumeKernel(uint32_t*                         volume_RGBA_image_data
             = Eigen::Vector3f::Constant(fmaxf(surface_normal_M.normalized().dot(diff), 0.f));
         Eigen::Vector3f col = dir + ambient_M;
         se::math::clamp(col, Eigen::Vector3f::Zero(), Eigen::Vector3f::Ones());
-        col = col.cwiseProduct(se::internal::color_map[se::internal::scale_image(x, y)]);
+        col = col.cwiseProduct(se::internal::color_map[surface_scale_image[pixel_idx]]);
         volume_RGBA_image_data[pixel_idx] = se::pack_rgba(col.x(), col.y(), col.z(), 0xFF);
       } else {
         volume_RGBA_image_data[pixel_idx] = 0xFF000000;
@@ -37,7 +37,11 @@
 #ifndef __TRACKING_HPP
 #define __TRACKING_HPP
 
+#include <algorithm>
+#include <type_traits>
+
 #include "se/utils/math_utils.h"
+#include "se/octree.hpp"
 #include "se/timings.h"
 #include "se/perfstats.h"
 #include "se/commons.h"
@@ -101,6 +105,80 @@ void trackKernel(TrackData*                        output_data,
 
 
 
+/**
+ * \brief Compute the tracking data and reduce it into the linear system used to
+ * update the camera pose in a single pass.
+ *
+ * Produces the same sums as trackKernel() followed by reduceKernel() without
+ * writing the per pixel tracking data to memory unless requested. The sums
+ * are accumulated in a fixed order so the result doesn't depend on the
+ * number of threads.
+ *
+ * param[out] output_data               The 8x32 reduction output, only the first row is non-zero.
+ * param[out] tracking_result           The per pixel tracking data as written by trackKernel(),
+ *                                      or nullptr to skip writing it.
+ * param[in]  input_point_cloud_C       The point cloud input provided by the sensor.
+ * param[in]  input_normals_C           The normals of the point cloud input provided by the sensor.
+ * param[in]  ref_surface_point_cloud_M The surface point cloud in map frame computed from the previous raycasting pose.
+ * param[in]  ref_surface_normals_M     The surface normals in map frame computed from the previous raycasting pose.
+ * param[in]  T_MC                      The current approximation of the camera pose.
+ * param[in]  T_MC_ref                  The raycasting pose the surface point cloud and normal was computed from.
+ * param[in]  sensor                    The sensor model used.
+ * param[in]  dist_threshold            The maximum abs distance between the input point and the projected surface point.
+ * param[in]  normal_threshold          The maximum dot product between the input normal and the projected normal.
+ */
+void trackReduceKernel(float*                            output_data,
+                       TrackData*                        tracking_result,
+                       const se::Image<Eigen::Vector3f>& input_point_cloud_C,
+                       const se::Image<Eigen::Vector3f>& input_normals_C,
+                       const se::Image<Eigen::Vector3f>& surface_point_cloud_M,
+                       const se::Image<Eigen::Vector3f>& surface_normals_M,
+                       const Eigen::Matrix4f&            T_MC,
+                       const Eigen::Matrix4f&            T_MC_ref,
+                       const SensorImpl&                 sensor,
+                       const float                       dist_threshold,
+                       const float                       normal_threshold);
+
+
+
+/**
+ * \brief Compute the tracking data and reduce it into the linear system used to
+ * update the camera pose by aligning the input point cloud to the signed
+ * distance field of the map.
+ *
+ * The residual of each input point is its signed distance from the surface
+ * and the Jacobian is computed from the normalized gradient of the field, so
+ * the linear system has the same form as the one of ICP and can be solved
+ * with updatePoseKernel() and checked with checkPoseKernel(). No raycast of
+ * the map is needed. Only available for voxel implementations storing a
+ * truncated signed distance function, see se::supportsSDFTracking.
+ *
+ * The meaning of the tracking results is the same as for trackKernel() with
+ * -3 for points in parts of the map that haven't been observed and -4 for
+ * points further than dist_threshold from the surface or outside the
+ * truncation band.
+ *
+ * param[out] output_data         The 8x32 reduction output, only the first row is non-zero.
+ * param[out] tracking_result     The per pixel tracking data or nullptr to skip writing it.
+ * param[in]  map                 The map to track against.
+ * param[in]  input_point_cloud_C The point cloud input provided by the sensor.
+ * param[in]  input_normals_C     The normals of the point cloud input provided by the sensor.
+ * param[in]  T_MC                The current approximation of the camera pose.
+ * param[in]  dist_threshold      The maximum abs distance between the input point and the surface.
+ * param[in]  normal_threshold    The maximum dot product between the input normal and the surface normal.
+ */
+template <typename VoxelImplT>
+void sdfTrackReduceKernel(float*                                            output_data,
+                          TrackData*                                        tracking_result,
+                          const se::Octree<typename VoxelImplT::VoxelType>& map,
+                          const se::Image<Eigen::Vector3f>&                 input_point_cloud_C,
+                          const se::Image<Eigen::Vector3f>&                 input_normals_C,
+                          const Eigen::Matrix4f&                            T_MC,
+                          const float                                       dist_threshold,
+                          const float                                       normal_threshold);
+
+
+
 bool updatePoseKernel(Eigen::Matrix4f& T_MC,
                       const float*     reduction_output,
                       const float      icp_threshold);
@@ -113,5 +191,170 @@ bool checkPoseKernel(Eigen::Matrix4f&       T_MC,
                      const Eigen::Vector2i& reduction_output_res,
                      const float            track_threshold);
 
+namespace se {
+  /**
+   * Whether sdfTrackReduceKernel() can be used with a voxel implementation,
+   * i.e. whether it stores a truncated signed distance function with
+   * truncation bound VoxelImplT::mu.
+   */
+  template <typename VoxelImplT, typename = void>
+  struct supportsSDFTracking : std::false_type {};
+
+  template <typename VoxelImplT>
+  struct supportsSDFTracking<VoxelImplT, decltype(void(VoxelImplT::mu))> : std::true_type {};
+
+
+
+  namespace internal {
+    /**
+     * Call track_pixel(row, pixel) for each pixel of an image of resolution
+     * input_res and accumulate the resulting TrackData into the reduction
+     * output like reduceKernel() does. The image rows are split into a fixed
+     * number of chunks, independent of the number of threads, whose sums are
+     * then added in a fixed order so the result doesn't depend on the thread
+     * scheduling. The TrackData is also written to tracking_result, with a
+     * row stride of result_stride, unless it's nullptr.
+     */
+    template <typename TrackPixelF>
+    void reduceTrackData(float*                 output_data,
+                         TrackData*             tracking_result,
+                         const Eigen::Vector2i& input_res,
+                         const int              result_stride,
+                         TrackPixelF            track_pixel) {
+
+      constexpr int num_chunks = 64;
+      float chunk_sums[num_chunks][32];
+      const int rows_per_chunk = (input_res.y() + num_chunks - 1) / num_chunks;
+
+#pragma omp parallel for schedule(dynamic)
+      for (int chunk_idx = 0; chunk_idx < num_chunks; chunk_idx++) {
+        float sums[32] = {0.0f};
+        const int y_end = std::min((chunk_idx + 1) * rows_per_chunk, input_res.y());
+        for (int y = chunk_idx * rows_per_chunk; y < y_end; y++) {
+          for (int x = 0; x < input_res.x(); x++) {
+            const Eigen::Vector2i pixel(x, y);
+            TrackData row;
+            track_pixel(row, pixel);
+            if (tracking_result) {
+              tracking_result[pixel.x() + pixel.y() * result_stride] = row;
+            }
+
+            if (row.result < 1) {
+              sums[29] += row.result == -4 ? 1 : 0;
+              sums[30] += row.result == -5 ? 1 : 0;
+              sums[31] += row.result >  -4 ? 1 : 0;
+              continue;
+            }
+            // Error part
+            sums[0] += row.error * row.error;
+            // JTe part
+            for (int i = 0; i < 6; ++i) {
+              sums[i + 1] += row.error * row.J[i];
+            }
+            // JTJ part, the upper triangle row by row
+            int jtj_idx = 7;
+            for (int i = 0; i < 6; ++i) {
+              for (int j = i; j < 6; ++j) {
+                sums[jtj_idx++] += row.J[i] * row.J[j];
+              }
+            }
+            sums[28] += 1;
+          }
+        }
+        std::copy(sums, sums + 32, chunk_sums[chunk_idx]);
+      }
+
+      // Pairwise tree reduction of the chunk sums into the first chunk.
+      for (int stride = 1; stride < num_chunks; stride *= 2) {
+        for (int chunk_idx = 0; chunk_idx + stride < num_chunks; chunk_idx += 2 * stride) {
+          for (int i = 0; i < 32; ++i) {
+            chunk_sums[chunk_idx][i] += chunk_sums[chunk_idx + stride][i];
+          }
+        }
+      }
+
+      // Same layout as the output of reduceKernel().
+      std::fill(output_data, output_data + 8 * 32, 0.0f);
+      std::copy(chunk_sums[0], chunk_sums[0] + 32, output_data);
+    }
+  } // namespace internal
+} // namespace se
+
+
+
+template <typename VoxelImplT>
+void sdfTrackReduceKernel(float*                                            output_data,
+                          TrackData*                                        tracking_result,
+                          const se::Octree<typename VoxelImplT::VoxelType>& map,
+                          const se::Image<Eigen::Vector3f>&                 input_point_cloud_C,
+                          const se::Image<Eigen::Vector3f>&                 input_normals_C,
+                          const Eigen::Matrix4f&                            T_MC,
+                          const float                                       dist_threshold,
+                          const float                                       normal_threshold) {
+
+  static_assert(se::supportsSDFTracking<VoxelImplT>::value,
+      "SDF tracking requires a TSDF-based voxel implementation");
+  TICKD("sdfTrackReduceKernel");
+  const Eigen::Vector2i input_res(input_point_cloud_C.width(), input_point_cloud_C.height());
+
+  se::internal::reduceTrackData(output_data, tracking_result, input_res, input_res.x(),
+      [&](TrackData& row, const Eigen::Vector2i& pixel) {
+        const Eigen::Vector3f& input_normal_C = input_normals_C[pixel.x() + pixel.y() * input_res.x()];
+        if (input_normal_C.x() == INVALID) {
+          row.result = -1;
+          return;
+        }
+
+        // point_M := The input point in map frame
+        const Eigen::Vector3f point_M = (T_MC *
+            input_point_cloud_C[pixel.x() + pixel.y() * input_res.x()].homogeneous()).head<3>();
+        if (!map.containsPoint(point_M)) {
+          row.result = -2;
+          return;
+        }
+
+        Eigen::Vector3f gradient;
+        bool is_valid;
+        const float value = map.interpGradAtPoint(point_M,
+            VoxelImplT::VoxelType::selectNodeValue, VoxelImplT::VoxelType::selectVoxelValue,
+            gradient, 0, is_valid).first;
+        if (!is_valid || gradient.norm() == 0.f) {
+          row.result = -3;
+          return;
+        }
+
+        // The field is normalized by the truncation bound and saturates
+        // outside of it, where it carries no information about the surface.
+        const float dist = VoxelImplT::mu * value;
+        if (std::fabs(value) >= 1.f || std::fabs(dist) > dist_threshold) {
+          row.result = -4;
+          return;
+        }
+
+        // surface_normal_M := The surface normal as it would be raycast.
+        const Eigen::Vector3f gradient_dir_M = gradient.normalized();
+        const Eigen::Vector3f surface_normal_M = VoxelImplT::invert_normals
+            ? Eigen::Vector3f(-gradient_dir_M) : gradient_dir_M;
+        if ((T_MC.topLeftCorner<3, 3>() * input_normal_C).dot(surface_normal_M) < normal_threshold) {
+          row.result = -5;
+          return;
+        }
+
+        // Moving the point by -dist along the gradient direction brings it
+        // on the surface, same as the point-to-plane ICP error.
+        row.result = 1;
+        row.error = -dist;
+        row.J[0] = gradient_dir_M.x();
+        row.J[1] = gradient_dir_M.y();
+        row.J[2] = gradient_dir_M.z();
+
+        const Eigen::Vector3f cross_prod = point_M.cross(gradient_dir_M);
+        row.J[3] = cross_prod.x();
+        row.J[4] = cross_prod.y();
+        row.J[5] = cross_prod.z();
+      });
+  TOCK("sdfTrackReduceKernel");
+}
+
 #endif
 
@@ -36,7 +36,9 @@
 
 #include "se/DenseSLAMSystem.h"
 
+#include <chrono>
 #include <cstring>
+#include <fstream>
 
 #include "se/voxel_block_ray_iterator.hpp"
 #include "se/algorithms/meshing.hpp"
@@ -52,6 +54,35 @@
 
 extern PerfStats stats;
 
+
+
+// Only instantiate sdfTrackReduceKernel() for the voxel implementations
+// supporting it so that DenseSLAMSystem compiles for all of them.
+template <typename VoxelImplT>
+static void sdfTrackReduce(std::true_type,
+                           float*                                            output_data,
+                           TrackData*                                        tracking_result,
+                           const se::Octree<typename VoxelImplT::VoxelType>& map,
+                           const se::Image<Eigen::Vector3f>&                 input_point_cloud_C,
+                           const se::Image<Eigen::Vector3f>&                 input_normals_C,
+                           const Eigen::Matrix4f&                            T_MC) {
+  sdfTrackReduceKernel<VoxelImplT>(output_data, tracking_result, map,
+      input_point_cloud_C, input_normals_C, T_MC, dist_threshold, normal_threshold);
+}
+
+template <typename VoxelImplT>
+static void sdfTrackReduce(std::false_type,
+                           float*,
+                           TrackData*,
+                           const se::Octree<typename VoxelImplT::VoxelType>&,
+                           const se::Image<Eigen::Vector3f>&,
+                           const se::Image<Eigen::Vector3f>&,
+                           const Eigen::Matrix4f&) {
+}
+
+
+
+
 DenseSLAMSystem::DenseSLAMSystem(const Eigen::Vector2i&   image_res,
                                  const Eigen::Vector3i&   map_size,
                                  const Eigen::Vector3f&   map_dim,
@@ -84,6 +115,8 @@ DenseSLAMSystem::DenseSLAMSystem(const Eigen::Vector2i&   image_res,
     raycast_T_MC_(T_MC_),
     surface_point_cloud_M_(image_res_.x(), image_res_.y(), Eigen::Vector3f::Zero()),
     surface_normals_M_(image_res_.x(), image_res_.y(), Eigen::Vector3f::Zero()),
+    surface_scale_image_(image_res_.x(), image_res_.y(), 0),
+    predicted_raycast_t_image_(image_res_.x(), image_res_.y(), 0.f),
     render_T_MC_(&T_MC_),
     T_MW_(T_MW)
   {
@@ -107,9 +140,9 @@ DenseSLAMSystem::DenseSLAMSystem(const Eigen::Vector2i&   image_res,
 
     // Initialize the Gaussian for the bilateral filter
     constexpr int gaussian_size = gaussian_radius * 2 + 1;
-    gaussian_.reserve(gaussian_size);
+    gaussian_.resize(gaussian_size);
     for (int i = 0; i < gaussian_size; i++) {
-      const int x = i - 2;
+      const int x = i - gaussian_radius;
       gaussian_[i] = expf(-(x * x) / (2 * delta * delta));
     }
 
@@ -125,6 +158,17 @@ DenseSLAMSystem::DenseSLAMSystem(const Eigen::Vector2i&   image_res,
     // Initialize the map
     map_ = std::shared_ptr<se::Octree<VoxelImpl::VoxelType> >(new se::Octree<VoxelImpl::VoxelType>());
     map_->init(map_size_.x(), map_dim_.x());
+
+    if (config_.async_render) {
+      async_renderer_.reset(new se::AsyncRenderer(image_res_, map_, map_mutex_));
+    }
+}
+
+
+
+DenseSLAMSystem::~DenseSLAMSystem() {
+  // The map may outlive the pipeline, see DenseSLAMSystem::getMap.
+  flushIntegration();
 }
 
 
@@ -148,6 +192,26 @@ bool DenseSLAMSystem::preprocessDepth(const float*           input_depth_image_d
 
 
 
+bool DenseSLAMSystem::preprocessDepth(const uint16_t*        input_depth_image_data,
+                                      const Eigen::Vector2i& input_depth_image_res,
+                                      const float            depth_scale,
+                                      const bool             filter_depth){
+  TICKD("preprocessDepth")
+  downsampleDepthKernel(input_depth_image_data, input_depth_image_res, depth_scale, depth_image_);
+
+  if (filter_depth) {
+    bilateralFilterKernel(scaled_depth_image_[0], depth_image_, gaussian_,
+        e_delta, gaussian_radius);
+  } else {
+    std::memcpy(scaled_depth_image_[0].data(), depth_image_.data(),
+        sizeof(float) * image_res_.x() * image_res_.y());
+  }
+  TOCK("preprocessDepth")
+  return true;
+}
+
+
+
 bool DenseSLAMSystem::preprocessColor(const uint32_t*        input_RGBA_image_data,
                                       const Eigen::Vector2i& input_RGBA_image_res) {
 
@@ -160,40 +224,46 @@ bool DenseSLAMSystem::preprocessColor(const uint32_t*        input_RGBA_image_da
 
 
 bool DenseSLAMSystem::track(const SensorImpl& sensor,
-                            const float       icp_threshold) {
+                            const float       icp_threshold,
+                            const bool        store_tracking_result) {
 
   TICK("TRACKING")
-  // half sample the input depth maps into the pyramid levels
-  for (unsigned int i = 1; i < iterations_.size(); ++i) {
-    halfSampleRobustImageKernel(scaled_depth_image_[i], scaled_depth_image_[i - 1], e_delta * 3, 1);
-  }
+  // Compute the depth, point cloud and normal pyramids of the input
+  depthPyramidKernel(scaled_depth_image_, input_point_cloud_C_, input_normals_C_, sensor,
+      e_delta * 3);
 
-  // prepare the 3D information from the input depth maps
-  for (unsigned int i = 0; i < iterations_.size(); ++i) {
-    const float scaling_factor = 1.f / (1 << i);
-    const SensorImpl scaled_sensor(sensor, scaling_factor);
-    depthToPointCloudKernel(input_point_cloud_C_[i], scaled_depth_image_[i], scaled_sensor);
-    if(sensor.left_hand_frame) {
-      pointCloudToNormalKernel<true>(input_normals_C_[i], input_point_cloud_C_[i]);
-    }
-    else {
-      pointCloudToNormalKernel<false>(input_normals_C_[i], input_point_cloud_C_[i]);
+  previous_T_MC_ = T_MC_;
+
+  if (usesSDFTracking()) {
+    // The map is read by the background renderer as well.
+    std::lock_guard<std::mutex> map_lock (map_mutex_);
+    for (int level = iterations_.size() - 1; level >= 0; --level) {
+      TrackData* tracking_result = (store_tracking_result && level == 0)
+          ? tracking_result_.data() : nullptr;
+      for (int i = 0; i < iterations_[level]; ++i) {
+        sdfTrackReduce<VoxelImpl>(se::supportsSDFTracking<VoxelImpl>(),
+            reduction_output_.data(), tracking_result, *map_,
+            input_point_cloud_C_[level], input_normals_C_[level], T_MC_);
+        if (updatePoseKernel(T_MC_, reduction_output_.data(), icp_threshold))
+          break;
+      }
     }
+    TOCK("TRACKING")
+    return checkPoseKernel(T_MC_, previous_T_MC_, reduction_output_.data(),
+        image_res_, track_threshold);
   }
 
-  previous_T_MC_ = T_MC_;
-
   for (int level = iterations_.size() - 1; level >= 0; --level) {
-    Eigen::Vector2i reduction_output_res(
-        image_res_.x() / (int) pow(2, level),
-        image_res_.y() / (int) pow(2, level));
+    // Only the tracking data of the finest level is kept for rendering, the
+    // coarser levels would be overwritten by it anyway.
+    TrackData* tracking_result = (store_tracking_result && level == 0)
+        ? tracking_result_.data() : nullptr;
     for (int i = 0; i < iterations_[level]; ++i) {
 
-      trackKernel(tracking_result_.data(), input_point_cloud_C_[level], input_normals_C_[level],
+      trackReduceKernel(reduction_output_.data(), tracking_result,
+          input_point_cloud_C_[level], input_normals_C_[level],
           surface_point_cloud_M_, surface_normals_M_, T_MC_, raycast_T_MC_, sensor, dist_threshold, normal_threshold);
 
-      reduceKernel(reduction_output_.data(), reduction_output_res, tracking_result_.data(), image_res_);
-
       if (updatePoseKernel(T_MC_, reduction_output_.data(), icp_threshold))
         break;
 
@@ -227,59 +297,123 @@ bool DenseSLAMSystem::integrate(const SensorImpl&  sensor,
 
   if (num_voxel > 0) {
     TICKD("allocate")
+    std::lock_guard<std::mutex> map_lock (map_mutex_);
     map_->allocate(allocation_list_.data(), num_voxel);
     TOCK("allocate")
   }
 
-  VoxelImpl::integrate(
-      *map_,
-      depth_image_,
-      T_CM,
-      sensor,
-      frame);
+  if (config_.integration_batch_size <= 1) {
+    std::lock_guard<std::mutex> map_lock (map_mutex_);
+    VoxelImpl::integrate(
+        *map_,
+        depth_image_,
+        T_CM,
+        sensor,
+        frame);
+  } else {
+    // Queue the frame and integrate the whole batch once it is full. The
+    // buffer sizes are recorded so that octants allocated by later frames in
+    // the batch are not updated with this one.
+    integration_batch_.emplace_back(depth_image_, T_CM, frame,
+        map_->pool().nodeBufferSize(), map_->pool().blockBufferSize());
+    integration_batch_sensor_.reset(new SensorImpl(sensor));
+    if (integration_batch_.size() >= static_cast<size_t>(config_.integration_batch_size)) {
+      flushIntegration();
+    }
+  }
   TOCK("INTEGRATION")
   return true;
 }
 
 
 
+bool DenseSLAMSystem::flushIntegration() {
+
+  if (integration_batch_.empty()) {
+    return false;
+  }
+  TICKD("integrateBatch")
+  std::unique_lock<std::mutex> map_lock (map_mutex_);
+  VoxelImpl::integrate(*map_, integration_batch_, *integration_batch_sensor_);
+  map_lock.unlock();
+  integration_batch_.clear();
+  TOCK("integrateBatch")
+  return true;
+}
+
+
+
 bool DenseSLAMSystem::raycast(const SensorImpl& sensor) {
 
   TICK("RAYCASTING")
   raycast_T_MC_ = T_MC_;
-  raycastKernel<VoxelImpl>(*map_, surface_point_cloud_M_, surface_normals_M_,
-      raycast_T_MC_, sensor);
+  if (config_.raycast_temporal_coherence) {
+    // Seed the rays with the previous raycast reprojected into the current
+    // view.
+    predictRaycastKernel(predicted_raycast_t_image_, surface_point_cloud_M_,
+        surface_normals_M_, raycast_T_MC_, sensor);
+    RaycastStats raycast_stats;
+    raycastKernel<VoxelImpl>(*map_, surface_point_cloud_M_, surface_normals_M_,
+        surface_scale_image_, raycast_T_MC_, sensor, &predicted_raycast_t_image_, config_.raycast_seed_margin,
+        &raycast_stats);
+    se::perfstats.sample("raycast_seeded", raycast_stats.num_seeded, PerfStats::COUNT);
+    se::perfstats.sample("raycast_fallback", raycast_stats.num_fallback, PerfStats::COUNT);
+    se::perfstats.sample("raycast_seed_error", raycast_stats.mean_seed_error, PerfStats::DISTANCE);
+  } else {
+    raycastKernel<VoxelImpl>(*map_, surface_point_cloud_M_, surface_normals_M_,
+        surface_scale_image_, raycast_T_MC_, sensor);
+  }
   TOCK("RAYCASTING")
   return true;
 }
 
 
 
+void DenseSLAMSystem::raycastViews(const std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>>& T_WCs,
+                                   const SensorImpl&                                                        sensor,
+                                   std::vector<RaycastView>&                                                views,
+                                   const int                                                                downsampling_factor,
+                                   const float                                                              unknown_sample_dist) {
+
+  std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>> T_MCs;
+  T_MCs.reserve(T_WCs.size());
+  for (const auto& T_WC : T_WCs) {
+    T_MCs.push_back(T_MW_ * T_WC);
+  }
+  const SensorImpl scaled_sensor(sensor, 1.f / downsampling_factor);
+  std::lock_guard<std::mutex> map_lock (map_mutex_);
+  raycastViewsKernel<VoxelImpl>(*map_, T_MCs, scaled_sensor, views, unknown_sample_dist);
+}
+
+
+
 void DenseSLAMSystem::renderVolume(uint32_t*              volume_RGBA_image_data,
                                    const Eigen::Vector2i& volume_RGBA_image_res,
                                    const SensorImpl&      sensor) {
 
   se::Image<Eigen::Vector3f> render_surface_point_cloud_M (image_res_.x(), image_res_.y());
   se::Image<Eigen::Vector3f> render_surface_normals_M (image_res_.x(), image_res_.y());
+  se::Image<int> render_surface_scale_image (image_res_.x(), image_res_.y());
   if (render_T_MC_->isApprox(raycast_T_MC_)) {
     // Copy the raycast from the camera viewpoint. Can't safely use memcpy with
     // Eigen objects it seems.
     for (size_t i = 0; i < surface_point_cloud_M_.size(); ++i) {
       render_surface_point_cloud_M[i] = surface_point_cloud_M_[i];
       render_surface_normals_M[i] = surface_normals_M_[i];
+      render_surface_scale_image[i] = surface_scale_image_[i];
     }
   } else {
     TICK("RAYCASTING")
     // Raycast the map from the render viewpoint.
     raycastKernel<VoxelImpl>(*map_, render_surface_point_cloud_M,
-        render_surface_normals_M, *render_T_MC_, sensor);
+        render_surface_normals_M, render_surface_scale_image, *render_T_MC_, sensor);
     TOCK("RAYCASTING")
   }
 
   TICKD("renderVolume")
   renderVolumeKernel<VoxelImpl>(volume_RGBA_image_data, volume_RGBA_image_res,
       se::math::to_translation(*render_T_MC_), ambient,
-      render_surface_point_cloud_M, render_surface_normals_M);
+      render_surface_point_cloud_M, render_surface_normals_M, render_surface_scale_image);
   TOCK("renderVolume")
 }
 
@@ -315,20 +449,109 @@ void DenseSLAMSystem::renderRGBA(uint32_t*              output_RGBA_image_data,
 
 
 
-void DenseSLAMSystem::dumpMesh(const std::string filename, const bool print_path) {
+bool DenseSLAMSystem::requestRender(const SensorImpl& sensor,
+                                    const bool        render_volume) {
+
+  if (!async_renderer_ || async_renderer_->busy()) {
+    return false;
+  }
+  // The renderer only reads its inputs while busy so they can be written to
+  // without locking.
+  TICKD("requestRender")
+  se::AsyncRenderer::Inputs& inputs = async_renderer_->inputs();
+  inputs.rgba_image = rgba_image_;
+  inputs.depth_image = depth_image_;
+  inputs.tracking_result = tracking_result_;
+  inputs.render_volume = render_volume;
+  if (render_volume) {
+    inputs.surface_point_cloud_M = surface_point_cloud_M_;
+    inputs.surface_normals_M = surface_normals_M_;
+    inputs.surface_scale_image = surface_scale_image_;
+    inputs.raycast_T_MC = raycast_T_MC_;
+    inputs.render_T_MC = *render_T_MC_;
+  }
+  const bool requested = async_renderer_->request(sensor);
+  TOCK("requestRender")
+  return requested;
+}
+
+
+
+size_t DenseSLAMSystem::renderedImages(uint32_t* rgba_render,
+                                       uint32_t* depth_render,
+                                       uint32_t* track_render,
+                                       uint32_t* volume_render) {
+
+  if (!async_renderer_) {
+    return 0;
+  }
+  return async_renderer_->copyOutputs(rgba_render, depth_render, track_render, volume_render);
+}
+
+
+
+int DenseSLAMSystem::dumpMesh(const std::string filename,
+                              const bool        print_path,
+                              const int         min_scale,
+                              const bool        binary) {
 
   TICK("dumpMesh")
+  flushIntegration();
   if (print_path) {
     std::cout << "Saving triangle mesh to file :" << filename  << std::endl;
   }
-  std::vector<se::Triangle> mesh;
-  VoxelImpl::dumpMesh(*map_, mesh);
-  if (str_utils::ends_with(filename, ".ply")) {
-    save_mesh_ply(mesh, filename.c_str(), se::math::to_inverse_transformation(this->T_MW_));
+  TICK("extractMesh")
+  se::IndexedMesh mesh;
+  if (min_scale > 0) {
+    VoxelImpl::dumpMesh(*map_, mesh, min_scale);
   } else {
-    save_mesh_vtk(mesh, filename.c_str(), se::math::to_inverse_transformation(this->T_MW_));
+    updateMesh().mesh(mesh);
+  }
+  TOCK("extractMesh")
+  TICK("saveMesh")
+  const auto save_start = std::chrono::steady_clock::now();
+  const Eigen::Matrix4f T_WM = se::math::to_inverse_transformation(this->T_MW_);
+  const bool ply = str_utils::ends_with(filename, ".ply");
+  size_t file_size = 0;
+  int status;
+  if (binary) {
+    status = ply ? save_mesh_ply_binary(mesh, filename, T_WM, nullptr, nullptr, &file_size)
+                 : save_mesh_vtk_binary(mesh, filename, T_WM, nullptr, nullptr, &file_size);
+  } else {
+    status = ply ? save_mesh_ply(mesh, filename, T_WM, nullptr, nullptr, &file_size)
+                 : save_mesh_vtk(mesh, filename, T_WM, nullptr, nullptr, &file_size);
+  }
+  const std::chrono::duration<double> save_time = std::chrono::steady_clock::now() - save_start;
+  TOCK("saveMesh")
+  if (status != 0) {
+    TOCK("dumpMesh")
+    return status;
+  }
+  const double file_size_mb = file_size / 1024.0 / 1024.0;
+  se::perfstats.sample("mesh_triangles", mesh.numTriangles(), PerfStats::COUNT);
+  se::perfstats.sample("mesh_vertices", mesh.vertexes.size(), PerfStats::COUNT);
+  se::perfstats.sample("mesh_size", file_size_mb, PerfStats::MEMORY);
+  // The mesh write throughput in MB/s.
+  se::perfstats.sample("mesh_save_rate", file_size_mb / save_time.count(), PerfStats::DOUBLE);
+  if (print_path) {
+    std::cout << "Saved " << mesh.numTriangles() << " triangles and "
+        << mesh.vertexes.size() << " vertices (" << file_size_mb << " MB, "
+        << file_size_mb / save_time.count() << " MB/s)" << std::endl;
   }
   TOCK("dumpMesh")
+  return 0;
+}
+
+
+
+const se::MeshCache<VoxelImpl::VoxelType>& DenseSLAMSystem::updateMesh() {
+
+  TICK("updateMesh")
+  flushIntegration();
+  const size_t num_meshed_blocks = mesh_cache_.update(*map_, VoxelImpl::dumpBlockMesh);
+  se::perfstats.sample("meshed_blocks", num_meshed_blocks, PerfStats::COUNT);
+  TOCK("updateMesh")
+  return mesh_cache_;
 }
 
 
@@ -336,6 +559,7 @@ void DenseSLAMSystem::dumpMesh(const std::string filename, const bool print_path
 void DenseSLAMSystem::saveStructure(const std::string base_filename) {
 
   TICK("saveStructure")
+  flushIntegration();
   std::stringstream f_s;
   f_s << base_filename << ".ply";
   se::save_octree_structure_ply(*map_, f_s.str().c_str());
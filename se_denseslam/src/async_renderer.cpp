@@ -0,0 +1,177 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "se/async_renderer.hpp"
+
+#include <algorithm>
+
+#include "se/constant_parameters.h"
+#include "se/perfstats.h"
+#include "se/rendering.hpp"
+
+
+
+se::AsyncRenderer::Inputs::Inputs(const Eigen::Vector2i& image_res)
+  : rgba_image(image_res.x(), image_res.y(), 0),
+    depth_image(image_res.x(), image_res.y(), 0.f),
+    tracking_result(image_res.prod(), TrackData()),
+    surface_point_cloud_M(image_res.x(), image_res.y(), Eigen::Vector3f::Zero()),
+    surface_normals_M(image_res.x(), image_res.y(), Eigen::Vector3f::Zero()),
+    surface_scale_image(image_res.x(), image_res.y(), 0),
+    raycast_T_MC(Eigen::Matrix4f::Identity()),
+    render_T_MC(Eigen::Matrix4f::Identity()),
+    render_volume(false) {
+}
+
+
+
+se::AsyncRenderer::Outputs::Outputs(const size_t num_pixels)
+  : rgba_render(num_pixels, 0),
+    depth_render(num_pixels, 0),
+    track_render(num_pixels, 0),
+    volume_render(num_pixels, 0) {
+}
+
+
+
+se::AsyncRenderer::AsyncRenderer(const Eigen::Vector2i&      image_res,
+                                 std::shared_ptr<OctreeType> map,
+                                 std::mutex&                 map_mutex)
+  : image_res_(image_res),
+    map_(map),
+    map_mutex_(map_mutex),
+    inputs_(image_res),
+    outputs_{{Outputs(image_res.prod()), Outputs(image_res.prod())}},
+    front_idx_(0),
+    num_renders_(0),
+    num_skipped_volume_renders_(0),
+    busy_(false),
+    stop_(false) {
+  thread_ = std::thread(&AsyncRenderer::run, this);
+}
+
+
+
+se::AsyncRenderer::~AsyncRenderer() {
+  {
+    std::unique_lock<std::mutex> lock (request_mutex_);
+    done_cv_.wait(lock, [this]{ return !busy_; });
+    stop_ = true;
+  }
+  request_cv_.notify_one();
+  thread_.join();
+}
+
+
+
+bool se::AsyncRenderer::request(const SensorImpl& sensor) {
+  {
+    std::lock_guard<std::mutex> lock (request_mutex_);
+    if (busy_) {
+      return false;
+    }
+    sensor_.reset(new SensorImpl(sensor));
+    busy_ = true;
+  }
+  request_cv_.notify_one();
+  return true;
+}
+
+
+
+void se::AsyncRenderer::wait() {
+  std::unique_lock<std::mutex> lock (request_mutex_);
+  done_cv_.wait(lock, [this]{ return !busy_; });
+}
+
+
+
+size_t se::AsyncRenderer::copyOutputs(uint32_t* rgba_render,
+                                      uint32_t* depth_render,
+                                      uint32_t* track_render,
+                                      uint32_t* volume_render) {
+  std::lock_guard<std::mutex> lock (output_mutex_);
+  if (num_renders_ == 0) {
+    return 0;
+  }
+  const Outputs& front = outputs_[front_idx_];
+  if (rgba_render) {
+    std::copy(front.rgba_render.begin(), front.rgba_render.end(), rgba_render);
+  }
+  if (depth_render) {
+    std::copy(front.depth_render.begin(), front.depth_render.end(), depth_render);
+  }
+  if (track_render) {
+    std::copy(front.track_render.begin(), front.track_render.end(), track_render);
+  }
+  if (volume_render) {
+    std::copy(front.volume_render.begin(), front.volume_render.end(), volume_render);
+  }
+  return num_renders_;
+}
+
+
+
+void se::AsyncRenderer::run() {
+  // The kernel timings of this thread would interleave with the ones of the
+  // pipeline thread.
+  se::perfstats.enableThreadSampling(false);
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock (request_mutex_);
+      request_cv_.wait(lock, [this]{ return busy_ || stop_; });
+      if (stop_) {
+        return;
+      }
+    }
+
+    // Only this thread swaps the buffers so the front one can be read
+    // without locking.
+    const int back_idx = 1 - front_idx_;
+    render(outputs_[back_idx], outputs_[front_idx_]);
+    {
+      std::lock_guard<std::mutex> lock (output_mutex_);
+      front_idx_ = back_idx;
+      num_renders_++;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock (request_mutex_);
+      busy_ = false;
+    }
+    done_cv_.notify_all();
+  }
+}
+
+
+
+void se::AsyncRenderer::render(Outputs& outputs, const Outputs& previous_outputs) {
+  renderRGBAKernel(outputs.rgba_render.data(), image_res_, inputs_.rgba_image);
+  renderDepthKernel(outputs.depth_render.data(), inputs_.depth_image.data(), image_res_,
+      sensor_->near_plane, sensor_->far_plane);
+  renderTrackKernel(outputs.track_render.data(), inputs_.tracking_result.data(), image_res_);
+
+  if (!inputs_.render_volume) {
+    // Keep showing the latest volume render.
+    outputs.volume_render = previous_outputs.volume_render;
+    return;
+  }
+  if (!inputs_.render_T_MC.isApprox(inputs_.raycast_T_MC)) {
+    // Raycast the map from the render viewpoint. The surface buffers of the
+    // inputs are overwritten, they are copied again on the next request. Never
+    // wait for the pipeline to finish modifying the map, keep showing the
+    // latest volume render instead.
+    std::unique_lock<std::mutex> lock (map_mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      outputs.volume_render = previous_outputs.volume_render;
+      num_skipped_volume_renders_++;
+      return;
+    }
+    raycastKernel<VoxelImpl>(*map_, inputs_.surface_point_cloud_M, inputs_.surface_normals_M,
+        inputs_.surface_scale_image, inputs_.render_T_MC, *sensor_);
+  }
+  renderVolumeKernel<VoxelImpl>(outputs.volume_render.data(), image_res_,
+      se::math::to_translation(inputs_.render_T_MC), ambient,
+      inputs_.surface_point_cloud_M, inputs_.surface_normals_M, inputs_.surface_scale_image);
+}
+
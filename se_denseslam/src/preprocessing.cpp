@@ -37,57 +37,128 @@
 #include "se/preprocessing.hpp"
 
 #include <cassert>
+#include <type_traits>
 
 #include "se/image_utils.hpp"
 
 
 
+namespace {
+  /**
+   * The bilateral filter range weight exp(-u) for u = (d - d_centre)^2 /
+   * (2 e_d^2), tabulated for u in [0, max_u] and linearly interpolated. The
+   * weight is treated as 0 above max_u where it's below 1e-7.
+   */
+  class RangeWeightLUT {
+    public:
+      RangeWeightLUT(const float e_d)
+        : scale_(size / (max_u * 2.f * e_d * e_d)) {
+        for (int i = 0; i <= size; ++i) {
+          table_[i] = expf(-max_u * i / size);
+        }
+        // Allow reading the entry after the last valid index.
+        table_[size + 1] = 0.f;
+      }
+
+      float operator()(const float depth_diff) const {
+        const float u = depth_diff * depth_diff * scale_;
+        if (u >= size) {
+          return 0.f;
+        }
+        const int i = static_cast<int>(u);
+        const float t = u - i;
+        return table_[i] + t * (table_[i + 1] - table_[i]);
+      }
+
+    private:
+      static constexpr int size = 2048;
+      static constexpr float max_u = 16.f;
+      const float scale_;
+      float table_[size + 2];
+  };
+
+
+
+  /**
+   * Filter the pixel (x, y). Neighbours outside the image are clamped to its
+   * edges only when Clamp is true, i.e. for pixels closer than radius to the
+   * image border.
+   */
+  template <bool Clamp>
+  inline float bilateralFilterPixel(const se::Image<float>& input_image,
+                                    const int               x,
+                                    const int               y,
+                                    const float*            spatial_weights,
+                                    const RangeWeightLUT&   range_weight,
+                                    const int               radius) {
+
+    const int width = input_image.width();
+    const int height = input_image.height();
+    const float centre_value = input_image[x + y * width];
+    float factor_count = 0.0f;
+    float filter_value_sum = 0.0f;
+    for (int j = -radius; j <= radius; ++j) {
+      const int y_tmp = Clamp ? se::math::clamp(y + j, 0, height - 1) : y + j;
+      const float* row = input_image.data() + y_tmp * width;
+      const float* row_spatial_weights = spatial_weights + (j + radius) * (2 * radius + 1) + radius;
+      for (int i = -radius; i <= radius; ++i) {
+        const int x_tmp = Clamp ? se::math::clamp(x + i, 0, width - 1) : x + i;
+        const float pixel_value_tmp = row[x_tmp];
+        if (pixel_value_tmp > 0.f) {
+          const float factor = row_spatial_weights[i] * range_weight(pixel_value_tmp - centre_value);
+          filter_value_sum += factor * pixel_value_tmp;
+          factor_count += factor;
+        }
+      }
+    }
+    return filter_value_sum / factor_count;
+  }
+} // namespace
+
+
+
 void bilateralFilterKernel(se::Image<float>&         output_image,
                            const se::Image<float>&   input_image,
                            const std::vector<float>& gaussian,
                            const float               e_d,
                            const int                 radius) {
 
-  if ((input_image.width() != output_image.width()) ||
-       input_image.height() != output_image.height()) {
-    std::cerr << "input/output image sizes differ." << std::endl;
-    exit(1);
-  }
+  assert(input_image.width() == output_image.width());
+  assert(input_image.height() == output_image.height());
+  assert(gaussian.size() >= static_cast<size_t>(2 * radius + 1));
 
   TICKD("bilateralFilterKernel")
   const int width = input_image.width();
   const int height = input_image.height();
-  const float e_d_squared_2 = e_d * e_d * 2.f;
-#pragma omp parallel for
-  for (int y = 0; y < height; y++) {
-    for (int x = 0; x < width; x++) {
-      const unsigned int pixel_idx = x + y * width;
-      if (input_image[pixel_idx] == 0) {
-        output_image[pixel_idx] = 0;
-        continue;
-      }
-
-      float factor_count = 0.0f;
-      float filter_value_sum = 0.0f;
+  const RangeWeightLUT range_weight (e_d);
+  const int diameter = 2 * radius + 1;
+  std::vector<float> spatial_weights (diameter * diameter);
+  for (int j = 0; j < diameter; ++j) {
+    for (int i = 0; i < diameter; ++i) {
+      spatial_weights[i + j * diameter] = gaussian[i] * gaussian[j];
+    }
+  }
 
-      const float centre_value = input_image[pixel_idx];
+  // Filter the pixels in [x_begin, x_end) of row y.
+  auto filter_pixels = [&](const int y, const int x_begin, const int x_end, auto clamp) {
+    for (int x = x_begin; x < x_end; x++) {
+      const unsigned int pixel_idx = x + y * width;
+      output_image[pixel_idx] = (input_image[pixel_idx] == 0) ? 0
+          : bilateralFilterPixel<decltype(clamp)::value>(input_image, x, y,
+              spatial_weights.data(), range_weight, radius);
+    }
+  };
 
-      for (int i = -radius; i <= radius; ++i) {
-        for (int j = -radius; j <= radius; ++j) {
-          const Eigen::Vector2i pixel_tmp = Eigen::Vector2i(
-              se::math::clamp(x + i, 0, width  - 1),
-              se::math::clamp(y + j, 0, height - 1));
-          const float pixel_value_tmp = input_image[pixel_tmp.x() + pixel_tmp.y() * width];
-          if (pixel_value_tmp > 0.f) {
-            const float mod = se::math::sq(pixel_value_tmp - centre_value);
-            const float factor = gaussian[i + radius]
-                * gaussian[j + radius] * expf(-mod / e_d_squared_2);
-            filter_value_sum += factor * pixel_value_tmp;
-            factor_count += factor;
-          }
-        }
-      }
-      output_image[pixel_idx] = filter_value_sum / factor_count;
+#pragma omp parallel for
+  for (int y = 0; y < height; y++) {
+    if ((y < radius) || (y >= height - radius) || (width <= 2 * radius)) {
+      filter_pixels(y, 0, width, std::true_type());
+    } else {
+      // Only the pixels closer than radius to the left and right borders
+      // need their neighbours clamped.
+      filter_pixels(y, 0, radius, std::true_type());
+      filter_pixels(y, radius, width - radius, std::false_type());
+      filter_pixels(y, width - radius, width, std::true_type());
     }
   }
   TOCK("bilateralFilterKernel");
@@ -191,50 +262,83 @@ void pointCloudToNormalKernel(se::Image<Eigen::Vector3f>&       normals,
 
 
 
-void downsampleDepthKernel(const float*           input_depth_data,
-                           const Eigen::Vector2i& input_depth_res,
-                           se::Image<float>&      output_depth) {
-  TICKD("downsampleDepthKernel")
-  // Check for unsupported conditions
-  if ((input_depth_res.x() < output_depth.width()) ||
-       input_depth_res.y() < output_depth.height()) {
-    std::cerr << "Invalid ratio." << std::endl;
-    exit(1);
+namespace {
+  // Only consider positive, non-NaN values for the median
+  inline bool isValidDepth(const float depth_value) {
+    return !((depth_value < 1e-5) || std::isnan(depth_value));
   }
-  if ((input_depth_res.x() % output_depth.width() != 0) ||
-      (input_depth_res.y() % output_depth.height() != 0)) {
-    std::cerr << "Invalid ratio." << std::endl;
-    exit(1);
-  }
-  if ((input_depth_res.x() / output_depth.width() !=
-       input_depth_res.y() / output_depth.height())) {
-    std::cerr << "Invalid ratio." << std::endl;
-    exit(1);
+
+  inline bool isValidDepth(const uint16_t depth_value) {
+    return depth_value > 0;
   }
 
-  const int ratio = input_depth_res.x() / output_depth.width();
-#pragma omp parallel for
-  for (int y_out = 0; y_out < output_depth.height(); y_out++) {
-    for (int x_out = 0; x_out < output_depth.width(); x_out++) {
-      std::vector<float> box_values;
+
+
+  template <typename DepthT>
+  void downsampleDepth(const DepthT*          input_depth_data,
+                       const Eigen::Vector2i& input_depth_res,
+                       const float            depth_scale,
+                       se::Image<float>&      output_depth) {
+    // Check for correct image sizes.
+    assert((input_depth_res.x() >= output_depth.width())
+        && "Error: input width must be greater than output width");
+    assert((input_depth_res.y() >= output_depth.height())
+        && "Error: input height must be greater than output height");
+    assert((input_depth_res.x() % output_depth.width() == 0)
+        && "Error: input width must be an integer multiple of output width");
+    assert((input_depth_res.y() % output_depth.height() == 0)
+        && "Error: input height must be an integer multiple of output height");
+    assert((input_depth_res.x() / output_depth.width()
+        == input_depth_res.y() / output_depth.height())
+        && "Error: input and output width and height ratios must be the same");
+
+    const int ratio = input_depth_res.x() / output_depth.width();
+#pragma omp parallel
+    {
+      // Scaling preserves the order of the values so the median can be
+      // computed before scaling.
+      std::vector<DepthT> box_values;
       box_values.reserve(ratio * ratio);
-      for (int b = 0; b < ratio; b++) {
-        for (int a = 0; a < ratio; a++) {
-          const int y_in = y_out * ratio + b;
-          const int x_in = x_out * ratio + a;
-          const float depth_value = input_depth_data[x_in + input_depth_res.x() * y_in];
-          // Only consider positive, non-NaN values for the median
-          if ((depth_value < 1e-5) || std::isnan(depth_value)) {
-            continue;
-          } else {
-            box_values.push_back(depth_value);
+#pragma omp for
+      for (int y_out = 0; y_out < output_depth.height(); y_out++) {
+        for (int x_out = 0; x_out < output_depth.width(); x_out++) {
+          for (int b = 0; b < ratio; b++) {
+            for (int a = 0; a < ratio; a++) {
+              const int y_in = y_out * ratio + b;
+              const int x_in = x_out * ratio + a;
+              const DepthT depth_value = input_depth_data[x_in + input_depth_res.x() * y_in];
+              if (isValidDepth(depth_value)) {
+                box_values.push_back(depth_value);
+              }
+            }
           }
+          output_depth(x_out, y_out) = box_values.empty()
+              ? 0.0f : depth_scale * se::math::almost_median(box_values);
+          box_values.clear();
         }
       }
-      output_depth(x_out, y_out) = box_values.empty() ? 0.0f : se::math::almost_median(box_values);
-      box_values.clear();
     }
   }
+} // namespace
+
+
+
+void downsampleDepthKernel(const float*           input_depth_data,
+                           const Eigen::Vector2i& input_depth_res,
+                           se::Image<float>&      output_depth) {
+  TICKD("downsampleDepthKernel")
+  downsampleDepth(input_depth_data, input_depth_res, 1.f, output_depth);
+  TOCK("downsampleDepthKernel");
+}
+
+
+
+void downsampleDepthKernel(const uint16_t*        input_depth_data,
+                           const Eigen::Vector2i& input_depth_res,
+                           const float            depth_scale,
+                           se::Image<float>&      output_depth) {
+  TICKD("downsampleDepthKernel")
+  downsampleDepth(input_depth_data, input_depth_res, depth_scale, output_depth);
   TOCK("downsampleDepthKernel");
 }
 
@@ -282,6 +386,139 @@ void halfSampleRobustImageKernel(se::Image<float>&       output_image,
 
 
 
+template <bool NegY>
+static void depthPyramidLevel(const se::Image<float>&     depth_image,
+                              se::Image<Eigen::Vector3f>& point_cloud_C,
+                              se::Image<Eigen::Vector3f>& normals_C,
+                              se::Image<float>*           half_depth_image,
+                              const SensorImpl&           sensor,
+                              const float                 e_d) {
+
+  const int width = depth_image.width();
+  const int height = depth_image.height();
+  // The image is processed in bands of rows. The points of each band and of
+  // the rows just above and below it are computed into a buffer small enough
+  // to stay in cache while the normals are computed from it.
+  constexpr int band_height = 16;
+  const int num_bands = (height + band_height - 1) / band_height;
+  std::vector<Eigen::Vector3f> band_points ((band_height + 2) * width);
+
+#pragma omp for
+  for (int band_idx = 0; band_idx < num_bands; band_idx++) {
+    const int y_begin = band_idx * band_height;
+    const int y_end = std::min(y_begin + band_height, height);
+    const int buffer_y_begin = std::max(y_begin - 1, 0);
+    const int buffer_y_end = std::min(y_end + 1, height);
+
+    // Same as depthToPointCloudKernel().
+    for (int y = buffer_y_begin; y < buffer_y_end; y++) {
+      for (int x = 0; x < width; x++) {
+        const float depth = depth_image[x + y * width];
+        Eigen::Vector3f& point = band_points[x + (y - buffer_y_begin) * width];
+        if (depth > 0) {
+          Eigen::Vector3f ray_dir_C;
+          sensor.model.backProject(Eigen::Vector2i(x, y).cast<float>(), &ray_dir_C);
+          point = depth * ray_dir_C;
+        } else {
+          point = Eigen::Vector3f::Zero();
+        }
+      }
+    }
+    auto point_at = [&](const int x, const int y) -> const Eigen::Vector3f& {
+      return band_points[x + (y - buffer_y_begin) * width];
+    };
+
+    // Same as pointCloudToNormalKernel().
+    for (int y = y_begin; y < y_end; y++) {
+      const int y_prev = std::max(y - 1, 0);
+      const int y_next = std::min(y + 1, height - 1);
+      const int y_up   = NegY ? y_prev : y_next;
+      const int y_down = NegY ? y_next : y_prev;
+      for (int x = 0; x < width; x++) {
+        const Eigen::Vector3f& point = point_at(x, y);
+        point_cloud_C[x + y * width] = point;
+        if (point.z() == 0.f) {
+          normals_C[x + y * width].x() = INVALID;
+          continue;
+        }
+        const Eigen::Vector3f& left  = point_at(std::max(x - 1, 0), y);
+        const Eigen::Vector3f& right = point_at(std::min(x + 1, width - 1), y);
+        const Eigen::Vector3f& up    = point_at(x, y_up);
+        const Eigen::Vector3f& down  = point_at(x, y_down);
+        if (left.z() == 0 || right.z() == 0 || up.z() == 0 || down.z() == 0) {
+          normals_C[x + y * width].x() = INVALID;
+          continue;
+        }
+        const Eigen::Vector3f dv_x = right - left;
+        const Eigen::Vector3f dv_y = up - down;
+        normals_C[x + y * width] = dv_x.cross(dv_y).normalized();
+      }
+    }
+
+    // Same as halfSampleRobustImageKernel() with a radius of 1. The band
+    // height is even so each output row only depends on rows of this band.
+    if (half_depth_image) {
+      const int half_width = half_depth_image->width();
+      const int half_y_end = std::min((y_end + 1) / 2, half_depth_image->height());
+      for (int y = y_begin / 2; y < half_y_end; y++) {
+        const int y_in = 2 * y;
+        const int y_in_next = std::min(y_in + 1, 2 * half_depth_image->height() - 1);
+        for (int x = 0; x < half_width; x++) {
+          const int x_in = 2 * x;
+          const int x_in_next = std::min(x_in + 1, 2 * half_width - 1);
+          const float in_pixel_value = depth_image[x_in + y_in * width];
+          const float in_pixel_values[4] = {
+            depth_image[x_in      + y_in      * width],
+            depth_image[x_in_next + y_in      * width],
+            depth_image[x_in      + y_in_next * width],
+            depth_image[x_in_next + y_in_next * width]};
+          float pixel_count = 0.0f;
+          float pixel_value_sum = 0.0f;
+          for (const float in_pixel_value_tmp : in_pixel_values) {
+            if (fabsf(in_pixel_value_tmp - in_pixel_value) < e_d) {
+              pixel_count += 1.0f;
+              pixel_value_sum += in_pixel_value_tmp;
+            }
+          }
+          (*half_depth_image)[x + y * half_width] = pixel_value_sum / pixel_count;
+        }
+      }
+    }
+  }
+}
+
+
+
+void depthPyramidKernel(std::vector<se::Image<float> >&           depth_pyramid,
+                        std::vector<se::Image<Eigen::Vector3f> >& point_cloud_pyramid,
+                        std::vector<se::Image<Eigen::Vector3f> >& normals_pyramid,
+                        const SensorImpl&                         sensor,
+                        const float                               e_d) {
+
+  assert(point_cloud_pyramid.size() >= depth_pyramid.size());
+  assert(normals_pyramid.size() >= depth_pyramid.size());
+  TICKD("depthPyramidKernel");
+  const int num_levels = depth_pyramid.size();
+  // A single parallel region for all levels, the implicit barrier at the end
+  // of each level ensures the next depth level is complete before it's used.
+#pragma omp parallel
+  for (int level = 0; level < num_levels; ++level) {
+    const SensorImpl scaled_sensor(sensor, 1.f / (1 << level));
+    se::Image<float>* half_depth_image = (level + 1 < num_levels)
+        ? &depth_pyramid[level + 1] : nullptr;
+    if (sensor.left_hand_frame) {
+      depthPyramidLevel<true>(depth_pyramid[level], point_cloud_pyramid[level],
+          normals_pyramid[level], half_depth_image, scaled_sensor, e_d);
+    } else {
+      depthPyramidLevel<false>(depth_pyramid[level], point_cloud_pyramid[level],
+          normals_pyramid[level], half_depth_image, scaled_sensor, e_d);
+    }
+  }
+  TOCK("depthPyramidKernel");
+}
+
+
+
 void downsampleImageKernel(const uint32_t*        input_RGBA_image_data,
                            const Eigen::Vector2i& input_RGBA_image_res,
                            se::Image<uint32_t>&   output_RGBA_image) {
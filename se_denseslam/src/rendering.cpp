@@ -42,6 +42,42 @@
 
 
 
+void predictRaycastKernel(se::Image<float>&                 predicted_t_image,
+                          const se::Image<Eigen::Vector3f>& surface_point_cloud_M,
+                          const se::Image<Eigen::Vector3f>& surface_normals_M,
+                          const Eigen::Matrix4f&            T_MC,
+                          const SensorImpl&                 sensor) {
+
+  TICKD("predictRaycastKernel");
+  for (size_t i = 0; i < predicted_t_image.size(); ++i) {
+    predicted_t_image[i] = 0.f;
+  }
+  const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MC);
+  // Not parallelized since several points may be projected onto the same
+  // pixel.
+  for (size_t i = 0; i < surface_point_cloud_M.size(); ++i) {
+    const Eigen::Vector3f& surface_normal_M = surface_normals_M[i];
+    if (surface_normal_M.x() == INVALID || surface_normal_M.isZero()) {
+      continue;
+    }
+    const Eigen::Vector3f point_C = (T_CM * surface_point_cloud_M[i].homogeneous()).head<3>();
+    Eigen::Vector2f pixel_f;
+    if (sensor.model.project(point_C, &pixel_f) != srl::projection::ProjectionStatus::Successful) {
+      continue;
+    }
+    const Eigen::Vector2i pixel = se::round_pixel(pixel_f);
+    // Keep the point closest to the camera.
+    float& predicted_t = predicted_t_image(pixel.x(), pixel.y());
+    const float t = point_C.norm();
+    if (predicted_t == 0.f || t < predicted_t) {
+      predicted_t = t;
+    }
+  }
+  TOCK("predictRaycastKernel");
+}
+
+
+
 void renderRGBAKernel(uint32_t*                  output_RGBA_image_data,
                       const Eigen::Vector2i&     output_RGBA_image_res,
                       const se::Image<uint32_t>& input_RGBA_image) {
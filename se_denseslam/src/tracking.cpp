@@ -238,6 +238,79 @@ void reduceKernel(float*                 output_data,
 
 
 
+/**
+ * Compute the ICP residual and Jacobian of a single input pixel, see
+ * trackKernel() for the meaning of the parameters.
+ */
+static inline void trackPixel(TrackData&                        row,
+                              const Eigen::Vector2i&            pixel,
+                              const Eigen::Vector2i&            input_res,
+                              const se::Image<Eigen::Vector3f>& input_point_cloud_C,
+                              const se::Image<Eigen::Vector3f>& input_normals_C,
+                              const se::Image<Eigen::Vector3f>& surface_point_cloud_M_ref,
+                              const se::Image<Eigen::Vector3f>& surface_normals_M_ref,
+                              const Eigen::Vector2i&            ref_res,
+                              const Eigen::Matrix4f&            T_MC,
+                              const Eigen::Matrix4f&            T_C_refM,
+                              const SensorImpl&                 sensor,
+                              const float                       dist_threshold,
+                              const float                       normal_threshold) {
+
+  if (input_normals_C[pixel.x() + pixel.y() * input_res.x()].x() == INVALID) {
+    row.result = -1;
+    return;
+  }
+
+  // point_M := The input point in map frame
+  const Eigen::Vector3f point_M = (T_MC *
+      input_point_cloud_C[pixel.x() + pixel.y() * input_res.x()].homogeneous()).head<3>();
+  // point_C_ref := The input point expressed in the camera frame the
+  // surface_point_cloud_M_ref and surface_point_cloud_M_ref was raycasted from.
+  const Eigen::Vector3f point_C_ref = (T_C_refM * point_M.homogeneous()).head<3>();
+
+  // ref_pixel_f := The pixel in the surface_point_cloud_M_ref and surface_point_cloud_M_ref image.
+  Eigen::Vector2f ref_pixel_f;
+  if (sensor.model.project(point_C_ref, &ref_pixel_f) != srl::projection::ProjectionStatus::Successful) {
+    row.result = -2;
+    return;
+  }
+
+  const Eigen::Vector2i ref_pixel = se::round_pixel(ref_pixel_f);
+  const Eigen::Vector3f ref_normal_M
+      = surface_normals_M_ref[ref_pixel.x() + ref_pixel.y() * ref_res.x()];
+
+  if (ref_normal_M.x() == INVALID) {
+    row.result = -3;
+    return;
+  }
+
+  const Eigen::Vector3f diff = surface_point_cloud_M_ref[ref_pixel.x() + ref_pixel.y() * ref_res.x()]
+      - point_M;
+  const Eigen::Vector3f input_normal_M = T_MC.topLeftCorner<3, 3>()
+      * input_normals_C[pixel.x() + pixel.y() * input_res.x()];
+
+  if (diff.norm() > dist_threshold) {
+    row.result = -4;
+    return;
+  }
+  if (input_normal_M.dot(ref_normal_M) < normal_threshold) {
+    row.result = -5;
+    return;
+  }
+  row.result = 1;
+  row.error = ref_normal_M.dot(diff);
+  row.J[0] = ref_normal_M.x();
+  row.J[1] = ref_normal_M.y();
+  row.J[2] = ref_normal_M.z();
+
+  const Eigen::Vector3f cross_prod = point_M.cross(ref_normal_M);
+  row.J[3] = cross_prod.x();
+  row.J[4] = cross_prod.y();
+  row.J[5] = cross_prod.z();
+}
+
+
+
 void trackKernel(TrackData*                        output_data,
                  const se::Image<Eigen::Vector3f>& input_point_cloud_C,
                  const se::Image<Eigen::Vector3f>& input_normals_C,
@@ -252,68 +325,46 @@ void trackKernel(TrackData*                        output_data,
   TICKD("trackKernel");
   const Eigen::Vector2i input_res( input_point_cloud_C.width(),  input_point_cloud_C.height());
   const Eigen::Vector2i ref_res(surface_point_cloud_M_ref.width(), surface_point_cloud_M_ref.height());
+  const Eigen::Matrix4f T_C_refM = T_MC_ref.inverse();
 
 #pragma omp parallel for
   for (int y = 0; y < input_res.y(); y++) {
     for (int x = 0; x < input_res.x(); x++) {
       const Eigen::Vector2i pixel(x, y);
+      trackPixel(output_data[pixel.x() + pixel.y() * ref_res.x()], pixel, input_res,
+          input_point_cloud_C, input_normals_C, surface_point_cloud_M_ref, surface_normals_M_ref,
+          ref_res, T_MC, T_C_refM, sensor, dist_threshold, normal_threshold);
+    }
+  }
+  TOCK("trackKernel");
+}
 
-      TrackData& row = output_data[pixel.x() + pixel.y() * ref_res.x()];
-
-      if (input_normals_C[pixel.x() + pixel.y() * input_res.x()].x() == INVALID) {
-        row.result = -1;
-        continue;
-      }
-
-      // point_M := The input point in map frame
-      const Eigen::Vector3f point_M = (T_MC *
-          input_point_cloud_C[pixel.x() + pixel.y() * input_res.x()].homogeneous()).head<3>();
-      // point_C_ref := The input point expressed in the camera frame the
-      // surface_point_cloud_M_ref and surface_point_cloud_M_ref was raycasted from.
-      const Eigen::Vector3f point_C_ref = (T_MC_ref.inverse() * point_M.homogeneous()).head<3>();
-
-      // ref_pixel_f := The pixel in the surface_point_cloud_M_ref and surface_point_cloud_M_ref image.
-      Eigen::Vector2f ref_pixel_f;
-      if (sensor.model.project(point_C_ref, &ref_pixel_f) != srl::projection::ProjectionStatus::Successful) {
-        row.result = -2;
-        continue;
-      }
-
-      const Eigen::Vector2i ref_pixel = se::round_pixel(ref_pixel_f);
-      const Eigen::Vector3f ref_normal_M
-          = surface_normals_M_ref[ref_pixel.x() + ref_pixel.y() * ref_res.x()];
 
-      if (ref_normal_M.x() == INVALID) {
-        row.result = -3;
-        continue;
-      }
 
-      const Eigen::Vector3f diff = surface_point_cloud_M_ref[ref_pixel.x() + ref_pixel.y() * ref_res.x()]
-          - point_M;
-      const Eigen::Vector3f input_normal_M = T_MC.topLeftCorner<3, 3>()
-          * input_normals_C[pixel.x() + pixel.y() * input_res.x()];
+void trackReduceKernel(float*                            output_data,
+                       TrackData*                        tracking_result,
+                       const se::Image<Eigen::Vector3f>& input_point_cloud_C,
+                       const se::Image<Eigen::Vector3f>& input_normals_C,
+                       const se::Image<Eigen::Vector3f>& surface_point_cloud_M_ref,
+                       const se::Image<Eigen::Vector3f>& surface_normals_M_ref,
+                       const Eigen::Matrix4f&            T_MC,
+                       const Eigen::Matrix4f&            T_MC_ref,
+                       const SensorImpl&                 sensor,
+                       const float                       dist_threshold,
+                       const float                       normal_threshold) {
 
-      if (diff.norm() > dist_threshold) {
-        row.result = -4;
-        continue;
-      }
-      if (input_normal_M.dot(ref_normal_M) < normal_threshold) {
-        row.result = -5;
-        continue;
-      }
-      row.result = 1;
-      row.error = ref_normal_M.dot(diff);
-      row.J[0] = ref_normal_M.x();
-      row.J[1] = ref_normal_M.y();
-      row.J[2] = ref_normal_M.z();
-
-      const Eigen::Vector3f cross_prod = point_M.cross(ref_normal_M);
-      row.J[3] = cross_prod.x();
-      row.J[4] = cross_prod.y();
-      row.J[5] = cross_prod.z();
-    }
-  }
-  TOCK("trackKernel");
+  TICKD("trackReduceKernel");
+  const Eigen::Vector2i input_res( input_point_cloud_C.width(),  input_point_cloud_C.height());
+  const Eigen::Vector2i ref_res(surface_point_cloud_M_ref.width(), surface_point_cloud_M_ref.height());
+  const Eigen::Matrix4f T_C_refM = T_MC_ref.inverse();
+
+  se::internal::reduceTrackData(output_data, tracking_result, input_res, ref_res.x(),
+      [&](TrackData& row, const Eigen::Vector2i& pixel) {
+        trackPixel(row, pixel, input_res,
+            input_point_cloud_C, input_normals_C, surface_point_cloud_M_ref, surface_normals_M_ref,
+            ref_res, T_MC, T_C_refM, sensor, dist_threshold, normal_threshold);
+      });
+  TOCK("trackReduceKernel");
 }
 
 
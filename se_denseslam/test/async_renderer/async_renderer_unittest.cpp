@@ -0,0 +1,175 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "se/async_renderer.hpp"
+#include "se/constant_parameters.h"
+#include "se/rendering.hpp"
+
+#define FRAMES 5
+
+
+
+// A camera looking at a flat wall parallel to its image plane.
+class AsyncRendererTest : public ::testing::Test {
+  protected:
+    AsyncRendererTest() :
+      image_res_(64, 48),
+      depth_image_(image_res_.x(), image_res_.y(), wall_depth_),
+      rgba_image_(image_res_.x(), image_res_.y()),
+      tracking_result_(image_res_.prod()),
+      sensor_({image_res_.x(), image_res_.y(), false,
+               0.1f, 4.f,
+               50.f, 50.f, image_res_.x() / 2.f, image_res_.y() / 2.f,
+               Eigen::VectorXf(0), Eigen::VectorXf(0)}),
+      point_cloud_M_(image_res_.x(), image_res_.y()),
+      normals_M_(image_res_.x(), image_res_.y()),
+      scale_image_(image_res_.x(), image_res_.y()),
+      num_pixels_(image_res_.prod()) {
+    }
+
+    virtual void SetUp() {
+      const int size = 128;
+      const float dim = 2.56f;
+      VoxelImpl::configure(dim / size);
+      map_ = std::make_shared<VoxelImpl::OctreeType>();
+      map_->init(size, dim);
+
+      T_MC_ = Eigen::Matrix4f::Identity();
+      T_MC_.topRightCorner<3, 1>() = Eigen::Vector3f(1.28f, 1.28f, 0.3f);
+      const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MC_);
+      std::vector<se::key_t> allocation_list(map_->size() / VoxelImpl::VoxelBlockType::size_li
+          * image_res_.prod());
+      for (int frame = 0; frame < FRAMES; ++frame) {
+        const size_t num_voxel = VoxelImpl::buildAllocationList(*map_, depth_image_, T_MC_,
+            sensor_, allocation_list.data(), allocation_list.size());
+        map_->allocate(allocation_list.data(), num_voxel);
+        VoxelImpl::integrate(*map_, depth_image_, T_CM, sensor_, frame);
+      }
+      raycastKernel<VoxelImpl>(*map_, point_cloud_M_, normals_M_, scale_image_, T_MC_, sensor_);
+
+      for (size_t i = 0; i < num_pixels_; ++i) {
+        rgba_image_[i] = 0xFF000000 | (i * 2654435761u & 0x00FFFFFF);
+        tracking_result_[i].result = static_cast<int>(i % 7) - 5;
+      }
+      renderer_.reset(new se::AsyncRenderer(image_res_, map_, map_mutex_));
+    }
+
+    void setInputs(const Eigen::Matrix4f& render_T_MC) {
+      se::AsyncRenderer::Inputs& inputs = renderer_->inputs();
+      inputs.rgba_image = rgba_image_;
+      inputs.depth_image = depth_image_;
+      inputs.tracking_result = tracking_result_;
+      inputs.surface_point_cloud_M = point_cloud_M_;
+      inputs.surface_normals_M = normals_M_;
+      inputs.surface_scale_image = scale_image_;
+      inputs.raycast_T_MC = T_MC_;
+      inputs.render_T_MC = render_T_MC;
+      inputs.render_volume = true;
+    }
+
+    const float wall_depth_ = 1.5f;
+    Eigen::Vector2i image_res_;
+    se::Image<float> depth_image_;
+    se::Image<uint32_t> rgba_image_;
+    std::vector<TrackData> tracking_result_;
+    SensorImpl sensor_;
+    std::shared_ptr<VoxelImpl::OctreeType> map_;
+    std::mutex map_mutex_;
+    Eigen::Matrix4f T_MC_;
+    se::Image<Eigen::Vector3f> point_cloud_M_;
+    se::Image<Eigen::Vector3f> normals_M_;
+    se::Image<int> scale_image_;
+    const size_t num_pixels_;
+    std::unique_ptr<se::AsyncRenderer> renderer_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(AsyncRendererTest, MatchesSynchronousRender) {
+  std::vector<uint32_t> rgba_render (num_pixels_);
+  std::vector<uint32_t> depth_render (num_pixels_);
+  std::vector<uint32_t> track_render (num_pixels_);
+  std::vector<uint32_t> volume_render (num_pixels_);
+  EXPECT_EQ(renderer_->copyOutputs(rgba_render.data(), depth_render.data(),
+      track_render.data(), volume_render.data()), 0u);
+
+  setInputs(T_MC_);
+  ASSERT_TRUE(renderer_->request(sensor_));
+  renderer_->wait();
+  EXPECT_FALSE(renderer_->busy());
+  ASSERT_EQ(renderer_->copyOutputs(rgba_render.data(), depth_render.data(),
+      track_render.data(), volume_render.data()), 1u);
+
+  std::vector<uint32_t> expected_render (num_pixels_);
+  renderRGBAKernel(expected_render.data(), image_res_, rgba_image_);
+  EXPECT_EQ(rgba_render, expected_render);
+  renderDepthKernel(expected_render.data(), depth_image_.data(), image_res_,
+      sensor_.near_plane, sensor_.far_plane);
+  EXPECT_EQ(depth_render, expected_render);
+  renderTrackKernel(expected_render.data(), tracking_result_.data(), image_res_);
+  EXPECT_EQ(track_render, expected_render);
+  renderVolumeKernel<VoxelImpl>(expected_render.data(), image_res_,
+      se::math::to_translation(T_MC_), ambient, point_cloud_M_, normals_M_,
+      scale_image_);
+  EXPECT_EQ(volume_render, expected_render);
+
+  // The latest volume render is kept when the volume isn't rendered.
+  setInputs(T_MC_);
+  renderer_->inputs().render_volume = false;
+  renderer_->inputs().surface_normals_M = se::Image<Eigen::Vector3f>(image_res_.x(),
+      image_res_.y(), Eigen::Vector3f::Zero());
+  ASSERT_TRUE(renderer_->request(sensor_));
+  renderer_->wait();
+  std::vector<uint32_t> kept_volume_render (num_pixels_);
+  ASSERT_EQ(renderer_->copyOutputs(nullptr, nullptr, nullptr, kept_volume_render.data()), 2u);
+  EXPECT_EQ(kept_volume_render, volume_render);
+}
+
+
+
+TEST_F(AsyncRendererTest, SkipVolumeRenderWhileMapLocked) {
+  std::vector<uint32_t> volume_render (num_pixels_);
+  setInputs(T_MC_);
+  ASSERT_TRUE(renderer_->request(sensor_));
+  renderer_->wait();
+  ASSERT_EQ(renderer_->copyOutputs(nullptr, nullptr, nullptr, volume_render.data()), 1u);
+
+  // Rendering from another viewpoint raycasts the map. While the map is
+  // locked the render doesn't wait for it and keeps the previous volume render.
+  Eigen::Matrix4f render_T_MC = T_MC_;
+  render_T_MC.topRightCorner<3, 1>() += Eigen::Vector3f(0.1f, 0.f, 0.f);
+  std::unique_lock<std::mutex> map_lock (map_mutex_);
+  setInputs(render_T_MC);
+  ASSERT_TRUE(renderer_->request(sensor_));
+  renderer_->wait();
+  std::vector<uint32_t> kept_volume_render (num_pixels_);
+  ASSERT_EQ(renderer_->copyOutputs(nullptr, nullptr, nullptr, kept_volume_render.data()), 2u);
+  EXPECT_EQ(kept_volume_render, volume_render);
+  EXPECT_EQ(renderer_->numSkippedVolumeRenders(), 1u);
+  map_lock.unlock();
+
+  setInputs(render_T_MC);
+  ASSERT_TRUE(renderer_->request(sensor_));
+  renderer_->wait();
+  ASSERT_EQ(renderer_->copyOutputs(nullptr, nullptr, nullptr, volume_render.data()), 3u);
+  EXPECT_EQ(renderer_->numSkippedVolumeRenders(), 1u);
+
+  se::Image<Eigen::Vector3f> point_cloud_M (image_res_.x(), image_res_.y());
+  se::Image<Eigen::Vector3f> normals_M (image_res_.x(), image_res_.y());
+  se::Image<int> scale_image (image_res_.x(), image_res_.y());
+  raycastKernel<VoxelImpl>(*map_, point_cloud_M, normals_M, scale_image, render_T_MC, sensor_);
+  std::vector<uint32_t> expected_render (num_pixels_);
+  renderVolumeKernel<VoxelImpl>(expected_render.data(), image_res_,
+      se::math::to_translation(render_T_MC), ambient, point_cloud_M, normals_M,
+      scale_image);
+  EXPECT_EQ(volume_render, expected_render);
+}
@@ -28,8 +28,10 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cmath>
 #include <cstdint>
 #include <cstring>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <lodepng.h>
@@ -228,3 +230,174 @@ TEST(DownsampleDepthKernel, VariedImageQuarter) {
       desired_depth, Eigen::Vector2i(1, 1));
 }
 
+
+
+TEST(DownsampleDepthKernel, UInt16MatchesFloat) {
+  // Depth in millimetres with some invalid pixels.
+  const Eigen::Vector2i input_res (16, 12);
+  std::vector<uint16_t> input_depth_16 (input_res.prod());
+  std::vector<float> input_depth (input_res.prod());
+  for (size_t i = 0; i < input_depth_16.size(); ++i) {
+    input_depth_16[i] = (i % 7 == 0) ? 0 : 500 + (i * 2654435761u) % 3000;
+    input_depth[i] = input_depth_16[i] * 0.001f;
+  }
+  for (const int ratio : {1, 2, 4}) {
+    const Eigen::Vector2i output_res = input_res / ratio;
+    se::Image<float> output_depth (output_res.x(), output_res.y());
+    se::Image<float> expected_output_depth (output_res.x(), output_res.y());
+    downsampleDepthKernel(input_depth_16.data(), input_res, 0.001f, output_depth);
+    downsampleDepthKernel(input_depth.data(), input_res, expected_output_depth);
+    for (size_t i = 0; i < output_depth.size(); ++i) {
+      EXPECT_EQ(output_depth[i], expected_output_depth[i]);
+    }
+  }
+}
+
+
+
+
+void test_depth_pyramid_kernel(const bool left_hand_frame) {
+  const Eigen::Vector2i image_res (64, 48);
+  const SensorImpl sensor ({image_res.x(), image_res.y(), left_hand_frame,
+      0.1f, 4.f,
+      50.f, left_hand_frame ? -50.f : 50.f, image_res.x() / 2.f, image_res.y() / 2.f,
+      Eigen::VectorXf(0), Eigen::VectorXf(0)});
+  const int num_levels = 3;
+  const float e_d = 0.3f;
+
+  std::vector<se::Image<float> > depth_pyramid;
+  std::vector<se::Image<Eigen::Vector3f> > point_cloud_pyramid;
+  std::vector<se::Image<Eigen::Vector3f> > normals_pyramid;
+  for (int level = 0; level < num_levels; ++level) {
+    const Eigen::Vector2i level_res = image_res / (1 << level);
+    depth_pyramid.emplace_back(level_res.x(), level_res.y(), 0.f);
+    point_cloud_pyramid.emplace_back(level_res.x(), level_res.y());
+    normals_pyramid.emplace_back(level_res.x(), level_res.y());
+  }
+  // A wavy surface with a depth discontinuity and some invalid pixels.
+  for (int y = 0; y < image_res.y(); y++) {
+    for (int x = 0; x < image_res.x(); x++) {
+      depth_pyramid[0](x, y) = 1.5f + 0.1f * std::sin(x / 6.f) + ((x > 40) ? 1.f : 0.f);
+      if ((x * 7 + y * 3) % 23 == 0) {
+        depth_pyramid[0](x, y) = 0.f;
+      }
+    }
+  }
+  std::vector<se::Image<float> > expected_depth_pyramid = depth_pyramid;
+  std::vector<se::Image<Eigen::Vector3f> > expected_point_cloud_pyramid = point_cloud_pyramid;
+  std::vector<se::Image<Eigen::Vector3f> > expected_normals_pyramid = normals_pyramid;
+  for (int level = 0; level < num_levels; ++level) {
+    if (level > 0) {
+      halfSampleRobustImageKernel(expected_depth_pyramid[level],
+          expected_depth_pyramid[level - 1], e_d, 1);
+    }
+    const SensorImpl scaled_sensor (sensor, 1.f / (1 << level));
+    depthToPointCloudKernel(expected_point_cloud_pyramid[level], expected_depth_pyramid[level],
+        scaled_sensor);
+    if (left_hand_frame) {
+      pointCloudToNormalKernel<true>(expected_normals_pyramid[level],
+          expected_point_cloud_pyramid[level]);
+    } else {
+      pointCloudToNormalKernel<false>(expected_normals_pyramid[level],
+          expected_point_cloud_pyramid[level]);
+    }
+  }
+
+  depthPyramidKernel(depth_pyramid, point_cloud_pyramid, normals_pyramid, sensor, e_d);
+  for (int level = 0; level < num_levels; ++level) {
+    for (size_t i = 0; i < depth_pyramid[level].size(); ++i) {
+      EXPECT_EQ(depth_pyramid[level][i], expected_depth_pyramid[level][i]);
+      EXPECT_EQ(point_cloud_pyramid[level][i], expected_point_cloud_pyramid[level][i]);
+      if (expected_normals_pyramid[level][i].x() == INVALID) {
+        EXPECT_EQ(normals_pyramid[level][i].x(), INVALID);
+      } else {
+        EXPECT_EQ(normals_pyramid[level][i], expected_normals_pyramid[level][i]);
+      }
+    }
+  }
+}
+
+
+
+TEST(DepthPyramidKernel, MatchesSeparateKernels) {
+  test_depth_pyramid_kernel(false);
+}
+
+
+
+TEST(DepthPyramidKernel, MatchesSeparateKernelsLeftHandFrame) {
+  test_depth_pyramid_kernel(true);
+}
+
+
+
+
+// The direct evaluation of the bilateral filter used before the range
+// weights were tabulated.
+void reference_bilateral_filter(se::Image<float>&         output_image,
+                                const se::Image<float>&   input_image,
+                                const std::vector<float>& gaussian,
+                                const float               e_d,
+                                const int                 radius) {
+  const int width = input_image.width();
+  const int height = input_image.height();
+  const float e_d_squared_2 = e_d * e_d * 2.f;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      const int pixel_idx = x + y * width;
+      if (input_image[pixel_idx] == 0) {
+        output_image[pixel_idx] = 0;
+        continue;
+      }
+      float factor_count = 0.0f;
+      float filter_value_sum = 0.0f;
+      const float centre_value = input_image[pixel_idx];
+      for (int i = -radius; i <= radius; ++i) {
+        for (int j = -radius; j <= radius; ++j) {
+          const float pixel_value_tmp = input_image(se::math::clamp(x + i, 0, width - 1),
+              se::math::clamp(y + j, 0, height - 1));
+          if (pixel_value_tmp > 0.f) {
+            const float mod = se::math::sq(pixel_value_tmp - centre_value);
+            const float factor = gaussian[i + radius]
+                * gaussian[j + radius] * expf(-mod / e_d_squared_2);
+            filter_value_sum += factor * pixel_value_tmp;
+            factor_count += factor;
+          }
+        }
+      }
+      output_image[pixel_idx] = filter_value_sum / factor_count;
+    }
+  }
+}
+
+
+
+TEST(BilateralFilterKernel, MatchesReference) {
+  const int radius = 2;
+  const float e_d = 0.1f;
+  std::vector<float> gaussian (2 * radius + 1);
+  for (int i = 0; i < 2 * radius + 1; i++) {
+    const int x = i - radius;
+    gaussian[i] = expf(-(x * x) / (2 * 4.f * 4.f));
+  }
+  // A noisy wavy surface with depth discontinuities and invalid pixels.
+  se::Image<float> input_image (64, 48);
+  for (int y = 0; y < input_image.height(); y++) {
+    for (int x = 0; x < input_image.width(); x++) {
+      const float noise = 0.02f * (((x * 37 + y * 91) % 17) / 8.f - 1.f);
+      input_image(x, y) = 1.5f + 0.1f * std::sin(x / 6.f) + ((x > 40) ? 1.f : 0.f)
+          + ((y > 30) ? 0.15f : 0.f) + noise;
+      if ((x * 7 + y * 3) % 23 == 0) {
+        input_image(x, y) = 0.f;
+      }
+    }
+  }
+  se::Image<float> output_image (input_image.width(), input_image.height());
+  se::Image<float> expected_output_image (input_image.width(), input_image.height());
+  bilateralFilterKernel(output_image, input_image, gaussian, e_d, radius);
+  reference_bilateral_filter(expected_output_image, input_image, gaussian, e_d, radius);
+  for (size_t i = 0; i < output_image.size(); ++i) {
+    EXPECT_NEAR(output_image[i], expected_output_image[i], 1e-5f);
+  }
+}
+
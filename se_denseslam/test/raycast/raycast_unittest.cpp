@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "se/rendering.hpp"
+
+#define FRAMES 5
+
+
+
+// A camera looking at a flat wall parallel to its image plane.
+class RaycastTest : public ::testing::Test {
+  protected:
+    RaycastTest() :
+      image_res_(67, 45),
+      depth_image_(image_res_.x(), image_res_.y(), wall_depth_),
+      sensor_({image_res_.x(), image_res_.y(), false,
+               0.1f, 4.f,
+               50.f, 50.f, image_res_.x() / 2.f, image_res_.y() / 2.f,
+               Eigen::VectorXf(0), Eigen::VectorXf(0)}),
+      point_cloud_M_(image_res_.x(), image_res_.y(), Eigen::Vector3f::Constant(-1.f)),
+      normals_M_(image_res_.x(), image_res_.y(), Eigen::Vector3f::Constant(-1.f)),
+      scale_image_(image_res_.x(), image_res_.y(), -1) {
+    }
+
+    virtual void SetUp() {
+      const int size = 128;
+      const float dim = 2.56f;
+      VoxelImpl::configure(dim / size);
+      map_.init(size, dim);
+
+      T_MC_ = Eigen::Matrix4f::Identity();
+      T_MC_.topRightCorner<3, 1>() = Eigen::Vector3f(1.28f, 1.28f, 0.3f);
+      const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MC_);
+      std::vector<se::key_t> allocation_list(map_.size() / VoxelImpl::VoxelBlockType::size_li
+          * image_res_.prod());
+      for (int frame = 0; frame < FRAMES; ++frame) {
+        const size_t num_voxel = VoxelImpl::buildAllocationList(map_, depth_image_, T_MC_,
+            sensor_, allocation_list.data(), allocation_list.size());
+        map_.allocate(allocation_list.data(), num_voxel);
+        VoxelImpl::integrate(map_, depth_image_, T_CM, sensor_, frame);
+      }
+    }
+
+    const float wall_depth_ = 1.5f;
+    Eigen::Vector2i image_res_;
+    se::Image<float> depth_image_;
+    SensorImpl sensor_;
+    VoxelImpl::OctreeType map_;
+    Eigen::Matrix4f T_MC_;
+    se::Image<Eigen::Vector3f> point_cloud_M_;
+    se::Image<Eigen::Vector3f> normals_M_;
+    se::Image<int> scale_image_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(RaycastTest, MatchesPerPixelRaycast) {
+  raycastKernel<VoxelImpl>(map_, point_cloud_M_, normals_M_, scale_image_, T_MC_, sensor_);
+
+  const Eigen::Vector3f t_MC = T_MC_.topRightCorner<3, 1>();
+  int num_hits = 0;
+  for (int y = 0; y < image_res_.y(); ++y) {
+    for (int x = 0; x < image_res_.x(); ++x) {
+      Eigen::Vector3f ray_dir_C;
+      sensor_.model.backProject(Eigen::Vector2f(x, y), &ray_dir_C);
+      const Eigen::Vector4f hit_M = VoxelImpl::raycast(map_, t_MC, ray_dir_C.normalized(),
+          sensor_.nearDist(ray_dir_C), sensor_.farDist(ray_dir_C));
+      // Every pixel is written.
+      if (hit_M.w() >= 0.f) {
+        EXPECT_EQ(point_cloud_M_(x, y), hit_M.head<3>());
+        EXPECT_EQ(scale_image_(x, y), static_cast<int>(hit_M.w()));
+        num_hits++;
+      } else {
+        EXPECT_EQ(point_cloud_M_(x, y), Eigen::Vector3f::Zero());
+        EXPECT_EQ(normals_M_(x, y).x(), INVALID);
+        EXPECT_EQ(scale_image_(x, y), 0);
+      }
+    }
+  }
+  EXPECT_GT(num_hits, image_res_.prod() / 2);
+}
+
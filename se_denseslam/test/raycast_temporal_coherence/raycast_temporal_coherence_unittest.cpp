@@ -0,0 +1,126 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "se/rendering.hpp"
+
+#define FRAMES 5
+
+
+
+// A camera looking at a flat wall parallel to its image plane. The map is
+// raycast from a pose close to the one it was integrated from, like when
+// tracking.
+class RaycastTemporalCoherenceTest : public ::testing::Test {
+  protected:
+    RaycastTemporalCoherenceTest() :
+      image_res_(64, 48),
+      depth_image_(image_res_.x(), image_res_.y(), wall_depth_),
+      sensor_({image_res_.x(), image_res_.y(), false,
+               0.1f, 4.f,
+               50.f, 50.f, image_res_.x() / 2.f, image_res_.y() / 2.f,
+               Eigen::VectorXf(0), Eigen::VectorXf(0)}),
+      prev_point_cloud_M_(image_res_.x(), image_res_.y()),
+      prev_normals_M_(image_res_.x(), image_res_.y()),
+      point_cloud_M_(image_res_.x(), image_res_.y()),
+      normals_M_(image_res_.x(), image_res_.y()),
+      seeded_point_cloud_M_(image_res_.x(), image_res_.y()),
+      seeded_normals_M_(image_res_.x(), image_res_.y()),
+      scale_image_(image_res_.x(), image_res_.y()),
+      predicted_t_image_(image_res_.x(), image_res_.y()) {
+    }
+
+    virtual void SetUp() {
+      const int size = 128;
+      const float dim = 2.56f;
+      VoxelImpl::configure(dim / size);
+      map_.init(size, dim);
+
+      prev_T_MC_ = Eigen::Matrix4f::Identity();
+      prev_T_MC_.topRightCorner<3, 1>() = Eigen::Vector3f(1.28f, 1.28f, 0.3f);
+      const Eigen::Matrix4f prev_T_CM = se::math::to_inverse_transformation(prev_T_MC_);
+      std::vector<se::key_t> allocation_list(map_.size() / VoxelImpl::VoxelBlockType::size_li
+          * image_res_.prod());
+      for (int frame = 0; frame < FRAMES; ++frame) {
+        const size_t num_voxel = VoxelImpl::buildAllocationList(map_, depth_image_, prev_T_MC_,
+            sensor_, allocation_list.data(), allocation_list.size());
+        map_.allocate(allocation_list.data(), num_voxel);
+        VoxelImpl::integrate(map_, depth_image_, prev_T_CM, sensor_, frame);
+      }
+      raycastKernel<VoxelImpl>(map_, prev_point_cloud_M_, prev_normals_M_, scale_image_,
+          prev_T_MC_, sensor_);
+
+      // Move the camera by a few centimetres and rotate it slightly.
+      T_MC_ = prev_T_MC_;
+      T_MC_.topLeftCorner<3, 3>() = Eigen::AngleAxisf(0.03f, Eigen::Vector3f::UnitY()).toRotationMatrix();
+      T_MC_.topRightCorner<3, 1>() += Eigen::Vector3f(0.03f, -0.02f, 0.01f);
+      raycastKernel<VoxelImpl>(map_, point_cloud_M_, normals_M_, scale_image_, T_MC_, sensor_);
+    }
+
+    const float wall_depth_ = 1.5f;
+    const float seed_margin_ = 0.05f;
+    Eigen::Vector2i image_res_;
+    se::Image<float> depth_image_;
+    SensorImpl sensor_;
+    VoxelImpl::OctreeType map_;
+    Eigen::Matrix4f prev_T_MC_;
+    Eigen::Matrix4f T_MC_;
+    se::Image<Eigen::Vector3f> prev_point_cloud_M_;
+    se::Image<Eigen::Vector3f> prev_normals_M_;
+    se::Image<Eigen::Vector3f> point_cloud_M_;
+    se::Image<Eigen::Vector3f> normals_M_;
+    se::Image<Eigen::Vector3f> seeded_point_cloud_M_;
+    se::Image<Eigen::Vector3f> seeded_normals_M_;
+    se::Image<int> scale_image_;
+    se::Image<float> predicted_t_image_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(RaycastTemporalCoherenceTest, SeededMatchesFullMarch) {
+  predictRaycastKernel(predicted_t_image_, prev_point_cloud_M_, prev_normals_M_, T_MC_, sensor_);
+  RaycastStats stats;
+  raycastKernel<VoxelImpl>(map_, seeded_point_cloud_M_, seeded_normals_M_, scale_image_,
+      T_MC_, sensor_, &predicted_t_image_, seed_margin_, &stats);
+
+  // Most rays have a prediction and hit the surface where predicted. Rays
+  // near the image border see past the integrated frustum and may fall back.
+  EXPECT_GT(stats.num_seeded, image_res_.prod() / 2u);
+  EXPECT_LT(stats.num_fallback, stats.num_seeded / 10);
+  EXPECT_LT(stats.mean_seed_error, map_.voxelDim());
+
+  // Seeded rays may also hit the surface behind unobserved gaps the full
+  // march stops at, so only the hits of the full march are compared.
+  for (size_t i = 0; i < point_cloud_M_.size(); ++i) {
+    if (normals_M_[i].x() != INVALID) {
+      ASSERT_NE(seeded_normals_M_[i].x(), INVALID);
+      EXPECT_LT((seeded_point_cloud_M_[i] - point_cloud_M_[i]).norm(), 0.5f * map_.voxelDim());
+    }
+  }
+}
+
+
+
+TEST_F(RaycastTemporalCoherenceTest, FallbackOnMiss) {
+  // Predict the surface behind the wall so that all seeded rays miss.
+  for (size_t i = 0; i < predicted_t_image_.size(); ++i) {
+    predicted_t_image_[i] = 2.f * wall_depth_;
+  }
+  RaycastStats stats;
+  raycastKernel<VoxelImpl>(map_, seeded_point_cloud_M_, seeded_normals_M_, scale_image_,
+      T_MC_, sensor_, &predicted_t_image_, seed_margin_, &stats);
+
+  EXPECT_EQ(stats.num_seeded, predicted_t_image_.size());
+  EXPECT_EQ(stats.num_fallback, stats.num_seeded);
+  for (size_t i = 0; i < point_cloud_M_.size(); ++i) {
+    EXPECT_EQ(seeded_point_cloud_M_[i], point_cloud_M_[i]);
+    EXPECT_EQ(seeded_normals_M_[i], normals_M_[i]);
+  }
+}
+
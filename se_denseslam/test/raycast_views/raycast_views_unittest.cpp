@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "se/rendering.hpp"
+
+#define FRAMES 5
+
+
+
+// A camera looking at a flat wall parallel to its image plane. The views are
+// raycast from the pose the wall was integrated from, from a nearby pose and
+// from a pose looking sideways at mostly unobserved space. Tested with
+// OFusion since it also integrates the free space in front of the wall.
+class RaycastViewsTest : public ::testing::Test {
+  protected:
+    RaycastViewsTest() :
+      image_res_(64, 48),
+      depth_image_(image_res_.x(), image_res_.y(), wall_depth_),
+      sensor_({image_res_.x(), image_res_.y(), false,
+               0.1f, 4.f,
+               50.f, 50.f, image_res_.x() / 2.f, image_res_.y() / 2.f,
+               Eigen::VectorXf(0), Eigen::VectorXf(0)}) {
+    }
+
+    virtual void SetUp() {
+      const int size = 128;
+      const float dim = 2.56f;
+      VoxelImpl::configure(dim / size);
+      map_.init(size, dim);
+
+      Eigen::Matrix4f T_MC = Eigen::Matrix4f::Identity();
+      T_MC.topRightCorner<3, 1>() = Eigen::Vector3f(1.28f, 1.28f, 0.3f);
+      const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MC);
+      std::vector<se::key_t> allocation_list(map_.size() / VoxelImpl::VoxelBlockType::size_li
+          * image_res_.prod());
+      for (int frame = 0; frame < FRAMES; ++frame) {
+        const size_t num_voxel = VoxelImpl::buildAllocationList(map_, depth_image_, T_MC,
+            sensor_, allocation_list.data(), allocation_list.size());
+        map_.allocate(allocation_list.data(), num_voxel);
+        VoxelImpl::integrate(map_, depth_image_, T_CM, sensor_, frame);
+      }
+
+      T_MCs_.push_back(T_MC);
+      T_MC.topLeftCorner<3, 3>() = Eigen::AngleAxisf(0.05f, Eigen::Vector3f::UnitY()).toRotationMatrix();
+      T_MC.topRightCorner<3, 1>() += Eigen::Vector3f(0.05f, -0.03f, 0.1f);
+      T_MCs_.push_back(T_MC);
+      T_MC.topLeftCorner<3, 3>() = Eigen::AngleAxisf(M_PI_2, Eigen::Vector3f::UnitY()).toRotationMatrix();
+      T_MCs_.push_back(T_MC);
+    }
+
+    const float wall_depth_ = 1.5f;
+    Eigen::Vector2i image_res_;
+    se::Image<float> depth_image_;
+    SensorImpl sensor_;
+    VoxelImpl::OctreeType map_;
+    std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f>> T_MCs_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(RaycastViewsTest, MatchesRaycastKernel) {
+  std::vector<RaycastView> views;
+  raycastViewsKernel<VoxelImpl>(map_, T_MCs_, sensor_, views);
+  ASSERT_EQ(views.size(), T_MCs_.size());
+
+  se::Image<Eigen::Vector3f> point_cloud_M (image_res_.x(), image_res_.y());
+  se::Image<Eigen::Vector3f> normals_M (image_res_.x(), image_res_.y());
+  se::Image<int> scale_image (image_res_.x(), image_res_.y());
+  for (size_t v = 0; v < T_MCs_.size(); ++v) {
+    const RaycastView& view = views[v];
+    ASSERT_EQ(view.depth_image.width(), image_res_.x());
+    ASSERT_EQ(view.depth_image.height(), image_res_.y());
+    EXPECT_EQ(view.num_unknown_samples, 0u);
+    raycastKernel<VoxelImpl>(map_, point_cloud_M, normals_M, scale_image, T_MCs_[v], sensor_);
+    const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MCs_[v]);
+    for (size_t i = 0; i < point_cloud_M.size(); ++i) {
+      if (point_cloud_M[i].isZero()) {
+        EXPECT_EQ(view.depth_image[i], 0.f);
+        EXPECT_EQ(view.scale_image[i], -1);
+      } else {
+        const Eigen::Vector3f point_C = (T_CM * point_cloud_M[i].homogeneous()).head<3>();
+        EXPECT_NEAR(view.depth_image[i], sensor_.measurementFromPoint(point_C), 1e-4f);
+        EXPECT_EQ(view.scale_image[i], scale_image[i]);
+      }
+    }
+  }
+  // The wall is seen from the first two views.
+  EXPECT_NEAR(views[0].depth_image(image_res_.x() / 2, image_res_.y() / 2), wall_depth_,
+      map_.voxelDim());
+  EXPECT_GT(views[1].depth_image(image_res_.x() / 2, image_res_.y() / 2), 0.f);
+}
+
+
+
+TEST_F(RaycastViewsTest, ReducedResolution) {
+  const SensorImpl scaled_sensor (sensor_, 0.5f);
+  std::vector<RaycastView> views;
+  raycastViewsKernel<VoxelImpl>(map_, T_MCs_, scaled_sensor, views);
+  ASSERT_EQ(views.size(), T_MCs_.size());
+  for (const auto& view : views) {
+    EXPECT_EQ(view.depth_image.width(), image_res_.x() / 2);
+    EXPECT_EQ(view.depth_image.height(), image_res_.y() / 2);
+    EXPECT_EQ(view.scale_image.width(), image_res_.x() / 2);
+    EXPECT_EQ(view.scale_image.height(), image_res_.y() / 2);
+  }
+  EXPECT_NEAR(views[0].depth_image(image_res_.x() / 4, image_res_.y() / 4), wall_depth_,
+      map_.voxelDim());
+}
+
+
+
+TEST_F(RaycastViewsTest, CountUnknownSamples) {
+  std::vector<RaycastView> views;
+  raycastViewsKernel<VoxelImpl>(map_, T_MCs_, sensor_, views, 4.f * map_.voxelDim());
+  ASSERT_EQ(views.size(), T_MCs_.size());
+  // Most of the space in front of the wall has been observed from the first
+  // view while the third view only looks at unobserved space.
+  EXPECT_GT(views[2].num_unknown_samples, 0u);
+  EXPECT_LT(views[0].num_unknown_samples, views[2].num_unknown_samples / 2);
+  EXPECT_LT(views[1].num_unknown_samples, views[2].num_unknown_samples / 2);
+}
+
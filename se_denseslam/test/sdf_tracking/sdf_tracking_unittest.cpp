@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "se/constant_parameters.h"
+#include "se/preprocessing.hpp"
+#include "se/tracking.hpp"
+#include "se/voxel_implementations.hpp"
+
+#define FRAMES 5
+
+
+
+// A camera looking at a wavy surface integrated from the reference pose and
+// tracked from a slightly perturbed pose.
+class SDFTrackingTest : public ::testing::Test {
+  protected:
+    SDFTrackingTest() :
+      image_res_(64, 48),
+      depth_image_(image_res_.x(), image_res_.y()),
+      input_point_cloud_C_(image_res_.x(), image_res_.y()),
+      input_normals_C_(image_res_.x(), image_res_.y()),
+      sensor_({image_res_.x(), image_res_.y(), false,
+               0.1f, 4.f,
+               50.f, 50.f, image_res_.x() / 2.f, image_res_.y() / 2.f,
+               Eigen::VectorXf(0), Eigen::VectorXf(0)}) {
+    }
+
+    virtual void SetUp() {
+      const int size = 128;
+      const float dim = 2.56f;
+      VoxelImpl::configure(dim / size);
+      map_.init(size, dim);
+
+      for (int y = 0; y < image_res_.y(); y++) {
+        for (int x = 0; x < image_res_.x(); x++) {
+          depth_image_(x, y) = 1.5f + 0.1f * std::sin(x / 6.f) + 0.1f * std::cos(y / 5.f);
+        }
+      }
+      depthToPointCloudKernel(input_point_cloud_C_, depth_image_, sensor_);
+      pointCloudToNormalKernel<false>(input_normals_C_, input_point_cloud_C_);
+
+      T_MC_ref_ = Eigen::Matrix4f::Identity();
+      T_MC_ref_.topRightCorner<3, 1>() = Eigen::Vector3f(1.28f, 1.28f, 0.3f);
+      const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MC_ref_);
+      std::vector<se::key_t> allocation_list(map_.size() / VoxelImpl::VoxelBlockType::size_li
+          * image_res_.prod());
+      for (int frame = 0; frame < FRAMES; ++frame) {
+        const size_t num_voxel = VoxelImpl::buildAllocationList(map_, depth_image_, T_MC_ref_,
+            sensor_, allocation_list.data(), allocation_list.size());
+        map_.allocate(allocation_list.data(), num_voxel);
+        VoxelImpl::integrate(map_, depth_image_, T_CM, sensor_, frame);
+      }
+
+      T_MC_ = T_MC_ref_;
+      T_MC_.topLeftCorner<3, 3>() = Eigen::AngleAxisf(0.02f, Eigen::Vector3f(1.f, 2.f, 3.f).normalized())
+          .toRotationMatrix();
+      T_MC_.topRightCorner<3, 1>() += Eigen::Vector3f(0.02f, -0.01f, 0.015f);
+    }
+
+    Eigen::Vector2i image_res_;
+    se::Image<float> depth_image_;
+    se::Image<Eigen::Vector3f> input_point_cloud_C_;
+    se::Image<Eigen::Vector3f> input_normals_C_;
+    SensorImpl sensor_;
+    VoxelImpl::OctreeType map_;
+    Eigen::Matrix4f T_MC_ref_;
+    Eigen::Matrix4f T_MC_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(SDFTrackingTest, SupportedVoxelImpl) {
+  EXPECT_TRUE(se::supportsSDFTracking<VoxelImpl>::value);
+}
+
+
+
+TEST_F(SDFTrackingTest, ZeroErrorAtReferencePose) {
+  std::vector<TrackData> tracking_result (image_res_.prod());
+  std::vector<float> output (8 * 32);
+  sdfTrackReduceKernel<VoxelImpl>(output.data(), tracking_result.data(), map_,
+      input_point_cloud_C_, input_normals_C_, T_MC_ref_, dist_threshold, normal_threshold);
+  // Most points are tracked successfully and lie on the surface.
+  EXPECT_GT(output[28], 0.8f * image_res_.prod());
+  EXPECT_LT(std::sqrt(output[0] / output[28]), 0.25f * map_.voxelDim());
+  for (const auto& row : tracking_result) {
+    if (row.result == 1) {
+      const Eigen::Vector3f J_t (row.J[0], row.J[1], row.J[2]);
+      EXPECT_NEAR(J_t.norm(), 1.f, 1e-4f);
+    }
+  }
+}
+
+
+
+TEST_F(SDFTrackingTest, FarFromSurface) {
+  // Move the camera so that the points land outside the truncation band.
+  Eigen::Matrix4f T_MC = T_MC_ref_;
+  T_MC.topRightCorner<3, 1>() += Eigen::Vector3f(0.f, 0.f, -0.25f);
+  std::vector<TrackData> tracking_result (image_res_.prod());
+  std::vector<float> output (8 * 32);
+  sdfTrackReduceKernel<VoxelImpl>(output.data(), tracking_result.data(), map_,
+      input_point_cloud_C_, input_normals_C_, T_MC, dist_threshold, normal_threshold);
+  EXPECT_EQ(output[28], 0.f);
+  for (const auto& row : tracking_result) {
+    EXPECT_LT(row.result, 1);
+  }
+}
+
+
+
+TEST_F(SDFTrackingTest, Converges) {
+  std::vector<float> output (8 * 32);
+  Eigen::Matrix4f T_MC = T_MC_;
+  for (int i = 0; i < 20; ++i) {
+    sdfTrackReduceKernel<VoxelImpl>(output.data(), nullptr, map_,
+        input_point_cloud_C_, input_normals_C_, T_MC, dist_threshold, normal_threshold);
+    if (updatePoseKernel(T_MC, output.data(), 1e-5f)) {
+      break;
+    }
+  }
+  Eigen::Matrix4f previous_T_MC = T_MC_;
+  EXPECT_TRUE(checkPoseKernel(T_MC, previous_T_MC, output.data(), image_res_, track_threshold));
+  EXPECT_LT((se::math::to_translation(T_MC) - se::math::to_translation(T_MC_ref_)).norm(),
+      0.25f * map_.voxelDim());
+  const Eigen::Matrix3f R_error = se::math::to_rotation(T_MC).transpose()
+      * se::math::to_rotation(T_MC_ref_);
+  EXPECT_LT(Eigen::AngleAxisf(R_error).angle(), 0.005f);
+}
+
@@ -0,0 +1,158 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "se/constant_parameters.h"
+#include "se/preprocessing.hpp"
+#include "se/tracking.hpp"
+
+
+
+// A camera looking at a wavy surface. The reference surface is the input
+// point cloud itself seen from the reference pose and the input is tracked
+// from a slightly perturbed pose.
+class TrackReduceTest : public ::testing::Test {
+  protected:
+    TrackReduceTest() :
+      image_res_(64, 48),
+      depth_image_(image_res_.x(), image_res_.y()),
+      input_point_cloud_C_(image_res_.x(), image_res_.y()),
+      input_normals_C_(image_res_.x(), image_res_.y()),
+      surface_point_cloud_M_(image_res_.x(), image_res_.y()),
+      surface_normals_M_(image_res_.x(), image_res_.y()),
+      sensor_({image_res_.x(), image_res_.y(), false,
+               0.1f, 4.f,
+               50.f, 50.f, image_res_.x() / 2.f, image_res_.y() / 2.f,
+               Eigen::VectorXf(0), Eigen::VectorXf(0)}) {
+    }
+
+    virtual void SetUp() {
+      for (int y = 0; y < image_res_.y(); y++) {
+        for (int x = 0; x < image_res_.x(); x++) {
+          depth_image_(x, y) = 1.5f + 0.1f * std::sin(x / 6.f) + 0.1f * std::cos(y / 5.f);
+        }
+      }
+      // Some pixels without input data.
+      depth_image_(10, 10) = 0.f;
+      depth_image_(40, 30) = 0.f;
+      depthToPointCloudKernel(input_point_cloud_C_, depth_image_, sensor_);
+      pointCloudToNormalKernel<false>(input_normals_C_, input_point_cloud_C_);
+
+      T_MC_ref_ = Eigen::Matrix4f::Identity();
+      T_MC_ref_.topRightCorner<3, 1>() = Eigen::Vector3f(1.f, 2.f, 0.5f);
+      for (size_t i = 0; i < surface_point_cloud_M_.size(); ++i) {
+        surface_point_cloud_M_[i] = (T_MC_ref_ * input_point_cloud_C_[i].homogeneous()).head<3>();
+        surface_normals_M_[i] = (input_normals_C_[i].x() == INVALID)
+            ? input_normals_C_[i] : T_MC_ref_.topLeftCorner<3, 3>() * input_normals_C_[i];
+      }
+
+      T_MC_ = T_MC_ref_;
+      T_MC_.topLeftCorner<3, 3>() = Eigen::AngleAxisf(0.02f, Eigen::Vector3f(1.f, 2.f, 3.f).normalized())
+          .toRotationMatrix();
+      T_MC_.topRightCorner<3, 1>() += Eigen::Vector3f(0.01f, -0.02f, 0.015f);
+    }
+
+    Eigen::Vector2i image_res_;
+    se::Image<float> depth_image_;
+    se::Image<Eigen::Vector3f> input_point_cloud_C_;
+    se::Image<Eigen::Vector3f> input_normals_C_;
+    se::Image<Eigen::Vector3f> surface_point_cloud_M_;
+    se::Image<Eigen::Vector3f> surface_normals_M_;
+    SensorImpl sensor_;
+    Eigen::Matrix4f T_MC_ref_;
+    Eigen::Matrix4f T_MC_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(TrackReduceTest, MatchesTrackAndReduce) {
+  std::vector<TrackData> expected_tracking_result (image_res_.prod());
+  std::vector<float> expected_output (8 * 32);
+  trackKernel(expected_tracking_result.data(), input_point_cloud_C_, input_normals_C_,
+      surface_point_cloud_M_, surface_normals_M_, T_MC_, T_MC_ref_, sensor_,
+      dist_threshold, normal_threshold);
+  reduceKernel(expected_output.data(), image_res_, expected_tracking_result.data(), image_res_);
+
+  std::vector<TrackData> tracking_result (image_res_.prod());
+  std::vector<float> output (8 * 32, 1.f);
+  trackReduceKernel(output.data(), tracking_result.data(), input_point_cloud_C_, input_normals_C_,
+      surface_point_cloud_M_, surface_normals_M_, T_MC_, T_MC_ref_, sensor_,
+      dist_threshold, normal_threshold);
+
+  for (size_t i = 0; i < tracking_result.size(); ++i) {
+    EXPECT_EQ(tracking_result[i].result, expected_tracking_result[i].result);
+    if (tracking_result[i].result == 1) {
+      EXPECT_EQ(tracking_result[i].error, expected_tracking_result[i].error);
+      for (int j = 0; j < 6; ++j) {
+        EXPECT_EQ(tracking_result[i].J[j], expected_tracking_result[i].J[j]);
+      }
+    }
+  }
+  // Most pixels are tracked successfully.
+  EXPECT_GT(output[28], 0.9f * image_res_.prod());
+  for (int i = 0; i < 32; ++i) {
+    EXPECT_NEAR(output[i], expected_output[i], 1e-4f * std::max(1.f, std::fabs(expected_output[i])));
+  }
+  for (int i = 32; i < 8 * 32; ++i) {
+    EXPECT_EQ(output[i], 0.f);
+  }
+
+  // The pose update is the same as with the separate kernels.
+  Eigen::Matrix4f T_MC = T_MC_;
+  Eigen::Matrix4f expected_T_MC = T_MC_;
+  updatePoseKernel(T_MC, output.data(), 1e-5f);
+  updatePoseKernel(expected_T_MC, expected_output.data(), 1e-5f);
+  EXPECT_TRUE(T_MC.isApprox(expected_T_MC, 1e-5f));
+}
+
+
+
+TEST_F(TrackReduceTest, Deterministic) {
+  std::vector<float> expected_output (8 * 32);
+  trackReduceKernel(expected_output.data(), nullptr, input_point_cloud_C_, input_normals_C_,
+      surface_point_cloud_M_, surface_normals_M_, T_MC_, T_MC_ref_, sensor_,
+      dist_threshold, normal_threshold);
+#ifdef _OPENMP
+  const int max_threads = omp_get_max_threads();
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    omp_set_num_threads(num_threads);
+#endif
+    std::vector<float> output (8 * 32);
+    trackReduceKernel(output.data(), nullptr, input_point_cloud_C_, input_normals_C_,
+        surface_point_cloud_M_, surface_normals_M_, T_MC_, T_MC_ref_, sensor_,
+        dist_threshold, normal_threshold);
+    EXPECT_EQ(output, expected_output);
+#ifdef _OPENMP
+  }
+  omp_set_num_threads(max_threads);
+#endif
+}
+
+
+
+TEST_F(TrackReduceTest, Converges) {
+  std::vector<float> output (8 * 32);
+  Eigen::Matrix4f T_MC = T_MC_;
+  for (int i = 0; i < 20; ++i) {
+    trackReduceKernel(output.data(), nullptr, input_point_cloud_C_, input_normals_C_,
+        surface_point_cloud_M_, surface_normals_M_, T_MC, T_MC_ref_, sensor_,
+        dist_threshold, normal_threshold);
+    if (updatePoseKernel(T_MC, output.data(), 1e-5f)) {
+      break;
+    }
+  }
+  Eigen::Matrix4f previous_T_MC = T_MC_;
+  EXPECT_TRUE(checkPoseKernel(T_MC, previous_T_MC, output.data(), image_res_, track_threshold));
+  EXPECT_TRUE(T_MC.isApprox(T_MC_ref_, 1e-3f));
+}
+
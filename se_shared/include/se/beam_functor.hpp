@@ -0,0 +1,336 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef BEAM_FUNCTOR_HPP
+#define BEAM_FUNCTOR_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <bitset>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "se/utils/math_utils.h"
+#include "se/image/image.hpp"
+#include "se/node.hpp"
+#include "se/functors/data_handler.hpp"
+#include "se/projective_functor.hpp"
+#include "se/sensor_implementation.hpp"
+
+namespace se {
+namespace functor {
+
+/*! \brief The voxels of a VoxelBlock that lie on at least one sensor beam.
+ * The voxels are indexed by x + y * size_li + z * size_sq relative to the
+ * VoxelBlock coordinates.
+ */
+template <typename VoxelBlockT>
+struct BeamBlock {
+  VoxelBlockT*                       block;
+  std::bitset<VoxelBlockT::size_cu> voxels;
+};
+
+
+
+/*! \brief Walk each valid beam of depth_image through the octree and find the
+ * allocated voxels it crosses.
+ *
+ * Each beam is sampled every half voxel from range(depth_value).x() metres
+ * in front of the measured point, but never closer than the near plane, to
+ * range(depth_value).y() metres behind it, but never beyond the far plane.
+ *
+ * \param[out] beam_blocks The VoxelBlocks crossed by at least one beam.
+ * \param[in]  octree      The octree to walk through.
+ * \param[in]  T_MC        The camera to map frame transformation.
+ * \param[in]  sensor      The sensor depth_image was captured with.
+ * \param[in]  depth_image The depth image.
+ * \param[in]  range       Functor returning the distances in front of and
+ *                         behind the measured point to sample, given the
+ *                         depth value.
+ */
+template <typename DataType, template <typename DataT> class OctreeT,
+          typename RangeF>
+void beam_blocks(std::vector<BeamBlock<typename DataType::VoxelBlockType>>& beam_blocks,
+                 const OctreeT<DataType>&                                   octree,
+                 const Eigen::Matrix4f&                                     T_MC,
+                 const SensorImpl&                                          sensor,
+                 const se::Image<float>&                                    depth_image,
+                 RangeF                                                     range) {
+
+  using VoxelBlockType = typename DataType::VoxelBlockType;
+  using VoxelMaskType = std::bitset<VoxelBlockType::size_cu>;
+  constexpr int block_size = VoxelBlockType::size_li;
+
+  const float voxel_dim = octree.voxelDim();
+  const float inverse_voxel_dim = 1.f / voxel_dim;
+  const float step = 0.5f * voxel_dim;
+  const int map_size = octree.size();
+
+  std::unordered_map<VoxelBlockType*, VoxelMaskType> block_voxels;
+#pragma omp parallel
+  {
+    std::unordered_map<VoxelBlockType*, VoxelMaskType> thread_block_voxels;
+#pragma omp for nowait
+    for (int y = 0; y < depth_image.height(); ++y) {
+      // The block of the last sample, consecutive samples mostly share it.
+      Eigen::Vector3i last_block_coord = Eigen::Vector3i::Constant(-1);
+      VoxelMaskType* last_voxels = nullptr;
+      for (int x = 0; x < depth_image.width(); ++x) {
+        const float depth_value = depth_image(x, y);
+        if (depth_value < sensor.near_plane) {
+          continue;
+        }
+
+        Eigen::Vector3f ray_dir_C;
+        sensor.model.backProject(Eigen::Vector2f(x, y), &ray_dir_C);
+        const Eigen::Vector3f point_C = depth_value * ray_dir_C;
+        const float point_dist = point_C.norm();
+        const Eigen::Vector2f beam_range = range(depth_value);
+        const float t_start = std::max(point_dist - beam_range.x(), sensor.near_plane);
+        // Like projective_functor, skip the samples beyond the far plane.
+        const float t_end = std::min(point_dist + beam_range.y(), sensor.farDist(ray_dir_C));
+        if (t_start >= t_end) {
+          continue;
+        }
+
+        const Eigen::Vector3f ray_origin_M = T_MC.topRightCorner<3, 1>();
+        const Eigen::Vector3f ray_dir_M = se::math::to_rotation(T_MC) * (point_C / point_dist);
+        const int num_steps = ceil((t_end - t_start) / step);
+        for (int i = 0; i <= num_steps; ++i) {
+          const Eigen::Vector3f sample_point_M = ray_origin_M + (t_start + i * step) * ray_dir_M;
+          const Eigen::Vector3f sample_coord_f = sample_point_M * inverse_voxel_dim;
+          if ((sample_coord_f.array() < 0.f).any() || (sample_coord_f.array() >= map_size).any()) {
+            continue;
+          }
+          const Eigen::Vector3i voxel_coord = sample_coord_f.cast<int>();
+          const Eigen::Vector3i block_coord = block_size * (voxel_coord / block_size);
+          if (block_coord != last_block_coord) {
+            last_block_coord = block_coord;
+            VoxelBlockType* block = octree.fetch(voxel_coord);
+            last_voxels = block ? &thread_block_voxels[block] : nullptr;
+          }
+          if (last_voxels) {
+            const Eigen::Vector3i voxel_offset = voxel_coord - block_coord;
+            last_voxels->set(voxel_offset.x() + voxel_offset.y() * block_size
+                + voxel_offset.z() * block_size * block_size);
+          }
+        }
+      }
+    }
+#pragma omp critical
+    {
+      for (const auto& thread_block : thread_block_voxels) {
+        block_voxels[thread_block.first] |= thread_block.second;
+      }
+    }
+  }
+
+  beam_blocks.clear();
+  beam_blocks.reserve(block_voxels.size());
+  for (const auto& block : block_voxels) {
+    beam_blocks.push_back({block.first, block.second});
+  }
+}
+
+
+
+/*! \brief Integrate a depth image by only updating the voxels crossed by its
+ * beams, see se::functor::beam_blocks(). Each selected voxel is updated at
+ * most once, exactly like projective_functor would update it. Nodes are
+ * updated as in projective_functor::apply.
+ *
+ * Intended for sparse sensors such as OusterLidar, where most voxels inside
+ * the frustum lie between beams.
+ */
+template <typename DataType, template <typename DataT> class OctreeT,
+          typename UpdateF, typename RangeF>
+class beam_functor {
+
+using VoxelBlockType = typename DataType::VoxelBlockType;
+
+public:
+  beam_functor(OctreeT<DataType>&      octree,
+               UpdateF&                update_funct,
+               const Eigen::Matrix4f&  T_CM,
+               const SensorImpl        sensor,
+               const se::Image<float>& image,
+               const Eigen::Vector3f&  sample_offset_frac,
+               RangeF                  range) :
+    octree_(octree),
+    update_funct_(update_funct),
+    T_CM_(T_CM),
+    sensor_(sensor),
+    image_(image),
+    sample_offset_frac_(sample_offset_frac),
+    range_(range),
+    node_funct_(octree, update_funct, T_CM, sensor, image, sample_offset_frac) {
+  }
+
+
+
+  void update_block(const BeamBlock<VoxelBlockType>& beam_block,
+                    const float                      voxel_dim) {
+
+    VoxelBlockType* block = beam_block.block;
+    update_funct_.reset(block);
+    block->current_scale(0);
+
+    constexpr int block_size = VoxelBlockType::size_li;
+    const Eigen::Vector3i voxel_coord_base = block->coordinates();
+    auto valid_predicate = [&](float depth_value){ return depth_value >= sensor_.near_plane; };
+
+    // Compute the sample points like projective_functor::update_block so
+    // that both produce identical voxel values.
+    const Eigen::Vector3f voxel_sample_coord_base_f   = se::get_sample_coord(voxel_coord_base, 1, sample_offset_frac_);
+    const Eigen::Vector3f sample_point_base_C         = (T_CM_ * (voxel_dim * voxel_sample_coord_base_f).homogeneous()).head(3);
+    const Eigen::Matrix3f sample_point_delta_matrix_C = (se::math::to_rotation(T_CM_) * voxel_dim * Eigen::Matrix3f::Identity());
+
+    bool is_visible = false;
+    for (size_t voxel_idx = 0; voxel_idx < beam_block.voxels.size(); ++voxel_idx) {
+      if (!beam_block.voxels[voxel_idx]) {
+        continue;
+      }
+      const Eigen::Vector3i voxel_offset(voxel_idx % block_size,
+          (voxel_idx / block_size) % block_size, voxel_idx / (block_size * block_size));
+      const Eigen::Vector3i voxel_coord = voxel_coord_base + voxel_offset;
+      const Eigen::Vector3f sample_point_C = sample_point_base_C
+          + sample_point_delta_matrix_C * voxel_offset.cast<float>();
+
+      if (sample_point_C.norm() > sensor_.farDist(sample_point_C)) {
+        continue;
+      }
+
+      float image_value(0);
+      if (!sensor_.projectToPixelValue(sample_point_C, image_, image_value, valid_predicate)) {
+        continue;
+      }
+
+      is_visible = true;
+
+      VoxelBlockHandler<DataType> handler = {block, voxel_coord};
+      update_funct_(handler, sample_point_C, image_value);
+    }
+
+    update_funct_(block, is_visible);
+  }
+
+
+
+  void apply() {
+    apply([](const se::Node<DataType>* octant) { return octant != nullptr; });
+  }
+
+
+
+  /*! \brief Same as apply() but only update the VoxelBlocks and Nodes for
+   * which is_allocated returns true.
+   */
+  template <typename IsAllocatedF>
+  void apply(IsAllocatedF is_allocated) {
+
+    const float voxel_dim = octree_.voxelDim();
+
+    /* Update the voxels of the leaf Octree nodes (VoxelBlock) on a beam. */
+    beam_blocks(beam_blocks_, octree_, se::math::to_inverse_transformation(T_CM_), sensor_,
+        image_, range_);
+    beam_blocks_.erase(std::remove_if(beam_blocks_.begin(), beam_blocks_.end(),
+        [&](const BeamBlock<VoxelBlockType>& beam_block) { return !is_allocated(beam_block.block); }),
+        beam_blocks_.end());
+#pragma omp parallel for
+    for (unsigned int i = 0; i < beam_blocks_.size(); ++i) {
+      update_block(beam_blocks_[i], voxel_dim);
+    }
+    active_list_.clear();
+    for (const auto& beam_block : beam_blocks_) {
+      active_list_.push_back(beam_block.block);
+    }
+
+    /* Update the intermediate Octree nodes (Node) inside the camera frustum. */
+    node_funct_.build_node_list();
+    const std::vector<se::Node<DataType>*>& node_list = node_funct_.nodeList();
+#pragma omp parallel for
+    for (unsigned int i = 0; i < node_list.size(); ++i) {
+      if (is_allocated(node_list[i])) {
+        node_funct_.update_node(node_list[i], voxel_dim);
+      }
+    }
+  }
+
+
+
+  /*! \brief The blocks updated by the last call to beam_functor::apply.
+   */
+  const std::vector<VoxelBlockType*>& activeList() const { return active_list_; }
+
+  /*! \brief The voxels updated by the last call to beam_functor::apply.
+   */
+  const std::vector<BeamBlock<VoxelBlockType>>& beamBlocks() const { return beam_blocks_; }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+  OctreeT<DataType>& octree_;
+  UpdateF& update_funct_;
+  const Eigen::Matrix4f& T_CM_;
+  const SensorImpl sensor_;
+  const se::Image<float>& image_;
+  const Eigen::Vector3f sample_offset_frac_;
+  RangeF range_;
+  projective_functor<DataType, OctreeT, UpdateF> node_funct_;
+  std::vector<BeamBlock<VoxelBlockType>> beam_blocks_;
+  std::vector<VoxelBlockType*> active_list_;
+};
+
+/*! \brief Create a beam_functor and call beam_functor::apply.
+ */
+template <typename DataType, template <typename DataT> class OctreeT,
+          typename UpdateF, typename RangeF>
+void beam_octree(OctreeT<DataType>&      octree,
+                 const Eigen::Vector3f&  sample_offset_frac,
+                 const Eigen::Matrix4f&  T_CM,
+                 const SensorImpl&       sensor,
+                 const se::Image<float>& image,
+                 UpdateF&                funct,
+                 RangeF                  range) {
+
+  beam_functor<DataType, OctreeT, UpdateF, RangeF>
+    it(octree, funct, T_CM, sensor, image, sample_offset_frac, range);
+  it.apply();
+}
+
+
+
+/*! \brief Integrate a batch of frames with beam_functor one frame at a time.
+ * Beams don't share the VoxelBlock traversal between frames, so this only
+ * allows using se::IntegrationBatch with beam integration. Frame f of the
+ * batch is applied with functs[f]. The octants allocated by later frames of
+ * the batch are skipped, so the result is identical to integrating the
+ * frames one by one.
+ */
+template <typename DataType, template <typename DataT> class OctreeT,
+          typename UpdateF, typename RangeF>
+void beam_octree_batch(OctreeT<DataType>&          octree,
+                       const Eigen::Vector3f&      sample_offset_frac,
+                       const SensorImpl&           sensor,
+                       const se::IntegrationBatch& batch,
+                       std::vector<UpdateF>&       functs,
+                       RangeF                      range) {
+
+  assert((functs.size() == batch.size())
+      && "Error: There must be one update functor per frame of the batch");
+  std::unordered_set<const se::Node<DataType>*> later_octants;
+  for (size_t f = 0; f < batch.size(); ++f) {
+    const se::IntegrationFrame& frame = batch[f];
+    internal::later_octants(later_octants, octree, frame.num_nodes, frame.num_blocks);
+    beam_functor<DataType, OctreeT, UpdateF, RangeF>
+      it(octree, functs[f], frame.T_CM, sensor, frame.depth_image, sample_offset_frac, range);
+    it.apply([&later_octants](const se::Node<DataType>* octant) {
+      return octant != nullptr && later_octants.count(octant) == 0;
+    });
+  }
+}
+}
+}
+#endif
+
@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef INTEGRATION_FRAME_HPP
+#define INTEGRATION_FRAME_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/StdVector>
+
+#include "se/image/image.hpp"
+
+
+
+namespace se {
+  /** \brief A depth frame queued for integration into the map.
+   *
+   * The sizes of the node and VoxelBlock buffers right after the allocation
+   * for this frame are recorded so that octants allocated by later frames of
+   * the same batch can be skipped, making batched integration identical to
+   * integrating the frames one by one.
+   */
+  struct IntegrationFrame {
+    IntegrationFrame(const se::Image<float>& depth_image,
+                     const Eigen::Matrix4f&  T_CM,
+                     const unsigned          frame,
+                     const size_t            num_nodes,
+                     const size_t            num_blocks)
+      : depth_image(depth_image),
+        T_CM(T_CM),
+        frame(frame),
+        num_nodes(num_nodes),
+        num_blocks(num_blocks) {
+    }
+
+    se::Image<float> depth_image;
+    Eigen::Matrix4f  T_CM;
+    unsigned         frame;
+    size_t           num_nodes;
+    size_t           num_blocks;
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  };
+
+  typedef std::vector<IntegrationFrame, Eigen::aligned_allocator<IntegrationFrame> > IntegrationBatch;
+} // namespace se
+
+#endif // INTEGRATION_FRAME_HPP
+
@@ -377,6 +377,18 @@ struct PerfStats {
     include_detailed_ = include_detailed;
   };
 
+  /**
+   * \brief Enable or disable sampling from the calling thread. Samples taken
+   *        while sampling is disabled are dropped, e.g. for kernels run in a
+   *        background thread whose durations would otherwise interleave with
+   *        the ones measured by the main thread.
+   *
+   * \param[in] enabled
+   */
+  void enableThreadSampling(const bool enabled) {
+    threadSampling() = enabled;
+  };
+
   /**
    * \brief Set the current iteration and add it to the stats.
    *
@@ -410,6 +422,14 @@ struct PerfStats {
   void writeSummaryToOStream(std::ostream& ostream,
                              const bool    include_iter_data = true);
 
+  /**
+   * \return Whether the calling thread may add samples.
+   */
+  static bool& threadSampling() {
+    static thread_local bool enabled = true;
+    return enabled;
+  };
+
   std::vector<PerfStats::Type> header_order_ =
       {FRAME, ITERATION, TIME, DURATION, MEMORY, POSITION, ORIENTATION, DISTANCE, FREQUENCY, BOOL,
        POWER, ENERGY, CURRENT, VOLTAGE,
@@ -371,6 +371,9 @@ inline double PerfStats::sample(const std::string& key,
                                 const bool         detailed) {
 
   double now = getTime();
+  if (!threadSampling()) {
+    return now;
+  }
   Stats& s = stats_[key];
 
   s.mutex_.lock();
@@ -397,6 +400,9 @@ inline double PerfStats::sampleDurationStart(const std::string& key,
                                              const bool         detailed) {
 
   double now = getTime();
+  if (!threadSampling()) {
+    return now;
+  }
   Stats& s = stats_[key];
 
   s.mutex_.lock();
@@ -421,6 +427,9 @@ inline double PerfStats::sampleDurationStart(const std::string& key,
 inline double PerfStats::sampleDurationEnd(const std::string& key) {
 
   double now = getTime();
+  if (!threadSampling()) {
+    return now;
+  }
   Stats& s = stats_[key];
 
   s.mutex_.lock();
@@ -29,13 +29,18 @@
 
 #ifndef PROJECTIVE_FUNCTOR_HPP
 #define PROJECTIVE_FUNCTOR_HPP
+#include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <functional>
+#include <unordered_set>
 #include <vector>
 
 #include "se/utils/math_utils.h"
 #include "filter.hpp"
 #include "se/node.hpp"
 #include "se/functors/data_handler.hpp"
+#include "se/integration_frame.hpp"
 #include "se/sensor_implementation.hpp"
 
 namespace se {
@@ -88,6 +93,44 @@ public:
 
 
 
+  /*! \brief Get all the intermediate Octree nodes (Node) whose bounding
+   * sphere intersects the camera frustum. The octree is traversed from the
+   * root and the children of nodes outside the frustum are skipped, since
+   * update_node cannot modify them. The nodes are stored in
+   * projective_functor::node_list_.
+   */
+  void build_node_list() {
+    node_list_.clear();
+    se::Node<DataType>* root = octree_.root();
+    if (root == nullptr) {
+      return;
+    }
+
+    const float voxel_dim = octree_.voxelDim();
+    std::vector<se::Node<DataType>*> node_stack = {root};
+    while (!node_stack.empty()) {
+      se::Node<DataType>* node = node_stack.back();
+      node_stack.pop_back();
+
+      const float node_dim = voxel_dim * node->size();
+      const Eigen::Vector3f node_centre_C = (T_CM_ * (voxel_dim * node->coordinates().template cast<float>()
+          + Eigen::Vector3f::Constant(0.5f * node_dim)).homogeneous()).head(3);
+      if (!sensor_.sphereInFrustum(node_centre_C, 0.5f * std::sqrt(3.f) * node_dim)) {
+        continue;
+      }
+      node_list_.push_back(node);
+
+      for (int child_idx = 0; child_idx < 8; ++child_idx) {
+        se::Node<DataType>* child = node->child(child_idx);
+        if (child != nullptr && !child->isBlock()) {
+          node_stack.push_back(child);
+        }
+      }
+    }
+  }
+
+
+
   void update_block(VoxelBlockType* block,
                     const float     voxel_dim) {
 
@@ -144,12 +187,28 @@ public:
 
   void update_node(se::Node<DataType>* node,
                    const float         voxel_dim) {
+    update_node(node, voxel_dim, [](const se::Node<DataType>*) { return false; });
+  }
+
+
+
+  /*! \brief Same as update_node() but skip the children of node for which
+   * skip_child returns true. skip_child is called with the child pointer,
+   * which is nullptr for unallocated children.
+   */
+  template <typename SkipChildF>
+  void update_node(se::Node<DataType>* node,
+                   const float         voxel_dim,
+                   SkipChildF          skip_child) {
 
     const Eigen::Vector3i node_coord = node->coordinates();
 
     /* Iterate over the Node children. */
 #pragma omp simd
     for(int child_idx = 0; child_idx < 8; ++child_idx) {
+      if (skip_child(node->child(child_idx))) {
+        continue;
+      }
       const unsigned int child_size  = node->size() / 2;
       const Eigen::Vector3i rel_step = Eigen::Vector3i((child_idx & 1) > 0, (child_idx & 2) > 0, (child_idx & 4) > 0);
       const Eigen::Vector3i child_coord = node_coord + child_size * rel_step;
@@ -179,21 +238,32 @@ public:
     const float voxel_dim = octree_.voxelDim();
 
     /* Update the leaf Octree nodes (VoxelBlock). */
+    active_list_.clear();
     build_active_list();
 #pragma omp parallel for
     for (unsigned int i = 0; i < active_list_.size(); ++i) {
       update_block(active_list_[i], voxel_dim);
     }
-    active_list_.clear();
 
-    /* Update the intermediate Octree nodes (Node). */
-    typename DataType::template MemoryBufferType<se::Node<DataType>>& node_buffer = octree_.pool().nodeBuffer();
+    /* Update the intermediate Octree nodes (Node) inside the camera frustum. */
+    build_node_list();
 #pragma omp parallel for
-      for (unsigned int i = 0; i < node_buffer.size(); ++i) {
-        update_node(node_buffer[i], voxel_dim);
-     }
+    for (unsigned int i = 0; i < node_list_.size(); ++i) {
+      update_node(node_list_[i], voxel_dim);
+    }
   }
 
+
+
+  /*! \brief The blocks updated by the last call to projective_functor::apply.
+   */
+  const std::vector<VoxelBlockType*>& activeList() const { return active_list_; }
+
+  /*! \brief The nodes found by the last call to
+   * projective_functor::build_node_list.
+   */
+  const std::vector<se::Node<DataType>*>& nodeList() const { return node_list_; }
+
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 
 private:
@@ -204,6 +274,7 @@ private:
   const se::Image<float>& image_;
   const Eigen::Vector3f sample_offset_frac_;
   std::vector<VoxelBlockType*> active_list_;
+  std::vector<se::Node<DataType>*> node_list_;
 };
 
 /*! \brief Create a projective_functor and call projective_functor::apply.
@@ -221,6 +292,135 @@ void projective_octree(OctreeT<DataType>&      octree,
     it(octree, funct, T_CM, sensor, image, sample_offset_frac);
   it.apply();
 }
+
+
+
+namespace internal {
+  /*! \brief Store the octants allocated after the node and VoxelBlock
+   * buffers had num_nodes and num_blocks elements in later_octants. Used to
+   * skip the octants allocated by later frames of an se::IntegrationBatch.
+   */
+  template <typename DataType, template <typename DataT> class OctreeT>
+  void later_octants(std::unordered_set<const se::Node<DataType>*>& later_octants,
+                     OctreeT<DataType>&                             octree,
+                     const size_t                                   num_nodes,
+                     const size_t                                   num_blocks) {
+    later_octants.clear();
+    auto& node_buffer = octree.pool().nodeBuffer();
+    for (size_t i = num_nodes; i < node_buffer.size(); ++i) {
+      later_octants.insert(node_buffer[i]);
+    }
+    auto& block_buffer = octree.pool().blockBuffer();
+    for (size_t i = num_blocks; i < block_buffer.size(); ++i) {
+      later_octants.insert(block_buffer[i]);
+    }
+  }
+} // namespace internal
+
+
+
+/*! \brief Integrate a batch of frames by visiting each VoxelBlock once and
+ * applying all the frames of the batch to it in order.
+ *
+ * A VoxelBlock is updated with a frame if it is active or inside the frame's
+ * camera frustum, exactly like in projective_functor::apply, and only if it
+ * had already been allocated when the frame was added to the batch. Frame
+ * f of the batch is applied with update_functs[f]. The result is thus
+ * identical to calling projective_functor::apply once per frame as long as
+ * the VoxelBlock and Node updates are independent of each other.
+ */
+template <typename DataType, template <typename DataT> class OctreeT,
+        typename UpdateF>
+class projective_batch_functor {
+
+using VoxelBlockType = typename DataType::VoxelBlockType;
+using FrameFunctorType = projective_functor<DataType, OctreeT, UpdateF>;
+
+public:
+  projective_batch_functor(OctreeT<DataType>&          octree,
+                           std::vector<UpdateF>&       update_functs,
+                           const SensorImpl            sensor,
+                           const se::IntegrationBatch& batch,
+                           const Eigen::Vector3f&      sample_offset_frac) :
+    octree_(octree),
+    sensor_(sensor),
+    batch_(batch) {
+    assert((update_functs.size() == batch_.size())
+        && "Error: There must be one update functor per frame of the batch");
+    frame_functs_.reserve(batch_.size());
+    for (size_t f = 0; f < batch_.size(); ++f) {
+      frame_functs_.emplace_back(octree_, update_functs[f], batch_[f].T_CM, sensor_,
+          batch_[f].depth_image, sample_offset_frac);
+    }
+  }
+
+
+
+  void apply() {
+
+    if (batch_.empty()) {
+      return;
+    }
+    const float voxel_dim = octree_.voxelDim();
+
+    /* Update the leaf Octree nodes (VoxelBlock) with all the frames. */
+    const typename DataType::template MemoryBufferType<VoxelBlockType>& block_buffer = octree_.pool().blockBuffer();
+    const size_t num_blocks = std::min(block_buffer.size(), batch_.back().num_blocks);
+#pragma omp parallel for
+    for (unsigned int i = 0; i < num_blocks; ++i) {
+      VoxelBlockType* block = block_buffer[i];
+      for (size_t f = 0; f < batch_.size(); ++f) {
+        if (i >= batch_[f].num_blocks) {
+          continue;
+        }
+        if (block->active()
+            || algorithms::in_frustum<VoxelBlockType>(block, voxel_dim, batch_[f].T_CM, sensor_)) {
+          frame_functs_[f].update_block(block, voxel_dim);
+        }
+      }
+    }
+
+    /* Update the intermediate Octree nodes (Node) inside each frame's camera
+     * frustum one frame at a time. */
+    std::unordered_set<const se::Node<DataType>*> later_octants;
+    for (size_t f = 0; f < batch_.size(); ++f) {
+      // Skip the nodes allocated by later frames of the batch.
+      internal::later_octants(later_octants, octree_, batch_[f].num_nodes, batch_[f].num_blocks);
+      frame_functs_[f].build_node_list();
+      const std::vector<se::Node<DataType>*>& node_list = frame_functs_[f].nodeList();
+#pragma omp parallel for
+      for (unsigned int i = 0; i < node_list.size(); ++i) {
+        if (later_octants.count(node_list[i]) == 0) {
+          frame_functs_[f].update_node(node_list[i], voxel_dim);
+        }
+      }
+    }
+  }
+
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+private:
+  OctreeT<DataType>& octree_;
+  const SensorImpl sensor_;
+  const se::IntegrationBatch& batch_;
+  std::vector<FrameFunctorType, Eigen::aligned_allocator<FrameFunctorType> > frame_functs_;
+};
+
+/*! \brief Create a projective_batch_functor and call
+ * projective_batch_functor::apply.
+ */
+template <typename DataType, template <typename DataT> class OctreeT,
+          typename UpdateF>
+void projective_octree_batch(OctreeT<DataType>&          octree,
+                             const Eigen::Vector3f&      sample_offset_frac,
+                             const SensorImpl&           sensor,
+                             const se::IntegrationBatch& batch,
+                             std::vector<UpdateF>&       functs) {
+
+  projective_batch_functor<DataType, OctreeT, UpdateF>
+    it(octree, functs, sensor, batch, sample_offset_frac);
+  it.apply();
+}
 }
 }
 #endif
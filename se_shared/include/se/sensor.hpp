@@ -318,7 +318,8 @@ namespace se {
      * \brief Test whether a 3D point in camera coordinates is inside the
      * sensor frustum.
      *
-     * \todo Implement
+     * Only the distance from the sensor is tested, the vertical field of
+     * view is ignored.
      */
     bool pointInFrustum(const Eigen::Vector3f& point_C) const;
 
@@ -326,8 +327,6 @@ namespace se {
      * \brief Test whether a 3D point in camera coordinates is inside the
      * sensor frustum.
      *
-     * \todo Implement
-     *
      * The difference from OusterLidar::pointInFrustum is that it is assumed
      * that the far plane is at infinity.
      */
@@ -337,9 +336,9 @@ namespace se {
      * \brief Test whether a sphere in camera coordinates is inside the sensor
      * frustum.
      *
-     * \todo Implement
-     *
-     * \todo Describe any issues/assumptions/approximations once implemented.
+     * Only the distance of the sphere from the sensor is tested, the vertical
+     * field of view is ignored. The test may thus return a sphere as being
+     * visible although it isn't.
      */
     bool sphereInFrustum(const Eigen::Vector3f& center_C,
                          const float            radius) const;
@@ -348,8 +347,6 @@ namespace se {
      * \brief Test whether a sphere in camera coordinates is inside the sensor
      * frustum.
      *
-     * \todo Implement
-     *
      * The difference from OusterLidar::sphereInFrustum is that it is assumed
      * that the far plane is at infinity.
      */
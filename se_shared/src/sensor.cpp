@@ -302,25 +302,23 @@ float se::OusterLidar::measurementFromPoint(const Eigen::Vector3f& point_C) cons
   return point_C.norm();
 }
 
-bool se::OusterLidar::pointInFrustum(const Eigen::Vector3f& /*point_C*/) const {
-  // TODO Implement
-  return false;
+bool se::OusterLidar::pointInFrustum(const Eigen::Vector3f& point_C) const {
+  const float dist = point_C.norm();
+  return (dist >= near_plane) && (dist <= far_plane);
 }
 
-bool se::OusterLidar::pointInFrustumInf(const Eigen::Vector3f& /*point_C*/) const {
-  // TODO Implement
-  return false;
+bool se::OusterLidar::pointInFrustumInf(const Eigen::Vector3f& point_C) const {
+  return point_C.norm() >= near_plane;
 }
 
-bool se::OusterLidar::sphereInFrustum(const Eigen::Vector3f& /*center_C*/,
-                                      const float            /*radius*/) const {
-  // TODO Implement
-  return false;
+bool se::OusterLidar::sphereInFrustum(const Eigen::Vector3f& center_C,
+                                      const float            radius) const {
+  const float dist = center_C.norm();
+  return (dist + radius >= near_plane) && (dist - radius <= far_plane);
 }
 
-bool se::OusterLidar::sphereInFrustumInf(const Eigen::Vector3f& /*center_C*/,
-                                         const float            /*radius*/) const {
-  // TODO Implement
-  return false;
+bool se::OusterLidar::sphereInFrustumInf(const Eigen::Vector3f& center_C,
+                                         const float            radius) const {
+  return center_C.norm() + radius >= near_plane;
 }
 
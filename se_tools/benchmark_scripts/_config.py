@@ -134,6 +134,7 @@ class General:
         self.pyramid                = None
         self.icp_threshold          = None
         self.render_volume_fullsize = None
+        self.sdf_tracking           = None
         self.drop_frames            = None
 
 
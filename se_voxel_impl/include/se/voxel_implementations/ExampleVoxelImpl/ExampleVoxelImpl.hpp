@@ -33,6 +33,7 @@
 
 #include "se/octree.hpp"
 #include "se/image/image.hpp"
+#include "se/integration_frame.hpp"
 #include "se/algorithms/meshing.hpp"
 #include "se/sensor_implementation.hpp"
 
@@ -159,7 +160,8 @@ struct ExampleVoxelImpl {
 
 
   /**
-   * Integrate a depth image into the map.
+   * Integrate a depth image into the map. The timestamp of each updated
+   * VoxelBlock must be set to frame.
    *
    * \warning The function signature must not be changed.
    */
@@ -171,6 +173,15 @@ struct ExampleVoxelImpl {
 
 
 
+  /**
+   * Integrate a batch of depth images into the map one image at a time.
+   */
+  static void integrate(OctreeType&                 map,
+                        const se::IntegrationBatch& batch,
+                        const SensorImpl&           sensor);
+
+
+
   /**
    * Cast a ray and return the point where the surface was hit.
    *
@@ -190,6 +201,29 @@ struct ExampleVoxelImpl {
   static void dumpMesh(OctreeType&                map,
                        std::vector<se::Triangle>& mesh);
 
+  /**
+   * Create an indexed mesh given the octree. Vertices shared by neighbouring
+   * triangles must only be added once, see se::meshing::IndexedMeshBuilder.
+   * Implementations storing coarser scales should mesh at min_scale or
+   * coarser to produce a lighter mesh, the others may ignore it.
+   *
+   * \warning The function signature must not be changed.
+   */
+  static void dumpMesh(OctreeType&                map,
+                       se::IndexedMesh&           mesh,
+                       const int                  min_scale = 0);
+
+  /**
+   * Create the indexed mesh of a single VoxelBlock. It must be identical to
+   * the part of the dumpMesh() mesh belonging to the VoxelBlock so that
+   * se::MeshCache can update the mesh one VoxelBlock at a time.
+   *
+   * \warning The function signature must not be changed.
+   */
+  static void dumpBlockMesh(OctreeType&                map,
+                            const VoxelBlockType*      block,
+                            se::IndexedMesh&           mesh);
+
   // Any other static functions required for the implementation go here.
 };
 
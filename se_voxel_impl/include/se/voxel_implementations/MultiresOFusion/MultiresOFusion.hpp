@@ -0,0 +1,324 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#ifndef __MULTIRESOFUSION_HPP
+#define __MULTIRESOFUSION_HPP
+
+#include <algorithm>
+#include <limits>
+
+#include "se/octree.hpp"
+#include "se/image/image.hpp"
+#include "se/integration_frame.hpp"
+#include "se/algorithms/meshing.hpp"
+#include "se/sensor_implementation.hpp"
+
+#include <yaml-cpp/yaml.h>
+
+/**
+ * Occupancy mapping voxel implementation for integration at multiple scales.
+ *
+ * Each VoxelBlock is integrated at the scale returned by
+ * SensorImpl::computeIntegrationScale(). The coarser scales of a VoxelBlock
+ * and the children data of the Nodes store the mean occupancy of the observed
+ * voxels they contain and the maximum occupancy of all the voxels they
+ * contain, unobserved voxels counting as MultiresOFusion::max_occupancy. An
+ * octant whose maximum occupancy is below MultiresOFusion::surface_boundary is
+ * thus observed free space as a whole, which allows free space queries and
+ * raycasts to terminate at coarse levels.
+ */
+struct MultiresOFusion {
+
+  /**
+   * The voxel type used as the template parameter for se::Octree.
+   */
+  struct VoxelType {
+    /**
+     * The struct stored in each se::Octree voxel.
+     */
+    struct VoxelData {
+      float x;        /**< The mean occupancy value in log-odds. */
+      float x_max;    /**< The maximum occupancy of the contained voxels in log-odds. */
+      int   y;        /**< The number of integrated measurements. */
+      bool  observed; /**< Whether the voxel has been observed at least once. */
+
+      bool operator==(const VoxelData& other) const;
+      bool operator!=(const VoxelData& other) const;
+    };
+
+    static inline VoxelData invalid()  { return {0.f, 0.f, 0, false}; }
+    static inline VoxelData initData() { return {0.f, 0.f, 0, false}; }
+
+    static float selectNodeValue(const VoxelData& data) {
+      return data.x;
+    };
+
+    static float selectVoxelValue(const VoxelData& data) {
+      return data.x;
+    };
+
+    static bool isInside(const VoxelData& data) {
+      return data.x > surface_boundary;
+    };
+
+    static bool isValid(const VoxelData& data) {
+      return data.observed;
+    };
+
+    /**
+     * Whether all the voxels contained in the octant data belongs to are
+     * observed free space. Valid at any scale and Node level.
+     */
+    static bool isFree(const VoxelData& data) {
+      return data.observed && data.x_max <= surface_boundary;
+    };
+
+    using VoxelBlockType = se::VoxelBlockFull<MultiresOFusion::VoxelType>;
+
+    /**
+     * Recompute scale of block from the observed voxels of scale - 1, pooling
+     * the mean and the maximum occupancy. Called when an outdated scale is
+     * first read, see se::VoxelBlock::dirtyAbove(). Only scale - 1 may be read
+     * from block.
+     */
+    static void propagateBlockScale(VoxelBlockType* block, const int scale);
+
+    /**
+     * Pool the mean occupancy of the observed elements of data and their
+     * maximum occupancy. Unobserved elements might be occupied, so they raise
+     * the maximum occupancy to MultiresOFusion::max_occupancy and the pooled
+     * data is never free.
+     */
+    template <typename DataIterT>
+    static VoxelData poolData(DataIterT begin, DataIterT end);
+
+    using MemoryPoolType = se::PagedMemoryPool<MultiresOFusion::VoxelType>;
+    template <typename ElemT>
+    using MemoryBufferType = se::PagedMemoryBuffer<ElemT>;
+  };
+
+  using VoxelData      = MultiresOFusion::VoxelType::VoxelData;
+  using OctreeType     = se::Octree<MultiresOFusion::VoxelType>;
+  using VoxelBlockType = typename MultiresOFusion::VoxelType::VoxelBlockType;
+
+  enum class UncertaintyModel { linear, quadratic };
+
+  /**
+   * No need to invert the normals when rendering an occupancy map.
+   */
+  static constexpr bool invert_normals = false;
+
+  /**
+   * The log-odds occupancy of a single measurement in free space and the
+   * maximum log-odds occupancy of a single measurement on the surface.
+   */
+  static constexpr float log_odd_min = -5.015f;
+  static constexpr float log_odd_max =  5.015f;
+
+  /**
+   * The surface is considered to be where the log-odds occupancy probability
+   * crosses this value.
+   *
+   *  <br>\em Default: 0
+   */
+  static float surface_boundary;
+
+  /**
+   * Stored occupancy probabilities in log-odds are clamped to never be lower
+   * than this value.
+   *
+   *  <br>\em Default: -100
+   */
+  static float min_occupancy;
+
+  /**
+   * Stored occupancy probabilities in log-odds are clamped to never be greater
+   * than this value.
+   *
+   *  <br>\em Default: 100
+   */
+  static float max_occupancy;
+
+  /**
+   * The maximum value of the weight MultiresOFusion::VoxelType::VoxelData::y.
+   *
+   *  <br>\em Default: 100
+   */
+  static int max_weight;
+
+  /**
+   * The minimum scale VoxelBlocks lying completely in free space are
+   * integrated at.
+   *
+   *  <br>\em Default: 0
+   */
+  static int free_space_integr_scale;
+
+  /**
+   * Use MultiresOFusion::tau_max as the surface thickness regardless of the
+   * measured depth.
+   *
+   *  <br>\em Default: false
+   */
+  static bool const_surface_thickness;
+
+  /**
+   * The surface thickness tau is k_tau times the measured depth clamped to
+   * [tau_min, tau_max].
+   *
+   *  <br>\em Default: 0.06, 0.16, 0.026
+   */
+  static float tau_min;
+  static float tau_max;
+  static float k_tau;
+
+  /**
+   * The measurement uncertainty sigma is k_sigma times the measured depth
+   * (linear) or its square (quadratic) clamped to [sigma_min, sigma_max].
+   *
+   *  <br>\em Default: quadratic, 0.005, 0.02, 0.0016
+   */
+  static UncertaintyModel uncertainty_model;
+  static float sigma_min;
+  static float sigma_max;
+  static float k_sigma;
+
+  static std::string type() { return "multiresofusion"; }
+
+  /**
+   * Configure the MultiresOFusion parameters
+   */
+  static void configure(const float voxel_dim);
+  static void configure(YAML::Node yaml_config, const float voxel_dim);
+
+  static std::string printConfig();
+
+  /**
+   * The surface thickness for a depth measurement.
+   */
+  static float computeTau(const float depth_value);
+
+  /**
+   * Three times the uncertainty of a depth measurement.
+   */
+  static float computeThreeSigma(const float depth_value);
+
+  /**
+   * Compute the VoxelBlocks and Nodes that need to be allocated given the
+   * camera pose.
+   */
+  static size_t buildAllocationList(OctreeType&             map,
+                                    const se::Image<float>& depth_image,
+                                    const Eigen::Matrix4f&  T_MC,
+                                    const SensorImpl&       sensor,
+                                    se::key_t*              allocation_list,
+                                    size_t                  reserved);
+
+
+
+  /**
+   * Integrate a depth image into the map.
+   */
+  static void integrate(OctreeType&             map,
+                        const se::Image<float>& depth_image,
+                        const Eigen::Matrix4f&  T_CM,
+                        const SensorImpl&       sensor,
+                        const unsigned          frame);
+
+
+
+  /**
+   * Integrate a batch of depth images into the map one image at a time.
+   */
+  static void integrate(OctreeType&                 map,
+                        const se::IntegrationBatch& batch,
+                        const SensorImpl&           sensor);
+
+
+
+  /**
+   * Cast a ray and return the point where the surface was hit. Octants that
+   * are free as a whole are skipped at the coarsest level they are stored at.
+   */
+  static Eigen::Vector4f raycast(const OctreeType&      map,
+                                 const Eigen::Vector3f& ray_origin_M,
+                                 const Eigen::Vector3f& ray_dir_M,
+                                 const float            t_near,
+                                 const float            t_far);
+
+  /**
+   * Test whether the octant of size 2^scale voxels containing point_M is free
+   * as a whole. Only the levels down to scale are traversed.
+   */
+  static bool isFree(const OctreeType&      map,
+                     const Eigen::Vector3f& point_M,
+                     const int              scale);
+
+  static void dumpMesh(OctreeType&                map,
+                       std::vector<se::Triangle>& mesh);
+
+  static void dumpMesh(OctreeType&                map,
+                       se::IndexedMesh&           mesh,
+                       const int                  min_scale = 0);
+
+  static void dumpBlockMesh(OctreeType&                map,
+                            const VoxelBlockType*      block,
+                            se::IndexedMesh&           mesh);
+
+};
+
+
+
+template <typename DataIterT>
+inline MultiresOFusion::VoxelData MultiresOFusion::VoxelType::poolData(DataIterT begin,
+                                                                      DataIterT end) {
+  VoxelData pooled_data = initData();
+  float mean = 0.f;
+  float weight = 0.f;
+  float x_max = std::numeric_limits<float>::lowest();
+  int sample_count = 0;
+  bool all_observed = true;
+  for (DataIterT it = begin; it != end; ++it) {
+    const VoxelData& data = *it;
+    if (!data.observed) {
+      all_observed = false;
+      continue;
+    }
+    x_max = std::max(x_max, data.x_max);
+    mean += data.x;
+    weight += data.y;
+    sample_count++;
+  }
+  if (sample_count > 0) {
+    pooled_data.x = mean / sample_count;
+    pooled_data.x_max = all_observed ? x_max : std::max(x_max, MultiresOFusion::max_occupancy);
+    pooled_data.y = ceil(weight / sample_count);
+    pooled_data.observed = true;
+  }
+  return pooled_data;
+}
+
+
+
+inline void MultiresOFusion::VoxelType::propagateBlockScale(VoxelBlockType* block,
+                                                            const int       scale) {
+  const Eigen::Vector3i block_coord = block->coordinates();
+  const int block_size = VoxelBlockType::size_li;
+  const int child_scale = scale - 1;
+  const int stride = 1 << scale;
+  const int child_stride = stride / 2;
+  VoxelData child_data[8];
+  for (int z = 0; z < block_size; z += stride)
+    for (int y = 0; y < block_size; y += stride)
+      for (int x = 0; x < block_size; x += stride) {
+        const Eigen::Vector3i voxel_coord = block_coord + Eigen::Vector3i(x, y, z);
+        for (int child_idx = 0; child_idx < 8; ++child_idx) {
+          const Eigen::Vector3i child_offset = child_stride * Eigen::Vector3i(
+              (child_idx & 1) > 0, (child_idx & 2) > 0, (child_idx & 4) > 0);
+          child_data[child_idx] = block->data(voxel_coord + child_offset, child_scale);
+        }
+        block->setData(voxel_coord, scale, poolData(child_data, child_data + 8));
+      }
+}
+
+#endif
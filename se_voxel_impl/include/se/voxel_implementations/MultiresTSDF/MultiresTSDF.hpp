@@ -32,6 +32,7 @@
 
 #include "se/octree.hpp"
 #include "se/image/image.hpp"
+#include "se/integration_frame.hpp"
 #include "se/algorithms/meshing.hpp"
 #include "se/sensor_implementation.hpp"
 
@@ -79,6 +80,13 @@ struct MultiresTSDF {
 
     using VoxelBlockType = se::VoxelBlockFull<MultiresTSDF::VoxelType>;
 
+    /**
+     * Recompute scale of block as the mean of the valid voxels of scale - 1.
+     * Called when an outdated scale is first read, see
+     * se::VoxelBlock::dirtyAbove(). Only scale - 1 may be read from block.
+     */
+    static void propagateBlockScale(VoxelBlockType* block, const int scale);
+
     using MemoryPoolType = se::PagedMemoryPool<MultiresTSDF::VoxelType>;
     template <typename ElemT>
     using MemoryBufferType = se::PagedMemoryBuffer<ElemT>;
@@ -114,6 +122,15 @@ struct MultiresTSDF {
    */
   static int max_weight;
 
+  /**
+   * Integrate by walking each sensor beam through the map and only updating
+   * the voxels it crosses, instead of projecting every voxel of the blocks in
+   * the frustum. Faster for sparse sensors such as OusterLidar.
+   *
+   *  <br>\em Default: false
+   */
+  static bool beam_integration;
+
   static std::string type() { return "multirestsdf"; }
 
   /**
@@ -148,6 +165,15 @@ struct MultiresTSDF {
 
 
 
+  /**
+   * Integrate a batch of depth images into the map one image at a time.
+   */
+  static void integrate(OctreeType&                 map,
+                        const se::IntegrationBatch& batch,
+                        const SensorImpl&           sensor);
+
+
+
   /**
    * Cast a ray and return the point where the surface was hit.
    */
@@ -160,7 +186,58 @@ struct MultiresTSDF {
   static void dumpMesh(OctreeType&                map,
                        std::vector<se::Triangle>& mesh);
 
+  static void dumpMesh(OctreeType&                map,
+                       se::IndexedMesh&           mesh,
+                       const int                  min_scale = 0);
+
+  static void dumpBlockMesh(OctreeType&                map,
+                            const VoxelBlockType*      block,
+                            se::IndexedMesh&           mesh);
+
 };
 
+
+
+inline void MultiresTSDF::VoxelType::propagateBlockScale(VoxelBlockType* block,
+                                                         const int       scale) {
+  const Eigen::Vector3i block_coord = block->coordinates();
+  const int block_size = VoxelBlockType::size_li;
+  const int child_scale = scale - 1;
+  const int stride = 1 << scale;
+  for (int z = 0; z < block_size; z += stride)
+    for (int y = 0; y < block_size; y += stride)
+      for (int x = 0; x < block_size; x += stride) {
+        const Eigen::Vector3i voxel_coord = block_coord + Eigen::Vector3i(x, y, z);
+
+        float mean = 0;
+        int sample_count = 0;
+        float weight = 0;
+        for (int k = 0; k < stride; k += stride / 2) {
+          for (int j = 0; j < stride; j += stride / 2) {
+            for (int i = 0; i < stride; i += stride / 2) {
+              VoxelData child_data = block->data(voxel_coord + Eigen::Vector3i(i, j, k), child_scale);
+              if (child_data.y != 0) {
+                mean += child_data.x;
+                weight += child_data.y;
+                sample_count++;
+              }
+            }
+          }
+        }
+        // All the members are overwritten, so the outdated value at scale
+        // is not read.
+        VoxelData voxel_data = initData();
+        if (sample_count != 0) {
+          mean /= sample_count;
+          weight /= sample_count;
+          voxel_data.x = mean;
+          voxel_data.x_last = mean;
+          voxel_data.y = ceil(weight);
+        }
+        voxel_data.delta_y = 0;
+        block->setData(voxel_coord, scale, voxel_data);
+      }
+}
+
 #endif
 
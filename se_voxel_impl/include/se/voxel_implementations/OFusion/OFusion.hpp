@@ -31,6 +31,7 @@
 
 #include "se/octree.hpp"
 #include "se/image/image.hpp"
+#include "se/integration_frame.hpp"
 #include "se/algorithms/meshing.hpp"
 #include "se/sensor_implementation.hpp"
 
@@ -46,11 +47,13 @@ struct OFusion {
    */
   struct VoxelType {
     /**
-     * The struct stored in each se::Octree voxel.
+     * The struct stored in each se::Octree voxel. Kept at 8 bytes so that a
+     * VoxelBlock fits twice as many voxels per cache line as with a double
+     * timestamp.
      */
     struct VoxelData {
-      float  x; /**< The occupancy value in log-odds. */
-      double y; /**< The timestamp of the last update. */
+      float x; /**< The occupancy value in log-odds. */
+      float y; /**< The timestamp of the last update in seconds. */
 
       bool operator==(const VoxelData& other) const;
       bool operator!=(const VoxelData& other) const;
@@ -130,6 +133,15 @@ struct OFusion {
    */
   static float k_sigma;
 
+  /**
+   * Integrate by walking each sensor beam through the map and only updating
+   * the voxels it crosses, instead of projecting every voxel of the blocks in
+   * the frustum. Faster for sparse sensors such as OusterLidar.
+   *
+   *  <br>\em Default: false
+   */
+  static bool beam_integration;
+
   static std::string type() { return "ofusion"; }
 
   /**
@@ -164,6 +176,15 @@ struct OFusion {
 
 
 
+  /**
+   * Integrate a batch of depth images into the map one image at a time.
+   */
+  static void integrate(OctreeType&                 map,
+                        const se::IntegrationBatch& batch,
+                        const SensorImpl&           sensor);
+
+
+
   /**
    * Cast a ray and return the point where the surface was hit.
    */
@@ -176,6 +197,14 @@ struct OFusion {
   static void dumpMesh(OctreeType&                map,
                        std::vector<se::Triangle>& mesh);
 
+  static void dumpMesh(OctreeType&                map,
+                       se::IndexedMesh&           mesh,
+                       const int                  min_scale = 0);
+
+  static void dumpBlockMesh(OctreeType&                map,
+                            const VoxelBlockType*      block,
+                            se::IndexedMesh&           mesh);
+
 };
 
 #endif
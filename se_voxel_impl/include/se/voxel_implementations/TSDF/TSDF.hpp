@@ -31,6 +31,7 @@
 
 #include "se/octree.hpp"
 #include "se/image/image.hpp"
+#include "se/integration_frame.hpp"
 #include "se/algorithms/meshing.hpp"
 #include "se/sensor_implementation.hpp"
 
@@ -111,6 +112,15 @@ struct TSDF {
    */
   static float max_weight;
 
+  /**
+   * Integrate by walking each sensor beam through the map and only updating
+   * the voxels it crosses, instead of projecting every voxel of the blocks in
+   * the frustum. Faster for sparse sensors such as OusterLidar.
+   *
+   *  <br>\em Default: false
+   */
+  static bool beam_integration;
+
   static std::string type() { return "tsdf"; }
 
   /**
@@ -145,6 +155,17 @@ struct TSDF {
 
 
 
+  /**
+   * Integrate a batch of depth images into the map, visiting each
+   * VoxelBlock once for the whole batch. The result is identical to
+   * integrating the images one by one in order.
+   */
+  static void integrate(OctreeType&                 map,
+                        const se::IntegrationBatch& batch,
+                        const SensorImpl&           sensor);
+
+
+
   /**
    * Cast a ray and return the point where the surface was hit.
    */
@@ -157,6 +178,14 @@ struct TSDF {
   static void dumpMesh(OctreeType&                map,
                        std::vector<se::Triangle>& mesh);
 
+  static void dumpMesh(OctreeType&                map,
+                       se::IndexedMesh&           mesh,
+                       const int                  min_scale = 0);
+
+  static void dumpBlockMesh(OctreeType&                map,
+                            const VoxelBlockType*      block,
+                            se::IndexedMesh&           mesh);
+
 };
 
 #endif
@@ -76,6 +76,16 @@ void ExampleVoxelImpl::integrate(OctreeType&             map,
 
 
 
+void ExampleVoxelImpl::integrate(OctreeType&                 map,
+                                 const se::IntegrationBatch& batch,
+                                 const SensorImpl&           sensor) {
+  for (const auto& frame : batch) {
+    integrate(map, frame.depth_image, frame.T_CM, sensor, frame.frame);
+  }
+}
+
+
+
 Eigen::Vector4f ExampleVoxelImpl::raycast(const OctreeType&      map,
                                           const Eigen::Vector3f& ray_origin_M,
                                           const Eigen::Vector3f& ray_dir_M,
@@ -88,3 +98,17 @@ void ExampleVoxelImpl::dumpMesh(OctreeType&                map,
                                 std::vector<se::Triangle>& mesh) {
 }
 
+
+
+void ExampleVoxelImpl::dumpMesh(OctreeType&                map,
+                                se::IndexedMesh&           mesh,
+                                const int                  /* min_scale */) {
+}
+
+
+
+void ExampleVoxelImpl::dumpBlockMesh(OctreeType&                map,
+                                     const VoxelBlockType*      block,
+                                     se::IndexedMesh&           mesh) {
+}
+
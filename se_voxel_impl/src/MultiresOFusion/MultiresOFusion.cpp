@@ -0,0 +1,167 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "se/voxel_implementations/MultiresOFusion/MultiresOFusion.hpp"
+
+#include <iostream>
+
+#include "se/str_utils.hpp"
+
+
+
+bool MultiresOFusion::VoxelType::VoxelData::operator==(const MultiresOFusion::VoxelType::VoxelData& other) const {
+  return (x == other.x) && (x_max == other.x_max)
+      && (y == other.y) && (observed == other.observed);
+}
+
+bool MultiresOFusion::VoxelType::VoxelData::operator!=(const MultiresOFusion::VoxelType::VoxelData& other) const {
+  return !(*this == other);
+}
+
+// Initialize static data members.
+constexpr bool MultiresOFusion::invert_normals;
+constexpr float MultiresOFusion::log_odd_min;
+constexpr float MultiresOFusion::log_odd_max;
+float MultiresOFusion::surface_boundary;
+float MultiresOFusion::min_occupancy;
+float MultiresOFusion::max_occupancy;
+int   MultiresOFusion::max_weight;
+int   MultiresOFusion::free_space_integr_scale;
+bool  MultiresOFusion::const_surface_thickness;
+float MultiresOFusion::tau_min;
+float MultiresOFusion::tau_max;
+float MultiresOFusion::k_tau;
+MultiresOFusion::UncertaintyModel MultiresOFusion::uncertainty_model;
+float MultiresOFusion::sigma_min;
+float MultiresOFusion::sigma_max;
+float MultiresOFusion::k_sigma;
+
+void MultiresOFusion::configure(const float /* voxel_dim */) {
+  surface_boundary        = 0.f;
+  min_occupancy           = -100;
+  max_occupancy           =  100;
+  max_weight              = 100;
+  free_space_integr_scale = 0;
+  const_surface_thickness = false;
+  tau_min                 = 0.06;
+  tau_max                 = 0.16;
+  k_tau                   = 0.026;
+  uncertainty_model       = UncertaintyModel::quadratic;
+  sigma_min               = 0.005;
+  sigma_max               = 0.02;
+  k_sigma                 = 0.0016;
+}
+
+void MultiresOFusion::configure(YAML::Node yaml_config, const float voxel_dim) {
+  configure(voxel_dim);
+
+  if (yaml_config.IsNull()) {
+    return;
+  }
+
+  if (yaml_config["surface_boundary"]) {
+    surface_boundary = yaml_config["surface_boundary"].as<float>();
+  }
+  if (yaml_config["occupancy_min_max"]) {
+    std::vector<float> occupancy_min_max = yaml_config["occupancy_min_max"].as<std::vector<float>>();
+    min_occupancy = occupancy_min_max[0];
+    max_occupancy = occupancy_min_max[1];
+  }
+  if (yaml_config["max_weight"]) {
+    max_weight = yaml_config["max_weight"].as<int>();
+  }
+  if (yaml_config["free_space_integr_scale"]) {
+    free_space_integr_scale = yaml_config["free_space_integr_scale"].as<int>();
+  }
+  if (yaml_config["const_surface_thickness"]) {
+    const_surface_thickness = yaml_config["const_surface_thickness"].as<bool>();
+  }
+  if (yaml_config["tau_min_max"]) {
+    std::vector<float> tau_min_max = yaml_config["tau_min_max"].as<std::vector<float>>();
+    tau_min = tau_min_max[0];
+    tau_max = tau_min_max[1];
+  }
+  if (yaml_config["k_tau"]) {
+    k_tau = yaml_config["k_tau"].as<float>();
+  }
+  if (yaml_config["uncertainty_model"]) {
+    const std::string model = yaml_config["uncertainty_model"].as<std::string>();
+    if (model == "linear") {
+      uncertainty_model = UncertaintyModel::linear;
+    } else if (model == "quadratic") {
+      uncertainty_model = UncertaintyModel::quadratic;
+    } else {
+      std::cerr << "Error: Invalid uncertainty model " << model
+                << ", using quadratic instead\n";
+    }
+  }
+  if (yaml_config["sigma_min_max"]) {
+    std::vector<float> sigma_min_max = yaml_config["sigma_min_max"].as<std::vector<float>>();
+    sigma_min = sigma_min_max[0];
+    sigma_max = sigma_min_max[1];
+  }
+  if (yaml_config["k_sigma"]) {
+    k_sigma = yaml_config["k_sigma"].as<float>();
+  }
+}
+
+std::string MultiresOFusion::printConfig() {
+
+  std::stringstream out;
+  out << str_utils::header_to_pretty_str("VOXEL IMPL") << "\n";
+  out << str_utils::bool_to_pretty_str(MultiresOFusion::invert_normals,           "Invert normals") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::surface_boundary,        "Surface boundary") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::min_occupancy,           "Min occupancy") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::max_occupancy,           "Max occupancy") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::max_weight,              "Max weight") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::free_space_integr_scale, "Free space integration scale") << "\n";
+  out << str_utils::bool_to_pretty_str(MultiresOFusion::const_surface_thickness,  "Constant surface thickness") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::tau_min,                 "tau min") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::tau_max,                 "tau max") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::k_tau,                   "k tau") << "\n";
+  out << str_utils::str_to_pretty_str((MultiresOFusion::uncertainty_model == UncertaintyModel::linear)
+      ? "linear" : "quadratic", "Uncertainty model") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::sigma_min,               "sigma min") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::sigma_max,               "sigma max") << "\n";
+  out << str_utils::value_to_pretty_str(MultiresOFusion::k_sigma,                 "k sigma") << "\n";
+  out << "\n";
+  return out.str();
+}
+
+float MultiresOFusion::computeTau(const float depth_value) {
+  if (const_surface_thickness) {
+    return tau_max;
+  }
+  return se::math::clamp(k_tau * depth_value, tau_min, tau_max);
+}
+
+float MultiresOFusion::computeThreeSigma(const float depth_value) {
+  const float sigma = (uncertainty_model == UncertaintyModel::linear)
+      ? k_sigma * depth_value
+      : k_sigma * se::math::sq(depth_value);
+  return 3.f * se::math::clamp(sigma, sigma_min, sigma_max);
+}
+
+void MultiresOFusion::dumpMesh(OctreeType&                map,
+                               std::vector<se::Triangle>& mesh) {
+
+  se::algorithms::dual_marching_cube(map, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
+}
+
+
+
+void MultiresOFusion::dumpMesh(OctreeType&                map,
+                               se::IndexedMesh&           mesh,
+                               const int                  min_scale) {
+
+  se::algorithms::dual_marching_cube(map, VoxelType::selectVoxelValue, VoxelType::isInside, mesh, min_scale);
+}
+
+
+
+void MultiresOFusion::dumpBlockMesh(OctreeType&                map,
+                                    const VoxelBlockType*      block,
+                                    se::IndexedMesh&           mesh) {
+
+  se::algorithms::dual_marching_cube_block(map, block, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
+}
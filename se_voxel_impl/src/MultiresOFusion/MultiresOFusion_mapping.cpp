@@ -0,0 +1,321 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "se/voxel_implementations/MultiresOFusion/MultiresOFusion.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+#include "se/node.hpp"
+#include "se/octree.hpp"
+#include "se/image/image.hpp"
+#include "se/filter.hpp"
+#include "se/perfstats.h"
+#include "se/projective_functor.hpp"
+#include "se/functors/for_each.hpp"
+#include "se/functors/propagate_up.hpp"
+
+
+
+// The number of block scales the integration marked as outdated and the
+// number of them that were still outdated from a previous update, i.e. whose
+// recomputation was avoided.
+static std::atomic<size_t> num_dirtied_scales(0);
+static std::atomic<size_t> num_avoided_propagations(0);
+
+
+
+struct MultiresOFusionUpdate {
+
+  using VoxelType      = MultiresOFusion::VoxelType;
+  using VoxelData      = MultiresOFusion::VoxelType::VoxelData;
+  using OctreeType     = se::Octree<MultiresOFusion::VoxelType>;
+  using NodeType       = se::Node<MultiresOFusion::VoxelType>;
+  using VoxelBlockType = typename MultiresOFusion::VoxelType::VoxelBlockType;
+
+  MultiresOFusionUpdate(const OctreeType&       map,
+                        const se::Image<float>& depth_image,
+                        const Eigen::Matrix4f&  T_CM,
+                        const SensorImpl        sensor,
+                        const float             voxel_dim,
+                        const unsigned          frame) :
+      map_(map),
+      depth_image_(depth_image),
+      T_CM_(T_CM),
+      sensor_(sensor),
+      voxel_dim_(voxel_dim),
+      sample_offset_frac_(map.sample_offset_frac_),
+      frame_(frame) {}
+
+  const OctreeType& map_;
+  const se::Image<float>& depth_image_;
+  const Eigen::Matrix4f& T_CM_;
+  const SensorImpl sensor_;
+  const float voxel_dim_;
+  const Eigen::Vector3f& sample_offset_frac_;
+  const unsigned frame_;
+
+
+
+  /**
+   * Fuse the measurement depth_value of point_C into data. The log-odds
+   * occupancy of the measurement is log_odd_min in front of the surface,
+   * rises linearly within three sigma of the surface and stays constant
+   * for half the surface thickness tau behind it.
+   *
+   * \return Whether point_C was close enough to the surface to be updated.
+   */
+  static bool updateVoxel(VoxelData&             data,
+                          const Eigen::Vector3f& point_C,
+                          const float            depth_value,
+                          const SensorImpl&      sensor) {
+
+    const float m = sensor.measurementFromPoint(point_C);
+    const float range_diff = (m - depth_value) / m * point_C.norm();
+    const float tau = MultiresOFusion::computeTau(depth_value);
+    const float three_sigma = MultiresOFusion::computeThreeSigma(depth_value);
+
+    float sample_value;
+    if (range_diff < -three_sigma) {
+      sample_value = MultiresOFusion::log_odd_min;
+    } else if (range_diff < tau / 2) {
+      sample_value = std::min(MultiresOFusion::log_odd_min
+          - MultiresOFusion::log_odd_min / three_sigma * (range_diff + three_sigma),
+          MultiresOFusion::log_odd_max);
+    } else if (range_diff < tau) {
+      sample_value = std::min(-MultiresOFusion::log_odd_min * tau / (2 * three_sigma),
+          MultiresOFusion::log_odd_max);
+    } else {
+      return false;
+    }
+
+    data.x = se::math::clamp(
+        (static_cast<float>(data.y) * data.x + sample_value) / (static_cast<float>(data.y) + 1.f),
+        MultiresOFusion::min_occupancy, MultiresOFusion::max_occupancy);
+    data.x_max = data.x;
+    data.y = std::min(data.y + 1, MultiresOFusion::max_weight);
+    data.observed = true;
+    return true;
+  }
+
+
+
+  /**
+   * Update the data of an unallocated child of a Node, used by
+   * se::functor::projective_functor::update_node. The whole child is covered
+   * by a single measurement, so its maximum is its mean occupancy.
+   */
+  void operator()(se::NodeHandler<VoxelType>& handler,
+                  const Eigen::Vector3f&      point_C,
+                  const float                 depth_value) {
+
+    VoxelData data = handler.get();
+    if (updateVoxel(data, point_C, depth_value, sensor_)) {
+      handler.set(data);
+    }
+  }
+
+
+
+  /**
+   * Copy the data of each voxel at scale to its children at the finer scales
+   * down to min_scale. Since the data at scale fuses all the measurements
+   * integrated so far, only resolution is lost.
+   */
+  static void propagateDown(VoxelBlockType* block,
+                            const int       scale,
+                            const int       min_scale) {
+
+    const Eigen::Vector3i block_coord = block->coordinates();
+    const int block_size = VoxelBlockType::size_li;
+    for (int voxel_scale = scale; voxel_scale > min_scale; --voxel_scale) {
+      const int stride = 1 << voxel_scale;
+      const int half_stride = stride / 2;
+      for (int z = 0; z < block_size; z += stride) {
+        for (int y = 0; y < block_size; y += stride) {
+          for (int x = 0; x < block_size; x += stride) {
+            const Eigen::Vector3i parent_coord = block_coord + Eigen::Vector3i(x, y, z);
+            VoxelData parent_data = block->data(parent_coord, voxel_scale);
+            parent_data.x_max = parent_data.x;
+            for (int k = 0; k < stride; k += half_stride) {
+              for (int j = 0; j < stride; j += half_stride) {
+                for (int i = 0; i < stride; i += half_stride) {
+                  block->setData(parent_coord + Eigen::Vector3i(i, j, k), voxel_scale - 1, parent_data);
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+
+
+
+  /**
+   * Update a voxel block at the scale returned by
+   * SensorImpl::computeIntegrationScale(). Blocks lying completely in front of
+   * the measured surface are integrated at least at
+   * MultiresOFusion::free_space_integr_scale.
+   */
+  void operator()(VoxelBlockType* block) {
+
+    constexpr int block_size = VoxelBlockType::size_li;
+    const Eigen::Vector3i block_coord = block->coordinates();
+    const Eigen::Vector3f block_centre_coord_f =
+        se::get_sample_coord(block_coord, block_size, Eigen::Vector3f::Constant(0.5f));
+    const Eigen::Vector3f block_centre_point_C = (T_CM_ * (voxel_dim_ * block_centre_coord_f).homogeneous()).head(3);
+    const int last_scale = block->current_scale();
+
+    int scale = sensor_.computeIntegrationScale(
+        block_centre_point_C, voxel_dim_, last_scale, block->min_scale(), map_.maxBlockScale());
+    float block_centre_depth_value(0);
+    if (sensor_.projectToPixelValue(block_centre_point_C, depth_image_, block_centre_depth_value,
+        [&](float depth_value){ return depth_value >= sensor_.near_plane; })) {
+      const float block_radius = 0.5f * std::sqrt(3.f) * block_size * voxel_dim_;
+      if (sensor_.measurementFromPoint(block_centre_point_C) + block_radius
+          < block_centre_depth_value - MultiresOFusion::computeThreeSigma(block_centre_depth_value)) {
+        scale = std::max(scale, MultiresOFusion::free_space_integr_scale);
+      }
+    }
+    scale = std::min(scale, map_.maxBlockScale());
+
+    if (block->min_scale() >= 0 && scale < last_scale) {
+      propagateDown(block, last_scale, scale);
+    }
+
+    bool is_visible = false;
+    const int stride = 1 << scale;
+    for (unsigned int z = 0; z < block_size; z += stride) {
+      for (unsigned int y = 0; y < block_size; y += stride) {
+        for (unsigned int x = 0; x < block_size; x += stride) {
+          const Eigen::Vector3i voxel_coord = block_coord + Eigen::Vector3i(x, y, z);
+          const Eigen::Vector3f voxel_sample_coord_f =
+              se::get_sample_coord(voxel_coord, stride, sample_offset_frac_);
+          const Eigen::Vector3f point_C = (T_CM_ * (voxel_dim_ * voxel_sample_coord_f).homogeneous()).head(3);
+
+          // Don't update the point if the sample point is behind the far plane
+          if (point_C.norm() > sensor_.farDist(point_C)) {
+            continue;
+          }
+          float depth_value(0);
+          if (!sensor_.projectToPixelValue(point_C, depth_image_, depth_value,
+              [&](float depth_value){ return depth_value >= sensor_.near_plane; })) {
+            continue;
+          }
+
+          is_visible = true;
+
+          VoxelData voxel_data = block->data(voxel_coord, scale);
+          if (updateVoxel(voxel_data, point_C, depth_value, sensor_)) {
+            block->setData(voxel_coord, scale, voxel_data);
+          }
+        }
+      }
+    }
+    block->current_scale(scale);
+    block->min_scale(block->min_scale() < 0 ? scale : std::min(block->min_scale(), scale));
+    // The coarser scales are only recomputed once they are read.
+    for (int voxel_scale = scale + 1; voxel_scale <= static_cast<int>(VoxelBlockType::max_scale); ++voxel_scale) {
+      num_avoided_propagations += block->dirty(voxel_scale);
+    }
+    num_dirtied_scales += VoxelBlockType::max_scale - scale;
+    block->dirtyAbove(scale);
+    block->active(is_visible);
+    if (is_visible || scale != last_scale) {
+      block->timestamp(frame_);
+    }
+  }
+
+
+
+  /**
+   * Pool the mean and maximum occupancy of each allocated child of node into
+   * the corresponding node->childData(). The data of children without any
+   * observed voxels is left untouched.
+   */
+  static void propagateUp(NodeType* node) {
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      NodeType* child = node->child(child_idx);
+      if (!child) {
+        continue;
+      }
+      VoxelData child_data;
+      if (child->isBlock()) {
+        const VoxelBlockType* block = static_cast<const VoxelBlockType*>(child);
+        child_data = block->data(block->coordinates(), VoxelBlockType::max_scale);
+      } else {
+        child_data = VoxelType::poolData(child->childrenData(), child->childrenData() + 8);
+      }
+      if (child_data.observed) {
+        node->childData(child_idx, child_data);
+      }
+    }
+  }
+};
+
+
+
+void MultiresOFusion::integrate(OctreeType&             map,
+                                const se::Image<float>& depth_image,
+                                const Eigen::Matrix4f&  T_CM,
+                                const SensorImpl&       sensor,
+                                const unsigned          frame) {
+
+  const float voxel_dim = map.dim() / map.size();
+  struct MultiresOFusionUpdate funct(map, depth_image, T_CM, sensor, voxel_dim, frame);
+
+  /* Retrieve the active list */
+  std::vector<VoxelBlockType *> active_list;
+  auto& block_buffer = map.pool().blockBuffer();
+
+  /* Predicates definition */
+  auto in_frustum_predicate =
+  std::bind(se::algorithms::in_frustum<VoxelBlockType>,
+      std::placeholders::_1, voxel_dim, T_CM, sensor);
+  auto is_active_predicate = [](const VoxelBlockType* block) {
+    return block->active();
+  };
+  se::algorithms::filter(active_list, block_buffer, is_active_predicate,
+                         in_frustum_predicate);
+
+  se::functor::internal::parallel_for_each(active_list, funct);
+
+  /* Carve the free space stored in the Nodes inside the camera frustum. */
+  se::functor::projective_functor<VoxelType, se::Octree, MultiresOFusionUpdate>
+    node_funct(map, funct, T_CM, sensor, depth_image, map.sample_offset_frac_);
+  node_funct.build_node_list();
+  const std::vector<se::Node<VoxelType>*>& node_list = node_funct.nodeList();
+#pragma omp parallel for
+  for (unsigned int i = 0; i < node_list.size(); ++i) {
+    // The data of allocated children is pooled from their own children and
+    // must not be overwritten.
+    node_funct.update_node(node_list[i], voxel_dim,
+        [](const se::Node<VoxelType>* child) { return child != nullptr; });
+  }
+
+  /* Pool the occupancy of the updated VoxelBlocks and Nodes up to the root. */
+  std::vector<se::Node<VoxelType>*> updated_octants (active_list.begin(), active_list.end());
+  updated_octants.insert(updated_octants.end(), node_list.begin(), node_list.end());
+  se::functor::propagate_up(updated_octants, MultiresOFusionUpdate::propagateUp);
+
+  // Block scales that were outdated again before being read, over all the
+  // block scales an eager propagation would have recomputed.
+  const size_t num_dirtied = num_dirtied_scales.exchange(0);
+  const size_t num_avoided = num_avoided_propagations.exchange(0);
+  se::perfstats.sample("propagation_avoided",
+      (num_dirtied > 0) ? 100.0 * num_avoided / num_dirtied : 0.0,
+      PerfStats::PERCENTAGE);
+}
+
+
+
+void MultiresOFusion::integrate(OctreeType&                 map,
+                                const se::IntegrationBatch& batch,
+                                const SensorImpl&           sensor) {
+
+  for (const auto& frame : batch) {
+    integrate(map, frame.depth_image, frame.T_CM, sensor, frame.frame);
+  }
+}
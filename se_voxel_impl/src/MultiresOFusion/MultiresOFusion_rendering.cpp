@@ -0,0 +1,152 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include "se/voxel_implementations/MultiresOFusion/MultiresOFusion.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include "se/utils/math_utils.h"
+
+
+
+/**
+ * Return the data of the coarsest octant containing voxel_coord that is free
+ * as a whole or, if there is none, the data at the finest level available.
+ * The scale the data was extracted from is returned.
+ */
+static int coarsest_data(const MultiresOFusion::OctreeType& map,
+                         const Eigen::Vector3i&             voxel_coord,
+                         const int                          min_scale,
+                         MultiresOFusion::VoxelData&        data) {
+
+  using VoxelBlockType = MultiresOFusion::VoxelBlockType;
+
+  const se::Node<MultiresOFusion::VoxelType>* node = map.root();
+  if (!node) {
+    data = MultiresOFusion::VoxelType::initData();
+    return se::math::log2_const(map.size());
+  }
+
+  const int block_size = VoxelBlockType::size_li;
+  for (int node_size = map.size() >> 1; node_size >= block_size; node_size >>= 1) {
+    const int child_idx = ((voxel_coord.x() & node_size) > 0)
+        + 2 * ((voxel_coord.y() & node_size) > 0) + 4 * ((voxel_coord.z() & node_size) > 0);
+    data = node->childrenData()[child_idx];
+    const int scale = se::math::log2_const(node_size);
+    const se::Node<MultiresOFusion::VoxelType>* child = node->child(child_idx);
+    if (!child || scale <= min_scale || MultiresOFusion::VoxelType::isFree(data)) {
+      return scale;
+    }
+    node = child;
+  }
+
+  const VoxelBlockType* block = static_cast<const VoxelBlockType*>(node);
+  const int finest_scale = std::max(block->current_scale(), min_scale);
+  for (int scale = VoxelBlockType::max_scale; scale > finest_scale; --scale) {
+    data = block->data(voxel_coord, scale);
+    if (MultiresOFusion::VoxelType::isFree(data)) {
+      return scale;
+    }
+  }
+  data = block->data(voxel_coord, finest_scale);
+  return finest_scale;
+}
+
+
+
+/**
+ * The ray parameter where the ray exits the octant of size 2^scale voxels
+ * containing voxel_coord.
+ */
+static float octant_exit(const Eigen::Vector3i& voxel_coord,
+                         const int              scale,
+                         const float            voxel_dim,
+                         const Eigen::Vector3f& ray_origin_M,
+                         const Eigen::Vector3f& ray_dir_M) {
+
+  const int octant_size = 1 << scale;
+  const Eigen::Vector3i octant_coord = (voxel_coord / octant_size) * octant_size;
+  float t_exit = std::numeric_limits<float>::infinity();
+  for (int i = 0; i < 3; ++i) {
+    if (ray_dir_M[i] == 0.f) {
+      continue;
+    }
+    const float face_M = voxel_dim * (octant_coord[i] + ((ray_dir_M[i] > 0.f) ? octant_size : 0));
+    t_exit = std::min(t_exit, (face_M - ray_origin_M[i]) / ray_dir_M[i]);
+  }
+  return t_exit;
+}
+
+
+
+Eigen::Vector4f MultiresOFusion::raycast(const OctreeType&      map,
+                                         const Eigen::Vector3f& ray_origin_M,
+                                         const Eigen::Vector3f& ray_dir_M,
+                                         const float            t_near,
+                                         const float            t_far) {
+
+  const float voxel_dim = map.voxelDim();
+  // Nudge the ray past octant boundaries so that it makes progress.
+  const float epsilon = 0.01f * voxel_dim;
+
+  float t = t_near;
+  bool prev_valid = false;
+  float value_t = 0.f;
+  float t_prev = t;
+  while (t < t_far) {
+    const Eigen::Vector3f ray_pos_M = ray_origin_M + t * ray_dir_M;
+    if (!map.containsPoint(ray_pos_M)) {
+      break;
+    }
+    const Eigen::Vector3i voxel_coord = map.pointToVoxel(ray_pos_M);
+    VoxelData data;
+    const int scale = coarsest_data(map, voxel_coord, 0, data);
+
+    if (!data.observed) {
+      // Unknown space can't contain the surface.
+      prev_valid = false;
+    } else if (VoxelType::isFree(data)) {
+      // The whole octant is free, the last free point is where the ray exits
+      // it.
+      prev_valid = true;
+      value_t = data.x;
+      t = std::max(octant_exit(voxel_coord, scale, voxel_dim, ray_origin_M, ray_dir_M), t) + epsilon;
+      t_prev = t;
+      continue;
+    } else if (data.x > surface_boundary) {
+      if (t == t_near) {
+        // Started inside the surface.
+        return Eigen::Vector4f::Constant(-1.f);
+      }
+      // Move backwards to the surface boundary crossing unless the ray came
+      // from unknown space.
+      const float t_hit = prev_valid
+          ? t - (t - t_prev) * (data.x - surface_boundary) / (data.x - value_t)
+          : t;
+      Eigen::Vector4f surface_point_M = (ray_origin_M + ray_dir_M * t_hit).homogeneous();
+      surface_point_M.w() = std::min(scale, static_cast<int>(VoxelBlockType::max_scale));
+      return surface_point_M;
+    } else {
+      // Observed but not free as a whole, march with half voxel steps.
+      prev_valid = true;
+      value_t = data.x;
+      t_prev = t;
+      t += 0.5f * voxel_dim * (1 << scale);
+      continue;
+    }
+    t = std::max(octant_exit(voxel_coord, scale, voxel_dim, ray_origin_M, ray_dir_M), t) + epsilon;
+  }
+  return Eigen::Vector4f::Constant(-1.f);
+}
+
+
+
+bool MultiresOFusion::isFree(const OctreeType&      map,
+                             const Eigen::Vector3f& point_M,
+                             const int              scale) {
+
+  VoxelData data;
+  coarsest_data(map, map.pointToVoxel(point_M), scale, data);
+  return VoxelType::isFree(data);
+}
@@ -48,10 +48,12 @@ constexpr bool MultiresTSDF::invert_normals;
 float MultiresTSDF::mu_factor;
 float MultiresTSDF::mu;
 int   MultiresTSDF::max_weight;
+bool  MultiresTSDF::beam_integration;
 
 void MultiresTSDF::configure(const float voxel_dim) {
   mu         = 8 * voxel_dim;
   max_weight = 100;
+  beam_integration = false;
 }
 
 void MultiresTSDF::configure(YAML::Node yaml_config, const float voxel_dim) {
@@ -70,6 +72,9 @@ void MultiresTSDF::configure(YAML::Node yaml_config, const float voxel_dim) {
   if (yaml_config["max_weight"]) {
     max_weight = yaml_config["max_weight"].as<float>();
   }
+  if (yaml_config["beam_integration"]) {
+    beam_integration = yaml_config["beam_integration"].as<bool>();
+  }
 }
 
 std::string MultiresTSDF::printConfig() {
@@ -80,6 +85,7 @@ std::string MultiresTSDF::printConfig() {
   out << str_utils::value_to_pretty_str(MultiresTSDF::mu_factor,     "mu factor") << "\n";
   out << str_utils::value_to_pretty_str(MultiresTSDF::mu,            "mu") << "\n";
   out << str_utils::value_to_pretty_str(MultiresTSDF::max_weight,    "Max weight") << "\n";
+  out << str_utils::bool_to_pretty_str(MultiresTSDF::beam_integration, "Beam integration") << "\n";
   out << "\n";
   return out.str();
 }
@@ -89,3 +95,21 @@ void MultiresTSDF::dumpMesh(OctreeType&                map,
 
   se::algorithms::dual_marching_cube(map, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
 }
+
+
+
+void MultiresTSDF::dumpMesh(OctreeType&                map,
+                            se::IndexedMesh&           mesh,
+                            const int                  min_scale) {
+
+  se::algorithms::dual_marching_cube(map, VoxelType::selectVoxelValue, VoxelType::isInside, mesh, min_scale);
+}
+
+
+
+void MultiresTSDF::dumpBlockMesh(OctreeType&                map,
+                                 const VoxelBlockType*      block,
+                                 se::IndexedMesh&           mesh) {
+
+  se::algorithms::dual_marching_cube_block(map, block, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
+}
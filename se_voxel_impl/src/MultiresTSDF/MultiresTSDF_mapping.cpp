@@ -31,12 +31,27 @@
 
 #include "se/voxel_implementations/MultiresTSDF/MultiresTSDF.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+
 #include "se/node.hpp"
 #include "se/octree.hpp"
 #include "se/image/image.hpp"
 #include "se/image_utils.hpp"
+#include "se/beam_functor.hpp"
 #include "se/filter.hpp"
+#include "se/perfstats.h"
 #include "se/functors/for_each.hpp"
+#include "se/functors/propagate_up.hpp"
+
+
+
+// The number of block scales the integration marked as outdated and the
+// number of them that were still outdated from a previous update, i.e. whose
+// recomputation was avoided.
+static std::atomic<size_t> num_dirtied_scales(0);
+static std::atomic<size_t> num_avoided_propagations(0);
 
 
 
@@ -52,13 +67,15 @@ struct MultiresTSDFUpdate {
                      const se::Image<float>& depth_image,
                      const Eigen::Matrix4f&  T_CM,
                      const SensorImpl        sensor,
-                     const float             voxel_dim) :
+                     const float             voxel_dim,
+                     const unsigned          frame) :
       map_(map),
       depth_image_(depth_image),
       T_CM_(T_CM),
       sensor_(sensor),
       voxel_dim_(voxel_dim),
-      sample_offset_frac_(map.sample_offset_frac_) {}
+      sample_offset_frac_(map.sample_offset_frac_),
+      frame_(frame) {}
 
   const OctreeType& map_;
   const se::Image<float>& depth_image_;
@@ -66,6 +83,7 @@ struct MultiresTSDFUpdate {
   const SensorImpl sensor_;
   const float voxel_dim_;
   const Eigen::Vector3f& sample_offset_frac_;
+  const unsigned frame_;
 
   /**
    * Update the subgrids of a voxel block starting from a given scale up
@@ -76,80 +94,56 @@ struct MultiresTSDFUpdate {
    */
   static void propagateUp(VoxelBlockType* block,
                           const int       scale) {
-    const Eigen::Vector3i block_coord = block->coordinates();
-    const int block_size = VoxelBlockType::size_li;
-    for (int voxel_scale = scale; voxel_scale < se::math::log2_const(block_size); ++voxel_scale) {
-      const int stride = 1 << (voxel_scale + 1);
-      for (int z = 0; z < block_size; z += stride)
-        for (int y = 0; y < block_size; y += stride)
-          for (int x = 0; x < block_size; x += stride) {
-            const Eigen::Vector3i voxel_coord = block_coord + Eigen::Vector3i(x, y, z);
-
-            float mean = 0;
-            int sample_count = 0;
-            float weight = 0;
-            for (int k = 0; k < stride; k += stride / 2) {
-              for (int j = 0; j < stride; j += stride / 2) {
-                for (int i = 0; i < stride; i += stride / 2) {
-                  VoxelData child_data = block->data(voxel_coord + Eigen::Vector3i(i, j, k), voxel_scale);
-                  if (child_data.y != 0) {
-                    mean += child_data.x;
-                    weight += child_data.y;
-                    sample_count++;
-                  }
-                }
-              }
-            }
-            VoxelData voxel_data = block->data(voxel_coord, voxel_scale + 1);
-
-            if (sample_count != 0) {
-              mean /= sample_count;
-              weight /= sample_count;
-              voxel_data.x = mean;
-              voxel_data.x_last = mean;
-              voxel_data.y = ceil(weight);
-            } else {
-              voxel_data = VoxelType::initData();
-            }
-            voxel_data.delta_y = 0;
-            block->setData(voxel_coord, voxel_scale + 1, voxel_data);
-          }
+    for (int voxel_scale = scale + 1; voxel_scale <= static_cast<int>(VoxelBlockType::max_scale); ++voxel_scale) {
+      VoxelType::propagateBlockScale(block, voxel_scale);
     }
   }
 
 
 
+  /**
+   * Store the minimum TSDF value and maximum weight of each allocated child
+   * of node in the corresponding node->childData(). VoxelBlocks are summarised
+   * at their current scale. Only observed voxels are considered, the data of
+   * children without any observed voxels is left untouched. The raycast uses
+   * the minimum TSDF value to skip octants that can't contain a surface.
+   */
   static void propagateUp(NodeType*      node,
-                          const int      voxel_depth,
                           const unsigned timestamp) {
 
-    if (!node->parent()) {
-      node->timestamp(timestamp);
-      return;
-    }
-
-    float mean = 0;
-    int sample_count = 0;
-    float weight = 0;
     for (int child_idx = 0; child_idx < 8; ++child_idx) {
-      const VoxelData& child_data = node->childData(child_idx);
-      if (child_data.y != 0) {
-        mean += child_data.x;
-        weight += child_data.y;
-        sample_count++;
+      const NodeType* child = node->child(child_idx);
+      if (!child) {
+        continue;
+      }
+      VoxelData min_data = VoxelType::initData();
+      bool observed = false;
+      auto pool = [&](const VoxelData& data) {
+        if (!VoxelType::isValid(data)) {
+          return;
+        }
+        if (!observed || data.x < min_data.x) {
+          min_data.x = data.x;
+          min_data.x_last = data.x;
+        }
+        min_data.y = std::max(min_data.y, data.y);
+        observed = true;
+      };
+      if (child->isBlock()) {
+        const VoxelBlockType* block = static_cast<const VoxelBlockType*>(child);
+        const int scale = block->current_scale();
+        const int num_voxels = VoxelBlockType::scaleNumVoxels(scale);
+        for (int voxel_idx = 0; voxel_idx < num_voxels; ++voxel_idx) {
+          pool(block->data(voxel_idx, scale));
+        }
+      } else {
+        for (int grandchild_idx = 0; grandchild_idx < 8; ++grandchild_idx) {
+          pool(child->childrenData()[grandchild_idx]);
+        }
+      }
+      if (observed) {
+        node->childData(child_idx, min_data);
       }
-    }
-
-    const unsigned int child_idx = se::child_idx(node->code(),
-                                                 se::keyops::code(node->code()), voxel_depth);
-    if (sample_count > 0) {
-      VoxelData& node_data = node->parent()->childData(child_idx);
-      mean /= sample_count;
-      weight /= sample_count;
-      node_data.x = mean;
-      node_data.x_last = mean;
-      node_data.y = ceil(weight);
-      node_data.delta_y = 0;
     }
     node->timestamp(timestamp);
   }
@@ -296,11 +290,19 @@ struct MultiresTSDFUpdate {
     }
     block->current_scale(voxel_scale);
     block->active(is_visible);
+    block->timestamp(frame_);
   }
 
 
 
-  void operator()(VoxelBlockType* block) {
+  /**
+   * Update a voxel block at the integration scale. If voxel_mask is not
+   * null only the voxels containing a set voxel of voxel_mask are updated,
+   * see se::functor::beam_blocks(). A change of integration scale always
+   * updates the whole block.
+   */
+  void operator()(VoxelBlockType*                               block,
+                  const std::bitset<VoxelBlockType::size_cu>* voxel_mask = nullptr) {
 
     constexpr int block_size = VoxelBlockType::size_li;
     const Eigen::Vector3i block_coord = block->coordinates();
@@ -319,10 +321,26 @@ struct MultiresTSDFUpdate {
     bool is_visible = false;
     block->current_scale(scale);
     const int stride = 1 << scale;
+
+    // Mark the first scale 0 voxel of each voxel at scale that is on a beam.
+    std::bitset<VoxelBlockType::size_cu> beam_voxels;
+    if (voxel_mask) {
+      for (size_t voxel_idx = 0; voxel_idx < voxel_mask->size(); ++voxel_idx) {
+        if ((*voxel_mask)[voxel_idx]) {
+          const int x = (voxel_idx % block_size) & ~(stride - 1);
+          const int y = ((voxel_idx / block_size) % block_size) & ~(stride - 1);
+          const int z = (voxel_idx / (block_size * block_size)) & ~(stride - 1);
+          beam_voxels.set(x + y * block_size + z * block_size * block_size);
+        }
+      }
+    }
     for (unsigned int z = 0; z < block_size; z += stride) {
       for (unsigned int y = 0; y < block_size; y += stride) {
 #pragma omp simd
         for (unsigned int x = 0; x < block_size; x += stride) {
+          if (voxel_mask && !beam_voxels[x + y * block_size + z * block_size * block_size]) {
+            continue;
+          }
           const Eigen::Vector3i voxel_coord = block_coord + Eigen::Vector3i(x, y, z);
           const Eigen::Vector3f voxel_sample_coord_f =
               se::get_sample_coord(voxel_coord, stride, sample_offset_frac_);
@@ -357,11 +375,21 @@ struct MultiresTSDFUpdate {
         }
       }
     }
-    propagateUp(block, scale);
+    // The coarser scales are only recomputed once they are read.
+    for (int voxel_scale = scale + 1; voxel_scale <= static_cast<int>(VoxelBlockType::max_scale); ++voxel_scale) {
+      num_avoided_propagations += block->dirty(voxel_scale);
+    }
+    num_dirtied_scales += VoxelBlockType::max_scale - scale;
+    block->dirtyAbove(scale);
     block->active(is_visible);
+    if (is_visible || scale != last_scale) {
+      block->timestamp(frame_);
+    }
   }
 };
 
+
+
 void MultiresTSDF::integrate(OctreeType&             map,
                              const se::Image<float>& depth_image,
                              const Eigen::Matrix4f&  T_CM,
@@ -370,41 +398,60 @@ void MultiresTSDF::integrate(OctreeType&             map,
 
   using namespace std::placeholders;
 
-  /* Retrieve the active list */
-  std::vector<VoxelBlockType *> active_list;
-  auto& block_buffer = map.pool().blockBuffer();
-
-  /* Predicates definition */
   const float voxel_dim = map.dim() / map.size();
-  auto in_frustum_predicate =
-  std::bind(se::algorithms::in_frustum<VoxelBlockType>,
-      std::placeholders::_1, voxel_dim, T_CM, sensor);
-  auto is_active_predicate = [](const VoxelBlockType* block) {
-    return block->active();
-  };
-  se::algorithms::filter(active_list, block_buffer, is_active_predicate,
-                         in_frustum_predicate);
-
-  std::deque<se::Node<VoxelType> *> node_queue;
   struct MultiresTSDFUpdate block_update_funct(
-      map, depth_image, T_CM, sensor, voxel_dim);
-  se::functor::internal::parallel_for_each(active_list, block_update_funct);
+      map, depth_image, T_CM, sensor, voxel_dim, frame);
+  std::vector<VoxelBlockType *> active_list;
 
-  for (const auto& block : active_list) {
-    if (block->parent()) {
-      node_queue.push_back(block->parent());
+  if (MultiresTSDF::beam_integration) {
+    /* Only update the voxels crossed by a beam within the allocation band */
+    std::vector<se::functor::BeamBlock<VoxelBlockType>> beam_blocks;
+    se::functor::beam_blocks(beam_blocks, map, se::math::to_inverse_transformation(T_CM),
+        sensor, depth_image, [](float) { return Eigen::Vector2f(MultiresTSDF::mu, MultiresTSDF::mu); });
+#pragma omp parallel for
+    for (unsigned int i = 0; i < beam_blocks.size(); ++i) {
+      block_update_funct(beam_blocks[i].block, &beam_blocks[i].voxels);
+    }
+    for (const auto& beam_block : beam_blocks) {
+      active_list.push_back(beam_block.block);
     }
+  } else {
+    /* Retrieve the active list */
+    auto& block_buffer = map.pool().blockBuffer();
+
+    /* Predicates definition */
+    auto in_frustum_predicate =
+    std::bind(se::algorithms::in_frustum<VoxelBlockType>,
+        std::placeholders::_1, voxel_dim, T_CM, sensor);
+    auto is_active_predicate = [](const VoxelBlockType* block) {
+      return block->active();
+    };
+    se::algorithms::filter(active_list, block_buffer, is_active_predicate,
+                           in_frustum_predicate);
+
+    se::functor::internal::parallel_for_each(active_list, block_update_funct);
   }
 
-  while (!node_queue.empty()) {
-    se::Node<VoxelType>* node = node_queue.front();
-    node_queue.pop_front();
-    if (node->timestamp() == frame) {
-      continue;
-    }
-    MultiresTSDFUpdate::propagateUp(node, map.voxelDepth(), frame);
-    if (node->parent()) {
-      node_queue.push_back(node->parent());
-    }
+  se::functor::propagate_up(active_list, [frame](se::Node<VoxelType>* node) {
+    MultiresTSDFUpdate::propagateUp(node, frame);
+  });
+
+  // Block scales that were outdated again before being read, over all the
+  // block scales an eager propagation would have recomputed.
+  const size_t num_dirtied = num_dirtied_scales.exchange(0);
+  const size_t num_avoided = num_avoided_propagations.exchange(0);
+  se::perfstats.sample("propagation_avoided",
+      (num_dirtied > 0) ? 100.0 * num_avoided / num_dirtied : 0.0,
+      PerfStats::PERCENTAGE);
+}
+
+
+
+void MultiresTSDF::integrate(OctreeType&                 map,
+                             const se::IntegrationBatch& batch,
+                             const SensorImpl&           sensor) {
+
+  for (const auto& frame : batch) {
+    integrate(map, frame.depth_image, frame.T_CM, sensor, frame.frame);
   }
 }
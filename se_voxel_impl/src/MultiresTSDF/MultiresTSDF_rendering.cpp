@@ -32,6 +32,7 @@
 #include "se/voxel_implementations/MultiresTSDF/MultiresTSDF.hpp"
 
 #include "se/common.hpp"
+#include "se/empty_space_skipping.hpp"
 #include "se/utils/math_utils.h"
 #include "se/voxel_block_ray_iterator.hpp"
 #include <type_traits>
@@ -70,8 +71,30 @@ Eigen::Vector4f MultiresTSDF::raycast(const OctreeType&      map,
   step_size = se::math::clamp(value_t * MultiresTSDF::mu, MultiresTSDF::mu / 10, MultiresTSDF::mu / 2);
   t += step_size;
 
+  // Octants whose minimum TSDF value is positive can't contain a surface. The
+  // interpolation at the coarsest scale reads voxels up to a VoxelBlock away.
+  auto is_empty = [](const VoxelData& data) { return data.y > 0 && data.x > 0.f; };
+  const float skip_margin = map.voxelDim() * VoxelBlockType::size_li;
+  float t_next_skip = t;
+
   if (value_t > 0) { // ups, if we were already in it, then don't render anything here
     for (; t < t_max; t += step_size) {
+      if (t >= t_next_skip) {
+        const float t_skip = se::skip_empty_space(map, ray_origin_M, ray_dir_M, t, skip_margin,
+            is_empty, t_next_skip);
+        if (t_skip > t) {
+          t = t_skip;
+          if (!find_valid_point(map, VoxelType::selectNodeValue, VoxelType::selectVoxelValue,
+                                ray_origin_M, ray_dir_M, step_size, t_max, t, value_t, point_M_t)) {
+            return Eigen::Vector4f::Zero();
+          }
+          if (value_t < 0) {
+            break;
+          }
+          step_size = se::math::clamp(value_t * MultiresTSDF::mu, MultiresTSDF::mu / 10, MultiresTSDF::mu / 2);
+          continue;
+        }
+      }
       ray_pos_M = ray_origin_M + ray_dir_M * t;
       VoxelData data;
       map.getAtPoint(ray_pos_M, data);
@@ -54,6 +54,7 @@ float OFusion::sigma_max_factor;
 float OFusion::sigma_min;
 float OFusion::sigma_max;
 float OFusion::k_sigma;
+bool  OFusion::beam_integration;
 
 void OFusion::configure(const float voxel_dim) {
   surface_boundary = 0.f;
@@ -65,7 +66,7 @@ void OFusion::configure(const float voxel_dim) {
   sigma_min        = sigma_min_factor * voxel_dim;
   sigma_max        = sigma_max_factor * voxel_dim;
   k_sigma          = 0.01;
-
+  beam_integration = false;
 }
 
 void OFusion::configure(YAML::Node yaml_config, const float voxel_dim) {
@@ -96,6 +97,9 @@ void OFusion::configure(YAML::Node yaml_config, const float voxel_dim) {
   if (yaml_config["k_sigma"]) {
     k_sigma = yaml_config["k_sigma"].as<float>();
   }
+  if (yaml_config["beam_integration"]) {
+    beam_integration = yaml_config["beam_integration"].as<bool>();
+  }
 }
 
 std::string OFusion::printConfig() {
@@ -112,6 +116,7 @@ std::string OFusion::printConfig() {
   out << str_utils::value_to_pretty_str(OFusion::sigma_min,        "sigma min") << "\n";
   out << str_utils::value_to_pretty_str(OFusion::sigma_max,        "sigma max") << "\n";
   out << str_utils::value_to_pretty_str(OFusion::k_sigma,          "k sigma") << "\n";
+  out << str_utils::bool_to_pretty_str(OFusion::beam_integration, "Beam integration") << "\n";
   out << "\n";
   return out.str();
 }
@@ -121,3 +126,21 @@ void OFusion::dumpMesh(OctreeType&                map,
 
   se::algorithms::marching_cube(map, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
 }
+
+
+
+void OFusion::dumpMesh(OctreeType&                map,
+                       se::IndexedMesh&           mesh,
+                       const int                  /* min_scale */) {
+
+  se::algorithms::marching_cube(map, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
+}
+
+
+
+void OFusion::dumpBlockMesh(OctreeType&                map,
+                            const VoxelBlockType*      block,
+                            se::IndexedMesh&           mesh) {
+
+  se::algorithms::marching_cube_block(map, block, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
+}
@@ -32,15 +32,114 @@
 #include "se/voxel_implementations/OFusion/OFusion.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
 
 #include "se/node.hpp"
+#include "se/beam_functor.hpp"
 #include "se/projective_functor.hpp"
+#include "se/functors/propagate_up.hpp"
 #include "se/image/image.hpp"
 #include "se/image_utils.hpp"
 #include "OFusion_bspline_lookup.cc"
 
 
 
+/**
+ * Compute the value of the q_cdf spline using a lookup table. This implements
+ * equation (7) from \cite VespaRAL18.
+ *
+ * \param[in] t Where to compute the value of the spline at.
+ * \return The value of the spline.
+ */
+static inline float ofusion_bspline_memoized(float t) {
+  float value = 0.f;
+  constexpr float inverse_range = 1.f / 6.f;
+  if (t >= -3.0f && t <= 3.0f) {
+    const unsigned int idx
+        = ((t + 3.f) * inverse_range) * (bspline_num_samples - 1) + 0.5f;
+    return bspline_lookup[idx];
+  } else if (t > 3.f) {
+    value = 1.f;
+  }
+  return value;
+}
+
+
+
+/**
+ * Compute the occupancy probability along the ray from the camera. This
+ * implements equation (6) from \cite VespaRAL18.
+ *
+ * \param[in] val The point on the ray at which the occupancy probability is
+ * computed. The point is expressed using the ray parametric equation.
+ * \return The occupancy probability.
+ */
+static inline float ofusion_H(const float val) {
+  const float Q_1 = ofusion_bspline_memoized(val);
+  const float Q_2 = ofusion_bspline_memoized(val - 3);
+  return Q_1 - Q_2 * 0.5f;
+}
+
+
+
+/**
+ * The log-odds occupancy of a single measurement, i.e. the log-odds of
+ * ofusion_H() clamped to [0.03, 0.97]. This implements equations (6) and (9)
+ * from \cite VespaRAL18. It is 0 where ofusion_H() is 0.5, in which case the
+ * measurement carries no information.
+ */
+static inline float ofusion_log_odds(const float val) {
+  const float sample = ofusion_H(val);
+  if (sample == 0.5f) {
+    return 0.f;
+  }
+  const float sample_clamped = se::math::clamp(sample, 0.03f, 0.97f);
+  return log2(sample_clamped / (1.f - sample_clamped));
+}
+
+
+
+/**
+ * ofusion_log_odds() sampled over [-3, 6], the range where ofusion_H() is not
+ * constant, with the same resolution as bspline_lookup.
+ */
+static const float log_odds_lookup_step = 6.f / (bspline_num_samples - 1);
+static const int   log_odds_num_samples = 1.5f * (bspline_num_samples - 1) + 2;
+
+static std::vector<float> ofusion_compute_log_odds_lookup() {
+  std::vector<float> lookup(log_odds_num_samples);
+  for (int i = 0; i < log_odds_num_samples; ++i) {
+    lookup[i] = ofusion_log_odds(-3.f + i * log_odds_lookup_step);
+  }
+  return lookup;
+}
+
+static const std::vector<float> log_odds_lookup = ofusion_compute_log_odds_lookup();
+
+
+
+/**
+ * Compute ofusion_log_odds() using a lookup table, avoiding the two spline
+ * evaluations and the logarithm per voxel.
+ *
+ * \param[in] t The distance from the measured surface along the ray divided
+ * by the measurement uncertainty.
+ * \return The log-odds occupancy of the measurement.
+ */
+static inline float ofusion_log_odds_memoized(const float t) {
+  if (t < -3.f) {
+    return log_odds_lookup.front();
+  } else if (t >= 6.f) {
+    return 0.f;
+  }
+  const int idx = (t + 3.f) * (1.f / log_odds_lookup_step) + 0.5f;
+  return log_odds_lookup[idx];
+}
+
+
+
 /**
  * Struct to hold the data and perform the update of the map from a single
  * depth frame.
@@ -48,12 +147,15 @@
 struct OFusionUpdate {
   const SensorImpl& sensor_;
   float             timestamp_;
+  const unsigned    frame_;
 
 
   OFusionUpdate(const SensorImpl&       sensor,
-                float                   timestamp) :
+                float                   timestamp,
+                const unsigned          frame) :
       sensor_(sensor),
-      timestamp_(timestamp) {};
+      timestamp_(timestamp),
+      frame_(frame) {};
 
 
 
@@ -67,55 +169,9 @@ struct OFusionUpdate {
             template <typename DataT> class VoxelBlockT>
   void operator()(VoxelBlockT<DataType>* block, const bool is_visible) {
     block->active(is_visible);
-  }
-
-
-
-  /**
-   * Compute the value of the q_cdf spline using a lookup table. This implements
-   * equation (7) from \cite VespaRAL18.
-   *
-   * \param[in] t Where to compute the value of the spline at.
-   * \return The value of the spline.
-   */
-  inline float ofusion_bspline_memoized(float t) {
-    float value = 0.f;
-    constexpr float inverse_range = 1.f / 6.f;
-    if (t >= -3.0f && t <= 3.0f) {
-      const unsigned int idx
-          = ((t + 3.f) * inverse_range) * (bspline_num_samples - 1) + 0.5f;
-      return bspline_lookup[idx];
-    } else if (t > 3.f) {
-      value = 1.f;
+    if (is_visible) {
+      block->timestamp(frame_);
     }
-    return value;
-  }
-
-
-
-  /**
-   * Compute the occupancy probability along the ray from the camera. This
-   * implements equation (6) from \cite VespaRAL18.
-   *
-   * \param[in] val The point on the ray at which the occupancy probability is
-   * computed. The point is expressed using the ray parametric equation.
-   * \return The occupancy probability.
-   */
-  inline float ofusion_H(const float val) {
-    const float Q_1 = ofusion_bspline_memoized(val);
-    const float Q_2 = ofusion_bspline_memoized(val - 3);
-    return Q_1 - Q_2 * 0.5f;
-  }
-
-
-
-  /**
-   * Perform a log-odds update of the occupancy probability. This implements
-   * equations (8) and (9) from \cite VespaRAL18.
-   */
-  inline float ofusion_update_logs(const float prior,
-                                   const float sample) {
-    return (prior + log2(sample / (1.f - sample)));
   }
 
 
@@ -125,12 +181,13 @@ struct OFusionUpdate {
    * forgetting factor. This implements equation (10) from \cite VespaRAL18.
    */
   inline float ofusion_apply_window(const float occupancy,
-                                    const float,
                                     const float delta_t,
                                     const float tau) {
-    float fraction = 1.f / (1.f + (delta_t / tau));
-    fraction = std::max(0.5f, fraction);
-    return occupancy * fraction;
+    // The fraction is clamped to 0.5 for delta_t >= tau, skip the division.
+    if (delta_t >= tau) {
+      return 0.5f * occupancy;
+    }
+    return occupancy * (tau / (tau + delta_t));
   }
 
 
@@ -140,27 +197,66 @@ struct OFusionUpdate {
                   const Eigen::Vector3f& point_C,
                   const float            depth_value) {
 
-    // Compute the occupancy probability for the current measurement.
+    // Compute the log-odds occupancy of the current measurement.
     const float m = sensor_.measurementFromPoint(point_C);
     const float diff = (m - depth_value);
     const float sigma = se::math::clamp(OFusion::k_sigma * se::math::sq(m), OFusion::sigma_min, OFusion::sigma_max);
-    float sample = ofusion_H(diff / sigma);
-    if (sample == 0.5f) {
+    const float sample_log_odds = ofusion_log_odds_memoized(diff / sigma);
+    if (sample_log_odds == 0.f) {
       return;
     }
-    sample = se::math::clamp(sample, 0.03f, 0.97f);
 
     auto data = handler.get();
 
     // Update the occupancy probability.
-    const double delta_t = timestamp_ - data.y;
-    data.x = ofusion_apply_window(data.x, OFusion::surface_boundary, delta_t, OFusion::tau);
-    data.x = ofusion_update_logs(data.x, sample);
-    data.x = se::math::clamp(data.x, OFusion::min_occupancy, OFusion::max_occupancy);
+    const float delta_t = timestamp_ - data.y;
+    data.x = ofusion_apply_window(data.x, delta_t, OFusion::tau);
+    data.x = se::math::clamp(data.x + sample_log_odds, OFusion::min_occupancy, OFusion::max_occupancy);
     data.y = timestamp_;
 
     handler.set(data);
   }
+
+
+
+  /**
+   * Store the maximum occupancy of each allocated child of node in the
+   * corresponding node->childData(). Only observed voxels are considered, the
+   * data of children without any observed voxels is left untouched.
+   */
+  static void propagateMax(se::Node<OFusion::VoxelType>* node) {
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      const se::Node<OFusion::VoxelType>* child = node->child(child_idx);
+      if (!child) {
+        continue;
+      }
+      OFusion::VoxelData max_data = OFusion::VoxelType::initData();
+      bool observed = false;
+      auto pool = [&](const OFusion::VoxelData& data) {
+        if (!OFusion::VoxelType::isValid(data)) {
+          return;
+        }
+        if (!observed || data.x > max_data.x) {
+          max_data.x = data.x;
+        }
+        max_data.y = std::max(max_data.y, data.y);
+        observed = true;
+      };
+      if (child->isBlock()) {
+        const OFusion::VoxelBlockType* block = static_cast<const OFusion::VoxelBlockType*>(child);
+        for (unsigned int voxel_idx = 0; voxel_idx < OFusion::VoxelBlockType::size_cu; ++voxel_idx) {
+          pool(block->data(voxel_idx));
+        }
+      } else {
+        for (int grandchild_idx = 0; grandchild_idx < 8; ++grandchild_idx) {
+          pool(child->childrenData()[grandchild_idx]);
+        }
+      }
+      if (observed) {
+        node->childData(child_idx, max_data);
+      }
+    }
+  }
 };
 
 
@@ -173,8 +269,41 @@ void OFusion::integrate(OctreeType&             map,
 
   const float timestamp = (1.f / 30.f) * frame;
 
-  struct OFusionUpdate funct(sensor, timestamp);
+  struct OFusionUpdate funct(sensor, timestamp, frame);
+
+  if (OFusion::beam_integration) {
+    // Carve the free space from the sensor up to the surface and update the
+    // voxels behind it as long as ofusion_H() differs from 0.5.
+    auto range = [](float depth_value) {
+      const float sigma = se::math::clamp(OFusion::k_sigma * se::math::sq(depth_value),
+          OFusion::sigma_min, OFusion::sigma_max);
+      return Eigen::Vector2f(std::numeric_limits<float>::infinity(), 6.f * sigma);
+    };
+    se::functor::beam_functor<OFusion::VoxelType, se::Octree, OFusionUpdate, decltype(range)>
+      beam_funct(map, funct, T_CM, sensor, depth_image, map.sample_offset_frac_, range);
+    beam_funct.apply();
+
+    /* Pool the maximum occupancy of the updated blocks up to the root. */
+    se::functor::propagate_up(beam_funct.activeList(), OFusionUpdate::propagateMax);
+    return;
+  }
+
+  se::functor::projective_functor<OFusion::VoxelType, se::Octree, OFusionUpdate>
+    projective_funct(map, funct, T_CM, sensor, depth_image, map.sample_offset_frac_);
+  projective_funct.apply();
+
+  /* Pool the maximum occupancy of the updated blocks up to the root. */
+  se::functor::propagate_up(projective_funct.activeList(), OFusionUpdate::propagateMax);
+}
 
-  se::functor::projective_octree(map, map.sample_offset_frac_, T_CM, sensor, depth_image, funct);
+
+
+void OFusion::integrate(OctreeType&                 map,
+                        const se::IntegrationBatch& batch,
+                        const SensorImpl&           sensor) {
+
+  for (const auto& frame : batch) {
+    integrate(map, frame.depth_image, frame.T_CM, sensor, frame.frame);
+  }
 }
 
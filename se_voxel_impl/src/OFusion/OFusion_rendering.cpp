@@ -32,6 +32,7 @@
 #include "se/voxel_implementations/OFusion/OFusion.hpp"
 
 #include "se/common.hpp"
+#include "se/empty_space_skipping.hpp"
 #include "se/utils/math_utils.h"
 #include "se/voxel_block_ray_iterator.hpp"
 #include <type_traits>
@@ -68,9 +69,32 @@ Eigen::Vector4f OFusion::raycast(const OctreeType&      map,
   }
   t += step_size;
 
+  // Octants whose maximum occupancy is below the surface boundary can't
+  // contain a surface.
+  auto is_empty = [](const VoxelData& data) {
+    return data.y > 0.f && data.x <= OFusion::surface_boundary;
+  };
+  const float skip_margin = map.voxelDim();
+  float t_next_skip = t;
+
   // if we are not already in it
   if (value_t <= OFusion::surface_boundary) {
     for (; t < t_max; t += step_size) {
+      if (t >= t_next_skip) {
+        const float t_skip = se::skip_empty_space(map, ray_origin_M, ray_dir_M, t, skip_margin,
+            is_empty, t_next_skip);
+        if (t_skip > t) {
+          t = t_skip;
+          if (!find_valid_point(map, VoxelType::selectNodeValue, VoxelType::selectVoxelValue,
+                                ray_origin_M, ray_dir_M, step_size, t_far, t, value_t, point_M_t)) {
+            return Eigen::Vector4f::Zero();
+          }
+          if (value_t > OFusion::surface_boundary) {
+            break;
+          }
+          continue;
+        }
+      }
       ray_pos_M = ray_origin_M + ray_dir_M * t;
       VoxelData data;
       map.getAtPoint(ray_pos_M, data);
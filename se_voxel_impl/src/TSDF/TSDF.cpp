@@ -47,6 +47,7 @@ constexpr bool TSDF::invert_normals;
 float TSDF::mu_factor;
 float TSDF::mu;
 float TSDF::max_weight;
+bool  TSDF::beam_integration;
 
 void TSDF::configure(YAML::Node yaml_config, const float voxel_dim) {
   configure(voxel_dim);
@@ -59,12 +60,16 @@ void TSDF::configure(YAML::Node yaml_config, const float voxel_dim) {
   if (yaml_config["max_weight"]) {
     max_weight = yaml_config["max_weight"].as<float>();
   }
+  if (yaml_config["beam_integration"]) {
+    beam_integration = yaml_config["beam_integration"].as<bool>();
+  }
 }
 
 void TSDF::configure(const float voxel_dim) {
   mu_factor  = 8;
   mu         = mu_factor * voxel_dim;
   max_weight = 100;
+  beam_integration = false;
 }
 
 std::string TSDF::printConfig() {
@@ -75,6 +80,7 @@ std::string TSDF::printConfig() {
   out << str_utils::value_to_pretty_str(TSDF::mu_factor,     "mu factor") << "\n";
   out << str_utils::value_to_pretty_str(TSDF::mu,            "mu") << "\n";
   out << str_utils::value_to_pretty_str(TSDF::max_weight,    "Max weight") << "\n";
+  out << str_utils::bool_to_pretty_str(TSDF::beam_integration, "Beam integration") << "\n";
   out << "\n";
   return out.str();
 }
@@ -84,3 +90,21 @@ void TSDF::dumpMesh(OctreeType&                map,
 
   se::algorithms::marching_cube(map, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
 }
+
+
+
+void TSDF::dumpMesh(OctreeType&                map,
+                    se::IndexedMesh&           mesh,
+                    const int                  /* min_scale */) {
+
+  se::algorithms::marching_cube(map, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
+}
+
+
+
+void TSDF::dumpBlockMesh(OctreeType&                map,
+                         const VoxelBlockType*      block,
+                         se::IndexedMesh&           mesh) {
+
+  se::algorithms::marching_cube_block(map, block, VoxelType::selectVoxelValue, VoxelType::isInside, mesh);
+}
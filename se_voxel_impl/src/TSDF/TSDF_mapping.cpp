@@ -35,6 +35,7 @@
 
 #include "se/octree.hpp"
 #include "se/node.hpp"
+#include "se/beam_functor.hpp"
 #include "se/projective_functor.hpp"
 #include "se/image_utils.hpp"
 
@@ -42,11 +43,13 @@
 
 struct TSDFUpdate {
   const SensorImpl& sensor_;
+  const unsigned    frame_;
 
 
 
-  TSDFUpdate(const SensorImpl& sensor) :
-      sensor_(sensor) {};
+  TSDFUpdate(const SensorImpl& sensor,
+             const unsigned    frame) :
+      sensor_(sensor), frame_(frame) {};
 
   template <typename DataType,
       template <typename DataT> class VoxelBlockT>
@@ -56,6 +59,9 @@ struct TSDFUpdate {
       template <typename DataT> class VoxelBlockT>
   void operator()(VoxelBlockT<DataType>* block, const bool is_visible) {
     block->active(is_visible);
+    if (is_visible) {
+      block->timestamp(frame_);
+    }
   }
 
   template <typename DataHandlerT>
@@ -83,10 +89,42 @@ void TSDF::integrate(OctreeType&             map,
                      const se::Image<float>& depth_image,
                      const Eigen::Matrix4f&  T_CM,
                      const SensorImpl&       sensor,
-                     const unsigned) {
+                     const unsigned          frame) {
+
+  struct TSDFUpdate funct(sensor, frame);
+
+  if (TSDF::beam_integration) {
+    // Only update the voxels crossed by a beam within the allocation band.
+    se::functor::beam_octree(map, map.sample_offset_frac_, T_CM, sensor, depth_image, funct,
+        [](float) { return Eigen::Vector2f(TSDF::mu, TSDF::mu); });
+  } else {
+    se::functor::projective_octree(map, map.sample_offset_frac_, T_CM, sensor, depth_image, funct);
+  }
+}
+
 
-  struct TSDFUpdate funct(sensor);
 
-  se::functor::projective_octree(map, map.sample_offset_frac_, T_CM, sensor, depth_image, funct);
+void TSDF::integrate(OctreeType&                 map,
+                     const se::IntegrationBatch& batch,
+                     const SensorImpl&           sensor) {
+
+  if (batch.empty()) {
+    return;
+  }
+  // One functor per frame so that each VoxelBlock is stamped with the newest
+  // frame that actually observed it.
+  std::vector<TSDFUpdate> functs;
+  functs.reserve(batch.size());
+  for (const auto& frame : batch) {
+    functs.emplace_back(sensor, frame.frame);
+  }
+
+  if (TSDF::beam_integration) {
+    // Beams are walked per frame, so the frames are integrated one by one.
+    se::functor::beam_octree_batch(map, map.sample_offset_frac_, sensor, batch, functs,
+        [](float) { return Eigen::Vector2f(TSDF::mu, TSDF::mu); });
+  } else {
+    se::functor::projective_octree_batch(map, map.sample_offset_frac_, sensor, batch, functs);
+  }
 }
 
@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "se/octree.hpp"
+#include "se/voxel_implementations/MultiresOFusion/MultiresOFusion.hpp"
+#include "../../src/MultiresOFusion/MultiresOFusion.cpp"
+#include "../../src/MultiresOFusion/MultiresOFusion_allocation.cpp"
+#include "../../src/MultiresOFusion/MultiresOFusion_mapping.cpp"
+#include "../../src/MultiresOFusion/MultiresOFusion_rendering.cpp"
+
+#define FRAMES 5
+
+
+
+// A camera looking at a flat wall parallel to its image plane.
+class MultiresOFusionFreeSpaceTest : public ::testing::Test {
+  protected:
+    MultiresOFusionFreeSpaceTest() :
+      depth_image_res_(64, 48),
+      depth_image_(depth_image_res_.x(), depth_image_res_.y(), wall_depth_),
+      sensor_({depth_image_res_.x(), depth_image_res_.y(), false,
+               0.1f, 4.f,
+               50.f, 50.f, depth_image_res_.x() / 2.f, depth_image_res_.y() / 2.f,
+               Eigen::VectorXf(0), Eigen::VectorXf(0)}) {
+    }
+
+    virtual void SetUp() {
+      const int size = 128;
+      const float dim = 2.56f;
+      MultiresOFusion::configure(dim / size);
+      map_.init(size, dim);
+
+      T_MC_ = Eigen::Matrix4f::Identity();
+      T_MC_.topRightCorner<3, 1>() = Eigen::Vector3f(1.28f, 1.28f, 0.3f);
+      const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MC_);
+      std::vector<se::key_t> allocation_list(map_.size() / MultiresOFusion::VoxelBlockType::size_li
+          * depth_image_res_.prod());
+      for (int frame = 0; frame < FRAMES; ++frame) {
+        const size_t num_voxel = MultiresOFusion::buildAllocationList(map_, depth_image_, T_MC_,
+            sensor_, allocation_list.data(), allocation_list.size());
+        map_.allocate(allocation_list.data(), num_voxel);
+        MultiresOFusion::integrate(map_, depth_image_, T_CM, sensor_, frame);
+      }
+    }
+
+    const float wall_depth_ = 1.5f;
+    Eigen::Vector2i depth_image_res_;
+    se::Image<float> depth_image_;
+    SensorImpl sensor_;
+    Eigen::Matrix4f T_MC_;
+    MultiresOFusion::OctreeType map_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(MultiresOFusionFreeSpaceTest, FreeInFrontOfWall) {
+  const Eigen::Vector3f t_MC = T_MC_.topRightCorner<3, 1>();
+  const Eigen::Vector3f free_point_M = t_MC + Eigen::Vector3f(0.f, 0.f, 0.5f * wall_depth_);
+  const Eigen::Vector3f wall_point_M = t_MC + Eigen::Vector3f(0.f, 0.f, wall_depth_);
+  EXPECT_TRUE(MultiresOFusion::isFree(map_, free_point_M, 0));
+  EXPECT_FALSE(MultiresOFusion::isFree(map_, wall_point_M, 0));
+  // Octants containing the wall are not free at any scale.
+  for (int scale = 0; scale < map_.voxelDepth(); ++scale) {
+    EXPECT_FALSE(MultiresOFusion::isFree(map_, wall_point_M, scale));
+  }
+}
+
+
+
+TEST_F(MultiresOFusionFreeSpaceTest, FreeAtCoarseScale) {
+  // The maximum occupancy pooled into the coarse scales is enough to tell a
+  // large octant in front of the wall is free.
+  const Eigen::Vector3f t_MC = T_MC_.topRightCorner<3, 1>();
+  const int scale = MultiresOFusion::VoxelBlockType::max_scale;
+  const float octant_dim = map_.voxelDim() * (1 << scale);
+  const Eigen::Vector3f free_point_M = t_MC
+      + Eigen::Vector3f(0.f, 0.f, wall_depth_ - 3.f * octant_dim);
+  EXPECT_TRUE(MultiresOFusion::isFree(map_, free_point_M, scale));
+}
+
+
+
+TEST_F(MultiresOFusionFreeSpaceTest, PartlyObservedNotFree) {
+  // Pooling a single unobserved voxel makes the pooled data not free.
+  MultiresOFusion::VoxelData child_data[8];
+  std::fill(child_data, child_data + 8,
+      MultiresOFusion::VoxelData{MultiresOFusion::log_odd_min, MultiresOFusion::log_odd_min, 1, true});
+  EXPECT_TRUE(MultiresOFusion::VoxelType::isFree(
+      MultiresOFusion::VoxelType::poolData(child_data, child_data + 8)));
+  child_data[3] = MultiresOFusion::VoxelType::initData();
+  const MultiresOFusion::VoxelData pooled_data = MultiresOFusion::VoxelType::poolData(child_data, child_data + 8);
+  EXPECT_TRUE(pooled_data.observed);
+  EXPECT_FLOAT_EQ(pooled_data.x, MultiresOFusion::log_odd_min);
+  EXPECT_FALSE(MultiresOFusion::VoxelType::isFree(pooled_data));
+
+  // The octants at the root level are mostly outside the camera frustum.
+  const Eigen::Vector3f t_MC = T_MC_.topRightCorner<3, 1>();
+  const Eigen::Vector3f free_point_M = t_MC + Eigen::Vector3f(0.f, 0.f, 0.5f * wall_depth_);
+  ASSERT_TRUE(MultiresOFusion::isFree(map_, free_point_M, 0));
+  EXPECT_FALSE(MultiresOFusion::isFree(map_, free_point_M, map_.voxelDepth() - 1));
+}
+
+
+
+TEST_F(MultiresOFusionFreeSpaceTest, RaycastHitsWall) {
+  const Eigen::Vector3f t_MC = T_MC_.topRightCorner<3, 1>();
+  const Eigen::Vector4f hit_M = MultiresOFusion::raycast(map_, t_MC, Eigen::Vector3f::UnitZ(),
+      sensor_.near_plane, sensor_.far_plane);
+  ASSERT_GE(hit_M.w(), 0.f);
+  EXPECT_NEAR(hit_M.z(), t_MC.z() + wall_depth_, 2.f * map_.voxelDim());
+  EXPECT_NEAR(hit_M.x(), t_MC.x(), 1e-5f);
+  EXPECT_NEAR(hit_M.y(), t_MC.y(), 1e-5f);
+}
+
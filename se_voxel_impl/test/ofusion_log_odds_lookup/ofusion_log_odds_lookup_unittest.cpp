@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+#include "se/voxel_implementations/OFusion/OFusion.hpp"
+#include "../../src/OFusion/OFusion.cpp"
+#include "../../src/OFusion/OFusion_mapping.cpp"
+
+
+
+TEST(OFusionLogOddsLookup, CompactVoxelData) {
+  EXPECT_LE(sizeof(OFusion::VoxelData), 8u);
+}
+
+
+
+TEST(OFusionLogOddsLookup, MatchesDirectComputation) {
+  // Sample well outside [-3, 6] to test the constant parts too.
+  const float t_min = -5.f;
+  const float t_max = 8.f;
+  const float t_step = 1e-4f;
+  float max_error = 0.f;
+  double error_sum = 0.0;
+  int num_samples = 0;
+  for (float t = t_min; t <= t_max; t += t_step) {
+    const float log_odds = ofusion_log_odds(t);
+    const float log_odds_memoized = ofusion_log_odds_memoized(t);
+    const float error = std::fabs(log_odds - log_odds_memoized);
+    max_error = std::max(max_error, error);
+    error_sum += error;
+    num_samples++;
+  }
+  // The error is bounded by the change of the log-odds within one lookup
+  // table step.
+  EXPECT_LT(max_error, 0.02f);
+  EXPECT_LT(error_sum / num_samples, 0.002);
+}
+
+
+
+TEST(OFusionLogOddsLookup, ConstantOutsideSpline) {
+  EXPECT_FLOAT_EQ(ofusion_log_odds_memoized(-10.f), log2(0.03f / 0.97f));
+  EXPECT_FLOAT_EQ(ofusion_log_odds_memoized(-3.5f), ofusion_log_odds(-3.5f));
+  EXPECT_EQ(ofusion_log_odds_memoized(6.5f), 0.f);
+  EXPECT_EQ(ofusion_log_odds_memoized(100.f), 0.f);
+}
+
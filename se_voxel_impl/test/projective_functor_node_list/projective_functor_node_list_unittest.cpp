@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "se/octree.hpp"
+#include "se/projective_functor.hpp"
+
+struct TestVoxelT {
+  typedef float VoxelData;
+  static inline VoxelData invalid(){ return 0.f; }
+  static inline VoxelData initData(){ return 0.f; }
+
+  using VoxelBlockType = se::VoxelBlockFull<TestVoxelT>;
+
+  using MemoryPoolType = se::PagedMemoryPool<TestVoxelT>;
+  template <typename BufferT>
+  using MemoryBufferType = se::PagedMemoryBuffer<BufferT>;
+};
+
+// Mark the Node children updated by projective_functor::update_node.
+struct MarkUpdate {
+  template <typename DataType, template <typename DataT> class VoxelBlockT>
+  void reset(VoxelBlockT<DataType>* /* block */) {}
+
+  template <typename DataType, template <typename DataT> class VoxelBlockT>
+  void operator()(VoxelBlockT<DataType>* /* block */, const bool /* is_visible */) {}
+
+  template <typename DataHandlerT>
+  void operator()(DataHandlerT&          handler,
+                  const Eigen::Vector3f& /* point_C */,
+                  const float            /* depth_value */) {
+    handler.set(1.f);
+  }
+};
+
+// The sensors have a 3 m far plane inside a 12.8 m map so that whole
+// subtrees are outside their frustum.
+template <typename SensorT>
+SensorT test_sensor();
+
+template <>
+se::PinholeCamera test_sensor<se::PinholeCamera>() {
+  return se::PinholeCamera({64, 48, false, 0.1f, 3.f, 50.f, 50.f, 32.f, 24.f,
+                            Eigen::VectorXf(0), Eigen::VectorXf(0)});
+}
+
+template <>
+se::OusterLidar test_sensor<se::OusterLidar>() {
+  se::SensorConfig config;
+  config.width = 64;
+  config.height = 16;
+  config.near_plane = 0.1f;
+  config.far_plane = 3.f;
+  config.beam_azimuth_angles = Eigen::VectorXf::Zero(16);
+  config.beam_elevation_angles = Eigen::VectorXf::LinSpaced(16, 15.f, -15.f);
+  return se::OusterLidar(config);
+}
+
+// Whether the sphere is certainly outside the frustum.
+bool outside_frustum(const se::PinholeCamera& sensor,
+                     const Eigen::Vector3f&   centre_C,
+                     const float              radius) {
+  // Behind the camera or beyond the far plane.
+  return (centre_C.z() + radius < 0.f) || (centre_C.z() - radius > sensor.far_plane);
+}
+
+bool outside_frustum(const se::OusterLidar& sensor,
+                     const Eigen::Vector3f& centre_C,
+                     const float            radius) {
+  // Beyond the far plane in every direction.
+  return centre_C.norm() - radius > sensor.far_plane;
+}
+
+
+
+class ProjectiveFunctorNodeListTest : public ::testing::Test {
+  protected:
+    ProjectiveFunctorNodeListTest() :
+      sensor_(test_sensor<SensorImpl>()),
+      depth_image_(sensor_.model.imageWidth(), sensor_.model.imageHeight(), 2.f) {
+    }
+
+    virtual void SetUp() {
+      octree_.init(128, 12.8f);
+      std::vector<se::key_t> allocation_list;
+      const int block_size = TestVoxelT::VoxelBlockType::size_li;
+      for (int z = 0; z < octree_.size(); z += block_size) {
+        for (int y = 0; y < octree_.size(); y += block_size) {
+          for (int x = 0; x < octree_.size(); x += block_size) {
+            allocation_list.push_back(octree_.hash(x, y, z, octree_.blockDepth()));
+          }
+        }
+      }
+      octree_.allocate(allocation_list.data(), allocation_list.size());
+      // At the map centre, looking along the map z axis.
+      T_MC_ = Eigen::Matrix4f::Identity();
+      T_MC_.topRightCorner<3, 1>() = Eigen::Vector3f::Constant(6.4f);
+    }
+
+    SensorImpl sensor_;
+    se::Image<float> depth_image_;
+    se::Octree<TestVoxelT> octree_;
+    Eigen::Matrix4f T_MC_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(ProjectiveFunctorNodeListTest, VisibleAndCulledNodes) {
+  const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MC_);
+  MarkUpdate funct;
+  se::functor::projective_functor<TestVoxelT, se::Octree, MarkUpdate>
+    node_funct(octree_, funct, T_CM, sensor_, depth_image_, Eigen::Vector3f::Constant(0.5f));
+  node_funct.build_node_list();
+  std::vector<se::Node<TestVoxelT>*> node_list = node_funct.nodeList();
+  std::sort(node_list.begin(), node_list.end());
+  auto in_node_list = [&](se::Node<TestVoxelT>* node) {
+    return std::binary_search(node_list.begin(), node_list.end(), node);
+  };
+
+  auto& node_buffer = octree_.pool().nodeBuffer();
+  ASSERT_FALSE(node_list.empty());
+  EXPECT_LT(node_list.size(), node_buffer.size());
+  EXPECT_TRUE(in_node_list(octree_.root()));
+
+  const float voxel_dim = octree_.voxelDim();
+  size_t num_updated = 0;
+  size_t num_outside = 0;
+  for (unsigned int i = 0; i < node_buffer.size(); ++i) {
+    se::Node<TestVoxelT>* node = node_buffer[i];
+    // Every node update_node can modify must be visible.
+    node_funct.update_node(node, voxel_dim);
+    bool is_updated = false;
+    for (int child_idx = 0; child_idx < 8; ++child_idx) {
+      is_updated |= node->childData(child_idx) == 1.f;
+    }
+    if (is_updated) {
+      num_updated++;
+      EXPECT_TRUE(in_node_list(node)) << "node " << node->coordinates().transpose() << " size " << node->size();
+    }
+
+    // Every node whose bounding sphere is certainly outside the frustum must
+    // be culled.
+    const float node_dim = voxel_dim * node->size();
+    const Eigen::Vector3f node_centre_M = voxel_dim * node->coordinates().cast<float>()
+        + Eigen::Vector3f::Constant(0.5f * node_dim);
+    const Eigen::Vector3f node_centre_C = (T_CM * node_centre_M.homogeneous()).head(3);
+    if (outside_frustum(sensor_, node_centre_C, 0.5f * std::sqrt(3.f) * node_dim)) {
+      num_outside++;
+      EXPECT_FALSE(in_node_list(node)) << "node " << node->coordinates().transpose() << " size " << node->size();
+    }
+  }
+  EXPECT_GT(num_updated, 0u);
+  EXPECT_GT(num_outside, 0u);
+}
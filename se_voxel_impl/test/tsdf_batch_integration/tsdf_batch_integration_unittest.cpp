@@ -0,0 +1,134 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "se/octree.hpp"
+#include "se/integration_frame.hpp"
+#include "se/voxel_implementations/TSDF/TSDF.hpp"
+
+#define FRAMES 6
+#define BATCH_SIZE 4
+
+
+
+class TSDFBatchIntegrationTest : public ::testing::Test {
+  protected:
+    TSDFBatchIntegrationTest() :
+      depth_image_res_(64, 48),
+      sensor_({depth_image_res_.x(), depth_image_res_.y(), false,
+               0.1f, 4.f,
+               50.f, 50.f, depth_image_res_.x() / 2.f, depth_image_res_.y() / 2.f,
+               Eigen::VectorXf(0), Eigen::VectorXf(0)}) {
+    }
+
+    virtual void SetUp() {
+      const int size = 128;
+      const float dim = 2.56f;
+      TSDF::configure(dim / size);
+      sequential_map_.init(size, dim);
+      batch_map_.init(size, dim);
+
+      // A wavy wall in front of a camera moving sideways and forward.
+      for (int frame = 0; frame < FRAMES; ++frame) {
+        se::Image<float> depth_image(depth_image_res_.x(), depth_image_res_.y());
+        for (int y = 0; y < depth_image_res_.y(); ++y) {
+          for (int x = 0; x < depth_image_res_.x(); ++x) {
+            depth_image(x, y) = 1.f - 0.02f * frame + 0.1f * std::sin(0.2f * x + 0.1f * y);
+          }
+        }
+        depth_images_.push_back(depth_image);
+        Eigen::Matrix4f T_MC = Eigen::Matrix4f::Identity();
+        T_MC.topRightCorner<3, 1>() = Eigen::Vector3f(1.f + 0.05f * frame, 1.28f, 0.3f + 0.02f * frame);
+        T_MCs_.push_back(T_MC);
+      }
+    }
+
+    void allocate(TSDF::OctreeType& map, const int frame) {
+      std::vector<se::key_t> allocation_list(map.size() / TSDF::VoxelType::VoxelBlockType::size_li
+          * depth_image_res_.prod());
+      const size_t num_voxel = TSDF::buildAllocationList(map, depth_images_[frame], T_MCs_[frame],
+          sensor_, allocation_list.data(), allocation_list.size());
+      map.allocate(allocation_list.data(), num_voxel);
+    }
+
+    // Integrate all the frames into sequential_map_ one by one and into
+    // batch_map_ in batches and test the maps are identical.
+    void expectIdenticalToSequential() {
+      se::IntegrationBatch batch;
+      for (int frame = 0; frame < FRAMES; ++frame) {
+        const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MCs_[frame]);
+
+        allocate(sequential_map_, frame);
+        TSDF::integrate(sequential_map_, depth_images_[frame], T_CM, sensor_, frame);
+
+        allocate(batch_map_, frame);
+        batch.emplace_back(depth_images_[frame], T_CM, frame,
+            batch_map_.pool().nodeBufferSize(), batch_map_.pool().blockBufferSize());
+        if (batch.size() == BATCH_SIZE || frame == FRAMES - 1) {
+          TSDF::integrate(batch_map_, batch, sensor_);
+          batch.clear();
+        }
+      }
+
+      auto& sequential_block_buffer = sequential_map_.pool().blockBuffer();
+      ASSERT_GT(sequential_block_buffer.size(), 0u);
+      ASSERT_EQ(sequential_block_buffer.size(), batch_map_.pool().blockBuffer().size());
+      const int block_size = TSDF::VoxelType::VoxelBlockType::size_li;
+      size_t num_observed = 0;
+      for (unsigned int i = 0; i < sequential_block_buffer.size(); ++i) {
+        const auto* sequential_block = sequential_block_buffer[i];
+        const auto* batch_block = batch_map_.fetch(sequential_block->coordinates());
+        ASSERT_NE(batch_block, nullptr);
+        EXPECT_EQ(sequential_block->active(), batch_block->active());
+        EXPECT_EQ(sequential_block->timestamp(), batch_block->timestamp());
+        for (int z = 0; z < block_size; ++z) {
+          for (int y = 0; y < block_size; ++y) {
+            for (int x = 0; x < block_size; ++x) {
+              const Eigen::Vector3i voxel_coord = sequential_block->coordinates() + Eigen::Vector3i(x, y, z);
+              const auto sequential_data = sequential_block->data(voxel_coord);
+              EXPECT_EQ(sequential_data, batch_block->data(voxel_coord));
+              num_observed += sequential_data.y > 0.f;
+            }
+          }
+        }
+      }
+      EXPECT_GT(num_observed, 0u);
+
+      auto& sequential_node_buffer = sequential_map_.pool().nodeBuffer();
+      ASSERT_EQ(sequential_node_buffer.size(), batch_map_.pool().nodeBuffer().size());
+      for (unsigned int i = 0; i < sequential_node_buffer.size(); ++i) {
+        auto* sequential_node = sequential_node_buffer[i];
+        const int depth = sequential_map_.voxelDepth() - std::log2(sequential_node->size());
+        auto* batch_node = batch_map_.fetchNode(sequential_node->coordinates(), depth);
+        ASSERT_NE(batch_node, nullptr);
+        for (int child_idx = 0; child_idx < 8; ++child_idx) {
+          EXPECT_EQ(sequential_node->childData(child_idx), batch_node->childData(child_idx));
+        }
+      }
+    }
+
+    Eigen::Vector2i depth_image_res_;
+    SensorImpl sensor_;
+    TSDF::OctreeType sequential_map_;
+    TSDF::OctreeType batch_map_;
+    std::vector<se::Image<float> > depth_images_;
+    std::vector<Eigen::Matrix4f, Eigen::aligned_allocator<Eigen::Matrix4f> > T_MCs_;
+};
+
+
+
+TEST_F(TSDFBatchIntegrationTest, IdenticalToSequential) {
+  expectIdenticalToSequential();
+}
+
+
+
+TEST_F(TSDFBatchIntegrationTest, BeamIdenticalToSequential) {
+  TSDF::beam_integration = true;
+  expectIdenticalToSequential();
+  TSDF::beam_integration = false;
+}
@@ -0,0 +1,179 @@
+// SPDX-FileCopyrightText: 2020 Smart Robotics Lab, Imperial College London
+// SPDX-License-Identifier: BSD-3-Clause
+
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "se/octree.hpp"
+#include "se/voxel_implementations/TSDF/TSDF.hpp"
+#include "../../src/TSDF/TSDF.cpp"
+#include "../../src/TSDF/TSDF_allocation.cpp"
+#include "../../src/TSDF/TSDF_mapping.cpp"
+
+// Only every BEAM_SPACING-th row of the depth image is valid, like the rings
+// of a LIDAR.
+#define BEAM_SPACING 4
+
+
+
+class TSDFBeamIntegrationTest : public ::testing::Test {
+  protected:
+    TSDFBeamIntegrationTest() :
+      depth_image_res_(64, 48),
+      depth_image_(depth_image_res_.x(), depth_image_res_.y()),
+      sensor_({depth_image_res_.x(), depth_image_res_.y(), false,
+               0.1f, 4.f,
+               50.f, 50.f, depth_image_res_.x() / 2.f, depth_image_res_.y() / 2.f,
+               Eigen::VectorXf(0), Eigen::VectorXf(0)}) {
+    }
+
+    virtual void SetUp() {
+      const int size = 128;
+      const float dim = 2.56f;
+      TSDF::configure(dim / size);
+      projective_map_.init(size, dim);
+      beam_map_.init(size, dim);
+
+      for (int y = 0; y < depth_image_res_.y(); ++y) {
+        for (int x = 0; x < depth_image_res_.x(); ++x) {
+          depth_image_(x, y) = (y % BEAM_SPACING == 0) ? 1.f + 0.1f * std::sin(0.2f * x) : 0.f;
+        }
+      }
+      T_MC_ = Eigen::Matrix4f::Identity();
+      T_MC_.topRightCorner<3, 1>() = Eigen::Vector3f(1.28f, 1.28f, 0.3f);
+      allocate(projective_map_);
+      allocate(beam_map_);
+    }
+
+    void allocate(TSDF::OctreeType& map) {
+      std::vector<se::key_t> allocation_list(map.size() / TSDF::VoxelType::VoxelBlockType::size_li
+          * depth_image_res_.prod());
+      const size_t num_voxel = TSDF::buildAllocationList(map, depth_image_, T_MC_,
+          sensor_, allocation_list.data(), allocation_list.size());
+      map.allocate(allocation_list.data(), num_voxel);
+    }
+
+    Eigen::Vector2i depth_image_res_;
+    se::Image<float> depth_image_;
+    SensorImpl sensor_;
+    Eigen::Matrix4f T_MC_;
+    TSDF::OctreeType projective_map_;
+    TSDF::OctreeType beam_map_;
+
+  public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+};
+
+
+
+TEST_F(TSDFBeamIntegrationTest, SubsetOfProjective) {
+  const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MC_);
+  TSDF::beam_integration = false;
+  TSDF::integrate(projective_map_, depth_image_, T_CM, sensor_, 0);
+  TSDF::beam_integration = true;
+  TSDF::integrate(beam_map_, depth_image_, T_CM, sensor_, 0);
+  TSDF::beam_integration = false;
+
+  auto& beam_block_buffer = beam_map_.pool().blockBuffer();
+  const int block_size = TSDF::VoxelType::VoxelBlockType::size_li;
+  size_t num_projective_observed = 0;
+  size_t num_beam_observed = 0;
+  for (unsigned int i = 0; i < beam_block_buffer.size(); ++i) {
+    const auto* beam_block = beam_block_buffer[i];
+    const auto* projective_block = projective_map_.fetch(beam_block->coordinates());
+    ASSERT_NE(projective_block, nullptr);
+    for (int z = 0; z < block_size; ++z) {
+      for (int y = 0; y < block_size; ++y) {
+        for (int x = 0; x < block_size; ++x) {
+          const Eigen::Vector3i voxel_coord = beam_block->coordinates() + Eigen::Vector3i(x, y, z);
+          const auto beam_data = beam_block->data(voxel_coord);
+          const auto projective_data = projective_block->data(voxel_coord);
+          num_projective_observed += projective_data.y > 0.f;
+          if (beam_data.y > 0.f) {
+            // Each voxel on a beam is updated once, like in projective mode.
+            num_beam_observed++;
+            EXPECT_EQ(beam_data, projective_data);
+          }
+        }
+      }
+    }
+  }
+  EXPECT_GT(num_beam_observed, 0u);
+  EXPECT_LT(num_beam_observed, num_projective_observed);
+}
+
+
+
+
+TEST_F(TSDFBeamIntegrationTest, FarPlane) {
+  // The measured surface straddles the far plane.
+  const SensorImpl sensor ({depth_image_res_.x(), depth_image_res_.y(), false,
+                            0.1f, 1.f,
+                            50.f, 50.f, depth_image_res_.x() / 2.f, depth_image_res_.y() / 2.f,
+                            Eigen::VectorXf(0), Eigen::VectorXf(0)});
+  for (int y = 0; y < depth_image_res_.y(); ++y) {
+    for (int x = 0; x < depth_image_res_.x(); ++x) {
+      depth_image_(x, y) = (y % BEAM_SPACING == 0) ? 1.f + 0.5f * TSDF::mu : 0.f;
+    }
+  }
+  TSDF::OctreeType projective_map;
+  TSDF::OctreeType beam_map;
+  projective_map.init(projective_map_.size(), projective_map_.dim());
+  beam_map.init(beam_map_.size(), beam_map_.dim());
+  for (auto* map : {&projective_map, &beam_map}) {
+    std::vector<se::key_t> allocation_list(map->size() / TSDF::VoxelType::VoxelBlockType::size_li
+        * depth_image_res_.prod());
+    const size_t num_voxel = TSDF::buildAllocationList(*map, depth_image_, T_MC_,
+        sensor, allocation_list.data(), allocation_list.size());
+    map->allocate(allocation_list.data(), num_voxel);
+  }
+
+  // No beam voxel lies beyond the far plane.
+  std::vector<se::functor::BeamBlock<TSDF::VoxelType::VoxelBlockType>> beam_blocks;
+  se::functor::beam_blocks(beam_blocks, beam_map, T_MC_, sensor, depth_image_,
+      [](float) { return Eigen::Vector2f(TSDF::mu, TSDF::mu); });
+  ASSERT_FALSE(beam_blocks.empty());
+  const Eigen::Matrix4f T_CM = se::math::to_inverse_transformation(T_MC_);
+  const int block_size = TSDF::VoxelType::VoxelBlockType::size_li;
+  const float voxel_dim = beam_map.voxelDim();
+  for (const auto& beam_block : beam_blocks) {
+    for (size_t voxel_idx = 0; voxel_idx < beam_block.voxels.size(); ++voxel_idx) {
+      if (beam_block.voxels[voxel_idx]) {
+        const Eigen::Vector3i voxel_coord = beam_block.block->coordinates() + Eigen::Vector3i(voxel_idx % block_size,
+            (voxel_idx / block_size) % block_size, voxel_idx / (block_size * block_size));
+        const Eigen::Vector3f voxel_centre_C = (T_CM
+            * (voxel_dim * (voxel_coord.cast<float>() + Eigen::Vector3f::Constant(0.5f))).homogeneous()).head(3);
+        EXPECT_LE(voxel_centre_C.norm(), sensor.farDist(voxel_centre_C) + voxel_dim);
+      }
+    }
+  }
+
+  // The voxels in front of the far plane are still integrated like in
+  // projective mode.
+  TSDF::integrate(projective_map, depth_image_, T_CM, sensor, 0);
+  TSDF::beam_integration = true;
+  TSDF::integrate(beam_map, depth_image_, T_CM, sensor, 0);
+  TSDF::beam_integration = false;
+  auto& beam_block_buffer = beam_map.pool().blockBuffer();
+  size_t num_beam_observed = 0;
+  for (unsigned int i = 0; i < beam_block_buffer.size(); ++i) {
+    const auto* beam_block = beam_block_buffer[i];
+    const auto* projective_block = projective_map.fetch(beam_block->coordinates());
+    ASSERT_NE(projective_block, nullptr);
+    for (int z = 0; z < block_size; ++z) {
+      for (int y = 0; y < block_size; ++y) {
+        for (int x = 0; x < block_size; ++x) {
+          const Eigen::Vector3i voxel_coord = beam_block->coordinates() + Eigen::Vector3i(x, y, z);
+          const auto beam_data = beam_block->data(voxel_coord);
+          if (beam_data.y > 0.f) {
+            num_beam_observed++;
+            EXPECT_EQ(beam_data, projective_block->data(voxel_coord));
+          }
+        }
+      }
+    }
+  }
+  EXPECT_GT(num_beam_observed, 0u);
+}